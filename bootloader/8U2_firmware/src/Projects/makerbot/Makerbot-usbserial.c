@@ -124,8 +124,9 @@ int main(void)
 			  LEDs_TurnOffLEDs(LEDMASK_RX);
 		}
 		
-		/* Load the next byte from the USART transmit buffer into the USART */
-		if (!(RingBuffer_IsEmpty(&USBtoUSART_Buffer))) {
+		/* Load the next byte from the USART transmit buffer into the USART once it can take it; waiting
+		 * for it here would stall USB servicing, which the higher baud rates can not afford */
+		if (!(RingBuffer_IsEmpty(&USBtoUSART_Buffer)) && (UCSR1A & (1 << UDRE1))) {
 		  Serial_TxByte(RingBuffer_Remove(&USBtoUSART_Buffer));
 		  	
 		  	LEDs_TurnOnLEDs(LEDMASK_RX);
@@ -216,6 +217,13 @@ void EVENT_CDC_Device_LineEncodingChanged(USB_ClassInfo_CDC_Device_t* const CDCI
 	UCSR1C = ConfigMask;
 	UCSR1A = (CDCInterfaceInfo->State.LineEncoding.BaudRateBPS == 57600) ? 0 : (1 << U2X1);
 	UCSR1B = ((1 << RXCIE1) | (1 << TXEN1) | (1 << RXEN1));
+
+	/* Above 115200 baud (the motherboard accepts 250000, 500000 and 1000000 once switched with
+	 * HOST_CMD_SET_BAUD), flush received bytes every 1ms rather than every 4ms: the receive buffer
+	 * would otherwise fill between flushes, and responses would wait longer than they take to send */
+	TCCR0B = (CDCInterfaceInfo->State.LineEncoding.BaudRateBPS > 115200)
+			 ? ((1 << CS01) | (1 << CS00))
+			 : (1 << CS02);
 }
 
 /** ISR to manage the reception of data from the serial port, placing received bytes into a circular buffer
@@ -22,6 +22,7 @@ Options:
   --r2=... 			R2 rating where # is the ohm rating of R2 (eg: 10K = 10000)
   --num-temps=... 	the number of temperature points to calculate (default: 20)
   --max-adc=... 	the max ADC reading to use.  if you use R1, it limits the top value for the thermistor circuit, and thus the possible range of ADC values
+  --step=... 		make a table of values every # ADC counts, a power of two, as TemperatureTable.cc holds them
 """
 
 from math import *
@@ -66,9 +67,10 @@ def main(argv):
 	r2 = 1600;
 	num_temps = int(20);
 	max_adc = int(1023);
+	step = 0;
 	
 	try:
-		opts, args = getopt.getopt(argv, "h", ["help", "r0=", "t0=", "beta=", "r1=", "r2=", "max-adc="])
+		opts, args = getopt.getopt(argv, "h", ["help", "r0=", "t0=", "beta=", "r1=", "r2=", "max-adc=", "step="])
 	except getopt.GetoptError:
 		usage()
 		sys.exit(2)
@@ -89,11 +91,20 @@ def main(argv):
 			r2 = int(arg)
 		elif opt == "--max-adc":
 			max_adc = int(arg)
+		elif opt == "--step":
+			step = int(arg)
+			if step < 2 or (step & (step - 1)):
+				usage()
+				sys.exit(2)
 			
 	increment = int(max_adc/(num_temps-1));
 	
 	t = Thermistor(r0, t0, beta, r1, r2)
 
+	if step:
+		grid(t, r0, t0, beta, r1, r2, max_adc, step)
+		return
+
 	adcs = range(1, max_adc, increment);
 #	adcs = [1, 20, 25, 30, 35, 40, 45, 50, 60, 70, 80, 90, 100, 110, 130, 150, 190, 220,  250, 300]
 	first = 1
@@ -119,6 +130,24 @@ def main(argv):
 			print "   {%s, %s}," % (adc, int(t.temp(adc)))
 	print "};"
 	
+# Fraction bits of TemperatureTable.cc's values
+TEMP_TABLE_FRAC_BITS = 4
+
+def grid(t, r0, t0, beta, r1, r2, max_adc, step):
+	"Print values every step ADC counts, with the TempGrid describing them"
+	adcs = range(step, max_adc + 1, step)
+	shift = step.bit_length() - 1
+
+	print "// Made with createTemperatureLookup.py"
+	print "// ./createTemperatureLookup.py --r0=%s --t0=%s --r1=%s --r2=%s --beta=%s --max-adc=%s --step=%s" % (r0, t0, r1, r2, beta, max_adc, step)
+	print "static const int16_t therm_values[] PROGMEM = {"
+	values = ["%6d" % int(round(t.temp(adc) * (1 << TEMP_TABLE_FRAC_BITS))) for adc in adcs]
+	for i in range(0, len(values), 8):
+		print "\t" + ", ".join(values[i:i + 8]) + ("," if i + 8 < len(values) else "")
+	print "};"
+	# The last value is read only to interpolate towards
+	print "// { %s, %s, %s, %s, therm_values }" % (adcs[0], adcs[-1] - 1, adcs[0], shift)
+
 def usage():
     print __doc__
 
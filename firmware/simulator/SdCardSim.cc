@@ -0,0 +1,713 @@
+// SdCardSim.cc
+// An SD card in SPI mode, emulated on the host for lib_sd
+//
+// Only what lib_sd uses is emulated: initialization (CMD0, CMD8, CMD55,
+// ACMD41, CMD58, CMD59, CMD16), single and multiple block reads (CMD17,
+// CMD18, CMD12) and single block writes (CMD24).  Command and data CRCs
+// are checked once the host turns CRC checking on with CMD59.  Timing is
+// measured in bytes clocked: the card's access and programming times are
+// given as numbers of bytes it answers with 0xff or busy.
+
+#define _FILE_OFFSET_BITS 64
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+
+#include "SdCardSim.hh"
+
+// Longest run of bytes the card may queue up for sending
+#define OUT_MAX (1L << 17)
+
+// Largest filler file written by format()
+#define FILLER_MAX 0x80000000UL
+
+// Data tokens and responses
+#define TOKEN_START  0xfe
+#define DATA_ACCEPT  0x05
+#define DATA_CRC_ERR 0x0b
+
+// R1 bits
+#define R1_IDLE      0x01
+#define R1_ILLEGAL   0x04
+#define R1_CRC_ERR   0x08
+#define R1_ADDR_ERR  0x20
+#define R1_PARAM_ERR 0x40
+
+SdSpiData SPDR;
+volatile uint8_t SPCR = 0;
+volatile uint8_t SPSR = 0;
+
+namespace sdsim {
+
+Stats stats;
+
+static int      image = -1;
+static uint64_t card_size = 0;
+static CardType card_type = CARD_SDSC;
+static bool     write_protect = false;
+static uint32_t read_latency = 0;
+static uint32_t write_latency = 0;
+static uint32_t stall_every = 0, stall_bytes = 0, stall_countdown = 0;
+static bool     refused[64];
+static uint32_t corrupt_countdown = 0;
+static uint64_t watch_first = 0, watch_count = 0;
+
+// Card state
+static bool     selected = false;
+static bool     idle = true;
+static bool     app_cmd = false;
+static bool     crc_on = false;
+static uint8_t  op_cond_polls = 0;
+static uint8_t  last_in = 0xff;
+
+// Command being received
+static uint8_t  cmd[6];
+static uint8_t  cmd_len = 0;
+
+// Multiple block read in progress
+static bool     streaming = false;
+static uint64_t stream_block = 0;
+
+// Single block write in progress
+enum { RX_COMMAND, RX_WRITE_TOKEN, RX_WRITE_DATA };
+static int      rx_state = RX_COMMAND;
+static uint64_t write_block = 0;
+static uint8_t  write_buf[514];
+static uint16_t write_len = 0;
+
+// Bytes queued for sending
+static uint8_t  out[OUT_MAX];
+static uint32_t out_head = 0, out_tail = 0;
+
+// Position in the queue of the start token of the block being sent, which
+// is counted as read once the token has been clocked out
+static int64_t  token_at = -1;
+static uint64_t token_block = 0;
+
+static void push(uint8_t b)
+{
+     if (out_tail >= OUT_MAX)
+     {
+	  fprintf(stderr, "sdsim: output queue overflow\n");
+	  exit(1);
+     }
+     out[out_tail++] = b;
+}
+
+static void pushRun(uint8_t b, uint32_t n)
+{
+     while (n--)
+	  push(b);
+}
+
+static void flush()
+{
+     out_head = out_tail = 0;
+     token_at = -1;
+}
+
+// CRC7 with polynomial x^7 + x^3 + 1, as the end of a command frame
+static uint8_t crc7(const uint8_t *data, uint8_t len)
+{
+     uint8_t crc = 0;
+
+     while (len--)
+     {
+	  uint8_t d = *data++;
+	  for (int i = 0; i < 8; i++, d <<= 1)
+	  {
+	       crc <<= 1;
+	       if ((d ^ crc) & 0x80)
+		    crc ^= 0x09;
+	  }
+     }
+     return (uint8_t)((crc << 1) | 1);
+}
+
+// CRC16 with polynomial 0x1021, as follows a data block
+static uint16_t crc16(const uint8_t *data, uint16_t len)
+{
+     uint16_t crc = 0;
+
+     while (len--)
+     {
+	  crc ^= (uint16_t)(*data++) << 8;
+	  for (int i = 0; i < 8; i++)
+	       crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+     }
+     return crc;
+}
+
+bool readImage(uint64_t offset, void *buf, size_t len)
+{
+     if (image < 0 || offset + len > card_size)
+	  return false;
+     return pread(image, buf, len, (off_t)offset) == (ssize_t)len;
+}
+
+bool writeImage(uint64_t offset, const void *buf, size_t len)
+{
+     if (image < 0 || offset + len > card_size)
+	  return false;
+     return pwrite(image, buf, len, (off_t)offset) == (ssize_t)len;
+}
+
+// Convert a command's address argument to a block number
+static bool blockAddress(uint32_t arg, uint64_t *block)
+{
+     if (card_type == CARD_SDHC)
+	  *block = arg;
+     else if (arg & 0x1ff)
+	  return false;
+     else
+	  *block = arg / 512;
+     return (*block + 1) * 512 <= card_size;
+}
+
+// Queue a data block: the access time, the start token, the data and its CRC
+static void queueBlock(uint64_t block)
+{
+     uint8_t data[512];
+
+     if (!readImage(block * 512, data, sizeof(data)))
+	  memset(data, 0, sizeof(data));
+     uint16_t crc = crc16(data, sizeof(data));
+     if (corrupt_countdown && --corrupt_countdown == 0)
+     {
+	  crc ^= 0xffff;
+	  stats.crc_errors++;
+     }
+
+     pushRun(0xff, read_latency);
+     if (stall_every && --stall_countdown == 0)
+     {
+	  pushRun(0xff, stall_bytes);
+	  stall_countdown = stall_every;
+     }
+     token_at = out_tail;
+     token_block = block;
+     push(TOKEN_START);
+     for (int i = 0; i < 512; i++)
+	  push(data[i]);
+     push((uint8_t)(crc >> 8));
+     push((uint8_t)crc);
+}
+
+// Count a block as read once its start token is sent
+static void countBlock()
+{
+     stats.blocks_read++;
+     if (token_block > stats.highest_read)
+	  stats.highest_read = token_block;
+     if (token_block - watch_first < watch_count)
+	  stats.watched_reads++;
+     token_at = -1;
+}
+
+static uint8_t r1(uint8_t bits)
+{
+     return (uint8_t)(bits | (idle ? R1_IDLE : 0));
+}
+
+static void command()
+{
+     uint8_t index = cmd[0] & 0x3f;
+     uint32_t arg = ((uint32_t)cmd[1] << 24) | ((uint32_t)cmd[2] << 16) |
+	  ((uint32_t)cmd[3] << 8) | (uint32_t)cmd[4];
+     bool app = app_cmd;
+     uint64_t block;
+
+     app_cmd = false;
+     stats.commands[index]++;
+
+     if (index == 12)
+     {
+	  // Stop transmission: the data stops, a stuff byte follows the
+	  // command and then R1b
+	  flush();
+	  streaming = false;
+	  push(0x3f);
+	  push(r1(0));
+	  pushRun(0x00, 2);
+	  return;
+     }
+
+     // Any other command also ends a multiple block read
+     flush();
+     streaming = false;
+     push(0xff);
+
+     if (crc_on && index != 0 && crc7(cmd, 5) != cmd[5])
+     {
+	  push(r1(R1_CRC_ERR));
+	  return;
+     }
+     if (refused[index])
+     {
+	  push(r1(R1_ILLEGAL));
+	  return;
+     }
+
+     switch (index)
+     {
+     case 0 :
+	  idle = true;
+	  crc_on = false;
+	  op_cond_polls = 0;
+	  rx_state = RX_COMMAND;
+	  push(r1(0));
+	  break;
+
+     case 8 :
+	  push(r1(0));
+	  push(0x00);
+	  push(0x00);
+	  push((uint8_t)((arg >> 8) & 0x0f));
+	  push((uint8_t)arg);
+	  break;
+
+     case 16 :
+	  push(r1(arg == 512 ? 0 : R1_PARAM_ERR));
+	  break;
+
+     case 17 :
+     case 18 :
+	  if (idle || !blockAddress(arg, &block))
+	  {
+	       push(r1(idle ? R1_ILLEGAL : R1_ADDR_ERR));
+	       break;
+	  }
+	  push(r1(0));
+	  if (index == 17)
+	       queueBlock(block);
+	  else
+	  {
+	       streaming = true;
+	       stream_block = block;
+	  }
+	  break;
+
+     case 24 :
+	  if (idle || !blockAddress(arg, &block))
+	  {
+	       push(r1(idle ? R1_ILLEGAL : R1_ADDR_ERR));
+	       break;
+	  }
+	  push(r1(0));
+	  write_block = block;
+	  rx_state = RX_WRITE_TOKEN;
+	  break;
+
+     case 41 :
+	  if (!app)
+	  {
+	       push(r1(R1_ILLEGAL));
+	       break;
+	  }
+	  // High capacity cards stay busy for hosts which do not support them
+	  if (idle && (card_type == CARD_SDSC || (arg & 0x40000000)) &&
+	      ++op_cond_polls > 2)
+	       idle = false;
+	  push(r1(0));
+	  break;
+
+     case 55 :
+	  app_cmd = true;
+	  push(r1(0));
+	  break;
+
+     case 58 :
+	  push(r1(0));
+	  push((uint8_t)((idle ? 0x00 : 0x80) |
+			 ((card_type == CARD_SDHC && !idle) ? 0x40 : 0x00)));
+	  push(0xff);
+	  push(0x80);
+	  push(0x00);
+	  break;
+
+     case 59 :
+	  crc_on = (arg & 1) != 0;
+	  push(r1(0));
+	  break;
+
+     default :
+	  push(r1(R1_ILLEGAL));
+	  break;
+     }
+}
+
+static void receive(uint8_t b)
+{
+     switch (rx_state)
+     {
+     case RX_WRITE_TOKEN :
+	  if (b == TOKEN_START)
+	  {
+	       rx_state = RX_WRITE_DATA;
+	       write_len = 0;
+	  }
+	  return;
+
+     case RX_WRITE_DATA :
+	  write_buf[write_len++] = b;
+	  if (write_len < sizeof(write_buf))
+	       return;
+	  rx_state = RX_COMMAND;
+	  if (crc_on && crc16(write_buf, 512) !=
+	      (uint16_t)((write_buf[512] << 8) | write_buf[513]))
+	  {
+	       push(DATA_CRC_ERR);
+	       return;
+	  }
+	  if (!write_protect)
+	       writeImage(write_block * 512, write_buf, 512);
+	  stats.blocks_written++;
+	  push(DATA_ACCEPT);
+	  pushRun(0x00, write_latency);
+	  return;
+
+     default :
+	  break;
+     }
+
+     if (cmd_len == 0 && (b & 0xc0) != 0x40)
+	  return;
+     cmd[cmd_len++] = b;
+     if (cmd_len == sizeof(cmd))
+     {
+	  command();
+	  cmd_len = 0;
+     }
+}
+
+uint8_t exchange(uint8_t b)
+{
+     // SPI clock divider, f_OSC / 4 to f_OSC / 128
+     uint32_t divider = (SPCR & 3) == 3 ? 128 : 4 << (2 * (SPCR & 3));
+
+     if (SPSR & (1 << SPI2X))
+	  divider /= 2;
+     stats.clocked++;
+     stats.cycles += 8 * divider;
+
+     if (!selected || image < 0)
+	  return 0xff;
+
+     if (out_head == out_tail)
+     {
+	  flush();
+	  if (streaming)
+	  {
+	       if ((stream_block + 1) * 512 > card_size)
+		    streaming = false;
+	       else
+		    queueBlock(stream_block++);
+	  }
+     }
+
+     if ((int64_t)out_head == token_at)
+	  countBlock();
+     uint8_t reply = (out_head < out_tail) ? out[out_head++] : 0xff;
+     receive(b);
+     return reply;
+}
+
+void select(bool on)
+{
+     if (!on)
+	  cmd_len = 0;
+     selected = on;
+}
+
+bool insert(uint64_t size, CardType type, const char *path)
+{
+     eject();
+
+     if (path)
+	  image = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+     else
+     {
+	  FILE *f = tmpfile();
+	  image = f ? dup(fileno(f)) : -1;
+	  if (f)
+	       fclose(f);
+     }
+     if (image < 0 || ftruncate(image, (off_t)size) != 0)
+     {
+	  perror(path ? path : "tmpfile");
+	  eject();
+	  return false;
+     }
+
+     card_size = size;
+     card_type = type;
+     idle = true;
+     app_cmd = false;
+     crc_on = false;
+     streaming = false;
+     rx_state = RX_COMMAND;
+     cmd_len = 0;
+     flush();
+     return true;
+}
+
+void eject()
+{
+     if (image >= 0)
+	  close(image);
+     image = -1;
+     card_size = 0;
+     selected = false;
+}
+
+bool inserted()
+{
+     return image >= 0;
+}
+
+bool locked()
+{
+     return write_protect;
+}
+
+uint64_t size()
+{
+     return card_size;
+}
+
+void setLocked(bool on)
+{
+     write_protect = on;
+}
+
+void setReadLatency(uint32_t bytes)
+{
+     read_latency = bytes;
+}
+
+void setWriteLatency(uint32_t bytes)
+{
+     write_latency = bytes;
+}
+
+void setReadStall(uint32_t every, uint32_t bytes)
+{
+     stall_every = every;
+     stall_bytes = bytes;
+     stall_countdown = every;
+}
+
+void refuse(uint8_t command)
+{
+     refused[command & 0x3f] = true;
+}
+
+void corruptRead(uint32_t n)
+{
+     corrupt_countdown = n;
+}
+
+void resetStats()
+{
+     memset(&stats, 0, sizeof(stats));
+}
+
+void watch(uint64_t first, uint64_t count)
+{
+     watch_first = first;
+     watch_count = count;
+}
+
+static void put16(uint8_t *p, uint16_t v)
+{
+     p[0] = (uint8_t)v;
+     p[1] = (uint8_t)(v >> 8);
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+     put16(p, (uint16_t)v);
+     put16(p + 2, (uint16_t)(v >> 16));
+}
+
+bool format(bool fat32, uint8_t sectors_per_cluster, uint64_t filler)
+{
+     // Partitions on SD cards start on a 4 MB boundary
+     const uint32_t start = 8192;
+     uint64_t card_sectors = card_size / 512;
+     uint8_t sector[512];
+
+     if (!inserted() || sectors_per_cluster == 0 ||
+	 card_sectors <= start + 1024 || card_sectors - start > 0xffffffffULL)
+	  return false;
+
+     uint32_t total = (uint32_t)(card_sectors - start);
+     uint16_t reserved = fat32 ? 32 : 1;
+     uint16_t root_entries = fat32 ? 0 : 512;
+     uint32_t root_sectors = root_entries * 32 / 512;
+     uint32_t entry = fat32 ? 4 : 2;
+
+     // Size the FAT for the clusters which remain once it is in place
+     uint32_t fat_sectors = 1, clusters;
+     for (;;)
+     {
+	  clusters = (total - reserved - 2 * fat_sectors - root_sectors) / sectors_per_cluster;
+	  uint32_t need = ((clusters + 2) * entry + 511) / 512;
+	  if (need <= fat_sectors)
+	       break;
+	  fat_sectors = need;
+     }
+     if (fat32 ? clusters < 65525 : (clusters < 4085 || clusters >= 65525))
+	  return false;
+
+     // Filler files take the clusters following the root directory
+     uint32_t cluster_bytes = (uint32_t)sectors_per_cluster * 512;
+     uint32_t fill_first = fat32 ? 3 : 2;
+     uint64_t fill_count = (filler + cluster_bytes - 1) / cluster_bytes;
+     uint32_t fill_per_file = FILLER_MAX / cluster_bytes;
+     if (fill_count >= clusters - (fill_first - 2) ||
+	 (fill_count + fill_per_file - 1) / fill_per_file > (fat32 ? sectors_per_cluster * 16u : root_entries))
+	  return false;
+
+     // Partition table
+     memset(sector, 0, sizeof(sector));
+     uint8_t *part = sector + 0x1be;
+     part[1] = 0xfe; part[2] = 0xff; part[3] = 0xff;
+     part[4] = fat32 ? 0x0c : 0x06;
+     part[5] = 0xfe; part[6] = 0xff; part[7] = 0xff;
+     put32(part + 8, start);
+     put32(part + 12, total);
+     sector[510] = 0x55;
+     sector[511] = 0xaa;
+     if (!writeImage(0, sector, sizeof(sector)))
+	  return false;
+
+     // Boot sector
+     uint64_t base = (uint64_t)start * 512;
+     memset(sector, 0, sizeof(sector));
+     sector[0] = 0xeb;
+     sector[1] = fat32 ? 0x58 : 0x3c;
+     sector[2] = 0x90;
+     memcpy(sector + 3, "SAILFISH", 8);
+     put16(sector + 11, 512);
+     sector[13] = sectors_per_cluster;
+     put16(sector + 14, reserved);
+     sector[16] = 2;
+     put16(sector + 17, root_entries);
+     if (!fat32 && total < 0x10000)
+	  put16(sector + 19, (uint16_t)total);
+     else
+	  put32(sector + 32, total);
+     sector[21] = 0xf8;
+     put16(sector + 24, 63);
+     put16(sector + 26, 255);
+     put32(sector + 28, start);
+     if (fat32)
+     {
+	  put32(sector + 36, fat_sectors);
+	  put32(sector + 44, 2);          // Root directory cluster
+	  put16(sector + 48, 1);          // FS information sector
+	  put16(sector + 50, 6);          // Backup boot sector
+	  sector[64] = 0x80;
+	  sector[66] = 0x29;
+	  put32(sector + 67, 0x5a11f15e);
+	  memcpy(sector + 71, "NO NAME    FAT32   ", 19);
+     }
+     else
+     {
+	  put16(sector + 22, (uint16_t)fat_sectors);
+	  sector[36] = 0x80;
+	  sector[38] = 0x29;
+	  put32(sector + 39, 0x5a11f15e);
+	  memcpy(sector + 43, "NO NAME    FAT16   ", 19);
+     }
+     sector[510] = 0x55;
+     sector[511] = 0xaa;
+     if (!writeImage(base, sector, sizeof(sector)) ||
+	 (fat32 && !writeImage(base + 6 * 512, sector, sizeof(sector))))
+	  return false;
+
+     if (fat32)
+     {
+	  memset(sector, 0, sizeof(sector));
+	  put32(sector, 0x41615252);
+	  put32(sector + 484, 0x61417272);
+	  put32(sector + 488, 0xffffffff);
+	  put32(sector + 492, 0xffffffff);
+	  put32(sector + 508, 0xaa550000);
+	  if (!writeImage(base + 512, sector, sizeof(sector)))
+	       return false;
+     }
+
+     // The FATs, then the root directory, which for FAT32 is cluster 2
+     uint32_t first_data = reserved + 2 * fat_sectors + root_sectors;
+     uint32_t clear_to = first_data + (fat32 ? sectors_per_cluster : 0);
+     uint32_t per_sector = 512 / entry;
+     uint64_t fill_end = fill_first + fill_count;
+     for (uint32_t s = reserved; s < clear_to; s++)
+     {
+	  memset(sector, 0, sizeof(sector));
+	  uint32_t c = (s - reserved) % fat_sectors * per_sector;
+	  if (s < reserved + 2 * fat_sectors && c < fill_end)
+	  {
+	       for (uint32_t i = 0; i < per_sector; i++, c++)
+	       {
+		    uint32_t v;
+		    if (c < fill_first)
+			 v = (c == 0) ? 0x0ffffff8 : 0x0fffffff;
+		    else if (c >= fill_end)
+			 break;
+		    else if (c + 1 == fill_end || (c + 1 - fill_first) % fill_per_file == 0)
+			 v = 0x0fffffff;
+		    else
+			 v = c + 1;
+		    if (fat32)
+			 put32(sector + 4 * i, v);
+		    else
+			 put16(sector + 2 * i, (uint16_t)v);
+	       }
+	  }
+	  if (!writeImage(base + (uint64_t)s * 512, sector, sizeof(sector)))
+	       return false;
+     }
+
+     // Root directory entries for the filler files
+     uint64_t root = base + (uint64_t)(reserved + 2 * fat_sectors) * 512;
+     for (uint32_t f = 0; (uint64_t)f * fill_per_file < fill_count; f++)
+     {
+	  uint32_t c = fill_first + f * fill_per_file;
+	  uint64_t left = filler - (uint64_t)f * fill_per_file * cluster_bytes;
+	  uint8_t ent[32];
+	  char name[12];
+
+	  memset(ent, 0, sizeof(ent));
+	  snprintf(name, sizeof(name), "FILLER%02uBIN", f);
+	  memcpy(ent, name, 11);
+	  ent[11] = 0x20;              // Archive
+	  put16(ent + 20, (uint16_t)(c >> 16));
+	  put16(ent + 26, (uint16_t)c);
+	  put32(ent + 28, (uint32_t)(left < FILLER_MAX ? left : FILLER_MAX));
+	  if (!writeImage(root + 32 * f, ent, sizeof(ent)))
+	       return false;
+     }
+
+     return true;
+}
+
+} // namespace sdsim
+
+SdSpiData& SdSpiData::operator=(uint8_t b)
+{
+     sdsim::last_in = sdsim::exchange(b);
+     SPSR |= (1 << SPIF);
+     return *this;
+}
+
+SdSpiData::operator uint8_t() const
+{
+     return sdsim::last_in;
+}
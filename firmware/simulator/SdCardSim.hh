@@ -0,0 +1,142 @@
+// SdCardSim.hh
+// An SD card in SPI mode, emulated on the host for lib_sd
+//
+// When built with -DSIMULATOR, lib_sd's sd_raw_config.h includes this
+// header in place of the AVR headers and pin definitions.  Writing SPDR
+// then clocks a byte out to the emulated card, and the card's reply is
+// read back from SPDR.  The card's blocks are kept in a file, which may be
+// sparse, so that images of large cards cost little disk space.
+//
+// The bytes clocked over the bus and the commands the card receives are
+// counted, so that the cost of a series of lib_sd calls may be measured.
+
+#ifndef SDCARDSIM_HH_
+#define SDCARDSIM_HH_
+
+#include <stdint.h>
+#include <stddef.h>
+
+// SPI register bits, as for the ATmega
+#define SPIE  7
+#define SPE   6
+#define DORD  5
+#define MSTR  4
+#define CPOL  3
+#define CPHA  2
+#define SPR1  1
+#define SPR0  0
+#define SPIF  7
+#define SPI2X 0
+
+// SPDR exchanges a byte with the card when assigned to
+class SdSpiData {
+public:
+     SdSpiData& operator=(uint8_t b);
+     operator uint8_t() const;
+};
+
+extern SdSpiData SPDR;
+extern volatile uint8_t SPCR;
+extern volatile uint8_t SPSR;
+
+#define _delay_us(us) do { } while (0)
+
+#define configure_pin_mosi()
+#define configure_pin_sck()
+#define configure_pin_ss()
+#define configure_pin_miso()
+#define configure_pin_available()
+#define configure_pin_locked()
+
+#define select_card()   sdsim::select(true)
+#define unselect_card() sdsim::select(false)
+
+// Both switches read low when asserted
+#define get_pin_available() (sdsim::inserted() ? 0 : 1)
+#define get_pin_locked()    (sdsim::locked() ? 0 : 1)
+
+namespace sdsim {
+
+// Card classes, which differ in how blocks are addressed
+enum CardType {
+     CARD_SDSC,    // Byte addresses, up to 2 GB
+     CARD_SDHC     // Block addresses
+};
+
+// CPU clock, for converting Stats::cycles to time
+#define SDSIM_F_CPU 16000000UL
+
+typedef struct {
+     uint64_t clocked;            // Bytes exchanged over SPI
+     uint64_t cycles;             // CPU cycles spent clocking them
+     uint32_t commands[64];       // Commands received, by index
+     uint32_t blocks_read;        // Data blocks begun
+     uint32_t blocks_written;     // Data blocks received
+     uint32_t crc_errors;         // Corrupted blocks sent, see corruptRead()
+     uint64_t highest_read;       // Highest block number sent
+     uint32_t watched_reads;      // Blocks sent from the range given to watch()
+} Stats;
+
+extern Stats stats;
+
+// Insert a card of the given size.  Its blocks are kept in the file at
+// path, which is created or truncated to the card's size, or in an
+// anonymous temporary file when path is NULL.  All blocks read as zero.
+bool insert(uint64_t size, CardType type, const char *path = NULL);
+
+// Remove the card and release its image
+void eject();
+
+bool inserted();
+bool locked();
+uint64_t size();
+
+// Write protect switch
+void setLocked(bool locked);
+
+// Number of 0xff bytes the card sends before each data block it reads,
+// as it would while fetching the block from flash
+void setReadLatency(uint32_t bytes);
+
+// Number of busy bytes the card sends after each data block it writes
+void setWriteLatency(uint32_t bytes);
+
+// Have every every'th data block the card reads wait a further bytes
+// 0xff bytes, as a card does when busy with its housekeeping.  every = 0
+// stops the stalls.
+void setReadStall(uint32_t every, uint32_t bytes);
+
+// Answer the given command with "illegal command" from now on
+void refuse(uint8_t command);
+
+// Send a bad CRC with the data block sent n blocks from now, n >= 1
+void corruptRead(uint32_t n);
+
+void resetStats();
+
+// Count the blocks sent from the count blocks starting at block first in
+// Stats::watched_reads
+void watch(uint64_t first, uint64_t count);
+
+// Chip select, driven by lib_sd
+void select(bool on);
+
+// Exchange one byte with the card, as SPDR does
+uint8_t exchange(uint8_t out);
+
+// Direct access to the card's contents, bypassing the bus
+bool readImage(uint64_t offset, void *buf, size_t len);
+bool writeImage(uint64_t offset, const void *buf, size_t len);
+
+// Write a partition table holding one FAT16 or FAT32 partition covering
+// the card, and an empty filesystem in that partition.  With filler
+// non-zero, files FILLER00.BIN, FILLER01.BIN, ... of up to 2 GB each and
+// filler bytes in all take the first clusters, so that files written
+// afterwards lie beyond them.  Their contents are left as zeros.  Returns
+// false if the card is the wrong size for the FAT type and cluster size
+// or too small for the filler.
+bool format(bool fat32, uint8_t sectors_per_cluster, uint64_t filler = 0);
+
+} // namespace sdsim
+
+#endif // SDCARDSIM_HH_
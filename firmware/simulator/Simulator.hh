@@ -40,6 +40,9 @@
 #define CRITICAL_SECTION_START  {}
 #define CRITICAL_SECTION_END    {}
 
+// Likewise avr-libc's <util/atomic.h>: the block is simply run
+#define ATOMIC_BLOCK(type)
+
 // Seems like a good idea, eh?
 #ifndef HAS_STEPPER_ACCELERATION
 #define HAS_STEPPER_ACCELERATION
@@ -60,6 +63,49 @@ extern FPTYPE fpscale2S(FPTYPE x, int lineno, const char *src);
 extern size_t strlcat(char *dst, const char *src, size_t size);
 #endif
 
+// Same as avr-libc's <util/crc16.h>
+static inline uint8_t _crc_ibutton_update(uint8_t crc, uint8_t data)
+{
+     crc = crc ^ data;
+     for (uint8_t i = 0; i < 8; i++)
+     {
+	  if (crc & 0x01)
+	       crc = (crc >> 1) ^ 0x8C;
+	  else
+	       crc >>= 1;
+     }
+     return crc;
+}
+
+static inline uint16_t _crc_ccitt_update(uint16_t crc, uint8_t data)
+{
+     data ^= (uint8_t)(crc & 0xff);
+     data ^= (uint8_t)(data << 4);
+     return ((((uint16_t)data << 8) | (crc >> 8)) ^ (uint8_t)(data >> 4) ^ ((uint16_t)data << 3));
+}
+
+// avr-libc program memory access; the host has a single address space
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t *)(addr))
+#define pgm_read_ptr(addr) (*(void * const *)(addr))
+
+// avr-libc EEPROM access; supplied by harnesses which need it
+extern uint8_t eeprom_read_byte(const uint8_t *addr);
+extern void eeprom_write_byte(uint8_t *addr, uint8_t value);
+extern int eeprom_is_ready(void);
+
+// The board's clock, in microseconds, and its reporting of a failed heater,
+// which is given the HeaterFailMode and the heater's calibration offset;
+// supplied by harnesses which need them
+extern uint32_t simulatorMicros(void);
+extern void simulatorHeaterFail(uint8_t mode, uint8_t heater);
+
+// Scheduler.cc's slices, each given as its TaskId; supplied by harnesses
+// which need it
+extern void simulatorRunTask(uint8_t task);
+
 #endif
 
 #endif
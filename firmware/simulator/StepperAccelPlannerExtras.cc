@@ -500,6 +500,14 @@ void plan_dump_run_data(int time_only)
      printf("Total print time is %02d:%02d:%02d.%02d (%f seconds)\n",
 	    ihours, imins, isecs, idsecs, total_time);
 
+#ifdef VOLUMETRIC_FLOW_LIMIT
+     if (max_filament_speed[0] != 0 || max_filament_speed[1] != 0)
+	  printf("%u blocks slowed by the volumetric flow limit, adding %f seconds (%.2f%%) at nominal speed\n",
+		 simulator_flow_limited, simulator_flow_limited_time,
+		 (total_time > simulator_flow_limited_time) ?
+		 100.0 * simulator_flow_limited_time / (total_time - simulator_flow_limited_time) : 0.0);
+#endif
+
      if (time_only)
 	     return;
 
@@ -0,0 +1,15 @@
+// TemperatureTableRep1.cc
+// Compile TemperatureTable.cc a second time, with the Replicator's
+// thermistor table, into namespace rep1 for temptable.cc
+
+#include <stddef.h>
+#include <stdint.h>
+#include <math.h>
+#include "Simulator.hh"
+#include "TemperatureTable.hh"
+
+#define MODEL_REPLICATOR
+
+namespace rep1 {
+#include "TemperatureTable.cc"
+}
@@ -0,0 +1,62 @@
+// ThermalPlant.cc
+// A heater and its temperature sensor, modelled on the host
+
+#include <string.h>
+
+#include "ThermalPlant.hh"
+
+// A 40 W cartridge in an aluminium block: some 4 C/s when cold, 600 C
+// above ambient were it left on, with a thermocouple.  PLA takes some
+// 0.46 J to melt a cubic millimetre from cold, from a block of 10 J/K.
+// The fan half as much again as the block loses in still air
+const plant_t plant_extruder = {
+     "extruder", 4.0f, 150.0f, 2.0f, 3.0f, 0.25f, 25.0f, 0.046f, 0.5f
+};
+
+// An aluminium plate over a PCB heater: slow, and well short of 300 C
+// above ambient, with a thermistor under the plate
+const plant_t plant_platform = {
+     "platform", 0.6f, 500.0f, 6.0f, 8.0f, 0.10f, 25.0f, 0.0f, 0.0f
+};
+
+ThermalPlant::ThermalPlant(const plant_t *plant, float dt_in, uint32_t seed_in)
+{
+     p = *plant;
+     dt = dt_in;
+     seed = seed_in;
+     ndelay = (uint16_t)(p.dead_time / dt + 0.5f);
+     if (ndelay >= PLANT_MAX_DELAY)
+	  ndelay = PLANT_MAX_DELAY - 1;
+     reset();
+}
+
+void ThermalPlant::reset()
+{
+     temp = p.ambient;
+     sensed = p.ambient;
+     memset(delay, 0, sizeof(delay));
+     idx = 0;
+}
+
+void ThermalPlant::step(uint8_t output, float flow, float fan)
+{
+     // The output applied ndelay steps ago arrives now
+     delay[idx] = output;
+     uint8_t applied = delay[(idx + PLANT_MAX_DELAY - ndelay) % PLANT_MAX_DELAY];
+     idx = (idx + 1) % PLANT_MAX_DELAY;
+
+     temp += dt * (p.rate * applied / 255.0f -
+		   (1.0f + p.fan * fan) * (temp - p.ambient) / p.tau - p.melt * flow);
+     sensed += dt * (temp - sensed) / p.sensor_tau;
+}
+
+float ThermalPlant::read()
+{
+     seed = seed * 1103515245 + 12345;
+     return sensed + p.noise * ((float)((seed >> 8) & 0xffff) / 32768.0f - 1.0f);
+}
+
+float ThermalPlant::holdingOutput(float t) const
+{
+     return 255.0f * (t - p.ambient) / (p.rate * p.tau);
+}
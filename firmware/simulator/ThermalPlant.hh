@@ -0,0 +1,74 @@
+// ThermalPlant.hh
+// A heater and its temperature sensor, modelled on the host
+//
+// The heater is first order plus dead time: full power heats it at rate
+// degrees per second from ambient, it loses heat to ambient with time
+// constant tau, and the power reaches it dead_time seconds after it is
+// applied.  The sensor lags the heater with time constant sensor_tau and
+// its readings carry uniform noise of up to noise degrees either way.
+// Filament melted in the heater draws melt degrees per second for each
+// cubic millimetre per second extruded, and a part cooling fan blowing on
+// it adds the fraction fan to its loss to ambient when at full speed.
+//
+// Presets resembling a MightyBoard extruder and heated platform are
+// provided, so that harnesses may drive the firmware's controllers with
+// the same plants.
+
+#ifndef THERMALPLANT_HH_
+#define THERMALPLANT_HH_
+
+#include <stdint.h>
+
+// Longest dead time, in steps
+#define PLANT_MAX_DELAY 256
+
+typedef struct {
+     const char *name;
+     float rate;             // Degrees per second at full power, from ambient
+     float tau;              // Time constant of the loss to ambient, seconds
+     float dead_time;        // Seconds before power reaches the heater
+     float sensor_tau;       // Time constant of the sensor, seconds
+     float noise;            // Largest sensor noise, degrees
+     float ambient;          // Degrees
+     float melt;             // Degrees per second per mm^3/s extruded
+     float fan;              // Loss added by the fan at full speed, fraction
+} plant_t;
+
+extern const plant_t plant_extruder;
+extern const plant_t plant_platform;
+
+class ThermalPlant {
+private:
+     plant_t p;
+     float dt;
+     float temp;
+     float sensed;
+     uint8_t delay[PLANT_MAX_DELAY];
+     uint16_t ndelay;
+     uint16_t idx;
+     uint32_t seed;
+
+public:
+     // dt_in is the seconds between calls to step()
+     ThermalPlant(const plant_t *plant, float dt_in, uint32_t seed_in = 1);
+
+     // Start over at ambient, with the heater off
+     void reset();
+
+     // Apply an output of 0 - 255 for dt seconds while extruding flow mm^3/s
+     // with the fan at a speed of 0 - 1
+     void step(uint8_t output, float flow = 0.0f, float fan = 0.0f);
+
+     // What the sensor reads, noise included
+     float read();
+
+     // The heater's true temperature
+     float temperature() const { return temp; }
+
+     // Output which holds the heater at a temperature
+     float holdingOutput(float t) const;
+
+     const plant_t *params() const { return &p; }
+};
+
+#endif
@@ -0,0 +1,292 @@
+// autotune.cc
+// Run the relay feedback PID autotune against a modelled heater
+//
+// The autotune in Autotune.cc is given the readings of a ThermalPlant,
+// once per PID update as Heater::manage_temperature() would, and its
+// output drives the plant.  The ultimate gain and period it measures and
+// the gains it derives are reported.
+//
+// The plant is then heated from ambient to the target under the firmware's
+// PID, as Heater::manage_temperature() runs it, first with the default
+// gains and then with the tuned ones.  For each, the overshoot, the time
+// to settle within TARGET_HYSTERESIS of the target for good, and the mean
+// error once settled are reported.  The tune fails if it does not finish,
+// or if its gains overshoot by more than -o degrees or do not settle.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "PID.hh"
+#include "Autotune.hh"
+#include "ThermalPlant.hh"
+
+#if defined(__arm__)
+#define GETOPTS_END (char)-1
+#else
+#define GETOPTS_END -1
+#endif
+
+#define PROGNAME "autotune"
+#define OPTIONS "[-? | -h] [-c cycles] [-e | -p] [-i ms] [-o degrees] [-s seed] [-t target] [-w file]"
+#define GETOPTS ":c:ehi:o:ps:t:w:?"
+
+// As in Heater.hh and Heater.cc
+#define DEFAULT_P 7.0
+#define DEFAULT_I 0.325
+#define DEFAULT_D 36.0
+#define PID_BYPASS_DELTA 15
+#define TARGET_HYSTERESIS 2
+
+typedef struct {
+     const plant_t *plant;
+     int target;
+     int interval_ms;        // SAMPLE_INTERVAL_MICROS_* on a MightyBoard Rev E
+     float run;              // Seconds to run the closed loop for
+} setup_t;
+
+static setup_t setups[] = {
+     { &plant_extruder, 230, 500, 1200.0f },
+     { &plant_platform, 110, 250, 3600.0f }
+};
+
+#define NSETUPS (sizeof(setups) / sizeof(setup_t))
+
+typedef struct {
+     float overshoot;
+     float settled;          // Seconds until within TARGET_HYSTERESIS for good
+     float error;            // Mean absolute error once settled
+} result_t;
+
+static uint8_t cycles = AUTOTUNE_CYCLES;
+static float max_overshoot = 10.0f;
+static uint32_t seed = 1;
+static FILE *wfp = NULL;
+
+static void usage(FILE *f, const char *prog)
+{
+     if (f == NULL)
+	  f = stderr;
+
+     fprintf(f,
+"Usage: %s " OPTIONS "\n"
+"    -c cycles -- Relay cycles to run (default %d)\n"
+"           -e -- Tune the extruder only\n"
+"        -i ms -- Milliseconds between PID updates (default 500 for the\n"
+"                 extruder, 250 for the platform)\n"
+"   -o degrees -- Largest overshoot allowed with the tuned gains (default 10)\n"
+"           -p -- Tune the platform only\n"
+"      -s seed -- Seed for the modelled sensor noise (default 1)\n"
+"    -t target -- Temperature to tune at (default 230 for the extruder,\n"
+"                 110 for the platform)\n"
+"      -w file -- Write the temperatures and outputs to file\n"
+"        ?, -h -- This help message\n",
+	     prog ? prog : PROGNAME, AUTOTUNE_CYCLES);
+}
+
+// Heater::manage_temperature()'s use of its PID
+static int pidStep(PID *pid, bool *bypassing, float pv)
+{
+     int delta = pid->getTarget() - (int)(0.5 + pv);
+
+     if (*bypassing && (delta < PID_BYPASS_DELTA)) {
+	  *bypassing = false;
+	  pid->reset_state();
+     }
+     else if (!*bypassing && (delta > PID_BYPASS_DELTA + 10))
+	  *bypassing = true;
+
+     if (*bypassing)
+	  return 255;
+     int mv = pid->calculate(pv);
+     if (mv < 0) mv = 0;
+     else if (mv > 255) mv = 255;
+     return mv;
+}
+
+static bool tune(const setup_t *s, PIDAutotune *at)
+{
+     float dt = s->interval_ms / 1000.0f;
+     ThermalPlant plant(s->plant, dt, seed);
+     uint32_t n = 0;
+
+     at->start(s->target, cycles);
+     while (at->isRunning())
+     {
+	  float pv = plant.read();
+	  uint8_t mv = at->update(pv);
+	  if (wfp)
+	       fprintf(wfp, "tune %s %.2f %.3f %u\n", s->plant->name, n * dt, pv, mv);
+	  plant.step(mv);
+	  n++;
+     }
+
+     if (at->getState() != PIDAutotune::AT_DONE)
+     {
+	  printf("%-9s tune at %d failed after %.0f s and %u cycles\n",
+		 s->plant->name, s->target, n * dt, at->getCycles());
+	  return false;
+     }
+     printf("%-9s tune at %d took %.0f s: Ku %.2f, Tu %.1f s; P %.4f, I %.4f, D %.4f\n",
+	    s->plant->name, s->target, n * dt, at->getUltimateGain(),
+	    at->getUltimatePeriod() * dt, at->getPGain() / 256.0,
+	    at->getIGain() / 256.0, at->getDGain() / 256.0);
+     return true;
+}
+
+static void closedLoop(const setup_t *s, uint16_t p, uint16_t i, uint16_t d,
+		       const char *what, result_t *res)
+{
+     float dt = s->interval_ms / 1000.0f;
+     ThermalPlant plant(s->plant, dt, seed);
+     PID pid;
+     bool bypassing = false;
+     uint32_t nsteps = (uint32_t)(s->run / dt);
+     uint32_t settled = 0, nerr = 0;
+     float err = 0;
+
+     pid.setPGain(p);
+     pid.setIGain(i);
+     pid.setDGain(d);
+     pid.setTarget(s->target);
+     res->overshoot = 0;
+     for (uint32_t n = 0; n < nsteps; n++)
+     {
+	  float pv = plant.read();
+	  uint8_t mv = (uint8_t)pidStep(&pid, &bypassing, pv);
+	  if (wfp)
+	       fprintf(wfp, "%s %s %.2f %.3f %u\n", what, s->plant->name, n * dt, pv, mv);
+	  plant.step(mv);
+
+	  float e = plant.temperature() - s->target;
+	  if (e > res->overshoot)
+	       res->overshoot = e;
+	  if (fabsf(e) > TARGET_HYSTERESIS)
+	  {
+	       settled = n + 1;
+	       err = 0;
+	       nerr = 0;
+	  }
+	  else
+	  {
+	       err += fabsf(e);
+	       nerr++;
+	  }
+     }
+     res->settled = (settled < nsteps) ? settled * dt : -1.0f;
+     res->error = nerr ? err / nerr : 0;
+}
+
+static void report(const setup_t *s, const char *what, const result_t *res)
+{
+     if (res->settled < 0)
+	  printf("%-9s %-7s overshoot %5.1f, never settled\n",
+		 s->plant->name, what, res->overshoot);
+     else
+	  printf("%-9s %-7s overshoot %5.1f, settled after %5.0f s, then off by %.2f on average\n",
+		 s->plant->name, what, res->overshoot, res->settled, res->error);
+}
+
+int main(int argc, const char *argv[])
+{
+     char c;
+     int interval = 0, target = 0;
+     bool extruder = true, platform = true, ok = true;
+     const char *wname = NULL;
+
+     while ((c = getopt(argc, (char **)argv, GETOPTS)) != GETOPTS_END)
+     {
+	  switch(c)
+	  {
+	  // Unknown switch
+	  case ':' :
+	  default :
+	       usage(stderr, argv[0]);
+	       return(1);
+
+	  // Explicit help request
+	  case 'h' :
+	  case '?' :
+	       usage(stdout, argv[0]);
+	       return(0);
+
+	  case 'c' :
+	       cycles = (uint8_t)strtoul(optarg, NULL, 0);
+	       break;
+
+	  case 'e' :
+	       platform = false;
+	       break;
+
+	  case 'i' :
+	       interval = (int)strtol(optarg, NULL, 0);
+	       break;
+
+	  case 'o' :
+	       max_overshoot = strtof(optarg, NULL);
+	       break;
+
+	  case 'p' :
+	       extruder = false;
+	       break;
+
+	  case 's' :
+	       seed = (uint32_t)strtoul(optarg, NULL, 0);
+	       break;
+
+	  case 't' :
+	       target = (int)strtol(optarg, NULL, 0);
+	       break;
+
+	  case 'w' :
+	       wname = optarg;
+	       break;
+	  }
+     }
+
+     if (interval < 0 || interval > 2000 || target < 0 || target > 280)
+     {
+	  fprintf(stderr, "The interval must be at most 2000 ms and the target at most 280\n");
+	  return(1);
+     }
+     if (wname && !(wfp = fopen(wname, "w")))
+     {
+	  fprintf(stderr, "Unable to create the file \"%s\"\n", wname);
+	  return(1);
+     }
+
+     for (size_t k = 0; k < NSETUPS; k++)
+     {
+	  setup_t *s = &setups[k];
+	  PIDAutotune at;
+	  result_t def, tuned;
+
+	  if ((s->plant == &plant_extruder && !extruder) ||
+	      (s->plant == &plant_platform && !platform))
+	       continue;
+	  if (interval)
+	       s->interval_ms = interval;
+	  if (target)
+	       s->target = target;
+
+	  if (!tune(s, &at))
+	  {
+	       ok = false;
+	       continue;
+	  }
+	  closedLoop(s, PID_GAIN_Q8_8(DEFAULT_P), PID_GAIN_Q8_8(DEFAULT_I),
+		     PID_GAIN_Q8_8(DEFAULT_D), "default", &def);
+	  report(s, "default", &def);
+	  closedLoop(s, at.getPGain(), at.getIGain(), at.getDGain(), "tuned", &tuned);
+	  report(s, "tuned", &tuned);
+	  if (tuned.settled < 0 || tuned.overshoot > max_overshoot)
+	       ok = false;
+     }
+
+     if (wfp)
+	  fclose(wfp);
+     return(ok ? 0 : 1);
+}
@@ -0,0 +1,356 @@
+// checkpointsim.cc
+// Exercise the print checkpoint EEPROM ring against simulated power failures
+//
+// The EEPROM is emulated, including the busy period following a write.
+// Power is cut at random points during header and record writes: the byte
+// being written when power fails is left holding garbage and all further
+// writes are lost.  After each failure, the firmware is "rebooted" and the
+// checkpoint it then finds must be either the last fully written checkpoint
+// or the one which was being written.  It must never be garbage.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "Simulator.hh"
+#include "Checkpoint.hh"
+#include "EepromMap.hh"
+
+#if defined(__arm__)
+#define GETOPTS_END (char)-1
+#else
+#define GETOPTS_END -1
+#endif
+
+#define PROGNAME "checkpointsim"
+#define OPTIONS "[-? | -h] [-n iterations] [-s seed] [-v]"
+#define GETOPTS ":hn:s:v?"
+
+#define EEPROM_SIZE 4096
+
+// Number of eeprom_is_ready() polls which see the EEPROM busy after a write
+#define EEPROM_BUSY_POLLS 3
+
+static uint8_t  eeprom_image[EEPROM_SIZE];
+static uint32_t wear[EEPROM_SIZE];
+static int      busy = 0;
+static bool     powered = true;
+static int32_t  cut_countdown = -1;
+static uint32_t bytes_written = 0;
+static int      verbose = 0;
+
+static uint16_t eeprom_address(const uint8_t *addr)
+{
+     uintptr_t a = (uintptr_t)addr;
+
+     if (a >= EEPROM_SIZE)
+     {
+	  fprintf(stderr, "EEPROM address 0x%lx out of range\n", (unsigned long)a);
+	  exit(1);
+     }
+     return (uint16_t)a;
+}
+
+uint8_t eeprom_read_byte(const uint8_t *addr)
+{
+     // avr-libc waits for any write in progress to complete
+     busy = 0;
+     return eeprom_image[eeprom_address(addr)];
+}
+
+void eeprom_write_byte(uint8_t *addr, uint8_t value)
+{
+     uint16_t a = eeprom_address(addr);
+
+     if (!powered)
+	  return;
+
+     if (busy)
+     {
+	  fprintf(stderr, "EEPROM write to 0x%04x while busy\n", a);
+	  exit(1);
+     }
+
+     if (cut_countdown == 0)
+     {
+	  // Power fails mid write: the cell is left in an unknown state
+	  eeprom_image[a] = (uint8_t)rand();
+	  powered = false;
+	  cut_countdown = -1;
+	  return;
+     }
+     else if (cut_countdown > 0)
+	  cut_countdown--;
+
+     eeprom_image[a] = value;
+     wear[a]++;
+     bytes_written++;
+     busy = EEPROM_BUSY_POLLS;
+}
+
+int eeprom_is_ready(void)
+{
+     if (busy)
+     {
+	  busy--;
+	  return 0;
+     }
+     return 1;
+}
+
+static void usage(FILE *f, const char *prog)
+{
+     if (f == NULL)
+	  f = stderr;
+
+     fprintf(f,
+"Usage: %s " OPTIONS "\n"
+" -n iterations -- Number of checkpoints to write (default 100000)\n"
+"       -s seed -- Random number seed (default 1)\n"
+"            -v -- Report each power failure\n"
+"         ?, -h -- This help message\n",
+	     prog ? prog : PROGNAME);
+}
+
+static void reboot(void)
+{
+     powered = true;
+     busy = 0;
+     checkpoint::init();
+}
+
+// Run the writer until it finishes or the power fails
+// Returns true if the write completed
+static bool flush(void)
+{
+     while (powered && checkpoint::isWriting())
+	  checkpoint::runWriterSlice();
+     return powered;
+}
+
+static void fill(checkpoint::Record& rec, uint32_t n)
+{
+     memset(&rec, 0, sizeof(rec));
+     rec.sd_offset   = 1000 + n * 37;
+     rec.line_number = n * 3;
+     rec.tool        = (n >> 8) & 1;
+     for (int i = 0; i < 5; i++)
+	  rec.position[i] = (int32_t)(n * (i + 1) * 11) - 5000;
+     rec.temp[0] = 220;
+     rec.temp[1] = (n & 0x400) ? 230 : 0;
+     rec.temp[2] = 110;
+     rec.fan = (n >> 6) & 1;
+}
+
+static const char *describe(const checkpoint::Record& rec)
+{
+     static char buf[64];
+     snprintf(buf, sizeof(buf), "seq %u, line %u", rec.seq, rec.line_number);
+     return buf;
+}
+
+int main(int argc, const char *argv[])
+{
+     char c;
+     uint32_t iterations = 100000;
+     unsigned int seed = 1;
+     uint32_t cuts = 0, header_cuts = 0, lost = 0, builds = 0;
+     uint32_t requested = 0;
+
+     while ((c = getopt(argc, (char **)argv, GETOPTS)) != GETOPTS_END)
+     {
+	  switch(c)
+	  {
+	  // Unknown switch
+	  case ':' :
+	  default :
+	       usage(stderr, argv[0]);
+	       return(1);
+
+	  // Explicit help request
+	  case 'h' :
+	  case '?' :
+	       usage(stdout, argv[0]);
+	       return(0);
+
+	  case 'n' :
+	       iterations = (uint32_t)strtoul(optarg, NULL, 0);
+	       break;
+
+	  case 's' :
+	       seed = (unsigned int)strtoul(optarg, NULL, 0);
+	       break;
+
+	  case 'v' :
+	       verbose = 1;
+	       break;
+	  }
+     }
+
+     srand(seed);
+
+     // A fresh, erased EEPROM holds no checkpoint
+     memset(eeprom_image, 0xff, sizeof(eeprom_image));
+     reboot();
+     if (checkpoint::available())
+     {
+	  fprintf(stderr, "Erased EEPROM reports a checkpoint\n");
+	  return(1);
+     }
+
+     char name[CHECKPOINT_NAME_LEN + 1];
+     char loaded_name[CHECKPOINT_NAME_LEN + 1];
+     checkpoint::Record committed, inflight, loaded;
+     bool have_committed = false;
+
+     snprintf(name, sizeof(name), "PART%04u.S3G", builds++);
+     checkpoint::beginBuild(name);
+     flush();
+
+     for (uint32_t n = 0; n < iterations; n++)
+     {
+	  bool new_build = (rand() % 64) == 0;
+	  char new_name[CHECKPOINT_NAME_LEN + 1];
+
+	  // Arm a power failure somewhere within the next write
+	  if ((rand() % 4) == 0)
+	       cut_countdown = rand() % (new_build ? sizeof(checkpoint::Header) :
+					 sizeof(checkpoint::Record));
+
+	  if (new_build)
+	  {
+	       snprintf(new_name, sizeof(new_name), "PART%04u.S3G", builds++);
+	       checkpoint::endBuild();
+	       checkpoint::beginBuild(new_name);
+	  }
+	  else
+	  {
+	       fill(inflight, n);
+	       if (!checkpoint::save(inflight))
+	       {
+		    fprintf(stderr, "%u: save() refused with no write in progress\n", n);
+		    return(1);
+	       }
+	       requested += sizeof(checkpoint::Record);
+	  }
+
+	  if (flush())
+	  {
+	       cut_countdown = -1;
+	       if (new_build)
+	       {
+		    strcpy(name, new_name);
+		    have_committed = false;
+	       }
+	       else
+	       {
+		    committed = inflight;
+		    have_committed = true;
+	       }
+	       continue;
+	  }
+
+	  // Power failed; see what survived
+	  cuts++;
+	  reboot();
+	  bool found = checkpoint::load(loaded, loaded_name);
+
+	  if (new_build)
+	  {
+	       // A torn header invalidates every slot; an intact old header
+	       // leaves the old build's checkpoint in place
+	       header_cuts++;
+	       if (found && !(have_committed &&
+			      !memcmp(&loaded, &committed, sizeof(loaded)) &&
+			      !strcmp(loaded_name, name)))
+	       {
+		    fprintf(stderr, "%u: header write interrupted, found %s of %s\n",
+			    n, describe(loaded), loaded_name);
+		    return(1);
+	       }
+	       if (verbose)
+		    printf("%u: header write interrupted, %s\n", n,
+			   found ? "old build retained" : "no checkpoint");
+	       if (found)
+		    lost++;
+
+	       // Start the new build over again
+	       strcpy(name, new_name);
+	       have_committed = false;
+	       checkpoint::beginBuild(name);
+	       flush();
+	       continue;
+	  }
+
+	  if (!found)
+	  {
+	       if (have_committed)
+	       {
+		    fprintf(stderr, "%u: record write interrupted, lost checkpoint %s\n",
+			    n, describe(committed));
+		    return(1);
+	       }
+	       if (verbose)
+		    printf("%u: record write interrupted, no checkpoint\n", n);
+	       continue;
+	  }
+
+	  if (strcmp(loaded_name, name))
+	  {
+	       fprintf(stderr, "%u: checkpoint for \"%s\" found, expected \"%s\"\n",
+		       n, loaded_name, name);
+	       return(1);
+	  }
+
+	  if (!memcmp(&loaded, &inflight, sizeof(loaded)))
+	  {
+	       if (verbose)
+		    printf("%u: record write interrupted, new checkpoint %s\n",
+			   n, describe(loaded));
+	  }
+	  else if (have_committed && !memcmp(&loaded, &committed, sizeof(loaded)))
+	  {
+	       if (verbose)
+		    printf("%u: record write interrupted, old checkpoint %s\n",
+			   n, describe(loaded));
+	       lost++;
+	  }
+	  else
+	  {
+	       fprintf(stderr, "%u: record write interrupted, found garbage %s\n",
+		       n, describe(loaded));
+	       return(1);
+	  }
+
+	  committed = loaded;
+	  have_committed = true;
+     }
+
+     // Wear across the ring
+     uint32_t wmin = 0xffffffff, wmax = 0, wsum = 0;
+     for (uint16_t a = eeprom_offsets::CHECKPOINT_RING;
+	  a < eeprom_offsets::CHECKPOINT_RING + CHECKPOINT_SLOTS * sizeof(checkpoint::Record); a++)
+     {
+	  if (wear[a] < wmin) wmin = wear[a];
+	  if (wear[a] > wmax) wmax = wear[a];
+	  wsum += wear[a];
+     }
+     uint32_t hmax = 0;
+     for (uint16_t a = eeprom_offsets::CHECKPOINT_HEADER;
+	  a < eeprom_offsets::CHECKPOINT_HEADER + sizeof(checkpoint::Header); a++)
+	  if (wear[a] > hmax) hmax = wear[a];
+
+     printf("%u checkpoints, %u builds, %u power failures (%u during header writes)\n",
+	    iterations, builds, cuts, header_cuts);
+     printf("%u interrupted writes fell back to the previous checkpoint\n", lost);
+     printf("%u slots of %u bytes; %u of %u record bytes needed writing\n",
+	    (unsigned int)CHECKPOINT_SLOTS, (unsigned int)sizeof(checkpoint::Record),
+	    bytes_written, requested);
+     printf("ring wear per byte: min %u, mean %.1f, max %u; header max %u\n",
+	    wmin, (float)wsum / (float)(CHECKPOINT_SLOTS * sizeof(checkpoint::Record)),
+	    wmax, hmax);
+
+     return(0);
+}
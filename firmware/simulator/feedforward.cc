@@ -0,0 +1,333 @@
+// feedforward.cc
+// Hold a modelled hotend at temperature through changes in extrusion rate
+//
+// An extruder is modelled with a ThermalPlant which filament draws heat
+// from as it is melted.  It is heated to the target under the firmware's
+// PID, as Heater::manage_temperature() runs it, and then "prints" moves
+// which alternate between slow perimeters and fast infill, with a retract
+// and a travel between each.  The moves are queued in a ring of block_t
+// as the planner would queue them, and the planner's lookahead is kept
+// full as they are executed.
+//
+// The print is run three times: with the PID alone and every section at
+// the perimeter flow, which gives the wander of the PID itself; with the
+// PID alone; and with the output which FeedForward.cc derives from the
+// queued blocks added to the PID's, as Heater::manage_temperature() does.
+// For each, the most the hotend falls below and rises above the target and
+// the RMS error are reported.  The feed-forward fails if it does not cut
+// the fall below the target, beyond the PID's own wander, by at least the
+// fraction -r.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "PID.hh"
+#include "FeedForward.hh"
+#include "StepperAxis.hh"
+#include "ThermalPlant.hh"
+
+#if defined(__arm__)
+#define GETOPTS_END (char)-1
+#else
+#define GETOPTS_END -1
+#endif
+
+#define PROGNAME "feedforward"
+#define OPTIONS "[-? | -h] [-c coefficient] [-f mm^3/s] [-p mm^3/s] [-r fraction] [-s seed] [-t target] [-w file]"
+#define GETOPTS ":c:f:hp:r:s:t:w:?"
+
+// As in Heater.hh and Heater.cc
+#define DEFAULT_P 7.0
+#define DEFAULT_I 0.325
+#define DEFAULT_D 36.0
+#define PID_BYPASS_DELTA 15
+#define HEATER_OFFSET_ADJUSTMENT 0
+
+// As in EepromMap.hh, and the MightyBoard's extruder steps per mm
+#define DEFAULT_COEFFICIENT 2.9
+#define FILAMENT_DIAMETER 1.75
+#define STEPS_PER_MM 96.275
+
+// Seconds per plant step, and plant steps per PID update
+#define DT 0.1f
+#define PID_STEPS 5
+
+// Seconds to heat up and settle for before printing
+#define WARM_UP 600
+
+// Sections of perimeters and of infill, each this long, in seconds
+#define SECTION 30
+#define SECTIONS 10
+
+// Seconds per printing move
+#define MOVE_TIME 0.5f
+
+#define MAX_MOVES 1024
+
+typedef struct {
+     float max_below;        // Most the hotend fell below the target
+     float max_above;        // Most it rose above the target
+     float rms;              // RMS error over the print
+} result_t;
+
+static float coefficient = DEFAULT_COEFFICIENT;
+static float perimeter_flow = 3.0f;
+static float infill_flow = 15.0f;
+static float min_reduction = 0.5f;
+static uint32_t seed = 1;
+static int target = 230;
+static FILE *wfp = NULL;
+
+// The print, and the flow each move of it extrudes, mm^3/s
+static block_t moves[MAX_MOVES];
+static float flows[MAX_MOVES];
+static uint16_t nmoves = 0;
+
+static void usage(FILE *f, const char *prog)
+{
+     if (f == NULL)
+	  f = stderr;
+
+     fprintf(f,
+"Usage: %s " OPTIONS "\n"
+"  -c coefficient -- Feed-forward, output per mm^3/s (default %.1f)\n"
+"       -f mm^3/s -- Infill flow (default 15)\n"
+"       -p mm^3/s -- Perimeter flow (default 3)\n"
+"     -r fraction -- Least fraction of the sag from the changes in flow\n"
+"                    the feed-forward must cut (default 0.5)\n"
+"         -s seed -- Seed for the modelled sensor noise (default 1)\n"
+"       -t target -- Temperature to print at (default 230)\n"
+"         -w file -- Write the temperatures, outputs and flows to file\n"
+"           ?, -h -- This help message\n",
+	     prog ? prog : PROGNAME, DEFAULT_COEFFICIENT);
+}
+
+static float area()
+{
+     return (float)M_PI * 0.25f * FILAMENT_DIAMETER * FILAMENT_DIAMETER;
+}
+
+// Queue a move of the given seconds at speed mm/s extruding e mm of filament
+static void addMove(float seconds, float speed, float e, bool xy)
+{
+     if (nmoves >= MAX_MOVES)
+	  return;
+
+     block_t *b = &moves[nmoves];
+     float mm = xy ? speed * seconds : fabsf(e);
+
+     memset(b, 0, sizeof(block_t));
+     b->steps[X_AXIS] = xy ? (int32_t)(mm * 88.573186f) : 0;
+     b->steps[A_AXIS] = (int32_t)(e * STEPS_PER_MM);
+     b->millimeters = ftok(mm);
+     b->nominal_speed = ftok(mm / seconds);
+     b->use_accel = 1;
+     flows[nmoves] = (xy && e > 0) ? e * area() / seconds : 0.0f;
+     nmoves++;
+}
+
+// Perimeters and infill in turn, each preceded by a retract, a travel and
+// a prime
+static void buildPrint(float infill)
+{
+     nmoves = 0;
+     for (int s = 0; s < SECTIONS; s++)
+     {
+	  float flow = (s & 1) ? infill : perimeter_flow;
+	  float speed = (s & 1) ? 80.0f : 40.0f;
+
+	  addMove(0.1f, 0.0f, -1.0f, false);
+	  addMove(0.5f, 150.0f, 0.0f, true);
+	  addMove(0.1f, 0.0f, 1.0f, false);
+	  for (float t = 0; t < SECTION; t += MOVE_TIME)
+	       addMove(MOVE_TIME, speed, flow * MOVE_TIME / area(), true);
+     }
+}
+
+// Heater::manage_temperature()'s use of its PID, with the feed-forward
+static int pidStep(PID *pid, bool *bypassing, float pv, uint8_t ff)
+{
+     int delta = pid->getTarget() - (int)(0.5 + pv);
+
+     if (*bypassing && (delta < PID_BYPASS_DELTA)) {
+	  *bypassing = false;
+	  pid->reset_state();
+     }
+     else if (!*bypassing && (delta > PID_BYPASS_DELTA + 10))
+	  *bypassing = true;
+
+     if (*bypassing)
+	  return 255;
+     int mv = pid->calculate(pv) + HEATER_OFFSET_ADJUSTMENT + ff;
+     if (mv < 0) mv = 0;
+     else if (mv > 255) mv = 255;
+     return mv;
+}
+
+static void print(const char *what, float infill, bool feed, result_t *res)
+{
+     ThermalPlant plant(&plant_extruder, DT, seed);
+     PID pid;
+     block_t ring[BLOCK_BUFFER_SIZE];
+     bool bypassing = false;
+     uint8_t mv = 0;
+     uint16_t current = 0;
+     float into = 0, err = 0;
+     uint32_t n, nerr = 0;
+
+     feedforward::setHotend(0, feed ? (uint16_t)(coefficient * 256.0f + 0.5f) : 0,
+			    FILAMENT_DIAMETER);
+     pid.setPGain(PID_GAIN_Q8_8(DEFAULT_P));
+     pid.setIGain(PID_GAIN_Q8_8(DEFAULT_I));
+     pid.setDGain(PID_GAIN_Q8_8(DEFAULT_D));
+     pid.setTarget(target);
+     memset(res, 0, sizeof(result_t));
+     buildPrint(infill);
+
+     for (n = 0; current < nmoves; n++)
+     {
+	  bool printing = n * DT >= WARM_UP;
+	  float flow = 0;
+
+	  if (printing)
+	  {
+	       // Advance through the print, and keep the lookahead full
+	       const block_t *b = &moves[current];
+	       float seconds = ktof(b->millimeters) / ktof(b->nominal_speed);
+
+	       if (into >= seconds - 0.001f)
+	       {
+		    into -= seconds;
+		    if (++current >= nmoves)
+			 break;
+	       }
+	       flow = flows[current];
+	       into += DT;
+	  }
+
+	  if (n % PID_STEPS == 0)
+	  {
+	       uint8_t ff = 0;
+
+	       if (printing && feed)
+	       {
+		    uint8_t tail = current & (BLOCK_BUFFER_SIZE - 1);
+		    uint8_t head = tail;
+
+		    for (uint16_t i = current;
+			 i < nmoves && ((head + 1) & (BLOCK_BUFFER_SIZE - 1)) != tail; i++)
+		    {
+			 ring[head] = moves[i];
+			 head = (head + 1) & (BLOCK_BUFFER_SIZE - 1);
+		    }
+		    ff = feedforward::output(0, feedforward::demand(ring, tail, head, 0,
+								     STEPS_PER_MM));
+	       }
+	       mv = (uint8_t)pidStep(&pid, &bypassing, plant.read(), ff);
+	  }
+	  plant.step(mv, flow);
+
+	  if (!printing)
+	       continue;
+	  float e = plant.temperature() - target;
+	  if (-e > res->max_below)
+	       res->max_below = -e;
+	  if (e > res->max_above)
+	       res->max_above = e;
+	  err += e * e;
+	  nerr++;
+	  if (wfp)
+	       fprintf(wfp, "%s %.1f %.2f %u %.1f\n", what, n * DT - WARM_UP,
+		       plant.temperature(), mv, flow);
+     }
+     res->rms = nerr ? sqrtf(err / nerr) : 0;
+     printf("%-12s fell %5.2f below and rose %5.2f above %d, RMS error %.2f\n",
+	    what, res->max_below, res->max_above, target, res->rms);
+}
+
+int main(int argc, const char *argv[])
+{
+     char c;
+     const char *wname = NULL;
+     result_t steady, pid, ff;
+
+     while ((c = getopt(argc, (char **)argv, GETOPTS)) != GETOPTS_END)
+     {
+	  switch(c)
+	  {
+	  // Unknown switch
+	  case ':' :
+	  default :
+	       usage(stderr, argv[0]);
+	       return(1);
+
+	  // Explicit help request
+	  case 'h' :
+	  case '?' :
+	       usage(stdout, argv[0]);
+	       return(0);
+
+	  case 'c' :
+	       coefficient = strtof(optarg, NULL);
+	       break;
+
+	  case 'f' :
+	       infill_flow = strtof(optarg, NULL);
+	       break;
+
+	  case 'p' :
+	       perimeter_flow = strtof(optarg, NULL);
+	       break;
+
+	  case 'r' :
+	       min_reduction = strtof(optarg, NULL);
+	       break;
+
+	  case 's' :
+	       seed = (uint32_t)strtoul(optarg, NULL, 0);
+	       break;
+
+	  case 't' :
+	       target = (int)strtol(optarg, NULL, 0);
+	       break;
+
+	  case 'w' :
+	       wname = optarg;
+	       break;
+	  }
+     }
+
+     if (coefficient < 0 || coefficient > 255 || perimeter_flow < 0 ||
+	 infill_flow < 0 || target < 100 || target > 280)
+     {
+	  fprintf(stderr, "The coefficient must be 0 to 255, the flows positive and the target 100 to 280\n");
+	  return(1);
+     }
+     if (wname && !(wfp = fopen(wname, "w")))
+     {
+	  fprintf(stderr, "Unable to create the file \"%s\"\n", wname);
+	  return(1);
+     }
+
+     printf("Perimeters at %.1f mm^3/s and infill at %.1f mm^3/s, %d s each\n",
+	    perimeter_flow, infill_flow, SECTION);
+     print("steady", perimeter_flow, false, &steady);
+     print("pid", infill_flow, false, &pid);
+     print("feedforward", infill_flow, true, &ff);
+
+     if (wfp)
+	  fclose(wfp);
+
+     // What the changes in flow add to the PID's own wander
+     float pid_sag = pid.max_below - steady.max_below;
+     float ff_sag = ff.max_below - steady.max_below;
+     float cut = (pid_sag > 0) ? 1.0f - ff_sag / pid_sag : 0.0f;
+
+     printf("The feed-forward cut the sag from the changes in flow from %.2f to %.2f, by %.0f%%\n",
+	    pid_sag, ff_sag, 100.0f * cut);
+     return((cut < min_reduction) ? 1 : 0);
+}
@@ -0,0 +1,636 @@
+// heatersim.cc
+// Run the firmware's heaters against modelled extruders and platforms
+//
+// Heater.cc, PID.cc, Thermistor.cc, TemperatureTable.cc and Timeout.cc are
+// built as they are for the firmware, and each Heater is run as the
+// Motherboard runs it: its manage_temperature() is called every
+// SAMPLE_INTERVAL_MICROS_THERMOCOUPLE for an extruder and every
+// SAMPLE_INTERVAL_MICROS_THERMISTOR for the platform, with the board's
+// clock advanced by the harness.  The heaters drive ThermalPlants.  An
+// extruder is read through a modelled MAX6675, which truncates to a
+// quarter degree; the platform through the firmware's Thermistor, whose
+// 10 bit ADC reading is found from the plant's temperature with the
+// Replicator 2 thermistor table.
+//
+// Each scenario sets its heater to a target from ambient, once the heater
+// has run for IDLE seconds, and, for most, upsets it EVENT_AT seconds
+// later:
+//
+//   heatup     the extruder heats up, and is left to hold its target
+//   platform   the platform heats up, and is left to hold its target
+//   onebit     as platform, with the MV cut to on or off as the firmware
+//              drove the platform before its software PWM
+//   fan        the part cooling fan comes on at full speed
+//   flow       the extruder starts extruding at the hotend's full flow
+//   unplugged  the platform's thermistor comes unplugged
+//   noheat     the extruder's heater is disconnected from the start
+//
+// For each, the seconds until the Heater first reports that it has reached
+// its target, the most the heater rose above the target before the upset
+// and the most it fell below after, until any failure, the swing of its
+// temperature over the last RUN_AFTER seconds of the run, and the failures
+// the Heater reported are given.  Scenarios are run -n times with different
+// sensor noise.  The harness fails if any run of a scenario reports a
+// failure it should not, or does not report the one it should:
+// HEATER_FAIL_NOT_PLUGGED_IN when unplugged and HEATER_FAIL_NOT_HEATING
+// when the heater is disconnected.  It also fails if, with both run, the
+// platform's proportional drive swings more than the on or off drive.
+//
+// Before the scenarios, CoolingFan.cc, built with PWM_OUTPUTS, is run from
+// a Heater whose temperature is swept up through the fan's set point and
+// back down.  The harness fails unless the fan is off up to 10 degrees
+// short of the set point, then runs at COOLING_FAN_MIN_SPEED or more,
+// rising with the temperature to full speed at the set point, and on the
+// way down stays on until COOLING_FAN_HYSTERESIS degrees below the
+// temperature it started above.
+//
+// The extruder's plant may be changed with -d, -e, -l and -r, so that a
+// controller can be tried against hotends other than the preset.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "Heater.hh"
+#include "CoolingFan.hh"
+#include "Thermistor.hh"
+#include "AnalogPin.hh"
+#include "Eeprom.hh"
+#include "TemperatureTable.hh"
+#include "ThermalPlant.hh"
+
+#if defined(__arm__)
+#define GETOPTS_END (char)-1
+#else
+#define GETOPTS_END -1
+#endif
+
+#define PROGNAME "heatersim"
+#define OPTIONS "[-? | -h] [-d seconds] [-e degrees] [-f mm^3/s] [-l seconds] [-n runs] [-r degrees/s] [-s seed] [-w file] [scenario ...]"
+#define GETOPTS ":d:e:f:hl:n:r:s:w:?"
+
+// As in boards/mighty_one/Configuration.hh
+#define SAMPLE_INTERVAL_MICROS_THERMISTOR   (250L * 1000L)
+#define SAMPLE_INTERVAL_MICROS_THERMOCOUPLE (500L * 1000L)
+
+// As in Thermistor.cc
+#define MAX_TEMP 255
+
+// Microseconds per plant step
+#define STEP_MICROS 50000L
+
+// Seconds the heater is managed before its target is set, so that it
+// knows the temperature it starts from, as on a running board; from
+// setting the target to the upset; and from the upset to the end of the
+// run.  The upset comes after Heater.cc's HEAT_UP_TIME, when a fall from
+// the target is looked for
+#define IDLE      10
+#define EVENT_AT  600
+#define RUN_AFTER 300
+
+enum {
+     EV_NONE = 0,            // Left to hold the target
+     EV_FAN,                 // Fan on at full speed
+     EV_FLOW,                // Extrusion at full flow
+     EV_UNPLUG,              // Sensor unplugged
+     EV_NO_HEAT              // Heater disconnected, from the start
+};
+
+typedef struct {
+     const char *name;
+     const char *what;
+     bool platform;          // The platform, else an extruder
+     bool one_bit;           // MV cut to on or off
+     int16_t target;         // Degrees
+     uint8_t event;          // EV_
+     uint8_t expect;         // HeaterFailMode the Heater should report
+} scenario_t;
+
+static const scenario_t scenarios[] = {
+     { "heatup", "Extruder heats up", false, false, 230, EV_NONE, HEATER_FAIL_NONE },
+     { "platform", "Platform heats up", true, false, 110, EV_NONE, HEATER_FAIL_NONE },
+     { "onebit", "Platform, on or off", true, true, 110, EV_NONE, HEATER_FAIL_NONE },
+     { "fan", "Fan comes on", false, false, 230, EV_FAN, HEATER_FAIL_NONE },
+     { "flow", "Full flow begins", false, false, 230, EV_FLOW, HEATER_FAIL_NONE },
+     { "unplugged", "Thermistor unplugged", true, false, 110, EV_UNPLUG,
+       HEATER_FAIL_NOT_PLUGGED_IN },
+     { "noheat", "Heater disconnected", false, false, 230, EV_NO_HEAT,
+       HEATER_FAIL_NOT_HEATING }
+};
+
+#define NSCENARIOS (sizeof(scenarios) / sizeof(scenario_t))
+
+typedef struct {
+     float setpoint;         // Seconds to reach the target, or < 0
+     float overshoot;        // Most above the target before the upset
+     float droop;            // Most below the target after it
+     float swing;            // Highest less lowest over the last RUN_AFTER s
+     uint8_t fail_mode;      // Failure reported, or HEATER_FAIL_NONE
+     float fail_time;        // Seconds after the upset it was reported
+} run_t;
+
+static plant_t extruder;
+static float full_flow = 15.0f;
+static FILE *wfp = NULL;
+
+// The board's clock, and the failure the Heater last reported
+static uint32_t now_micros;
+static uint8_t fail_mode;
+static uint32_t fail_micros;
+
+// The plant the thermistor is in, and whether it is plugged in
+static ThermalPlant *thermistor_plant;
+static bool thermistor_unplugged;
+
+uint32_t simulatorMicros(void)
+{
+     return now_micros;
+}
+
+void simulatorHeaterFail(uint8_t mode, uint8_t heater)
+{
+     (void)heater;
+     fail_mode = mode;
+     fail_micros = now_micros;
+}
+
+// PID gains and fan settings are not kept; the defaults are used
+namespace eeprom {
+uint16_t getEepromFixed16Raw(const uint16_t location, const uint16_t default_value)
+{
+     (void)location;
+     return default_value;
+}
+
+uint8_t getEeprom8(const uint16_t location, const uint8_t default_value)
+{
+     (void)location;
+     return default_value;
+}
+}
+
+// PwmOutputs.cc's interface; the CoolingFan's duty is kept
+static uint8_t fan_duty;
+
+namespace pwm {
+void set(uint8_t channel, uint8_t value)
+{
+     if (channel == TOOL0_FAN)
+	  fan_duty = value;
+}
+}
+
+// The ADC reading for a thermistor at a temperature: the reading the
+// firmware's table converts to nearest it.  Readings fall as it warms
+static int16_t thermistorReading(float t)
+{
+     int16_t lo = 1, hi = 1008;
+
+     while (lo < hi)
+     {
+	  int16_t mid = (lo + hi) / 2;
+	  if (TemperatureTable::TempReadtoCelsius(mid, TemperatureTable::table_thermistor,
+						  MAX_TEMP) > t)
+	       lo = mid + 1;
+	  else
+	       hi = mid;
+     }
+     if (lo > 1 &&
+	 fabsf(TemperatureTable::TempReadtoCelsius(lo - 1, TemperatureTable::table_thermistor,
+						   MAX_TEMP) - t) <
+	 fabsf(TemperatureTable::TempReadtoCelsius(lo, TemperatureTable::table_thermistor,
+						   MAX_TEMP) - t))
+	  lo--;
+     return lo;
+}
+
+// AnalogPin.cc's interface; a conversion completes as soon as it starts,
+// and is collected by the Thermistor the next time it is updated
+void initAnalogPin(uint8_t pin)
+{
+     (void)pin;
+}
+
+bool startAnalogRead(uint8_t pin, volatile int16_t *destination, volatile bool *finished)
+{
+     (void)pin;
+     // Unplugged, the pull up takes the input to the rail
+     *destination = thermistor_unplugged ? 1023 : thermistorReading(thermistor_plant->read());
+     *finished = true;
+     return true;
+}
+
+// An extruder's MAX6675
+class SimThermocouple : public TemperatureSensor {
+private:
+     ThermalPlant *plant;
+
+public:
+     bool unplugged;
+
+     SimThermocouple(ThermalPlant *plant_in) : plant(plant_in), unplugged(false) {}
+
+     SensorState update() {
+	  if (unplugged) {
+	       current_temp = BAD_TEMPERATURE + 1;
+	       return SS_ERROR_UNPLUGGED;
+	  }
+	  float t = plant->read();
+	  current_temp = (t > 0) ? floorf(t * 4.0f) * 0.25f : 0;
+	  return SS_OK;
+     }
+};
+
+// A temperature set by the harness
+class SetTemperature : public TemperatureSensor {
+public:
+     float temperature;
+
+     SetTemperature() : temperature(0) {}
+
+     SensorState update() {
+	  current_temp = temperature;
+	  return SS_OK;
+     }
+};
+
+class SimElement : public HeatingElement {
+public:
+     uint8_t value;
+     bool one_bit;
+
+     SimElement(bool one_bit_in = false) : value(0), one_bit(one_bit_in) {}
+
+     // As BuildPlatformHeatingElement drove the platform without PWM_OUTPUTS
+     void setHeatingElement(uint8_t value_in) {
+	  value = (one_bit && value_in) ? 255 : value_in;
+     }
+};
+
+static void usage(FILE *f, const char *prog)
+{
+     if (f == NULL)
+	  f = stderr;
+
+     fprintf(f,
+"Usage: %s " OPTIONS "\n"
+"       -d seconds -- Extruder's dead time (default %.1f)\n"
+"       -e degrees -- Extruder's largest sensor noise (default %.2f)\n"
+"       -f mm^3/s  -- Hotend's full flow (default 15)\n"
+"       -l seconds -- Extruder's time constant of loss to ambient (default %.0f)\n"
+"       -n runs    -- Runs of each scenario (default 5)\n"
+"       -r deg/s   -- Extruder's heating rate at full power (default %.1f)\n"
+"       -s seed    -- Seed for the first run's sensor noise (default 1)\n"
+"       -w file    -- Write the temperatures and outputs to file\n"
+"       scenario   -- Any of heatup, platform, onebit, fan, flow, unplugged\n"
+"                     and noheat (default all)\n"
+"         ?, -h    -- This help message\n",
+	     prog ? prog : PROGNAME, plant_extruder.dead_time, plant_extruder.noise,
+	     plant_extruder.tau, plant_extruder.rate);
+}
+
+static const char *failName(uint8_t mode)
+{
+     switch (mode)
+     {
+     case HEATER_FAIL_NONE :            return "none";
+     case HEATER_FAIL_NOT_PLUGGED_IN :  return "not plugged in";
+     case HEATER_FAIL_SOFTWARE_CUTOFF : return "software cutoff";
+     case HEATER_FAIL_NOT_HEATING :     return "not heating";
+     case HEATER_FAIL_DROPPING_TEMP :   return "dropping temp";
+     case HEATER_FAIL_BAD_READS :       return "bad reads";
+     default :                          return "unknown";
+     }
+}
+
+static void run(const scenario_t *s, uint32_t seed, run_t *r)
+{
+     ThermalPlant plant(s->platform ? &plant_platform : &extruder,
+			STEP_MICROS / 1000000.0f, seed);
+     SimThermocouple thermocouple(&plant);
+     Thermistor thermistor(0, TemperatureTable::table_thermistor);
+     SimElement element(s->one_bit);
+     uint32_t interval = s->platform ? SAMPLE_INTERVAL_MICROS_THERMISTOR :
+	  SAMPLE_INTERVAL_MICROS_THERMOCOUPLE;
+
+     now_micros = 0;
+     fail_mode = HEATER_FAIL_NONE;
+     thermistor_plant = &plant;
+     thermistor_unplugged = false;
+
+     // As the Motherboard and ExtruderBoard construct them
+     Heater heater(s->platform ? (TemperatureSensor&)thermistor :
+		   (TemperatureSensor&)thermocouple,
+		   element, interval, 0, !s->platform, s->platform ? 2 : 0);
+
+     thermistor.init();
+
+     r->setpoint = -1;
+     r->overshoot = 0;
+     r->droop = 0;
+     r->swing = 0;
+     r->fail_mode = HEATER_FAIL_NONE;
+     r->fail_time = 0;
+
+     uint32_t start_micros = IDLE * 1000000L;
+     uint32_t event_micros = start_micros + ((s->event == EV_NO_HEAT) ? 0 : EVENT_AT * 1000000L);
+     uint32_t end_micros = start_micros + (EVENT_AT + RUN_AFTER) * 1000000L;
+     uint32_t swing_micros = end_micros - RUN_AFTER * 1000000L;
+     uint32_t next = 0;
+     float lowest = 0, highest = 0;
+
+     for (; now_micros < end_micros; now_micros += STEP_MICROS)
+     {
+	  bool upset = (s->event != EV_NONE) && now_micros >= event_micros;
+
+	  if (now_micros == start_micros)
+	       heater.set_target_temperature(s->target);
+
+	  if (upset && s->event == EV_UNPLUG)
+	       thermistor_unplugged = thermocouple.unplugged = true;
+
+	  if (now_micros >= next)
+	  {
+	       heater.manage_temperature();
+	       next += interval;
+	       if (r->setpoint < 0 && now_micros >= start_micros &&
+		   heater.has_reached_target_temperature())
+		    r->setpoint = (now_micros - start_micros) / 1000000.0f;
+	  }
+
+	  plant.step((upset && s->event == EV_NO_HEAT) ? 0 : element.value,
+		     (upset && s->event == EV_FLOW) ? full_flow : 0.0f,
+		     (upset && s->event == EV_FAN) ? 1.0f : 0.0f);
+
+	  float e = plant.temperature() - s->target;
+	  if (now_micros < start_micros)
+	       ;
+	  else if (!upset)
+	  {
+	       if (e > r->overshoot)
+		    r->overshoot = e;
+	  }
+	  else if (fail_mode == HEATER_FAIL_NONE && -e > r->droop)
+	       r->droop = -e;
+
+	  if (now_micros == swing_micros)
+	       lowest = highest = plant.temperature();
+	  else if (now_micros > swing_micros)
+	  {
+	       if (plant.temperature() < lowest)
+		    lowest = plant.temperature();
+	       if (plant.temperature() > highest)
+		    highest = plant.temperature();
+	       r->swing = highest - lowest;
+	  }
+
+	  if (wfp)
+	       fprintf(wfp, "%s %u %.2f %.2f %d %u\n", s->name, seed,
+		       ((int32_t)now_micros - (int32_t)start_micros) / 1000000.0f, plant.temperature(),
+		       heater.get_current_temperature(), element.value);
+
+	  if (fail_mode != HEATER_FAIL_NONE && r->fail_mode == HEATER_FAIL_NONE)
+	  {
+	       r->fail_mode = fail_mode;
+	       r->fail_time = ((int32_t)fail_micros - (int32_t)event_micros) / 1000000.0f;
+	  }
+     }
+}
+
+// Sweep a Heater's temperature from ambient up past a CoolingFan's set
+// point and back, checking the fan's duty at each degree; returns the
+// number of degrees at which it was wrong
+static uint32_t fanCurve(void)
+{
+     SetTemperature sensor;
+     SimElement element;
+     Heater heater(sensor, element, SAMPLE_INTERVAL_MICROS_THERMOCOUPLE, 0, true, 0);
+     CoolingFan fan(heater, 0, pwm::TOOL0_FAN);
+     int16_t low = DEFAULT_COOLING_FAN_SETPOINT_C - 10;
+     int16_t t, started = 0;
+     uint8_t last = 0;
+     uint32_t wrong = 0;
+
+     now_micros = 0;
+     fail_mode = HEATER_FAIL_NONE;
+
+     for (int pass = 0; pass < 2; pass++)
+     {
+	  bool up = (pass == 0);
+
+	  for (t = up ? 20 : DEFAULT_COOLING_FAN_SETPOINT_C + 20;
+	       up ? t <= DEFAULT_COOLING_FAN_SETPOINT_C + 20 : t >= 20;
+	       t += up ? 1 : -1)
+	  {
+	       sensor.temperature = t;
+	       now_micros += SAMPLE_INTERVAL_MICROS_THERMOCOUPLE;
+	       heater.manage_temperature();
+	       fan.manageCoolingFan();
+
+	       bool ok;
+	       if (up && t <= low)
+		    ok = (fan_duty == 0);
+	       else if (t >= DEFAULT_COOLING_FAN_SETPOINT_C)
+		    ok = (fan_duty == 255);
+	       else if (up)
+		    ok = (fan_duty >= COOLING_FAN_MIN_SPEED && fan_duty >= last);
+	       else if (t <= low - COOLING_FAN_HYSTERESIS)
+		    ok = (fan_duty == 0);
+	       else
+		    ok = (fan_duty >= COOLING_FAN_MIN_SPEED && fan_duty <= last);
+
+	       if (up && !started && fan_duty)
+		    started = t;
+	       if (!ok)
+	       {
+		    wrong++;
+		    printf("  fan curve, %s at %d C: duty %u\n", up ? "rising" : "falling",
+			   t, fan_duty);
+	       }
+	       last = fan_duty;
+	  }
+     }
+
+     if (started != low + 1)
+	  wrong++;
+     printf("Fan curve: starts at %d C, %u wrong\n", started, wrong);
+     return wrong;
+}
+
+int main(int argc, const char *argv[])
+{
+     char c;
+     const char *wname = NULL;
+     int runs = 5;
+     uint32_t seed = 1;
+     uint32_t false_faults = 0, missed = 0, fan_wrong;
+     float platform_swing = -1, one_bit_swing = -1;
+
+     extruder = plant_extruder;
+
+     while ((c = getopt(argc, (char **)argv, GETOPTS)) != GETOPTS_END)
+     {
+	  switch(c)
+	  {
+	  // Unknown switch
+	  case ':' :
+	  default :
+	       usage(stderr, argv[0]);
+	       return(1);
+
+	  // Explicit help request
+	  case 'h' :
+	  case '?' :
+	       usage(stdout, argv[0]);
+	       return(0);
+
+	  case 'd' :
+	       extruder.dead_time = strtof(optarg, NULL);
+	       break;
+
+	  case 'e' :
+	       extruder.noise = strtof(optarg, NULL);
+	       break;
+
+	  case 'f' :
+	       full_flow = strtof(optarg, NULL);
+	       break;
+
+	  case 'l' :
+	       extruder.tau = strtof(optarg, NULL);
+	       break;
+
+	  case 'n' :
+	       runs = (int)strtol(optarg, NULL, 0);
+	       break;
+
+	  case 'r' :
+	       extruder.rate = strtof(optarg, NULL);
+	       break;
+
+	  case 's' :
+	       seed = (uint32_t)strtoul(optarg, NULL, 0);
+	       break;
+
+	  case 'w' :
+	       wname = optarg;
+	       break;
+	  }
+     }
+
+     if (runs < 1 || extruder.dead_time < 0 || extruder.noise < 0 ||
+	 extruder.tau <= 0 || extruder.rate <= 0 || full_flow < 0)
+     {
+	  fprintf(stderr, "The runs, time constant and rate must be positive, and the rest not negative\n");
+	  return(1);
+     }
+     for (int i = optind; i < argc; i++)
+     {
+	  size_t j;
+	  for (j = 0; j < NSCENARIOS && strcmp(argv[i], scenarios[j].name); j++)
+	       ;
+	  if (j >= NSCENARIOS)
+	  {
+	       fprintf(stderr, "Unknown scenario \"%s\"\n", argv[i]);
+	       usage(stderr, argv[0]);
+	       return(1);
+	  }
+     }
+     if (wname && !(wfp = fopen(wname, "w")))
+     {
+	  fprintf(stderr, "Unable to create the file \"%s\"\n", wname);
+	  return(1);
+     }
+
+     fan_wrong = fanCurve();
+
+     printf("%-10s %-21s %9s %9s %9s %9s  %s\n", "scenario", "", "setpoint", "overshoot",
+	    "droop", "swing", "faults");
+     for (size_t j = 0; j < NSCENARIOS; j++)
+     {
+	  const scenario_t *s = &scenarios[j];
+	  bool chosen = (optind >= argc);
+
+	  for (int i = optind; i < argc && !chosen; i++)
+	       chosen = !strcmp(argv[i], s->name);
+	  if (!chosen)
+	       continue;
+
+	  float setpoint = 0, overshoot = 0, droop = 0, swing = 0, latency = 0;
+	  int reached = 0, detected = 0, wrong = 0;
+
+	  for (int n = 0; n < runs; n++)
+	  {
+	       run_t r;
+
+	       run(s, seed + n, &r);
+	       if (r.setpoint >= 0)
+	       {
+		    setpoint += r.setpoint;
+		    reached++;
+	       }
+	       if (r.overshoot > overshoot)
+		    overshoot = r.overshoot;
+	       if (r.droop > droop)
+		    droop = r.droop;
+	       if (r.swing > swing)
+		    swing = r.swing;
+	       if (r.fail_mode == s->expect && s->expect != HEATER_FAIL_NONE)
+	       {
+		    detected++;
+		    latency += r.fail_time;
+	       }
+	       else if (r.fail_mode != HEATER_FAIL_NONE)
+	       {
+		    wrong++;
+		    printf("  %s, seed %u: %s at %.1f s\n", s->name, seed + n,
+			   failName(r.fail_mode), r.fail_time);
+	       }
+	  }
+
+	  printf("%-10s %-21s ", s->name, s->what);
+	  if (reached)
+	       printf("%7.1f s ", setpoint / reached);
+	  else
+	       printf("%9s ", "-");
+	  printf("%9.2f ", overshoot);
+	  if (s->event == EV_NONE || s->expect != HEATER_FAIL_NONE)
+	       printf("%9s ", "-");
+	  else
+	       printf("%9.2f ", droop);
+	  if (s->expect != HEATER_FAIL_NONE)
+	       printf("%9s  ", "-");
+	  else
+	       printf("%9.2f  ", swing);
+	  if (s->expect == HEATER_FAIL_NONE)
+	       printf("%d/%d false\n", wrong, runs);
+	  else
+	       printf("%d/%d %s after %.1f s, %d/%d false\n", detected, runs,
+		      failName(s->expect), detected ? latency / detected : 0.0f,
+		      wrong, runs);
+
+	  false_faults += wrong;
+	  missed += runs - detected - (s->expect == HEATER_FAIL_NONE ? runs : 0);
+
+	  if (s->platform && s->event == EV_NONE)
+	       *(s->one_bit ? &one_bit_swing : &platform_swing) = swing;
+     }
+
+     if (wfp)
+	  fclose(wfp);
+
+     printf("%u false faults, %u missed\n", false_faults, missed);
+
+     // The platform's proportional drive should hold it at least as
+     // closely as cutting the MV to one bit did
+     bool worse = (platform_swing >= 0 && one_bit_swing >= 0 &&
+		   platform_swing > one_bit_swing);
+     if (worse)
+	  printf("The platform swings %.2f degrees, %.2f on or off\n",
+		 platform_swing, one_bit_swing);
+
+     return((false_faults || missed || fan_wrong || worse) ? 1 : 0);
+}
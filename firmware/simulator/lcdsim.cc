@@ -0,0 +1,580 @@
+// lcdsim.cc
+// Drive the LCD's framebuffer and output queue with the screens' drawing,
+// and check what a modelled HD44780 shows
+//
+// Screens are drawn through the calls LiquidCrystalSerial makes of
+// LcdFramebuffer.cc, and what they draw is sent to a model of the
+// HD44780's DDRAM and address counter in one of three ways:
+//
+//   direct       as the screens write it, without LCD_FRAMEBUFFER
+//   framebuffer  by LiquidCrystalSerial::flush(), -b cells on each main
+//                loop which does not update the screen
+//   queue        the same cells pushed onto LcdQueue.cc's queue, with
+//                LCD_QUEUE, and sent a step at a time by the microsecond
+//                timer's interrupt every 100 us; the model takes each
+//                nibble on the falling edge of the enable
+//
+// A main loop is taken to last -t microseconds, besides any time it spends
+// waiting on the LCD, and the screen is updated every -l loops; by default
+// every 50 ms, as the quickest of the screens are.  Three screens are
+// drawn:
+//
+//   monitor  temperatures, progress and time rewritten in place, with the
+//            whole screen cleared and redrawn every 100 updates
+//   menu     a menu whose cursor moves a line each update, cleared and
+//            redrawn whenever it moves onto another page
+//   redraw   two full pages of text in turn, so that every update
+//            changes every cell
+//
+// For each way, the bytes the LCD is sent per update and the clears, which
+// take 2 ms apiece, are given, with the longest any main loop waited on
+// the LCD, taking the _delay_us() calls of LiquidCrystalSerial.cc, the
+// longest the LCD took to show an update, and the updates it had yet to
+// show when the next was drawn.  Every RESET_EVERY updates
+// the LCD is set up again, as InterfaceBoard::resetLCD() does, which
+// clears it and leaves its address counter in CGRAM.
+//
+// The harness fails if, once an update has been sent, the model shows
+// anything but what was drawn, or if the queue sends the LCD a byte
+// within 37 us of the last.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "LcdFramebuffer.hh"
+#include "LcdQueue.hh"
+
+#if defined(__arm__)
+#define GETOPTS_END (char)-1
+#else
+#define GETOPTS_END -1
+#endif
+
+#define PROGNAME "lcdsim"
+#define OPTIONS "[-? | -h] [-b cells] [-l loops] [-n updates] [-s seed] [-t micros] [screen ...]"
+#define GETOPTS ":b:hl:n:s:t:?"
+
+// As in LiquidCrystalSerial.hh
+#define LCD_CLEARDISPLAY 0x01
+#define LCD_SETCGRAMADDR 0x40
+#define LCD_SETDDRAMADDR 0x80
+
+// LiquidCrystalSerial.cc's waits: send() is two load()s, each three
+// writeSerial()s of 9 us and pulseEnable()'s three more; a clear is 2 ms
+#define SEND_MICROS  60
+#define CLEAR_MICROS 2000
+
+// The microsecond timer's tick, as in Motherboard.cc, and the least time
+// the LCD needs between bytes
+#define TICK_MICROS 100
+#define BYTE_MICROS 37
+
+#define COLS LCD_FRAMEBUFFER_COLS
+#define ROWS LCD_FRAMEBUFFER_ROWS
+
+// Updates between resets of the LCD
+#define RESET_EVERY 250
+
+enum {
+     WAY_DIRECT = 0,
+     WAY_FRAMEBUFFER,
+     WAY_QUEUE,
+     WAYS
+};
+
+static const char *way_names[WAYS] = { "direct", "framebuffer", "queue" };
+
+// An HD44780 in two line mode, with its 4 bit interface
+typedef struct {
+     uint8_t ddram[128];
+     uint8_t ac;             // Address counter
+     bool cgram;             // Counter is in CGRAM
+     bool enable;            // Enable, as last set
+     bool low;               // The next nibble is a byte's low nibble
+     uint8_t high;           // The byte's high nibble
+     uint32_t last;          // Microseconds the last byte was taken at
+} hd44780_t;
+
+// LiquidCrystalSerial's cursor and the screen as drawn
+typedef struct {
+     uint8_t col, row;
+     uint8_t drawn[ROWS][COLS];
+     uint32_t bytes;         // Sent when drawn straight to the LCD
+     uint32_t clears;
+} screen_t;
+
+typedef struct {
+     const char *name;
+     void (*draw)(screen_t *s, uint32_t update);
+} workload_t;
+
+typedef struct {
+     float bytes;            // Per update
+     float clears;           // Per update
+     uint32_t stall;         // Most microseconds a loop waited on the LCD
+     uint32_t lag;           // Most microseconds to show an update
+     uint32_t late;          // Updates not shown before the next
+     uint32_t mismatches;    // Updates the LCD showed wrongly
+     uint32_t too_soon;      // Bytes the queue sent within BYTE_MICROS
+} result_t;
+
+static LcdFramebuffer *frame;
+static hd44780_t lcd;
+static uint32_t lcd_bytes;
+static uint32_t now;
+static uint32_t too_soon;
+
+static void hdCommand(uint8_t value)
+{
+     lcd_bytes++;
+     if (value & LCD_SETDDRAMADDR)
+     {
+	  lcd.ac = value & 0x7f;
+	  lcd.cgram = false;
+     }
+     else if (value & LCD_SETCGRAMADDR)
+	  lcd.cgram = true;
+}
+
+static void hdData(uint8_t value)
+{
+     lcd_bytes++;
+     if (lcd.cgram)
+	  return;
+     lcd.ddram[lcd.ac] = value;
+     // The counter runs from the end of each line to the start of the other
+     if (lcd.ac == 0x27)
+	  lcd.ac = 0x40;
+     else if (lcd.ac == 0x67)
+	  lcd.ac = 0x00;
+     else
+	  lcd.ac++;
+}
+
+// The shift register set to a load, or a load with the enable set
+static void hdShift(uint8_t value)
+{
+     bool enable = (value & LCD_LOAD_ENABLE) != 0;
+
+     if (lcd.enable && !enable)
+     {
+	  if (!lcd.low)
+	  {
+	       if (now - lcd.last < BYTE_MICROS)
+		    too_soon++;
+	       lcd.high = value >> 4;
+	       lcd.low = true;
+	  }
+	  else
+	  {
+	       uint8_t b = (lcd.high << 4) | (value >> 4);
+
+	       if (value & 0x02)
+		    hdData(b);
+	       else
+		    hdCommand(b);
+	       lcd.low = false;
+	       lcd.last = now;
+	  }
+     }
+     lcd.enable = enable;
+}
+
+// LiquidCrystalSerial::begin(), which clears the LCD and then programs the
+// custom characters
+static void hdReset(void)
+{
+     memset(&lcd, 0, sizeof(lcd));
+     memset(lcd.ddram, ' ', sizeof(lcd.ddram));
+     lcd.cgram = true;
+     lcdqueue::reset();
+     frame->displayCleared();
+     frame->addressLost();
+}
+
+static bool hdShows(const screen_t *s)
+{
+     static const uint8_t row_offsets[] = { 0x00, 0x40, 0x14, 0x54 };
+
+     for (int r = 0; r < ROWS; r++)
+	  if (memcmp(&lcd.ddram[row_offsets[r]], s->drawn[r], COLS))
+	       return false;
+     return true;
+}
+
+// LiquidCrystalSerial::flush() sending to the LCD; the microseconds it
+// waits, and whether it left cells unsent
+static uint32_t flush(uint8_t cells, bool *pending)
+{
+     uint8_t address, c;
+     bool move;
+     uint32_t bytes = lcd_bytes;
+
+     *pending = true;
+     for (; cells; cells--)
+     {
+	  if (!frame->next(&address, &c, &move))
+	  {
+	       *pending = false;
+	       break;
+	  }
+	  if (move)
+	       hdCommand(LCD_SETDDRAMADDR | address);
+	  hdData(c);
+     }
+     return (lcd_bytes - bytes) * SEND_MICROS;
+}
+
+// LiquidCrystalSerial::send() with LCD_QUEUE
+static void queueSend(uint8_t value, bool data)
+{
+     uint8_t mode = data ? 0x02 : 0x00;
+
+     lcdqueue::push((value & 0xf0) + mode);
+     lcdqueue::push(((value << 4) & 0xf0) + mode);
+}
+
+// LiquidCrystalSerial::flush() with LCD_QUEUE; whether it left cells
+// unqueued
+static bool flushQueue(uint8_t cells)
+{
+     uint8_t address, c;
+     bool move;
+
+     for (; cells; cells--)
+     {
+	  if (lcdqueue::room() < 4)
+	       return true;
+	  if (!frame->next(&address, &c, &move))
+	       return false;
+	  if (move)
+	       queueSend(LCD_SETDDRAMADDR | address, false);
+	  queueSend(c, true);
+     }
+     return true;
+}
+
+// LiquidCrystalSerial's setCursor(), write() and clear(), counting the
+// bytes they would send straight to the LCD
+static void lcdSetCursor(screen_t *s, uint8_t col, uint8_t row)
+{
+     s->col = col;
+     s->row = row;
+     s->bytes++;
+}
+
+static void lcdWrite(screen_t *s, uint8_t c)
+{
+     frame->put(s->col, s->row, c);
+     if (s->col < COLS && s->row < ROWS)
+	  s->drawn[s->row][s->col] = c;
+     s->bytes++;
+     if (++s->col >= COLS)
+	  lcdSetCursor(s, 0, s->row + 1);
+}
+
+static void lcdWriteString(screen_t *s, const char *str)
+{
+     while (*str)
+	  lcdWrite(s, *str++);
+}
+
+static void lcdClear(screen_t *s)
+{
+     frame->clear();
+     memset(s->drawn, ' ', sizeof(s->drawn));
+     s->col = s->row = 0;
+     s->bytes++;
+     s->clears++;
+}
+
+// The monitor screen: labels drawn on a redraw, and the values rewritten
+// in place on every update
+static void drawMonitor(screen_t *s, uint32_t update)
+{
+     char buf[COLS + 1];
+
+     if (update % 100 == 0)
+     {
+	  lcdClear(s);
+	  lcdSetCursor(s, 0, 0);
+	  lcdWriteString(s, "Right Tool:");
+	  lcdSetCursor(s, 0, 1);
+	  lcdWriteString(s, "Left Tool:");
+	  lcdSetCursor(s, 0, 2);
+	  lcdWriteString(s, "Platform:");
+	  lcdSetCursor(s, 0, 3);
+	  lcdWriteString(s, "Elapsed:");
+     }
+
+     snprintf(buf, sizeof(buf), "%3d/%3d", 229 + rand() % 3, 230);
+     lcdSetCursor(s, 12, 0);
+     lcdWriteString(s, buf);
+     snprintf(buf, sizeof(buf), "%3d/%3d", 229 + rand() % 3, 230);
+     lcdSetCursor(s, 12, 1);
+     lcdWriteString(s, buf);
+     snprintf(buf, sizeof(buf), "%3d/%3d", 109 + rand() % 2, 110);
+     lcdSetCursor(s, 12, 2);
+     lcdWriteString(s, buf);
+     snprintf(buf, sizeof(buf), "%3uh%02um", (update / 7200) % 1000, (update / 120) % 60);
+     lcdSetCursor(s, 12, 3);
+     lcdWriteString(s, buf);
+}
+
+// A menu of ten items, four to a page, whose cursor moves down a line
+// each update: the page is cleared and redrawn when the cursor moves
+// onto another, and otherwise only the old and new cursors are drawn
+static void drawMenu(screen_t *s, uint32_t update)
+{
+     static const char *items[] = {
+	  "Print from SD", "Preheat", "Utilities", "Info and Settings",
+	  "Change Filament", "Level Build Plate", "Home Axes", "Jog Mode",
+	  "Calibrate Nozzles", "Restore Defaults"
+     };
+     uint8_t index = update % 10;
+     uint8_t page = index / ROWS;
+
+     if (update == 0 || index % ROWS == 0)
+     {
+	  lcdClear(s);
+	  for (uint8_t i = 0; i < ROWS && page * ROWS + i < 10; i++)
+	  {
+	       lcdSetCursor(s, 1, i);
+	       lcdWriteString(s, items[page * ROWS + i]);
+	  }
+     }
+     else
+     {
+	  lcdSetCursor(s, 0, (index - 1) % ROWS);
+	  lcdWrite(s, ' ');
+     }
+     lcdSetCursor(s, 0, index % ROWS);
+     lcdWrite(s, '>');
+}
+
+// Two pages, neither with a character in the same place as the other
+static void drawRedraw(screen_t *s, uint32_t update)
+{
+     lcdClear(s);
+     for (uint8_t r = 0; r < ROWS; r++)
+     {
+	  lcdSetCursor(s, 0, r);
+	  for (uint8_t c = 0; c < COLS; c++)
+	       lcdWrite(s, (update & 1) ? 'a' + (r * COLS + c) % 26 :
+			'A' + (r * COLS + c + 1) % 26);
+     }
+}
+
+static const workload_t workloads[] = {
+     { "monitor", drawMonitor },
+     { "menu", drawMenu },
+     { "redraw", drawRedraw }
+};
+
+#define NWORKLOADS (sizeof(workloads) / sizeof(workload_t))
+
+static void run(const workload_t *w, int way, int budget, int loops,
+		int updates, uint32_t loop_micros, uint32_t seed, result_t *r)
+{
+     LcdFramebuffer fb;
+     screen_t s;
+     uint32_t next_tick = TICK_MICROS;
+     uint32_t drawn_at = 0;
+     bool pending = false, shown = true;
+
+     frame = &fb;
+     lcd_bytes = 0;
+     now = 0;
+     too_soon = 0;
+     memset(r, 0, sizeof(result_t));
+     memset(&s, 0, sizeof(s));
+     memset(s.drawn, ' ', sizeof(s.drawn));
+     srand(seed);
+     hdReset();
+
+     for (int u = 0; u < updates; u++)
+     {
+	  for (int l = 0; l < loops; l++)
+	  {
+	       uint32_t stall = 0;
+
+	       if (l == 0)
+	       {
+		    if (u && u % RESET_EVERY == 0)
+			 hdReset();
+
+		    uint32_t bytes = s.bytes, clears = s.clears;
+
+		    w->draw(&s, u);
+		    drawn_at = now;
+		    shown = false;
+		    pending = true;
+		    if (way == WAY_DIRECT)
+		    {
+			 stall = (s.bytes - bytes) * SEND_MICROS +
+			      (s.clears - clears) * CLEAR_MICROS;
+			 pending = false;
+		    }
+	       }
+	       else if (way == WAY_FRAMEBUFFER)
+		    stall = flush(budget, &pending);
+	       else if (way == WAY_QUEUE)
+		    pending = flushQueue(budget);
+
+	       if (stall > r->stall)
+		    r->stall = stall;
+	       now += loop_micros + stall;
+
+	       // The timer's interrupts during the loop
+	       for (; next_tick <= now; next_tick += TICK_MICROS)
+	       {
+		    uint8_t value;
+		    uint32_t at = now;
+
+		    now = next_tick;
+		    if (way == WAY_QUEUE && lcdqueue::step(&value))
+			 hdShift(value);
+		    now = at;
+	       }
+
+	       if (!shown && !pending && (way != WAY_QUEUE || lcdqueue::empty()))
+	       {
+		    // The LCD shows the update, or should
+		    shown = true;
+		    if (way != WAY_DIRECT)
+		    {
+			 if (!hdShows(&s))
+			      r->mismatches++;
+			 if (now - drawn_at > r->lag)
+			      r->lag = now - drawn_at;
+		    }
+	       }
+	  }
+	  if (!shown)
+	       r->late++;
+     }
+
+     r->bytes = (float)((way == WAY_DIRECT) ? s.bytes : lcd_bytes) / updates;
+     r->clears = (way == WAY_DIRECT) ? (float)s.clears / updates : 0.0f;
+     r->too_soon = too_soon;
+}
+
+static void usage(FILE *f, const char *prog)
+{
+     if (f == NULL)
+	  f = stderr;
+
+     fprintf(f,
+"Usage: %s " OPTIONS "\n"
+"       -b cells   -- Cells flushed per main loop (default %d)\n"
+"       -l loops   -- Main loops per screen update (default 100)\n"
+"       -n updates -- Screen updates (default 1000)\n"
+"       -s seed    -- Seed for the values drawn (default 1)\n"
+"       -t micros  -- Microseconds per main loop (default 500)\n"
+"       screen     -- Any of monitor, menu and redraw (default all)\n"
+"         ?, -h    -- This help message\n",
+	     prog ? prog : PROGNAME, LCD_FLUSH_CELLS);
+}
+
+int main(int argc, const char *argv[])
+{
+     char c;
+     int budget = LCD_FLUSH_CELLS;
+     int loops = 100;
+     int updates = 1000;
+     uint32_t loop_micros = 500;
+     uint32_t seed = 1;
+     uint32_t failures = 0;
+
+     while ((c = getopt(argc, (char **)argv, GETOPTS)) != GETOPTS_END)
+     {
+	  switch(c)
+	  {
+	  // Unknown switch
+	  case ':' :
+	  default :
+	       usage(stderr, argv[0]);
+	       return(1);
+
+	  // Explicit help request
+	  case 'h' :
+	  case '?' :
+	       usage(stdout, argv[0]);
+	       return(0);
+
+	  case 'b' :
+	       budget = (int)strtol(optarg, NULL, 0);
+	       break;
+
+	  case 'l' :
+	       loops = (int)strtol(optarg, NULL, 0);
+	       break;
+
+	  case 'n' :
+	       updates = (int)strtol(optarg, NULL, 0);
+	       break;
+
+	  case 's' :
+	       seed = (uint32_t)strtoul(optarg, NULL, 0);
+	       break;
+
+	  case 't' :
+	       loop_micros = (uint32_t)strtoul(optarg, NULL, 0);
+	       break;
+	  }
+     }
+
+     if (budget < 1 || budget > 254 || loops < 2 || updates < 1 || loop_micros < 1)
+     {
+	  fprintf(stderr, "The cells must be 1 to 254, the loops at least 2, and the updates and microseconds positive\n");
+	  return(1);
+     }
+     for (int i = optind; i < argc; i++)
+     {
+	  size_t j;
+	  for (j = 0; j < NWORKLOADS && strcmp(argv[i], workloads[j].name); j++)
+	       ;
+	  if (j >= NWORKLOADS)
+	  {
+	       fprintf(stderr, "Unknown screen \"%s\"\n", argv[i]);
+	       usage(stderr, argv[0]);
+	       return(1);
+	  }
+     }
+
+     printf("%-8s %-12s %12s %13s %12s %10s %5s  %s\n", "screen", "", "bytes/update",
+	    "clears/update", "worst stall", "shown in", "late", "mismatches");
+     for (size_t j = 0; j < NWORKLOADS; j++)
+     {
+	  const workload_t *w = &workloads[j];
+	  bool chosen = (optind >= argc);
+
+	  for (int i = optind; i < argc && !chosen; i++)
+	       chosen = !strcmp(argv[i], w->name);
+	  if (!chosen)
+	       continue;
+
+	  for (int way = 0; way < WAYS; way++)
+	  {
+	       result_t r;
+
+	       run(w, way, budget, loops, updates, loop_micros, seed, &r);
+	       printf("%-8s %-12s %12.1f %13.2f %9.2f ms %7.1f ms %5u  ",
+		      way ? "" : w->name, way_names[way], r.bytes, r.clears,
+		      r.stall / 1000.0f, r.lag / 1000.0f, r.late);
+	       if (way == WAY_DIRECT)
+		    printf("-\n");
+	       else
+		    printf("%u\n", r.mismatches);
+	       if (r.too_soon)
+		    printf("%-8s %-12s %u bytes sent within %d us of the last\n", "", "",
+			   r.too_soon, BYTE_MICROS);
+	       failures += r.mismatches + r.too_soon;
+	  }
+     }
+
+     return(failures ? 1 : 0);
+}
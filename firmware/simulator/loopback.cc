@@ -0,0 +1,519 @@
+// loopback.cc
+// Measure host streaming throughput with pipelined packet reception
+//
+// A host streaming QUEUE_POINT_NEW commands to the bot is simulated,
+// microsecond by microsecond, with the firmware's own InPacketRing,
+// InPacket and OutPacket code at both ends of a simulated USB-serial link.
+// The link carries each byte at the UART's baud rate and adds a fixed USB
+// latency in each direction.  The firmware side mirrors host::runHostSlice():
+// each main loop slice processes at most one packet and only when the
+// previous response has finished sending.
+//
+// The host keeps up to "window" packets in flight and uses credit based flow
+// control: it queries the remaining command buffer capacity and never sends
+// more command bytes than the last reported capacity allows.  A window of one
+// is the classic stop-and-wait host.
+//
+// Each ring size is then run again with the host packing as many moves as
+// fit into each HOST_CMD_BATCH packet.  The capacity in each batch response
+// serves as the host's credit, so that queries are only needed to get going.
+//
+// As on the ATmega2560, the receive interrupt only stores bytes in a ring of
+// HOST_RX_RING bytes, which each main loop slice feeds to the packets.  Once
+// a second the main loop stalls, as it does for an EEPROM write burst or
+// the LCD, and the ring alone takes what arrives.  A byte arriving with the
+// ring full is dropped, which ends the run.  The harness fails if a byte is
+// dropped while the host keeps no more full packets in flight than the
+// ring holds.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "Simulator.hh"
+#include "Packet.hh"
+#include "Commands.hh"
+
+#if defined(__arm__)
+#define GETOPTS_END (char)-1
+#else
+#define GETOPTS_END -1
+#endif
+
+#ifndef HOST_BATCH_PAYLOAD
+#error HOST_BATCH_PAYLOAD must be defined when building loopback
+#endif
+
+#define PROGNAME "loopback"
+#define OPTIONS "[-? | -h] [-b baud] [-l latency] [-m move] [-n commands] [-r ring] [-s slice] [-t stall]"
+#define GETOPTS ":b:hl:m:n:r:s:t:?"
+
+// Size of the firmware's command buffer
+#define COMMAND_BUFFER_SIZE 512
+
+// QUEUE_POINT_NEW: command, 5 x int32, uint32 us, uint8 relative
+#define MOVE_LENGTH 26
+
+// Largest number of bytes in transit in either direction
+#define LINK_BYTES 4096
+
+// Host sends a query for the buffer capacity when its credit falls below this
+#define CREDIT_LOW (COMMAND_BUFFER_SIZE / 2)
+
+// Largest receive ring, and how often the main loop stalls, microseconds
+#define RING_MAX     4096
+#define STALL_PERIOD 1000000
+
+static uint32_t byte_us    = 87;     // 115200 baud
+static uint32_t latency_us = 1000;   // USB latency, each direction
+static uint32_t move_us    = 0;      // Time to execute a move, 0 for none
+static uint32_t slice_us   = 100;    // Firmware main loop period
+static uint32_t stall_us   = 20000;  // Main loop stall, once a second
+static uint32_t ring_bytes = 512;    // HOST_RX_RING
+static uint32_t commands   = 10000;
+
+// One direction of the link
+typedef struct {
+     uint8_t  data[LINK_BYTES];
+     uint32_t when[LINK_BYTES];      // Arrival time of each byte
+     uint32_t head, tail;
+     uint32_t free_at;               // When the wire is next free
+     uint32_t bytes;                 // Bytes carried
+} link_t;
+
+static void link_reset(link_t *l)
+{
+     memset(l, 0, sizeof(link_t));
+}
+
+// Queue a byte handed to the link at time t.  It arrives once it has
+// crossed the wire and the USB latency has passed.
+static void link_put(link_t *l, uint32_t t, uint8_t b)
+{
+     uint32_t start = (t > l->free_at) ? t : l->free_at;
+
+     l->free_at = start + byte_us;
+     l->data[l->head % LINK_BYTES] = b;
+     l->when[l->head % LINK_BYTES] = l->free_at + latency_us;
+     l->head++;
+     l->bytes++;
+     if (l->head - l->tail > LINK_BYTES)
+     {
+	  fprintf(stderr, "Link overrun\n");
+	  exit(1);
+     }
+}
+
+static bool link_get(link_t *l, uint32_t t, uint8_t *b)
+{
+     if (l->tail == l->head || l->when[l->tail % LINK_BYTES] > t)
+	  return false;
+     *b = l->data[l->tail % LINK_BYTES];
+     l->tail++;
+     return true;
+}
+
+// Hand every byte of a packet to the link
+static void link_send(link_t *l, uint32_t t, OutPacket& p)
+{
+     p.prepareForResend();
+     do
+	  link_put(l, t, p.getNextByteToSend());
+     while (!p.isFinished());
+}
+
+static void usage(FILE *f, const char *prog)
+{
+     if (f == NULL)
+	  f = stderr;
+
+     fprintf(f,
+"Usage: %s " OPTIONS "\n"
+"      -b baud -- Host UART baud rate (default 115200)\n"
+"   -l latency -- USB latency in each direction, microseconds (default 1000)\n"
+"      -m move -- Time to execute each move, microseconds (default 0: moves\n"
+"                 leave the command buffer as soon as they arrive)\n"
+"  -n commands -- Number of move commands to stream (default 10000)\n"
+"      -r ring -- Receive ring, bytes (default 512)\n"
+"     -s slice -- Firmware main loop period, microseconds (default 100)\n"
+"     -t stall -- Main loop stall once a second, microseconds (default 20000)\n"
+"        ?, -h -- This help message\n",
+	     prog ? prog : PROGNAME);
+}
+
+typedef struct {
+     uint32_t elapsed_us;
+     uint32_t overflows;
+     uint32_t queries;
+     uint32_t down_bytes;
+     uint32_t dropped;
+} result_t;
+
+// Stream the commands through a firmware ring of N packets with the host
+// keeping up to N packets in flight, batching moves if asked to
+template<uint8_t N>
+static void run(bool batch, result_t *res)
+{
+     static link_t down, up;
+     InPacketRing<N> rx;
+     OutPacket out;
+     InPacket response;
+     OutPacket request;
+     static uint8_t ring[RING_MAX];
+     uint32_t ring_head = 0, ring_tail = 0;
+
+     link_reset(&down);
+     link_reset(&up);
+     rx.reset();
+     out.reset();
+     response.reset();
+     memset(res, 0, sizeof(result_t));
+
+     // Firmware state
+     uint16_t buffered = 0;
+     uint32_t next_slice = 0, next_move = 0, next_stall = STALL_PERIOD;
+     uint32_t tx_done = 0;           // When the last response has been sent
+
+     // Host state.  For each packet in flight, whether it is a query, the
+     // moves it carries, and the command bytes sent up to and including it.
+     bool     is_query[N];
+     uint8_t  moves[N];
+     uint32_t mark[N];
+     uint8_t  inflight = 0, oldest = 0;
+     bool     query_outstanding = false;
+     uint32_t sent = 0, acked = 0;
+     uint32_t sent_bytes = 0;
+     uint32_t capacity = 0, capacity_mark = 0;
+
+     for (uint32_t t = 0; acked < commands; t++)
+     {
+	  uint8_t b;
+
+	  // Firmware receive interrupt
+	  while (link_get(&down, t, &b))
+	  {
+	       if (ring_head - ring_tail < ring_bytes)
+		    ring[ring_head++ % ring_bytes] = b;
+	       else
+		    res->dropped++;
+	  }
+	  // The packet a dropped byte belonged to never arrives, and the
+	  // host waits for its response forever
+	  if (res->dropped)
+	       break;
+
+	  // Firmware main loop
+	  if (t >= next_slice)
+	  {
+	       next_slice = t + slice_us;
+	       if (t >= next_stall)
+	       {
+		    next_slice = t + stall_us;
+		    next_stall += STALL_PERIOD;
+	       }
+
+	       // UART::processReceived()
+	       while (ring_tail != ring_head)
+		    rx.processByte(ring[ring_tail++ % ring_bytes]);
+
+	       // Execute moves
+	       if (move_us == 0)
+		    buffered = 0;
+	       else if (buffered && t >= next_move)
+	       {
+		    buffered -= MOVE_LENGTH;
+		    next_move = t + move_us;
+	       }
+
+	       InPacket& in = rx.current();
+	       if (t >= tx_done && in.isFinished() == 1)
+	       {
+		    out.reset();
+		    uint8_t command = in.read8(0);
+		    if (command == HOST_CMD_BATCH)
+		    {
+			 if (COMMAND_BUFFER_SIZE - buffered >= in.getLength() - 1)
+			 {
+			      buffered += in.getLength() - 1;
+			      out.append8(RC_OK);
+			 }
+			 else
+			      out.append8(RC_BUFFER_OVERFLOW);
+			 out.append32(COMMAND_BUFFER_SIZE - buffered);
+		    }
+		    else if (command & 0x80)
+		    {
+			 if (COMMAND_BUFFER_SIZE - buffered >= in.getLength())
+			 {
+			      buffered += in.getLength();
+			      out.append8(RC_OK);
+			 }
+			 else
+			      out.append8(RC_BUFFER_OVERFLOW);
+		    }
+		    else if (command == HOST_CMD_GET_BUFFER_SIZE)
+		    {
+			 out.append8(RC_OK);
+			 out.append32(COMMAND_BUFFER_SIZE - buffered);
+		    }
+		    else
+			 out.append8(RC_CMD_UNSUPPORTED);
+		    rx.release();
+		    // The response goes out byte by byte from the transmit
+		    // interrupt; hand it to the link as a whole and note when
+		    // it will have been sent
+		    link_send(&up, t, out);
+		    tx_done = up.free_at;
+	       }
+	  }
+
+	  // Host: collect responses
+	  while (link_get(&up, t, &b))
+	  {
+	       response.processByte(b);
+	       if (response.isFinished() != 1)
+		    continue;
+	       if (inflight == 0)
+	       {
+		    fprintf(stderr, "Unexpected response\n");
+		    exit(1);
+	       }
+	       if (is_query[oldest])
+	       {
+		    capacity = response.read32(1);
+		    capacity_mark = mark[oldest];
+		    query_outstanding = false;
+	       }
+	       else
+	       {
+		    if (response.read8(0) == RC_OK)
+			 acked += moves[oldest];
+		    else
+			 res->overflows++;
+		    if (batch)
+		    {
+			 capacity = response.read32(1);
+			 capacity_mark = mark[oldest];
+		    }
+	       }
+	       oldest = (oldest + 1) % N;
+	       inflight--;
+	       response.reset();
+	  }
+
+	  // Host: send what the window and credit allow
+	  while (inflight < N)
+	  {
+	       uint32_t credit = capacity - (sent_bytes - capacity_mark);
+	       uint8_t slot = (oldest + inflight) % N;
+
+	       request.reset();
+	       if (batch)
+	       {
+		    // Batch responses keep the credit up to date; only
+		    // query when nothing in flight will do so
+		    uint32_t n = (HOST_BATCH_PAYLOAD - 1) / MOVE_LENGTH;
+		    if (n > credit / MOVE_LENGTH)
+			 n = credit / MOVE_LENGTH;
+		    if (n > commands - sent)
+			 n = commands - sent;
+		    if (n == 0 && inflight == 0 && sent < commands)
+		    {
+			 request.append8(HOST_CMD_GET_BUFFER_SIZE);
+			 is_query[slot] = true;
+			 mark[slot] = sent_bytes;
+			 res->queries++;
+		    }
+		    else if (n == 0)
+			 break;
+		    else
+		    {
+			 request.append8(HOST_CMD_BATCH);
+			 for (uint32_t m = 0; m < n; m++)
+			 {
+			      request.append8(HOST_CMD_QUEUE_POINT_NEW);
+			      for (int i = 0; i < 5; i++)
+				   request.append32(sent * (i + 1));
+			      request.append32(1000);
+			      request.append8(0);
+			      sent++;
+			 }
+			 sent_bytes += n * MOVE_LENGTH;
+			 is_query[slot] = false;
+			 moves[slot] = n;
+			 mark[slot] = sent_bytes;
+		    }
+	       }
+	       else if (!query_outstanding && credit < CREDIT_LOW)
+	       {
+		    request.append8(HOST_CMD_GET_BUFFER_SIZE);
+		    is_query[slot] = true;
+		    mark[slot] = sent_bytes;
+		    query_outstanding = true;
+		    res->queries++;
+	       }
+	       else if (sent < commands && credit >= MOVE_LENGTH)
+	       {
+		    request.append8(HOST_CMD_QUEUE_POINT_NEW);
+		    for (int i = 0; i < 5; i++)
+			 request.append32(sent * (i + 1));
+		    request.append32(1000);
+		    request.append8(0);
+		    is_query[slot] = false;
+		    moves[slot] = 1;
+		    sent++;
+		    sent_bytes += MOVE_LENGTH;
+	       }
+	       else
+		    break;
+	       link_send(&down, t, request);
+	       inflight++;
+	  }
+
+	  res->elapsed_us = t;
+     }
+     res->down_bytes = down.bytes;
+}
+
+static void report(uint8_t n, bool batch, const result_t *res)
+{
+     float seconds = (float)res->elapsed_us / 1000000.0;
+
+     if (res->dropped)
+     {
+	  printf("%4u %5s   byte dropped after %.3f s\n", n, batch ? "yes" : "no", seconds);
+	  return;
+     }
+     printf("%4u %5s %10.3f %11.0f %8u %8u %8.0f%%\n",
+	    n, batch ? "yes" : "no", seconds, (float)commands / seconds, res->queries, res->overflows,
+	    100.0 * (float)res->down_bytes * (float)byte_us / (float)res->elapsed_us);
+}
+
+// A dropped byte is a failure when the host's window of full packets fits
+// in the ring
+static bool dropped(uint8_t n, bool batch, const result_t *res)
+{
+     uint32_t packet = (batch ? HOST_BATCH_PAYLOAD : MOVE_LENGTH) + 3;
+
+     return res->dropped && n * packet <= ring_bytes;
+}
+
+int main(int argc, const char *argv[])
+{
+     char c;
+     result_t res;
+     uint32_t overflows = 0;
+     uint32_t baseline = 0, pipelined = 0, batched = 0;
+     bool lost = false;
+
+     while ((c = getopt(argc, (char **)argv, GETOPTS)) != GETOPTS_END)
+     {
+	  switch(c)
+	  {
+	  // Unknown switch
+	  case ':' :
+	  default :
+	       usage(stderr, argv[0]);
+	       return(1);
+
+	  // Explicit help request
+	  case 'h' :
+	  case '?' :
+	       usage(stdout, argv[0]);
+	       return(0);
+
+	  case 'b' :
+	       byte_us = (10000000 + strtoul(optarg, NULL, 0) / 2) / strtoul(optarg, NULL, 0);
+	       break;
+
+	  case 'l' :
+	       latency_us = (uint32_t)strtoul(optarg, NULL, 0);
+	       break;
+
+	  case 'm' :
+	       move_us = (uint32_t)strtoul(optarg, NULL, 0);
+	       break;
+
+	  case 'n' :
+	       commands = (uint32_t)strtoul(optarg, NULL, 0);
+	       break;
+
+	  case 'r' :
+	       ring_bytes = (uint32_t)strtoul(optarg, NULL, 0);
+	       if (ring_bytes == 0 || ring_bytes > RING_MAX)
+	       {
+		    fprintf(stderr, "The ring must be 1 to %u bytes\n", RING_MAX);
+		    return(1);
+	       }
+	       break;
+
+	  case 't' :
+	       stall_us = (uint32_t)strtoul(optarg, NULL, 0);
+	       break;
+
+	  case 's' :
+	       slice_us = (uint32_t)strtoul(optarg, NULL, 0);
+	       if (slice_us == 0)
+		    slice_us = 1;
+	       break;
+	  }
+     }
+
+     printf("%u moves of %u bytes, %u us/byte, %u us USB latency, %u us/move\n",
+	    commands, MOVE_LENGTH, byte_us, latency_us, move_us);
+     printf("%u byte receive ring, main loop stalls for %u us once a second\n\n",
+	    ring_bytes, stall_us);
+     printf("ring batch    seconds  commands/s  queries overflow  link use\n");
+
+     for (int b = 0; b < 2; b++)
+     {
+	  bool batch = b != 0;
+
+	  run<1>(batch, &res);
+	  report(1, batch, &res);
+	  overflows += res.overflows;
+	  lost |= dropped(1, batch, &res);
+	  if (!batch)
+	       baseline = res.elapsed_us;
+	  run<2>(batch, &res);
+	  report(2, batch, &res);
+	  overflows += res.overflows;
+	  lost |= dropped(2, batch, &res);
+	  run<4>(batch, &res);
+	  report(4, batch, &res);
+	  overflows += res.overflows;
+	  lost |= dropped(4, batch, &res);
+	  if (!batch)
+	       pipelined = res.elapsed_us;
+	  else
+	       batched = res.elapsed_us;
+	  run<8>(batch, &res);
+	  report(8, batch, &res);
+	  overflows += res.overflows;
+	  lost |= dropped(8, batch, &res);
+     }
+
+     if (overflows)
+     {
+	  fprintf(stderr, "Command buffer overflowed despite flow control\n");
+	  return(1);
+     }
+     if (lost)
+     {
+	  fprintf(stderr, "Receive ring overran with the host's window within it\n");
+	  return(1);
+     }
+     if (pipelined >= baseline)
+     {
+	  fprintf(stderr, "Pipelining did not improve throughput\n");
+	  return(1);
+     }
+     if (batched >= pipelined)
+     {
+	  fprintf(stderr, "Batching did not improve throughput\n");
+	  return(1);
+     }
+     return(0);
+}
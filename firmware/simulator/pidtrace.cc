@@ -0,0 +1,409 @@
+// pidtrace.cc
+// Check the fixed point PID controller against the float one it replaced
+//
+// Both controllers are driven with the same temperature traces, through
+// the steps Heater::manage_temperature() takes each time it runs: setting
+// the target when it changes, bypassing the PID far below the target and
+// resetting its state on leaving the bypass, and clamping the output to
+// 0 - 255.  Their outputs and error terms are compared at every step.
+//
+// Traces are read from files given with -f, which hold a line per step
+// with the target and the temperature read, as "230 187.25".  Blank lines
+// and lines starting with '#' are ignored.  Without -f, traces are made by
+// heating a simple model of an extruder and of the platform through a
+// series of targets, under the float controller, with sensor noise; -w
+// writes them out in the same form.
+//
+// The fixed point controller rounds temperatures to 1/256 degree, so its
+// output may differ from the float one's by OUTPUT_SCALE where the sum of
+// the terms lies near a whole number.  Any greater difference fails; with
+// very large gains, the rounding is magnified enough that it may.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "PID.hh"
+
+#if defined(__arm__)
+#define GETOPTS_END (char)-1
+#else
+#define GETOPTS_END -1
+#endif
+
+#define PROGNAME "pidtrace"
+#define OPTIONS "[-? | -h] [-d gain] [-f trace-file] [-i gain] [-p gain] [-s seed] [-w file]"
+#define GETOPTS ":d:f:hi:p:s:w:?"
+
+// As in Heater.hh, Heater.cc and PID.cc
+#define DEFAULT_P 7.0
+#define DEFAULT_I 0.325
+#define DEFAULT_D 36.0
+#define PID_BYPASS_DELTA 15
+#define OUTPUT_SCALE 2
+
+// Seconds between PID updates, Heater::UPDATE_INTERVAL_MICROS
+#define UPDATE_INTERVAL 0.5
+
+#define MAX_TRACES 8
+
+// The PID controller as it was, in float
+class FloatPID {
+private:
+     float p_gain, i_gain, d_gain;
+     float delta_history[DELTA_SAMPLES];
+     float delta_summation;
+     uint8_t delta_idx;
+     float prev_error;
+     float error_acc;
+     int sp;
+     int last_output;
+
+public:
+     FloatPID() { reset(); }
+     void setPGain(const float g) { p_gain = g; }
+     void setIGain(const float g) { i_gain = g; }
+     void setDGain(const float g) { d_gain = g; }
+     const int getTarget() const { return sp; }
+     int getErrorTerm() { return (int)error_acc; }
+
+     void reset() {
+	  sp = 0;
+	  p_gain = i_gain = d_gain = 0;
+	  reset_state();
+     }
+
+     void reset_state() {
+	  error_acc = 0;
+	  prev_error = 0;
+	  for (delta_idx = 0; delta_idx < DELTA_SAMPLES; delta_idx++)
+	       delta_history[delta_idx] = 0;
+	  delta_idx = 0;
+	  delta_summation = 0;
+	  last_output = 0;
+     }
+
+     int calculate(const float pv) {
+	  float e = sp - pv;
+	  error_acc += e;
+	  if (error_acc > 256)
+	       error_acc = 256;
+	  else if (error_acc < -256)
+	       error_acc = -256;
+	  float p_term = (float)e * p_gain;
+	  float i_term = (float)error_acc * i_gain;
+	  float delta = e - prev_error;
+	  delta_summation -= delta_history[delta_idx];
+	  delta_history[delta_idx] = delta;
+	  delta_summation += (float)delta;
+	  delta_idx = (delta_idx+1) % DELTA_SAMPLES;
+	  float d_term = delta_summation * d_gain;
+	  prev_error = e;
+	  last_output = ((int)(p_term + i_term + d_term))*OUTPUT_SCALE;
+	  return last_output;
+     }
+
+     void setTarget(const int target) {
+	  if (abs(sp - target) > 10)
+	       reset_state();
+	  sp = target;
+     }
+};
+
+// Heater::manage_temperature()'s use of its PID
+template <class C>
+class Heater {
+public:
+     C pid;
+     bool bypassing;
+
+     Heater() : bypassing(false) {}
+
+     int step(int target, float pv) {
+	  int current = (int)(0.5 + pv);
+
+	  if (target != pid.getTarget())
+	       pid.setTarget(target);
+
+	  int delta = pid.getTarget() - current;
+	  if (bypassing && (delta < PID_BYPASS_DELTA)) {
+	       bypassing = false;
+	       pid.reset_state();
+	  }
+	  else if (!bypassing && (delta > PID_BYPASS_DELTA + 10))
+	       bypassing = true;
+
+	  if (bypassing)
+	       return 255;
+	  int mv = 0;
+	  if (pid.getTarget() != 0) {
+	       mv = pid.calculate(pv);
+	       if (mv < 0) mv = 0;
+	       else if (mv > 255) mv = 255;
+	  }
+	  return mv;
+     }
+};
+
+typedef struct {
+     const char *name;
+     uint32_t steps;
+     uint32_t differ;        // Steps whose outputs differ
+     int worst_output;       // Largest difference between the outputs
+     int worst_error;        // Largest difference between the error terms
+     uint32_t worst_step;
+} result_t;
+
+// Model of a heater: full power heats it at rate degrees per second from
+// ambient, it loses heat with time constant tau and its sensor lags by
+// sensor_tau
+typedef struct {
+     const char *name;
+     float rate;
+     float tau;
+     float sensor_tau;
+     float noise;
+     const int *targets;     // Target for each period, ending with -1
+     float period;           // Seconds each target is held
+} model_t;
+
+static const int extruder_targets[] = { 230, 220, 240, 180, 0, 230, -1 };
+static const int platform_targets[] = { 110, 100, 115, 0, -1 };
+
+static const model_t models[] = {
+     { "extruder", 4.0f, 150.0f, 3.0f, 0.25f, extruder_targets, 300.0f },
+     { "platform", 0.6f, 500.0f, 8.0f, 0.10f, platform_targets, 900.0f }
+};
+
+#define NMODELS (sizeof(models) / sizeof(model_t))
+
+static float p_gain = DEFAULT_P, i_gain = DEFAULT_I, d_gain = DEFAULT_D;
+static uint32_t seed = 1;
+static FILE *wfp = NULL;
+
+static void usage(FILE *f, const char *prog)
+{
+     if (f == NULL)
+	  f = stderr;
+
+     fprintf(f,
+"Usage: %s " OPTIONS "\n"
+"      -d gain -- Derivative gain (default 36.0)\n"
+"-f trace-file -- Replay a trace; may be given %d times\n"
+"      -i gain -- Integral gain (default 0.325)\n"
+"      -p gain -- Proportional gain (default 7.0)\n"
+"      -s seed -- Seed for the modelled sensor noise (default 1)\n"
+"      -w file -- Write the modelled traces to file\n"
+"        ?, -h -- This help message\n",
+	     prog ? prog : PROGNAME, MAX_TRACES);
+}
+
+// Noise uniform in [-1, 1)
+static float noise(void)
+{
+     seed = seed * 1103515245 + 12345;
+     return (float)((seed >> 8) & 0xffff) / 32768.0f - 1.0f;
+}
+
+// Both controllers with the same gains, as the EEPROM holds them
+static void setGains(Heater<FloatPID> *f, Heater<PID> *q)
+{
+     uint16_t p = PID_GAIN_Q8_8(p_gain);
+     uint16_t i = PID_GAIN_Q8_8(i_gain);
+     uint16_t d = PID_GAIN_Q8_8(d_gain);
+
+     // As eeprom::getEepromFixed16() converts them
+     f->pid.setPGain((float)(p >> 8) + (float)(p & 0xff) / 256.0f);
+     f->pid.setIGain((float)(i >> 8) + (float)(i & 0xff) / 256.0f);
+     f->pid.setDGain((float)(d >> 8) + (float)(d & 0xff) / 256.0f);
+     q->pid.setPGain(p);
+     q->pid.setIGain(i);
+     q->pid.setDGain(d);
+}
+
+// Run one step of the trace through both and compare them
+static int compare(Heater<FloatPID> *f, Heater<PID> *q, int target, float pv, result_t *res)
+{
+     int mv_f = f->step(target, pv);
+     int mv_q = q->step(target, pv);
+     int d_out = abs(mv_f - mv_q);
+     int d_err = abs(f->pid.getErrorTerm() - q->pid.getErrorTerm());
+
+     if (d_out)
+	  res->differ++;
+     if (d_out > res->worst_output) {
+	  res->worst_output = d_out;
+	  res->worst_step = res->steps;
+     }
+     if (d_err > res->worst_error)
+	  res->worst_error = d_err;
+     res->steps++;
+     return mv_f;
+}
+
+static void model(const model_t *m, result_t *res)
+{
+     Heater<FloatPID> f;
+     Heater<PID> q;
+     float temp = 25.0f, sensed = 25.0f;
+
+     setGains(&f, &q);
+     memset(res, 0, sizeof(result_t));
+     res->name = m->name;
+     if (wfp)
+	  fprintf(wfp, "# %s\n", m->name);
+
+     for (const int *t = m->targets; *t >= 0; t++)
+	  for (float s = 0; s < m->period; s += UPDATE_INTERVAL)
+	  {
+	       float pv = sensed + m->noise * noise();
+	       if (wfp)
+		    fprintf(wfp, "%d %.3f\n", *t, pv);
+	       int mv = compare(&f, &q, *t, pv, res);
+	       temp += UPDATE_INTERVAL * (m->rate * mv / 255.0f - (temp - 25.0f) / m->tau);
+	       sensed += UPDATE_INTERVAL * (temp - sensed) / m->sensor_tau;
+	  }
+     if (wfp)
+	  fprintf(wfp, "\n");
+}
+
+static bool replay(const char *fname, result_t *res)
+{
+     FILE *fp = fopen(fname, "r");
+     char line[128];
+     Heater<FloatPID> f;
+     Heater<PID> q;
+     int target;
+     float pv;
+
+     if (!fp)
+     {
+	  fprintf(stderr, "Unable to open the file \"%s\"\n", fname);
+	  return false;
+     }
+     setGains(&f, &q);
+     memset(res, 0, sizeof(result_t));
+     res->name = fname;
+     while (fgets(line, sizeof(line), fp))
+     {
+	  if (line[0] == '#' || line[0] == '\n')
+	       continue;
+	  if (sscanf(line, "%d %f", &target, &pv) != 2)
+	  {
+	       fprintf(stderr, "%s: cannot read \"%s\"\n", fname, line);
+	       fclose(fp);
+	       return false;
+	  }
+	  compare(&f, &q, target, pv, res);
+     }
+     fclose(fp);
+     return true;
+}
+
+static bool report(const result_t *res)
+{
+     printf("%-12s %6u steps, %5u outputs differ (%.2f%%), by at most %d (step %u); "
+	    "error terms by at most %d\n",
+	    res->name, res->steps, res->differ,
+	    res->steps ? 100.0 * res->differ / res->steps : 0.0,
+	    res->worst_output, res->worst_step, res->worst_error);
+     return res->worst_output <= OUTPUT_SCALE && res->worst_error <= 1;
+}
+
+int main(int argc, const char *argv[])
+{
+     char c;
+     const char *traces[MAX_TRACES];
+     const char *wname = NULL;
+     int ntraces = 0;
+     bool ok = true;
+     result_t res;
+
+     while ((c = getopt(argc, (char **)argv, GETOPTS)) != GETOPTS_END)
+     {
+	  switch(c)
+	  {
+	  // Unknown switch
+	  case ':' :
+	  default :
+	       usage(stderr, argv[0]);
+	       return(1);
+
+	  // Explicit help request
+	  case 'h' :
+	  case '?' :
+	       usage(stdout, argv[0]);
+	       return(0);
+
+	  case 'd' :
+	       d_gain = strtof(optarg, NULL);
+	       break;
+
+	  case 'f' :
+	       if (ntraces >= MAX_TRACES)
+	       {
+		    usage(stderr, argv[0]);
+		    return(1);
+	       }
+	       traces[ntraces++] = optarg;
+	       break;
+
+	  case 'i' :
+	       i_gain = strtof(optarg, NULL);
+	       break;
+
+	  case 'p' :
+	       p_gain = strtof(optarg, NULL);
+	       break;
+
+	  case 's' :
+	       seed = (uint32_t)strtoul(optarg, NULL, 0);
+	       break;
+
+	  case 'w' :
+	       wname = optarg;
+	       break;
+	  }
+     }
+
+     if (p_gain < 0 || p_gain >= 256 || i_gain < 0 || i_gain >= 256 ||
+	 d_gain < 0 || d_gain >= 256)
+     {
+	  fprintf(stderr, "Gains must be from 0 to 255.99\n");
+	  return(1);
+     }
+
+     printf("Gains P %.4f, I %.4f, D %.4f as Q8.8\n",
+	    PID_GAIN_Q8_8(p_gain) / 256.0, PID_GAIN_Q8_8(i_gain) / 256.0,
+	    PID_GAIN_Q8_8(d_gain) / 256.0);
+
+     if (ntraces)
+     {
+	  for (int i = 0; i < ntraces; i++)
+	  {
+	       if (!replay(traces[i], &res))
+		    return(1);
+	       if (!report(&res))
+		    ok = false;
+	  }
+	  return(ok ? 0 : 1);
+     }
+
+     if (wname && !(wfp = fopen(wname, "w")))
+     {
+	  fprintf(stderr, "Unable to create the file \"%s\"\n", wname);
+	  return(1);
+     }
+     for (size_t i = 0; i < NMODELS; i++)
+     {
+	  model(&models[i], &res);
+	  if (!report(&res))
+	       ok = false;
+     }
+     if (wfp)
+	  fclose(wfp);
+     return(ok ? 0 : 1);
+}
@@ -65,13 +65,13 @@ static ssize_t display(void *ctx_, unsigned char *str, size_t len)
 
 #if defined(SAILTIME)
 #define PROGNAME "sailtime"
-#define OPTIONS "[-? | -h] [-a x,y,z,a,b] [-c x,y,z,a,b]"
-#define GETOPTS ":a:c:h?"
+#define OPTIONS "[-? | -h] [-a x,y,z,a,b] [-c x,y,z,a,b] [-v a,b]"
+#define GETOPTS ":a:c:hv:?"
 #define REPORT 0
 #else
 #define PROGNAME "planner"
-#define OPTIONS "[-? | -h] [-a x,y,z,a,b] [-c x,y,z,a,b] [-mstu] [-d mask] [-r rate]"
-#define GETOPTS ":a:c:hd:mr:stu?"
+#define OPTIONS "[-? | -h] [-a x,y,z,a,b] [-c x,y,z,a,b] [-mstu] [-d mask] [-r rate] [-v a,b]"
+#define GETOPTS ":a:c:hd:mr:stuv:?"
 #define REPORT -1
 #endif
 
@@ -92,6 +92,8 @@ static void usage(FILE *f, const char *prog)
 "           -s -- Display block initial, peak and final speeds (mm/s) along with rates\n"
 "           -u -- Display significant differences between interval based and us based feed rates\n"
 #endif
+"       -v a,b -- Maximum a and b volumetric flows (mm^3/s) for %.2f mm filament;\n"
+"                 a single value sets both\n"
 "        ?, -h -- This help message\n"
 "\n"
 " Default maximum accelerations are:\n"
@@ -103,7 +105,7 @@ static void usage(FILE *f, const char *prog)
 "     x, y = %d mm/s\n"
 "        z = %d mm/s\n"
 "     a, b = %d mm/s\n",
-	     prog ? prog : PROGNAME,
+	     prog ? prog : PROGNAME, (float)DEFAULT_FILAMENT_DIAMETER / 100.0,
 	     DEFAULT_MAX_ACCELERATION_AXIS_X, DEFAULT_MAX_ACCELERATION_AXIS_Z,
 	     DEFAULT_MAX_ACCELERATION_AXIS_A,
 	     DEFAULT_MAX_SPEED_CHANGE_X, DEFAULT_MAX_SPEED_CHANGE_Z,
@@ -257,6 +259,36 @@ int main(int argc, const char *argv[])
 	  case 'u' :
 	       simulator_show_alt_feed_rate = true;
 	       break;
+
+	  // Max volumetric flows
+	  case 'v' :
+	  {
+	       char *ptr = NULL;
+	       float flow[2], diameter = (float)DEFAULT_FILAMENT_DIAMETER / 100.0;
+
+	       flow[0] = strtof(optarg, &ptr);
+	       if (ptr == NULL || ptr == optarg || flow[0] < 0)
+	       {
+		    fprintf(stderr, "%s: unable to parse the volumetric flow, \"%s\", as a floating point number\n",
+			    argv[0], optarg);
+		    return(1);
+	       }
+	       flow[1] = flow[0];
+	       if (*ptr == ',')
+	       {
+		    const char *str = ptr + 1;
+		    flow[1] = strtof(str, &ptr);
+		    if (ptr == str || flow[1] < 0)
+		    {
+			 fprintf(stderr, "%s: unable to parse the volumetric flow, \"%s\", as a floating point number\n",
+				 argv[0], str);
+			 return(1);
+		    }
+	       }
+	       for (int i = 0; i < 2; i++)
+		    max_filament_speed[i] = FTOFP(flow[i] / (0.7853982 * diameter * diameter));
+	  }
+	  break;
 	  }
      }
 
@@ -0,0 +1,421 @@
+// preheat.cc
+// Compare stock and scheduled preheating on modelled heaters
+//
+// An extruder and the platform, and optionally a second extruder, are
+// modelled with ThermalPlants and run under the firmware's PID as
+// Heater::manage_temperature() runs it.  They are preheated from ambient
+// to their targets
+//
+//   serially, as the stock firmware does: without HEATERS_ON_STEROIDS the
+//   extruders are paused until the platform reaches its target; with it,
+//   every heater runs at once, and
+//
+//   under the schedule of Preheat.cc, several times over so that it learns
+//   the heaters from an erased EEPROM as the firmware would.
+//
+// For each preheat, the time until every heater has reached its target and
+// the spread between the first and last to reach it are reported, as are
+// the seconds an extruder spent at full power while the platform did.  The
+// schedule fails if, once learned, it is slower than the stock preheat;
+// if, with a shared supply, an extruder ever runs at full power alongside
+// the platform; or if, without one, the heaters finish more than -m
+// seconds apart.  It also fails if plan() writes the EEPROM itself, or the
+// writer writes more than a byte at a time; the bytes written are given.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "PID.hh"
+#include "Preheat.hh"
+#include "EepromMap.hh"
+#include "ThermalPlant.hh"
+
+#if defined(__arm__)
+#define GETOPTS_END (char)-1
+#else
+#define GETOPTS_END -1
+#endif
+
+#define PROGNAME "preheat"
+#define OPTIONS "[-? | -h] [-d] [-m seconds] [-n runs] [-s seed] [-v] [-w file] [-x]"
+#define GETOPTS ":dhm:n:s:vw:x?"
+
+// As in Heater.hh and Heater.cc
+#define DEFAULT_P 7.0
+#define DEFAULT_I 0.325
+#define DEFAULT_D 36.0
+#define PID_BYPASS_DELTA 15
+#define TARGET_HYSTERESIS 2
+
+// Seconds per plant step; the PIDs update every few steps
+#define DT 0.25f
+
+// Longest preheat, seconds
+#define RUN_LIMIT 3600
+
+#define EEPROM_SIZE 4096
+
+static uint8_t eeprom_image[EEPROM_SIZE];
+static uint32_t eeprom_writes = 0;
+
+uint8_t eeprom_read_byte(const uint8_t *addr)
+{
+     return eeprom_image[(uintptr_t)addr % EEPROM_SIZE];
+}
+
+void eeprom_write_byte(uint8_t *addr, uint8_t value)
+{
+     eeprom_image[(uintptr_t)addr % EEPROM_SIZE] = value;
+     eeprom_writes++;
+}
+
+int eeprom_is_ready(void)
+{
+     return 1;
+}
+
+typedef struct {
+     const plant_t *plant;
+     int target;
+     int every;              // Plant steps per PID update
+} setup_t;
+
+// Tool 0, tool 1 and the platform, as preheat:: numbers them.  The
+// extruders' thermocouples are read every 500 ms, the platform's
+// thermistor every 250 ms, as on a MightyBoard Rev E.
+static const setup_t setups[PREHEAT_HEATERS] = {
+     { &plant_extruder, 230, 2 },
+     { &plant_extruder, 230, 2 },
+     { &plant_platform, 110, 1 }
+};
+
+// A modelled Heater
+typedef struct {
+     ThermalPlant *plant;
+     PID pid;
+     int target;             // Setpoint, even while paused
+     bool paused;
+     bool bypassing;
+     uint8_t mv;
+     float reached;          // Seconds until the target was reached, or -1
+} heater_t;
+
+static bool dual = false;
+static bool shared = true;
+static int max_spread = 15;
+static uint32_t seed = 1;
+static int verbose = 0;
+static FILE *wfp = NULL;
+
+static void usage(FILE *f, const char *prog)
+{
+     if (f == NULL)
+	  f = stderr;
+
+     fprintf(f,
+"Usage: %s " OPTIONS "\n"
+"           -d -- Preheat both extruders\n"
+"   -m seconds -- Largest spread between the heaters finishing allowed\n"
+"                 without a shared supply (default 15)\n"
+"      -n runs -- Scheduled preheats to run (default 5)\n"
+"      -s seed -- Seed for the modelled sensor noise (default 1)\n"
+"           -v -- Report the learned models after each preheat\n"
+"      -w file -- Write the temperatures and outputs to file\n"
+"           -x -- The supply can run every heater at once, as with\n"
+"                 HEATERS_ON_STEROIDS\n"
+"        ?, -h -- This help message\n",
+	     prog ? prog : PROGNAME);
+}
+
+// Heater::Pause()
+static void pause(heater_t *h, bool on)
+{
+     if (h->paused == on)
+	  return;
+     h->paused = on;
+     h->pid.setTarget(on ? (int)(0.5f + h->plant->read()) : h->target);
+}
+
+// Heater::manage_temperature()'s use of its PID
+static uint8_t pidStep(heater_t *h, float pv)
+{
+     int delta = h->pid.getTarget() - (int)(0.5f + pv);
+
+     if (h->bypassing && (delta < PID_BYPASS_DELTA)) {
+	  h->bypassing = false;
+	  h->pid.reset_state();
+     }
+     else if (!h->bypassing && (delta > PID_BYPASS_DELTA + 10))
+	  h->bypassing = true;
+
+     if (h->bypassing)
+	  return 255;
+     int mv = h->pid.calculate(pv);
+     if (mv < 0) mv = 0;
+     else if (mv > 255) mv = 255;
+     return (uint8_t)mv;
+}
+
+typedef struct {
+     float ready;            // Seconds until every heater reached its target
+     float spread;           // Seconds between the first and last to do so
+     float overlap;          // Seconds an extruder and the platform both bypassed
+     uint32_t written;       // EEPROM bytes written
+     bool burst;             // plan() wrote, or the writer wrote several bytes
+} result_t;
+
+static bool heatUp(bool scheduled, const char *what, result_t *res)
+{
+     heater_t heaters[PREHEAT_HEATERS];
+     uint8_t used = dual ? 0x07 : 0x05;
+     uint32_t n;
+
+     for (uint8_t i = 0; i < PREHEAT_HEATERS; i++)
+     {
+	  heater_t *h = &heaters[i];
+
+	  h->plant = new ThermalPlant(setups[i].plant, DT, seed + i);
+	  h->pid.setPGain(PID_GAIN_Q8_8(DEFAULT_P));
+	  h->pid.setIGain(PID_GAIN_Q8_8(DEFAULT_I));
+	  h->pid.setDGain(PID_GAIN_Q8_8(DEFAULT_D));
+	  h->target = (used & (1 << i)) ? setups[i].target : 0;
+	  h->pid.setTarget(h->target);
+	  h->paused = false;
+	  h->bypassing = false;
+	  h->mv = 0;
+	  h->reached = h->target ? -1.0f : 0.0f;
+     }
+
+     preheat::reset();
+     res->overlap = 0;
+     res->written = 0;
+     res->burst = false;
+     for (n = 0; n < (uint32_t)(RUN_LIMIT / DT); n++)
+     {
+	  float t = n * DT;
+	  int16_t temp[PREHEAT_HEATERS], target[PREHEAT_HEATERS];
+	  bool done = true;
+
+	  for (uint8_t i = 0; i < PREHEAT_HEATERS; i++)
+	  {
+	       temp[i] = (int16_t)(0.5f + heaters[i].plant->read());
+	       target[i] = heaters[i].target;
+	  }
+
+	  // Decide who heats, once a second
+	  if ((n % (uint32_t)(1.0f / DT)) == 0)
+	  {
+	       if (scheduled)
+	       {
+		    uint32_t before = eeprom_writes;
+		    uint8_t hold = preheat::plan((uint16_t)t, temp, target);
+		    if (eeprom_writes != before)
+			 res->burst = true;
+		    for (uint8_t i = 0; i < PREHEAT_HEATERS; i++)
+			 pause(&heaters[i], (hold & (1 << i)) != 0);
+	       }
+	       else if (shared)
+	       {
+		    bool wait = heaters[PREHEAT_PLATFORM].reached < 0;
+		    pause(&heaters[0], wait);
+		    pause(&heaters[1], wait);
+	       }
+	  }
+
+	  for (uint8_t i = 0; i < PREHEAT_HEATERS; i++)
+	  {
+	       heater_t *h = &heaters[i];
+
+	       if ((n % setups[i].every) == 0)
+	       {
+		    float pv = h->plant->read();
+		    h->mv = h->pid.getTarget() ? pidStep(h, pv) : 0;
+		    if (h->reached < 0 && !h->paused &&
+			abs(temp[i] - h->target) <= TARGET_HYSTERESIS)
+			 h->reached = t;
+	       }
+	       if (h->reached < 0)
+		    done = false;
+	  }
+	  if ((heaters[0].bypassing || heaters[1].bypassing) &&
+	      heaters[PREHEAT_PLATFORM].bypassing)
+	       res->overlap += DT;
+
+	  if (wfp)
+	  {
+	       fprintf(wfp, "%s %.2f", what, t);
+	       for (uint8_t i = 0; i < PREHEAT_HEATERS; i++)
+		    fprintf(wfp, " %d %u%s", temp[i], heaters[i].mv,
+			    heaters[i].paused ? "p" : "");
+	       fprintf(wfp, "\n");
+	  }
+
+	  // The command slice runs the writer far more often than this, so
+	  // that a learned model is written before the next preheat
+	  uint32_t before = eeprom_writes;
+	  preheat::runWriterSlice();
+	  res->written += eeprom_writes - before;
+	  if (eeprom_writes - before > 1)
+	       res->burst = true;
+
+	  // The schedule learns from the heaters it sees reach their targets
+	  if (done && !(scheduled && preheat::active()))
+	       break;
+	  for (uint8_t i = 0; i < PREHEAT_HEATERS; i++)
+	       heaters[i].plant->step(heaters[i].mv);
+     }
+
+     float first = RUN_LIMIT, last = 0;
+     bool ok = true;
+     for (uint8_t i = 0; i < PREHEAT_HEATERS; i++)
+     {
+	  if (!(used & (1 << i)))
+	       continue;
+	  if (heaters[i].reached < 0)
+	       ok = false;
+	  else
+	  {
+	       if (heaters[i].reached < first) first = heaters[i].reached;
+	       if (heaters[i].reached > last) last = heaters[i].reached;
+	  }
+	  delete heaters[i].plant;
+     }
+     res->ready = last;
+     res->spread = last - first;
+
+     if (!ok)
+	  printf("%-9s never reached its targets\n", what);
+     else
+	  printf("%-9s ready after %5.0f s, spread %4.0f s, overlap %4.0f s, %u EEPROM bytes written\n",
+		 what, res->ready, res->spread, res->overlap, res->written);
+     if (res->burst)
+     {
+	  printf("%-9s wrote the EEPROM other than a byte at a time from the writer\n", what);
+	  ok = false;
+     }
+     return ok;
+}
+
+static void reportModels(void)
+{
+     for (uint8_t i = 0; i < PREHEAT_HEATERS; i++)
+     {
+	  preheat::Model m;
+	  bool learned = preheat::getModel(i, m);
+
+	  if (i == 1 && !dual)
+	       continue;
+	  printf("          %s %u: %s %.2f C/s, approach %u s\n",
+		 (i == PREHEAT_PLATFORM) ? "platform" : "tool", i,
+		 learned ? "learned" : "default", m.rate / 100.0, m.approach);
+     }
+}
+
+int main(int argc, const char *argv[])
+{
+     char c;
+     int runs = 5;
+     bool ok = true;
+     const char *wname = NULL;
+     result_t stock, res;
+
+     while ((c = getopt(argc, (char **)argv, GETOPTS)) != GETOPTS_END)
+     {
+	  switch(c)
+	  {
+	  // Unknown switch
+	  case ':' :
+	  default :
+	       usage(stderr, argv[0]);
+	       return(1);
+
+	  // Explicit help request
+	  case 'h' :
+	  case '?' :
+	       usage(stdout, argv[0]);
+	       return(0);
+
+	  case 'd' :
+	       dual = true;
+	       break;
+
+	  case 'm' :
+	       max_spread = (int)strtol(optarg, NULL, 0);
+	       break;
+
+	  case 'n' :
+	       runs = (int)strtol(optarg, NULL, 0);
+	       break;
+
+	  case 's' :
+	       seed = (uint32_t)strtoul(optarg, NULL, 0);
+	       break;
+
+	  case 'v' :
+	       verbose++;
+	       break;
+
+	  case 'w' :
+	       wname = optarg;
+	       break;
+
+	  case 'x' :
+	       shared = false;
+	       break;
+	  }
+     }
+
+     if (runs < 1)
+     {
+	  fprintf(stderr, "At least one run is needed\n");
+	  return(1);
+     }
+     if (wname && !(wfp = fopen(wname, "w")))
+     {
+	  fprintf(stderr, "Unable to create the file \"%s\"\n", wname);
+	  return(1);
+     }
+
+     // An erased EEPROM: nothing learned
+     memset(eeprom_image, 0xff, sizeof(eeprom_image));
+     preheat::setSharedSupply(shared);
+
+     printf("%s supply, %s\n", shared ? "Shared" : "Unshared",
+	    dual ? "two extruders and the platform" : "one extruder and the platform");
+     if (!heatUp(false, "stock", &stock))
+	  ok = false;
+
+     for (int r = 1; r <= runs; r++)
+     {
+	  char what[16];
+
+	  snprintf(what, sizeof(what), "run %d", r);
+	  if (!heatUp(true, what, &res))
+	       ok = false;
+	  if (verbose)
+	       reportModels();
+	  if (shared && res.overlap > 0)
+	       ok = false;
+     }
+
+     // Once learned, the schedule must do no worse than the stock preheat,
+     // and without a shared supply must bring the heaters in together
+     if (res.ready > stock.ready + PREHEAT_MARGIN)
+     {
+	  printf("The schedule was slower than the stock preheat\n");
+	  ok = false;
+     }
+     if (!shared && res.spread > max_spread)
+     {
+	  printf("The heaters finished %.0f s apart\n", res.spread);
+	  ok = false;
+     }
+
+     if (wfp)
+	  fclose(wfp);
+     return(ok ? 0 : 1);
+}
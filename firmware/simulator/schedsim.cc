@@ -0,0 +1,616 @@
+// schedsim.cc
+// Run the main loop's scheduler against a fake clock
+//
+// Scheduler.cc is built as it is for the firmware, with the Replicator 1's
+// task table, and its runPass() is called as the main loop calls it.  The
+// harness keeps the board's clock and stands in for every slice: each run
+// of a task is recorded, and moves the clock on by the time that task is
+// set to take.  Between passes the clock moves on by PASS_GAP, the rest of
+// the main loop.  The planner's fill is set through the planner's own
+// ring indices.
+//
+// The checks are
+//
+//   rank      with every task due, a pass runs them highest priority
+//             first, ties in the order of the table
+//   boost     with the planner under SCHEDULER_PLANNER_LOW blocks, the
+//             tasks which feed it are raised above the rest; with it full,
+//             the interface's tasks are
+//   first     the first task of a pass is run however long it takes, and
+//             the tasks after it wait for the next pass unless late
+//   rollover  across the clock's wrap every task is run each pass or a
+//             period apart, and none is late
+//   misses    with the command slice taking most of each pass, the tasks
+//             which do not fit are run only once past their deadlines,
+//             ahead of the rest, and each such run is counted as missed;
+//             the tasks which fit miss none
+//   profile   SliceProfile.cc, also built as for the firmware, counts each
+//             time in its bucket at every bucket's edges, holds a count
+//             at 65535 and a time longer than that as 65535, is read and
+//             cleared as HOST_CMD_GET_SLICE_PROFILE reads it, finds the
+//             worst slice leaving out the loop, and is given the tasks'
+//             and the loop's times by the scheduler
+//
+// The harness fails if any check does.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "Simulator.hh"
+#include "Scheduler.hh"
+#include "SliceProfile.hh"
+#include "StepperAccelPlanner.hh"
+
+#if defined(SD_READ_AHEAD) || defined(PRINT_CHECKPOINT) || defined(MODEL_REPLICATOR2)
+#error "The expected orders are for the Replicator 1's task table"
+#endif
+
+#if defined(__arm__)
+#define GETOPTS_END (char)-1
+#else
+#define GETOPTS_END -1
+#endif
+
+#define PROGNAME "schedsim"
+#define OPTIONS "[-? | -h] [-v] [check ...]"
+#define GETOPTS ":hv?"
+
+// Microseconds of the main loop between passes
+#define PASS_GAP 100
+
+// Planner fills: between the two boosts, low and full
+#define PLANNED_MID  8
+#define PLANNED_LOW  (SCHEDULER_PLANNER_LOW - 2)
+#define PLANNED_FULL (BLOCK_BUFFER_SIZE - 1)
+
+// Most tasks run on one pass
+#define RAN_MAX 32
+
+using namespace scheduler;
+
+static const char *task_names[TASKS] = {
+     "host", "command", "steppers", "interface", "screen", "motherboard",
+     "platform", "extruder 1", "extruder 2", "piezo"
+};
+
+static const char *slice_names[profile::SLICES] = {
+     "host", "command", "motherboard", "interface", "sd", "planner", "loop"
+};
+
+// Each task's period, as in Scheduler.cc's table
+static const micros_t periods[TASKS] = {
+     0, 0, 0, 0, 50000, 0, SAMPLE_INTERVAL_MICROS_THERMISTOR,
+     SAMPLE_INTERVAL_MICROS_THERMOCOUPLE, SAMPLE_INTERVAL_MICROS_THERMOCOUPLE, 0
+};
+
+// The orders Scheduler.cc's priorities give, with every task due
+static const uint8_t order_mid[TASKS] = {
+     TASK_STEPPERS, TASK_HOST, TASK_COMMAND, TASK_PIEZO, TASK_MOTHERBOARD,
+     TASK_PLATFORM, TASK_EXTRUDER_ONE, TASK_EXTRUDER_TWO, TASK_INTERFACE,
+     TASK_SCREEN
+};
+
+static const uint8_t order_low[TASKS] = {
+     TASK_HOST, TASK_COMMAND, TASK_STEPPERS, TASK_PIEZO, TASK_MOTHERBOARD,
+     TASK_PLATFORM, TASK_EXTRUDER_ONE, TASK_EXTRUDER_TWO, TASK_INTERFACE,
+     TASK_SCREEN
+};
+
+static const uint8_t order_full[TASKS] = {
+     TASK_STEPPERS, TASK_HOST, TASK_COMMAND, TASK_INTERFACE, TASK_SCREEN,
+     TASK_PIEZO, TASK_MOTHERBOARD, TASK_PLATFORM, TASK_EXTRUDER_ONE,
+     TASK_EXTRUDER_TWO
+};
+
+typedef struct {
+     const char *name;
+     const char *what;
+     uint32_t (*check)(void);
+} check_t;
+
+// The board's clock, and the microseconds each task's run takes
+static uint32_t now_micros;
+static uint32_t took[TASKS];
+
+// The tasks run on the last pass, in order
+static uint8_t ran[RAN_MAX];
+static uint8_t nran;
+
+static int verbose = 0;
+
+// StepperAccelPlanner.cc's ring, whose indices give movesplanned()
+volatile unsigned char block_buffer_head;
+volatile unsigned char block_buffer_tail;
+
+uint32_t simulatorMicros(void)
+{
+     return now_micros;
+}
+
+void simulatorRunTask(uint8_t task)
+{
+     if (nran < RAN_MAX)
+	  ran[nran++] = task;
+     now_micros += took[task];
+}
+
+static void usage(FILE *f, const char *prog)
+{
+     if (f == NULL)
+	  f = stderr;
+
+     fprintf(f,
+"Usage: %s " OPTIONS "\n"
+"       -v         -- Show the tasks run on each pass checked\n"
+"       check      -- Any of rank, boost, first, rollover, misses and\n"
+"                     profile (default all)\n"
+"         ?, -h    -- This help message\n",
+	     prog ? prog : PROGNAME);
+}
+
+static void setPlanned(uint8_t planned)
+{
+     block_buffer_tail = 0;
+     block_buffer_head = planned;
+}
+
+// Run a pass of the main loop
+static void pass(void)
+{
+     nran = 0;
+     runPass();
+     now_micros += PASS_GAP;
+
+     if (verbose > 1)
+     {
+	  printf("  %10u:", now_micros);
+	  for (uint8_t k = 0; k < nran; k++)
+	       printf("%s %s", k ? "," : "", task_names[ran[k]]);
+	  printf("\n");
+     }
+}
+
+// Start afresh at a time, with every task due, taking no time, and the
+// planner between the boosts
+static void start(uint32_t micros)
+{
+     now_micros = micros;
+     memset(took, 0, sizeof(took));
+     setPlanned(PLANNED_MID);
+     reset();
+}
+
+static void clearStats(void)
+{
+     TaskStats s;
+
+     for (uint8_t i = 0; i < TASKS; i++)
+	  getStats(i, &s, true);
+}
+
+static uint16_t misses(uint8_t task)
+{
+     TaskStats s;
+
+     getStats(task, &s, false);
+     return s.misses;
+}
+
+// Compare the last pass's tasks with those expected; returns 1 when they
+// differ
+static uint32_t expect(const char *what, const uint8_t *order, uint8_t n)
+{
+     bool same = (nran == n) && !memcmp(ran, order, n);
+
+     if (!same || verbose)
+     {
+	  printf("  %s:\n   ran", what);
+	  for (uint8_t k = 0; k < nran; k++)
+	       printf("%s %s", k ? "," : "", task_names[ran[k]]);
+	  if (!same)
+	  {
+	       printf("\n   expected");
+	       for (uint8_t k = 0; k < n; k++)
+		    printf("%s %s", k ? "," : "", task_names[order[k]]);
+	  }
+	  printf("\n");
+     }
+     return same ? 0 : 1;
+}
+
+static uint32_t checkRank(void)
+{
+     start(1000);
+     pass();
+     return expect("every task due", order_mid, TASKS);
+}
+
+static uint32_t checkBoost(void)
+{
+     uint32_t wrong = 0;
+
+     start(1000);
+     setPlanned(PLANNED_LOW);
+     pass();
+     wrong += expect("planner low", order_low, TASKS);
+
+     start(1000);
+     setPlanned(PLANNED_FULL);
+     pass();
+     wrong += expect("planner full", order_full, TASKS);
+
+     // Just short of either boost
+     start(1000);
+     setPlanned(SCHEDULER_PLANNER_LOW);
+     pass();
+     wrong += expect("planner at the low mark", order_mid, TASKS);
+
+     start(1000);
+     setPlanned(PLANNED_FULL - 1);
+     pass();
+     wrong += expect("planner short of full", order_mid, TASKS);
+
+     return wrong;
+}
+
+static uint32_t checkFirst(void)
+{
+     uint32_t wrong = 0;
+     uint8_t first = order_mid[0];
+
+     // The first task overruns the pass by itself: the rest, none late,
+     // wait
+     start(1000);
+     took[first] = SCHEDULER_PASS_MICROS + SCHEDULER_PASS_MICROS / 4;
+     pass();
+     wrong += expect("first overruns", order_mid, 1);
+
+     // And are run, in order, on the next
+     took[first] = 0;
+     pass();
+     wrong += expect("next pass", order_mid, TASKS);
+
+     for (uint8_t i = 0; i < TASKS; i++)
+	  if (misses(i))
+	  {
+	       printf("  %s missed %u deadlines\n", task_names[i], misses(i));
+	       wrong++;
+	  }
+
+     return wrong;
+}
+
+static uint32_t checkRollover(void)
+{
+     uint32_t wrong = 0, passes = 0;
+     uint32_t last[TASKS];
+     uint32_t runs[TASKS];
+     bool wrapped = false;
+
+     // Run the clock up to a few seconds short of its wrap a second a
+     // pass, so that the tasks' due times are those of a long running
+     // board
+     start(1000);
+     while (now_micros < 0xffffffffUL - 3000000UL)
+     {
+	  pass();
+	  now_micros += 1000000UL;
+     }
+     while (now_micros < 0xffffffffUL - 2000000UL)
+	  pass();
+     clearStats();
+
+     memset(last, 0, sizeof(last));
+     memset(runs, 0, sizeof(runs));
+     for (passes = 0; passes < 40000; passes++)
+     {
+	  uint32_t before = now_micros;
+
+	  pass();
+	  if (now_micros < before)
+	       wrapped = true;
+
+	  for (uint8_t k = 0; k < nran; k++)
+	  {
+	       uint8_t i = ran[k];
+	       uint32_t interval = before - last[i];
+
+	       // A period apart, give or take the passes it fell due in
+	       if (runs[i] && periods[i] &&
+		   (interval + PASS_GAP < periods[i] || interval > periods[i] + PASS_GAP))
+	       {
+		    printf("  %s run %u us after the last\n", task_names[i], interval);
+		    wrong++;
+	       }
+	       last[i] = before;
+	       runs[i]++;
+	  }
+     }
+
+     for (uint8_t i = 0; i < TASKS; i++)
+     {
+	  if (!periods[i] && runs[i] != passes)
+	  {
+	       printf("  %s run %u times in %u passes\n", task_names[i], runs[i], passes);
+	       wrong++;
+	  }
+	  if (misses(i))
+	  {
+	       printf("  %s missed %u deadlines\n", task_names[i], misses(i));
+	       wrong++;
+	  }
+     }
+     if (!wrapped)
+     {
+	  printf("  the clock never wrapped\n");
+	  wrong++;
+     }
+
+     return wrong;
+}
+
+static uint32_t checkMisses(void)
+{
+     uint32_t wrong = 0, late_passes = 0;
+     TaskStats s;
+
+     // The command slice leaves room only for the piezo's 50 us budget
+     // after it
+     start(1000);
+     took[TASK_COMMAND] = SCHEDULER_PASS_MICROS - 60;
+     for (uint32_t passes = 0; passes < 2000; passes++)
+     {
+	  uint16_t before[TASKS];
+
+	  for (uint8_t i = 0; i < TASKS; i++)
+	       before[i] = misses(i);
+	  pass();
+
+	  // Every task run late is run ahead of those on time, and is
+	  // counted as missed
+	  bool ahead = true;
+	  for (uint8_t k = 0; k < nran; k++)
+	  {
+	       uint8_t i = ran[k];
+	       bool missed = (misses(i) != before[i]);
+
+	       if (missed && !ahead)
+	       {
+		    printf("  %s run late after %s\n", task_names[i], task_names[ran[k - 1]]);
+		    wrong++;
+	       }
+	       if (!missed)
+		    ahead = false;
+	       else if (k == 0)
+		    late_passes++;
+	  }
+     }
+
+     for (uint8_t i = 0; i < TASKS; i++)
+     {
+	  getStats(i, &s, false);
+
+	  bool fits = (i == TASK_STEPPERS || i == TASK_HOST || i == TASK_COMMAND ||
+		       i == TASK_PIEZO);
+	  if (verbose)
+	       printf("  %-12s %5u runs, %5u missed\n", task_names[i], s.runs, s.misses);
+	  if (!s.runs || (fits ? s.misses != 0 : s.misses != s.runs))
+	  {
+	       printf("  %s: %u runs, %u missed\n", task_names[i], s.runs, s.misses);
+	       wrong++;
+	  }
+     }
+     if (!late_passes)
+     {
+	  printf("  no task was run late\n");
+	  wrong++;
+     }
+
+     // Read and clear
+     getStats(TASK_SCREEN, &s, true);
+     getStats(TASK_SCREEN, &s, false);
+     if (s.runs || s.misses || s.total || s.longest)
+     {
+	  printf("  the screen's statistics were not cleared\n");
+	  wrong++;
+     }
+
+     return wrong;
+}
+
+// The bucket SliceProfile.hh says a time is counted in: under 32 us in
+// bucket 0, from 2^(n+4) us up to twice that in bucket n, and the rest in
+// the last
+static uint8_t bucketOf(uint32_t micros)
+{
+     uint8_t n = 0;
+
+     if (micros > 0xffff)
+	  micros = 0xffff;
+     while (n < PROFILE_BUCKETS - 1 && micros >= (32UL << n))
+	  n++;
+     return n;
+}
+
+// Read and clear a slice's histogram, as HOST_CMD_GET_SLICE_PROFILE does
+// for the host, and check it holds only what is expected; returns 1 when
+// it does not
+static uint32_t expectHistogram(const char *what, uint8_t slice, uint8_t bucket,
+				uint16_t count, uint16_t longest)
+{
+     profile::Histogram h;
+     bool same = profile::get(slice, &h, true) && h.longest == longest;
+
+     for (uint8_t n = 0; n < PROFILE_BUCKETS; n++)
+	  if (h.counts[n] != ((n == bucket) ? count : 0))
+	       same = false;
+
+     if (!same || verbose)
+     {
+	  printf("  %s, %s: longest %u us, counts", what, slice_names[slice], h.longest);
+	  for (uint8_t n = 0; n < PROFILE_BUCKETS; n++)
+	       printf(" %u", h.counts[n]);
+	  if (!same)
+	       printf("; expected %u in bucket %u, longest %u us", count, bucket, longest);
+	  printf("\n");
+     }
+     return same ? 0 : 1;
+}
+
+static uint32_t checkProfile(void)
+{
+     uint32_t wrong = 0;
+     profile::Histogram h;
+     uint16_t longest;
+     char what[32];
+
+     // Each bucket's edges, and past the longest time kept
+     profile::reset();
+     for (uint8_t n = 0; n < PROFILE_BUCKETS; n++)
+     {
+	  uint32_t edges[2] = { n ? (uint32_t)16 << n : 0, ((uint32_t)32 << n) - 1 };
+
+	  if (n == PROFILE_BUCKETS - 1)
+	       edges[1] = 0x10000UL;
+	  for (uint8_t e = 0; e < 2; e++)
+	  {
+	       profile::record(profile::SLICE_HOST, edges[e]);
+	       snprintf(what, sizeof(what), "%u us", edges[e]);
+	       wrong += expectHistogram(what, profile::SLICE_HOST, n, 1,
+					(edges[e] > 0xffff) ? 0xffff : edges[e]);
+	       if (bucketOf(edges[e]) != n)
+	       {
+		    printf("  %u us is not at an edge of bucket %u\n", edges[e], n);
+		    wrong++;
+	       }
+	  }
+     }
+
+     // A count stops at 65535
+     for (uint32_t k = 0; k < 0x10010UL; k++)
+	  profile::record(profile::SLICE_COMMAND, 100);
+     wrong += expectHistogram("held", profile::SLICE_COMMAND, bucketOf(100), 0xffff, 100);
+
+     // Cleared once read, left when not; none beyond the last slice, and
+     // nothing counted for SLICE_NONE
+     profile::record(profile::SLICE_SD, 40);
+     profile::record(profile::SLICE_NONE, 40);
+     profile::get(profile::SLICE_SD, &h, false);
+     wrong += expectHistogram("read", profile::SLICE_SD, bucketOf(40), 1, 40);
+     wrong += expectHistogram("cleared", profile::SLICE_SD, 0, 0, 0);
+     if (profile::get(profile::SLICES, &h, true))
+     {
+	  printf("  a slice beyond the last was read\n");
+	  wrong++;
+     }
+     for (uint8_t i = 0; i < profile::SLICES; i++)
+	  wrong += expectHistogram("none counted", i, 0, 0, 0);
+
+     // The worst slice, leaving out the loop as a whole
+     profile::record(profile::SLICE_LOOP, 60000);
+     profile::record(profile::SLICE_HOST, 100);
+     profile::record(profile::SLICE_PLANNER, 900);
+     profile::record(profile::SLICE_COMMAND, 500);
+     uint8_t worst = profile::worst(&longest);
+     if (worst != profile::SLICE_PLANNER || longest != 900)
+     {
+	  printf("  worst %s, %u us; expected planner, 900 us\n", slice_names[worst], longest);
+	  wrong++;
+     }
+
+     // The scheduler counts each task's run in its slice, and from the
+     // second pass the time from one pass to the next
+     start(1000);
+     took[TASK_COMMAND] = 100;
+     took[TASK_SCREEN] = 1200;
+     pass();
+     pass();
+     wrong += expectHistogram("two passes", profile::SLICE_HOST, 0, 2, 0);
+     wrong += expectHistogram("two passes", profile::SLICE_COMMAND, bucketOf(100), 2, 100);
+     wrong += expectHistogram("two passes", profile::SLICE_LOOP, bucketOf(1300 + PASS_GAP), 1,
+			      1300 + PASS_GAP);
+     profile::get(profile::SLICE_INTERFACE, &h, true);
+     if (h.counts[0] != 2 || h.counts[bucketOf(1200)] != 1 || h.longest != 1200)
+     {
+	  printf("  two passes, interface: longest %u us, %u under 32 us, %u at 1200 us;"
+		 " expected the interface twice and the screen once\n",
+		 h.longest, h.counts[0], h.counts[bucketOf(1200)]);
+	  wrong++;
+     }
+
+     return wrong;
+}
+
+static const check_t checks[] = {
+     { "rank", "Priority order", checkRank },
+     { "boost", "Planner boosts", checkBoost },
+     { "first", "First task in a pass", checkFirst },
+     { "rollover", "Clock wrap", checkRollover },
+     { "misses", "Missed deadlines", checkMisses },
+     { "profile", "Slice profile", checkProfile }
+};
+
+#define NCHECKS (sizeof(checks) / sizeof(check_t))
+
+int main(int argc, const char *argv[])
+{
+     char c;
+     uint32_t failed = 0;
+
+     while ((c = getopt(argc, (char **)argv, GETOPTS)) != GETOPTS_END)
+     {
+	  switch(c)
+	  {
+	  // Unknown switch
+	  case ':' :
+	  default :
+	       usage(stderr, argv[0]);
+	       return(1);
+
+	  // Explicit help request
+	  case 'h' :
+	  case '?' :
+	       usage(stdout, argv[0]);
+	       return(0);
+
+	  case 'v' :
+	       verbose++;
+	       break;
+	  }
+     }
+
+     for (int i = optind; i < argc; i++)
+     {
+	  size_t j;
+	  for (j = 0; j < NCHECKS && strcmp(argv[i], checks[j].name); j++)
+	       ;
+	  if (j >= NCHECKS)
+	  {
+	       fprintf(stderr, "Unknown check \"%s\"\n", argv[i]);
+	       usage(stderr, argv[0]);
+	       return(1);
+	  }
+     }
+
+     for (size_t j = 0; j < NCHECKS; j++)
+     {
+	  bool chosen = (optind >= argc);
+
+	  for (int i = optind; i < argc && !chosen; i++)
+	       chosen = !strcmp(argv[i], checks[j].name);
+	  if (!chosen)
+	       continue;
+
+	  uint32_t wrong = checks[j].check();
+	  printf("%-9s %-21s %s\n", checks[j].name, checks[j].what,
+		 wrong ? "failed" : "ok");
+	  failed += wrong ? 1 : 0;
+     }
+
+     printf("%u checks failed\n", failed);
+     return(failed ? 1 : 0);
+}
@@ -0,0 +1,359 @@
+// sdcapture.cc
+// Measure the SPI traffic of capturing a build to an SD card file
+//
+// The card is emulated at the SPI level by SdCardSim.cc and given an empty
+// FAT filesystem.  A file is then written a packet at a time, as the host
+// sends it with HOST_CMD_CAPTURE_TO_FILE: first with a fat_write_file()
+// call for each packet, as capturePacket() in SDCard.cc does without
+// SD_CAPTURE_BUFFER, and then through SDCapture.cc's write-behind buffer.
+// For each, the bytes clocked over SPI, the blocks read and written and
+// the throughput at the SPI clock are reported.
+//
+// The files are read back and checked, as is the free space on the card,
+// so that any clusters allocated ahead of the data by FAT_WRITE_EXTENT and
+// not freed again would be noticed.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "SdCardSim.hh"
+#include "lib_sd/sd_raw.h"
+#include "lib_sd/partition.h"
+#include "lib_sd/fat.h"
+#include "SDCapture.hh"
+
+#if defined(__arm__)
+#define GETOPTS_END (char)-1
+#else
+#define GETOPTS_END -1
+#endif
+
+#define PROGNAME "sdcapture"
+#define OPTIONS "[-? | -h] [-3] [-c card-MB] [-f file-KB] [-H] [-k sectors] [-l bytes] [-p bytes] [-w bytes]"
+#define GETOPTS ":3c:f:hHk:l:p:w:?"
+
+#define TEST_FILE "CAPTURE.X3G"
+
+// The serial link to the host at 115200 baud, bytes per second
+#define SERIAL_RATE 11520.0
+
+typedef struct {
+     uint64_t clocked;
+     uint64_t cycles;
+     uint32_t read;
+     uint32_t written;
+     uint32_t fat_read;
+} result_t;
+
+static struct partition_struct *partition = 0;
+static struct fat_fs_struct *fs = 0;
+static struct fat_dir_struct *root = 0;
+
+static void usage(FILE *f, const char *prog)
+{
+     if (f == NULL)
+	  f = stderr;
+
+     fprintf(f,
+"Usage: %s " OPTIONS "\n"
+"           -3 -- Format the card FAT32 rather than FAT16\n"
+"   -c card-MB -- Card size in megabytes (default 128)\n"
+"   -f file-KB -- Bytes to capture, in kilobytes (default 256)\n"
+"           -H -- Emulate an SDHC card rather than SDSC\n"
+"   -k sectors -- Sectors per cluster (default 8)\n"
+"     -l bytes -- Card access time, in bytes clocked, before each block\n"
+"                 it sends (default 64)\n"
+"     -p bytes -- Bytes captured from each packet (default 32)\n"
+"     -w bytes -- Busy bytes the card sends after each block written\n"
+"                 (default 256)\n"
+"        ?, -h -- This help message\n",
+	     prog ? prog : PROGNAME);
+}
+
+// Content of the captured file
+static uint8_t pattern(uint32_t i)
+{
+     return (uint8_t)((i ^ (i >> 9) ^ (i >> 17)) * 131 + 17);
+}
+
+static void unmount(void)
+{
+     if (root)
+	  fat_close_dir(root);
+     if (fs)
+	  fat_close(fs);
+     if (partition)
+	  partition_close(partition);
+     root = 0;
+     fs = 0;
+     partition = 0;
+}
+
+static bool mount(void)
+{
+     struct fat_dir_entry_struct dir;
+
+     unmount();
+     if (!sd_raw_init(false, 0))
+     {
+	  fprintf(stderr, "sd_raw_init() failed, sd_errno 0x%02x\n", sd_errno);
+	  return false;
+     }
+     partition = partition_open(sd_raw_read, sd_raw_read_interval,
+				sd_raw_write, sd_raw_write_interval, 0);
+     if (!partition)
+     {
+	  fprintf(stderr, "partition_open() failed\n");
+	  return false;
+     }
+     fs = fat_open(partition);
+     if (!fs || !fat_get_dir_entry_of_path(fs, "/", &dir) ||
+	 !(root = fat_open_dir(fs, &dir)))
+     {
+	  fprintf(stderr, "Unable to open the filesystem, fat_errno 0x%02x\n", fat_errno);
+	  return false;
+     }
+     return true;
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+     return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Have the card count the blocks read from the FATs
+static bool watchFats(void)
+{
+     uint8_t b[512];
+
+     if (!sdsim::readImage(0, b, sizeof(b)))
+	  return false;
+     uint32_t start = get32(b + 0x1be + 8);
+     if (!sdsim::readImage((uint64_t)start * 512, b, sizeof(b)))
+	  return false;
+     uint32_t fat_sectors = b[22] | (b[23] << 8);
+     if (fat_sectors == 0)
+	  fat_sectors = get32(b + 36);
+     sdsim::watch(start + (b[14] | (b[15] << 8)), (uint64_t)fat_sectors * b[16]);
+     return true;
+}
+
+static bool findFile(const char *name, struct fat_dir_entry_struct *entry)
+{
+     fat_reset_dir(root);
+     while (fat_read_dir(root, entry))
+	  if (!strcmp(entry->long_name, name))
+	       return true;
+     return false;
+}
+
+// Capture size bytes to a new file, packet bytes at a time, as
+// startCapture(), capturePacket() and finishCapture() do
+static bool capture(uint32_t size, uint32_t packet, bool buffered, result_t *res)
+{
+     struct fat_dir_entry_struct entry;
+     struct fat_file_struct *fd;
+     uint8_t buf[256];
+
+     sdsim::resetStats();
+     if (findFile(TEST_FILE, &entry))
+	  fat_delete_file(fs, &entry);
+     if (!fat_create_file(root, TEST_FILE, &entry) ||
+	 !findFile(TEST_FILE, &entry) || !(fd = fat_open_file(fs, &entry)))
+     {
+	  fprintf(stderr, "Unable to create " TEST_FILE "\n");
+	  return false;
+     }
+     if (buffered)
+	  sdcapture::begin(fd);
+
+     bool ok = true;
+     for (uint32_t i = 0; ok && i < size; i += packet)
+     {
+	  uint32_t n = (size - i < packet) ? size - i : packet;
+	  for (uint32_t j = 0; j < n; j++)
+	       buf[j] = pattern(i + j);
+	  ok = buffered ? sdcapture::write(buf, (uint16_t)n) :
+	       fat_write_file(fd, buf, n) == (intptr_t)n;
+     }
+     if (buffered && !sdcapture::finish())
+	  ok = false;
+     fat_close_file(fd);
+     if (!sd_raw_sync() || !ok)
+     {
+	  fprintf(stderr, "Writing " TEST_FILE " failed\n");
+	  return false;
+     }
+
+     res->clocked  = sdsim::stats.clocked;
+     res->cycles   = sdsim::stats.cycles;
+     res->read     = sdsim::stats.blocks_read;
+     res->written  = sdsim::stats.blocks_written;
+     res->fat_read = sdsim::stats.watched_reads;
+     return true;
+}
+
+// Read the captured file back and check it
+static bool check(uint32_t size)
+{
+     struct fat_dir_entry_struct entry;
+     struct fat_file_struct *fd;
+     uint8_t buf[512];
+     uint32_t pos = 0;
+     intptr_t n;
+
+     if (!findFile(TEST_FILE, &entry) || !(fd = fat_open_file(fs, &entry)))
+     {
+	  fprintf(stderr, "Unable to open " TEST_FILE "\n");
+	  return false;
+     }
+     while ((n = fat_read_file(fd, buf, sizeof(buf))) > 0)
+     {
+	  for (intptr_t i = 0; i < n; i++, pos++)
+	       if (buf[i] != pattern(pos))
+	       {
+		    fprintf(stderr, TEST_FILE " is wrong at offset %u\n", pos);
+		    fat_close_file(fd);
+		    return false;
+	       }
+     }
+     fat_close_file(fd);
+     if (n < 0 || pos != size || entry.file_size != size)
+     {
+	  fprintf(stderr, TEST_FILE " holds %u bytes rather than %u\n", pos, size);
+	  return false;
+     }
+     return true;
+}
+
+static void report(const char *what, uint32_t size, const result_t *res)
+{
+     double secs = (double)res->cycles / (double)SDSIM_F_CPU;
+
+     printf("%-16s %9llu SPI bytes, %.3f per byte, %6.3f s, %7.1f KB/s (%.1f x serial); "
+	    "%u blocks written, %u read, %u of FAT\n",
+	    what, (unsigned long long)res->clocked,
+	    (double)res->clocked / (double)size, secs,
+	    (double)size / secs / 1024.0, (double)size / secs / SERIAL_RATE,
+	    res->written, res->read, res->fat_read);
+}
+
+int main(int argc, const char *argv[])
+{
+     char c;
+     bool fat32 = false;
+     sdsim::CardType type = sdsim::CARD_SDSC;
+     uint32_t card_mb = 128, file_kb = 256, latency = 64, packet = 32, busy = 256;
+     uint8_t sectors = 8;
+     result_t direct, buffered;
+
+     while ((c = getopt(argc, (char **)argv, GETOPTS)) != GETOPTS_END)
+     {
+	  switch(c)
+	  {
+	  // Unknown switch
+	  case ':' :
+	  default :
+	       usage(stderr, argv[0]);
+	       return(1);
+
+	  // Explicit help request
+	  case 'h' :
+	  case '?' :
+	       usage(stdout, argv[0]);
+	       return(0);
+
+	  case '3' :
+	       fat32 = true;
+	       break;
+
+	  case 'c' :
+	       card_mb = (uint32_t)strtoul(optarg, NULL, 0);
+	       break;
+
+	  case 'f' :
+	       file_kb = (uint32_t)strtoul(optarg, NULL, 0);
+	       break;
+
+	  case 'H' :
+	       type = sdsim::CARD_SDHC;
+	       break;
+
+	  case 'k' :
+	       sectors = (uint8_t)strtoul(optarg, NULL, 0);
+	       break;
+
+	  case 'l' :
+	       latency = (uint32_t)strtoul(optarg, NULL, 0);
+	       break;
+
+	  case 'p' :
+	       packet = (uint32_t)strtoul(optarg, NULL, 0);
+	       break;
+
+	  case 'w' :
+	       busy = (uint32_t)strtoul(optarg, NULL, 0);
+	       break;
+	  }
+     }
+
+     if (packet < 1 || packet > 256)
+     {
+	  fprintf(stderr, "Packets must be from 1 to 256 bytes\n");
+	  return(1);
+     }
+
+     uint32_t size = file_kb * 1024;
+
+     if (!sdsim::insert((uint64_t)card_mb << 20, type))
+	  return(1);
+     if (!sdsim::format(fat32, sectors))
+     {
+	  fprintf(stderr, "Cannot format a %u MB card FAT%d with %u sectors per cluster\n",
+		  card_mb, fat32 ? 32 : 16, sectors);
+	  return(1);
+     }
+     if (!mount() || !watchFats())
+	  return(1);
+     sdsim::setReadLatency(latency);
+     sdsim::setWriteLatency(busy);
+
+     uint32_t cluster = (uint32_t)sectors * 512;
+     uint64_t free_before = fat_get_fs_free(fs);
+
+     printf("%u KB captured %u bytes at a time, %u byte clusters, FAT%d on a %u MB %s card, "
+	    "%u byte access time, %u busy bytes per block written, "
+	    "%u clusters allocated at once\n",
+	    file_kb, packet, cluster, fat32 ? 32 : 16, card_mb,
+	    type == sdsim::CARD_SDHC ? "SDHC" : "SDSC", latency, busy, FAT_WRITE_EXTENT);
+
+     if (!capture(size, packet, false, &direct) || !check(size))
+	  return(1);
+     report("per packet", size, &direct);
+     if (!capture(size, packet, true, &buffered) || !check(size))
+	  return(1);
+     report("buffered", size, &buffered);
+
+     // The file's clusters and no more should be in use
+     uint64_t used = free_before - fat_get_fs_free(fs);
+     uint64_t needed = (uint64_t)((size + cluster - 1) / cluster) * cluster;
+
+     unmount();
+     sdsim::eject();
+
+     if (used != needed)
+     {
+	  fprintf(stderr, "%llu bytes of clusters are in use rather than %llu\n",
+		  (unsigned long long)used, (unsigned long long)needed);
+	  return(1);
+     }
+     if (buffered.clocked >= direct.clocked)
+     {
+	  fprintf(stderr, "Buffering clocked no fewer bytes than writing each packet\n");
+	  return(1);
+     }
+     return(0);
+}
@@ -0,0 +1,383 @@
+// sddir.cc
+// Measure the cost of listing a large folder in the LCD menu's SD card menu
+//
+// The card is emulated at the SPI level by SdCardSim.cc and given a FAT
+// filesystem holding a folder of files with long names, half of them
+// .x3g files which the menu lists and half .txt files which it skips.  The
+// folder is then listed as the menu does: counted once, after which the
+// entries are fetched a line at a time.  Each is fetched first by reading
+// the folder from its start, as the menu did before SD_DIR_INDEX, and
+// then with SDIndex.cc.  Scrolling down through the folder, redrawing the
+// current line and jumping about in it are each measured, and the SPI
+// bytes and time per line, average and worst case, reported.  The names
+// fetched are checked against each other.
+//
+// The card reads the folder through lib_sd's one block cache, so a line
+// costs nothing on the bus when its entry lies in the cached block.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "SdCardSim.hh"
+#include "lib_sd/sd_raw.h"
+#include "lib_sd/partition.h"
+#include "lib_sd/fat.h"
+#include "SDIndex.hh"
+
+#if defined(__arm__)
+#define GETOPTS_END (char)-1
+#else
+#define GETOPTS_END -1
+#endif
+
+#define PROGNAME "sddir"
+#define OPTIONS "[-? | -h] [-3] [-c card-MB] [-H] [-l bytes] [-n files]"
+#define GETOPTS ":3c:hHl:n:?"
+
+#define FOLDER "Prints"
+
+// As for the menu
+#define NAME_LEN 64
+
+// Redraws of each line while scrolling, and random lines fetched
+#define REDRAWS 4
+#define JUMPS   200
+
+typedef struct {
+     uint64_t clocked;
+     uint64_t cycles;
+     uint64_t worst_clocked;
+     uint64_t worst_cycles;
+     uint32_t lines;
+} result_t;
+
+static struct partition_struct *partition = 0;
+static struct fat_fs_struct *fs = 0;
+static struct fat_dir_struct *root = 0;
+static struct fat_dir_struct *folder = 0;
+
+static void usage(FILE *f, const char *prog)
+{
+     if (f == NULL)
+	  f = stderr;
+
+     fprintf(f,
+"Usage: %s " OPTIONS "\n"
+"           -3 -- Format the card FAT32 rather than FAT16\n"
+"   -c card-MB -- Card size in megabytes (default 128)\n"
+"           -H -- Emulate an SDHC card rather than SDSC\n"
+"     -l bytes -- Card access time, in bytes clocked, before each block\n"
+"                 it sends (default 64)\n"
+"     -n files -- Files in the folder, half of them listed (default 500)\n"
+"        ?, -h -- This help message\n",
+	     prog ? prog : PROGNAME);
+}
+
+// The menu's choice of entries: .. and folders not beginning with ., and
+// s3g and x3g files
+static bool isListed(const char *name, uint8_t len, bool isdir)
+{
+     if (isdir)
+	  return name[0] != '.' || (name[1] == '.' && name[2] == 0);
+     return len >= 4 && name[len - 4] == '.' &&
+	  strchr("sSxX", name[len - 3]) && name[len - 2] == '3' &&
+	  (name[len - 1] == 'g' || name[len - 1] == 'G');
+}
+
+static void unmount(void)
+{
+     if (folder)
+	  fat_close_dir(folder);
+     if (root)
+	  fat_close_dir(root);
+     if (fs)
+	  fat_close(fs);
+     if (partition)
+	  partition_close(partition);
+     folder = 0;
+     root = 0;
+     fs = 0;
+     partition = 0;
+}
+
+static bool mount(void)
+{
+     struct fat_dir_entry_struct dir;
+
+     unmount();
+     if (!sd_raw_init(false, 0))
+     {
+	  fprintf(stderr, "sd_raw_init() failed, sd_errno 0x%02x\n", sd_errno);
+	  return false;
+     }
+     partition = partition_open(sd_raw_read, sd_raw_read_interval,
+				sd_raw_write, sd_raw_write_interval, 0);
+     if (!partition)
+     {
+	  fprintf(stderr, "partition_open() failed\n");
+	  return false;
+     }
+     fs = fat_open(partition);
+     if (!fs || !fat_get_dir_entry_of_path(fs, "/", &dir) ||
+	 !(root = fat_open_dir(fs, &dir)))
+     {
+	  fprintf(stderr, "Unable to open the filesystem, fat_errno 0x%02x\n", fat_errno);
+	  return false;
+     }
+     return true;
+}
+
+// Create the folder and n empty files in it
+static bool fill(uint32_t n)
+{
+     struct fat_dir_entry_struct entry;
+     char name[NAME_LEN];
+
+     if (!fat_create_dir(root, FOLDER, &entry) ||
+	 !(folder = fat_open_dir(fs, &entry)))
+     {
+	  fprintf(stderr, "Unable to create the folder " FOLDER "\n");
+	  return false;
+     }
+     for (uint32_t i = 0; i < n; i++)
+     {
+	  snprintf(name, sizeof(name), (i & 1) ? "Notes on part %03u.txt" :
+		   "Part %03u of the big print.x3g", i / 2);
+	  if (!fat_create_file(folder, name, &entry))
+	  {
+	       fprintf(stderr, "Unable to create %s\n", name);
+	       return false;
+	  }
+     }
+     return sd_raw_sync() != 0;
+}
+
+// Fetch the index'th listed entry by reading the folder from its start
+static bool rescan(uint8_t index, char *name)
+{
+     struct fat_dir_entry_struct entry;
+     uint8_t i = 0;
+
+     name[0] = 0;
+     fat_reset_dir(folder);
+     while (fat_read_dir(folder, &entry))
+     {
+	  if ((entry.attributes & (FAT_ATTRIB_HIDDEN | FAT_ATTRIB_SYSTEM | FAT_ATTRIB_VOLUME)) ||
+	      !entry.long_name[0] ||
+	      !isListed(entry.long_name, strlen(entry.long_name),
+			(entry.attributes & FAT_ATTRIB_DIR) != 0))
+	       continue;
+	  if (i++ == index)
+	  {
+	       strcpy(name, entry.long_name);
+	       return true;
+	  }
+     }
+     return false;
+}
+
+static bool fetch(bool indexed, uint8_t index, char *name, result_t *res)
+{
+     uint64_t clocked = sdsim::stats.clocked;
+     uint64_t cycles = sdsim::stats.cycles;
+     bool ok;
+
+     if (indexed)
+	  ok = sdindex::entry(folder, index, isListed, name, NAME_LEN, 0, 0);
+     else
+	  ok = rescan(index, name);
+
+     clocked = sdsim::stats.clocked - clocked;
+     cycles = sdsim::stats.cycles - cycles;
+     res->clocked += clocked;
+     res->cycles += cycles;
+     if (clocked > res->worst_clocked)
+	  res->worst_clocked = clocked;
+     if (cycles > res->worst_cycles)
+	  res->worst_cycles = cycles;
+     res->lines++;
+     return ok;
+}
+
+// The lines fetched by each test
+static uint8_t line(int test, uint32_t i, uint8_t count)
+{
+     switch (test)
+     {
+     case 0 :  return (uint8_t)(i % count);                 // Scroll down
+     case 1 :  return (uint8_t)(i / (REDRAWS + 1));         // ... redrawing
+     case 2 :  return (uint8_t)(count - 1 - (i % count));   // Scroll up
+     default : return (uint8_t)((i * 7919 + 13) % count);   // Jump about
+     }
+}
+
+static uint32_t lines(int test, uint8_t count)
+{
+     return (test == 1) ? (uint32_t)count * (REDRAWS + 1) :
+	  (test == 3) ? JUMPS : count;
+}
+
+static void report(const char *what, const result_t *res)
+{
+     printf("%-12s %9.1f SPI bytes per line, worst %7llu; "
+	    "%7.3f ms per line, worst %7.3f ms\n",
+	    what, (double)res->clocked / (double)res->lines,
+	    (unsigned long long)res->worst_clocked,
+	    1000.0 * (double)res->cycles / (double)res->lines / (double)SDSIM_F_CPU,
+	    1000.0 * (double)res->worst_cycles / (double)SDSIM_F_CPU);
+}
+
+int main(int argc, const char *argv[])
+{
+     static const char *tests[] = {
+	  "scroll down", "redraw", "scroll up", "jump about"
+     };
+     char c;
+     bool fat32 = false;
+     sdsim::CardType type = sdsim::CARD_SDSC;
+     uint32_t card_mb = 128, files = 500, latency = 64;
+     char a[NAME_LEN], b[NAME_LEN];
+     bool failed = false;
+
+     while ((c = getopt(argc, (char **)argv, GETOPTS)) != GETOPTS_END)
+     {
+	  switch(c)
+	  {
+	  // Unknown switch
+	  case ':' :
+	  default :
+	       usage(stderr, argv[0]);
+	       return(1);
+
+	  // Explicit help request
+	  case 'h' :
+	  case '?' :
+	       usage(stdout, argv[0]);
+	       return(0);
+
+	  case '3' :
+	       fat32 = true;
+	       break;
+
+	  case 'c' :
+	       card_mb = (uint32_t)strtoul(optarg, NULL, 0);
+	       break;
+
+	  case 'H' :
+	       type = sdsim::CARD_SDHC;
+	       break;
+
+	  case 'l' :
+	       latency = (uint32_t)strtoul(optarg, NULL, 0);
+	       break;
+
+	  case 'n' :
+	       files = (uint32_t)strtoul(optarg, NULL, 0);
+	       break;
+	  }
+     }
+
+     if (!sdsim::insert((uint64_t)card_mb << 20, type))
+	  return(1);
+     if (!sdsim::format(fat32, fat32 ? 1 : 8))
+     {
+	  fprintf(stderr, "Cannot format a %u MB card FAT%d\n", card_mb, fat32 ? 32 : 16);
+	  return(1);
+     }
+     if (!mount() || !fill(files))
+	  return(1);
+     sdsim::setReadLatency(latency);
+
+     // Count as the menu does, without an index and with one
+     uint32_t listed = 0;
+     while (rescan((uint8_t)listed, a) && listed < 255)
+	  listed++;
+     sdsim::resetStats();
+     uint8_t count = sdindex::count(folder, isListed);
+     printf("%u files in " FOLDER ", %u listed, %u indexed; FAT%d on a %u MB %s card, "
+	    "%u byte access time\n", files, listed, count, fat32 ? 32 : 16, card_mb,
+	    type == sdsim::CARD_SDHC ? "SDHC" : "SDSC", latency);
+     printf("Counting:    %9llu SPI bytes, %7.3f ms\n",
+	    (unsigned long long)sdsim::stats.clocked,
+	    1000.0 * (double)sdsim::stats.cycles / (double)SDSIM_F_CPU);
+     if (count != (listed < SD_INDEX_MAX ? listed : SD_INDEX_MAX))
+     {
+	  fprintf(stderr, "Indexed %u entries rather than %u\n", count, listed);
+	  failed = true;
+     }
+     if (count == 0)
+	  return(1);
+
+     // However large the folder, a line should cost no more than reading
+     // the first 2 * SD_INDEX_STRIDE listed entries from its start
+     result_t first;
+     memset(&first, 0, sizeof(first));
+     uint8_t mbr;
+     sd_raw_read(0, &mbr, 1);  // Out of lib_sd's cache with the folder
+     fetch(false, (count < 2 * SD_INDEX_STRIDE ? count : 2 * SD_INDEX_STRIDE) - 1,
+	   a, &first);
+     uint64_t bound = first.clocked;
+
+     for (int t = 0; t < 4; t++)
+     {
+	  result_t old, idx;
+	  uint32_t n = lines(t, count);
+	  char *names = (char *)malloc(n * NAME_LEN);
+
+	  if (names == NULL)
+	  {
+	       perror("malloc");
+	       return(1);
+	  }
+	  memset(&old, 0, sizeof(old));
+	  memset(&idx, 0, sizeof(idx));
+
+	  // The two are run separately, as either would otherwise evict
+	  // the other's block from lib_sd's cache
+	  for (uint32_t i = 0; i < n; i++)
+	       fetch(false, line(t, i, count), names + i * NAME_LEN, &old);
+	  sdindex::invalidate();
+	  sdindex::count(folder, isListed);
+	  for (uint32_t i = 0; i < n; i++)
+	  {
+	       uint8_t l = line(t, i, count);
+	       if (!fetch(true, l, b, &idx) || strcmp(names + i * NAME_LEN, b))
+	       {
+		    fprintf(stderr, "%s: line %u is \"%s\" rather than \"%s\"\n",
+			    tests[t], l, b, names + i * NAME_LEN);
+		    failed = true;
+		    break;
+	       }
+	  }
+	  free(names);
+	  printf("%s\n", tests[t]);
+	  report("  rescan", &old);
+	  report("  indexed", &idx);
+	  if (idx.worst_clocked > bound)
+	  {
+	       fprintf(stderr, "%s: the index's worst line is too slow\n", tests[t]);
+	       failed = true;
+	  }
+     }
+
+     // A file added after indexing is listed once the index is invalidated
+     struct fat_dir_entry_struct entry;
+     if (!fat_create_file(folder, "Added later.x3g", &entry))
+	  return(1);
+     sdindex::invalidate();
+     if (count < SD_INDEX_MAX &&
+	 (sdindex::count(folder, isListed) != count + 1 ||
+	  !sdindex::entry(folder, count, isListed, b, NAME_LEN, 0, 0) ||
+	  strcmp(b, "Added later.x3g")))
+     {
+	  fprintf(stderr, "The added file was not indexed\n");
+	  failed = true;
+     }
+
+     unmount();
+     sdsim::eject();
+     return(failed ? 1 : 0);
+}
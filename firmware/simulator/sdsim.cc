@@ -0,0 +1,509 @@
+// sdsim.cc
+// Measure the SPI traffic of reading a file from an SD card as a print does
+//
+// The card is emulated at the SPI level by SdCardSim.cc and given a FAT
+// filesystem holding a test file, written through lib_sd.  The file is then
+// read back a byte at a time with fat_read_file(), as fetchNextByte() in
+// SDCard.cc does: first with single block reads and then with multi-block
+// reads.  The bytes clocked over SPI per byte of the file are reported for
+// each.  Reading with multi-block reads is then repeated with a block's CRC
+// corrupted midway and with the card refusing multi-block reads, to check
+// the fall back to single block reads.
+//
+// SDHC cards are clocked faster than SDSC cards when CRCs are checked, so
+// the reads, which check CRCs, are also timed at the standard clock and
+// without CRC checks.  With -F, the test file is placed
+// beyond filler files on the card; on a 32 GB card with -F 5000 it lies
+// beyond 4 GB, exercising lib_sd's 64-bit card offsets.
+//
+// Finally, the file is read at random offsets after seeking, as when
+// resuming a build.  The blocks read from the FATs are counted throughout.
+// With -g, the test file is written a cluster at a time alternately with
+// a second file, so that none of its clusters are contiguous.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "SdCardSim.hh"
+#include "lib_sd/sd_raw.h"
+#include "lib_sd/partition.h"
+#include "lib_sd/fat.h"
+
+#if defined(__arm__)
+#define GETOPTS_END (char)-1
+#else
+#define GETOPTS_END -1
+#endif
+
+#define PROGNAME "sdsim"
+#define OPTIONS "[-? | -h] [-3] [-c card-MB] [-f file-KB] [-F filler-MB] [-g] [-H] [-i image] [-k sectors] [-l bytes]"
+#define GETOPTS ":3c:f:F:ghHi:k:l:?"
+
+#define TEST_FILE   "TEST.S3G"
+#define SPACER_FILE "SPACER.BIN"
+
+// Seeks made, and bytes read after each
+#define SEEKS      200
+#define SEEK_READ  16
+#define SEEK_LABEL "200 seeks"
+
+// Bytes per fat_write_file() call when writing the test file, as for a
+// captured packet
+#define WRITE_CHUNK 64
+
+typedef struct {
+     uint64_t clocked;
+     uint64_t cycles;
+     uint32_t single;       // CMD17
+     uint32_t multiple;     // CMD18
+     uint32_t stops;        // CMD12
+     uint32_t blocks;
+     uint32_t fat_blocks;   // Blocks read from the FATs
+     uint64_t highest;      // Highest block read
+} result_t;
+
+static struct partition_struct *partition = 0;
+static struct fat_fs_struct *fs = 0;
+static struct fat_dir_struct *root = 0;
+
+static void usage(FILE *f, const char *prog)
+{
+     if (f == NULL)
+	  f = stderr;
+
+     fprintf(f,
+"Usage: %s " OPTIONS "\n"
+"           -3 -- Format the card FAT32 rather than FAT16\n"
+"   -c card-MB -- Card size in megabytes (default 128)\n"
+"   -f file-KB -- Test file size in kilobytes (default 1024)\n"
+" -F filler-MB -- Megabytes of filler files to place before the test file\n"
+"           -g -- Fragment the test file\n"
+"           -H -- Emulate an SDHC card rather than SDSC\n"
+"     -i image -- Keep the card's contents in this file (default a\n"
+"                 temporary file)\n"
+"   -k sectors -- Sectors per cluster (default 8)\n"
+"     -l bytes -- Card access time, in bytes clocked, before each block\n"
+"                 it sends (default 64)\n"
+"        ?, -h -- This help message\n",
+	     prog ? prog : PROGNAME);
+}
+
+// Content of the test file, varying from block to block
+static uint8_t pattern(uint32_t i)
+{
+     return (uint8_t)((i ^ (i >> 9) ^ (i >> 17)) * 131 + 17);
+}
+
+static void unmount(void)
+{
+     if (root)
+	  fat_close_dir(root);
+     if (fs)
+	  fat_close(fs);
+     if (partition)
+	  partition_close(partition);
+     root = 0;
+     fs = 0;
+     partition = 0;
+}
+
+static bool mount(bool use_crc, uint8_t speed)
+{
+     struct fat_dir_entry_struct dir;
+
+     unmount();
+     if (!sd_raw_init(use_crc, speed))
+     {
+	  fprintf(stderr, "sd_raw_init() failed, sd_errno 0x%02x\n", sd_errno);
+	  return false;
+     }
+     partition = partition_open(sd_raw_read, sd_raw_read_interval,
+				sd_raw_write, sd_raw_write_interval, 0);
+     if (!partition)
+     {
+	  fprintf(stderr, "partition_open() failed\n");
+	  return false;
+     }
+     fs = fat_open(partition);
+     if (!fs || !fat_get_dir_entry_of_path(fs, "/", &dir) ||
+	 !(root = fat_open_dir(fs, &dir)))
+     {
+	  fprintf(stderr, "Unable to open the filesystem, fat_errno 0x%02x\n", fat_errno);
+	  return false;
+     }
+     return true;
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+     return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Have the card count the blocks read from the FATs
+static bool watchFats(void)
+{
+     uint8_t b[512];
+
+     if (!sdsim::readImage(0, b, sizeof(b)))
+	  return false;
+     uint32_t start = get32(b + 0x1be + 8);
+     if (!sdsim::readImage((uint64_t)start * 512, b, sizeof(b)))
+	  return false;
+     uint32_t fat_sectors = b[22] | (b[23] << 8);
+     if (fat_sectors == 0)
+	  fat_sectors = get32(b + 36);
+     sdsim::watch(start + (b[14] | (b[15] << 8)), (uint64_t)fat_sectors * b[16]);
+     return true;
+}
+
+static struct fat_file_struct *openFile(const char *name)
+{
+     struct fat_dir_entry_struct entry;
+
+     fat_reset_dir(root);
+     while (fat_read_dir(root, &entry))
+	  if (!strcmp(entry.long_name, name))
+	       return fat_open_file(fs, &entry);
+     return 0;
+}
+
+// Append len bytes of the test pattern, starting from its offset'th byte
+static bool appendFile(const char *name, uint32_t offset, uint32_t len)
+{
+     struct fat_file_struct *fd = openFile(name);
+     uint8_t buf[WRITE_CHUNK];
+     int32_t end = 0;
+
+     if (!fd || !fat_seek_file(fd, &end, FAT_SEEK_END))
+     {
+	  fprintf(stderr, "Unable to open %s\n", name);
+	  if (fd)
+	       fat_close_file(fd);
+	  return false;
+     }
+     for (uint32_t i = 0; i < len; )
+     {
+	  uint32_t n = (len - i < WRITE_CHUNK) ? len - i : WRITE_CHUNK;
+	  for (uint32_t j = 0; j < n; j++)
+	       buf[j] = pattern(offset + i + j);
+	  if (fat_write_file(fd, buf, n) != (intptr_t)n)
+	  {
+	       fprintf(stderr, "Write to %s failed at offset %u\n", name, end + i);
+	       fat_close_file(fd);
+	       return false;
+	  }
+	  i += n;
+     }
+     fat_close_file(fd);
+     return true;
+}
+
+// Write the test file, a piece of the given size at a time, with a piece
+// of the spacer file after each when spacing
+static bool writeFile(const char *name, uint32_t size, uint32_t piece, bool spacing)
+{
+     struct fat_dir_entry_struct entry;
+
+     if (!fat_create_file(root, name, &entry) ||
+	 (spacing && !fat_create_file(root, SPACER_FILE, &entry)))
+     {
+	  fprintf(stderr, "Unable to create %s\n", name);
+	  return false;
+     }
+     for (uint32_t i = 0; i < size; i += piece)
+     {
+	  uint32_t n = (size - i < piece) ? size - i : piece;
+	  if (!appendFile(name, i, n) ||
+	      (spacing && !appendFile(SPACER_FILE, 0, n)))
+	       return false;
+     }
+     return sd_raw_sync() != 0;
+}
+
+static void collect(result_t *res)
+{
+     res->clocked    = sdsim::stats.clocked;
+     res->cycles     = sdsim::stats.cycles;
+     res->single     = sdsim::stats.commands[17];
+     res->multiple   = sdsim::stats.commands[18];
+     res->stops      = sdsim::stats.commands[12];
+     res->blocks     = sdsim::stats.blocks_read;
+     res->fat_blocks = sdsim::stats.watched_reads;
+     res->highest    = sdsim::stats.highest_read;
+}
+
+// Read the file back a byte at a time and check it
+static bool readFile(const char *name, uint32_t size, bool stream, result_t *res)
+{
+     struct fat_file_struct *fd = openFile(name);
+     uint32_t n = 0;
+     intptr_t r;
+     uint8_t b;
+     bool differs = false;
+
+     if (!fd)
+     {
+	  fprintf(stderr, "Unable to open %s\n", name);
+	  return false;
+     }
+
+     sdsim::resetStats();
+     if (stream)
+	  sd_raw_stream(1);
+     while ((r = fat_read_file(fd, &b, 1)) > 0)
+     {
+	  if (b != pattern(n))
+	  {
+	       differs = true;
+	       break;
+	  }
+	  n++;
+     }
+     sd_raw_stream(0);
+     fat_close_file(fd);
+
+     collect(res);
+
+     if (differs)
+     {
+	  fprintf(stderr, "%s differs at offset %u\n", name, n);
+	  return false;
+     }
+     if (r < 0)
+     {
+	  fprintf(stderr, "Read of %s failed at offset %u, fat_errno 0x%02x\n",
+		  name, n, fat_errno);
+	  return false;
+     }
+     if (n != size)
+     {
+	  fprintf(stderr, "Read %u bytes of %s, expected %u\n", n, name, size);
+	  return false;
+     }
+     return true;
+}
+
+// Seek to pseudo-random offsets and check the bytes read at each
+static bool seekFile(const char *name, uint32_t size, result_t *res)
+{
+     struct fat_file_struct *fd = openFile(name);
+     uint32_t x = 1;
+     uint8_t buf[SEEK_READ];
+
+     if (!fd || size <= SEEK_READ)
+     {
+	  fprintf(stderr, "Unable to open %s\n", name);
+	  if (fd)
+	       fat_close_file(fd);
+	  return false;
+     }
+
+     sdsim::resetStats();
+     sd_raw_stream(1);
+     for (int i = 0; i < SEEKS; i++)
+     {
+	  x = x * 1103515245 + 12345;
+	  int32_t off = (int32_t)((x >> 8) % (size - SEEK_READ));
+	  uint32_t at = (uint32_t)off;
+	  if (!fat_seek_file(fd, &off, FAT_SEEK_SET) ||
+	      fat_read_file(fd, buf, SEEK_READ) != SEEK_READ)
+	  {
+	       fprintf(stderr, "Read of %s failed at offset %u, fat_errno 0x%02x\n",
+		       name, at, fat_errno);
+	       sd_raw_stream(0);
+	       fat_close_file(fd);
+	       return false;
+	  }
+	  for (int j = 0; j < SEEK_READ; j++)
+	       if (buf[j] != pattern(at + j))
+	       {
+		    fprintf(stderr, "%s differs at offset %u\n", name, at + j);
+		    sd_raw_stream(0);
+		    fat_close_file(fd);
+		    return false;
+	       }
+     }
+     sd_raw_stream(0);
+     fat_close_file(fd);
+
+     collect(res);
+     return true;
+}
+
+static void report(const char *what, uint32_t size, const result_t *res)
+{
+     printf("%-20s %9llu SPI bytes, %.3f per file byte, %6.3f s; "
+	    "%u blocks, %u of FAT, CMD17 %u, CMD18 %u, CMD12 %u\n",
+	    what, (unsigned long long)res->clocked,
+	    (double)res->clocked / (double)size,
+	    (double)res->cycles / (double)SDSIM_F_CPU,
+	    res->blocks, res->fat_blocks, res->single, res->multiple, res->stops);
+}
+
+int main(int argc, const char *argv[])
+{
+     char c;
+     bool fat32 = false, fragment = false;
+     sdsim::CardType type = sdsim::CARD_SDSC;
+     uint32_t card_mb = 128, file_kb = 1024, filler_mb = 0, latency = 64;
+     uint8_t sectors = 8;
+     const char *image = NULL;
+     result_t single, multi, standard, nocrc, crc, refused, seeks;
+
+     while ((c = getopt(argc, (char **)argv, GETOPTS)) != GETOPTS_END)
+     {
+	  switch(c)
+	  {
+	  // Unknown switch
+	  case ':' :
+	  default :
+	       usage(stderr, argv[0]);
+	       return(1);
+
+	  // Explicit help request
+	  case 'h' :
+	  case '?' :
+	       usage(stdout, argv[0]);
+	       return(0);
+
+	  case '3' :
+	       fat32 = true;
+	       break;
+
+	  case 'c' :
+	       card_mb = (uint32_t)strtoul(optarg, NULL, 0);
+	       break;
+
+	  case 'f' :
+	       file_kb = (uint32_t)strtoul(optarg, NULL, 0);
+	       break;
+
+	  case 'F' :
+	       filler_mb = (uint32_t)strtoul(optarg, NULL, 0);
+	       break;
+
+	  case 'g' :
+	       fragment = true;
+	       break;
+
+	  case 'H' :
+	       type = sdsim::CARD_SDHC;
+	       break;
+
+	  case 'i' :
+	       image = optarg;
+	       break;
+
+	  case 'k' :
+	       sectors = (uint8_t)strtoul(optarg, NULL, 0);
+	       break;
+
+	  case 'l' :
+	       latency = (uint32_t)strtoul(optarg, NULL, 0);
+	       break;
+	  }
+     }
+
+     uint32_t size = file_kb * 1024;
+
+     uint64_t filler = (uint64_t)filler_mb << 20;
+
+     if (!sdsim::insert((uint64_t)card_mb << 20, type, image))
+	  return(1);
+     if (!sdsim::format(fat32, sectors, filler))
+     {
+	  fprintf(stderr, "Cannot format a %u MB card FAT%d with %u sectors per cluster "
+		  "and %u MB of filler\n", card_mb, fat32 ? 32 : 16, sectors, filler_mb);
+	  return(1);
+     }
+     uint32_t cluster = (uint32_t)sectors * 512;
+     if (!mount(false, 0) || !watchFats() ||
+	 !writeFile(TEST_FILE, size, fragment ? cluster : size, fragment))
+	  return(1);
+
+     printf("%u KB %s file after %u MB of filler, %u byte clusters, FAT%d on a %u MB %s card, "
+	    "%u byte access time\n", file_kb, fragment ? "fragmented" : "contiguous",
+	    filler_mb, cluster, fat32 ? 32 : 16,
+	    card_mb, type == sdsim::CARD_SDHC ? "SDHC" : "SDSC", latency);
+
+     sdsim::setReadLatency(latency);
+     if (!mount(true, 0) ||
+	 !readFile(TEST_FILE, size, false, &single) ||
+	 !readFile(TEST_FILE, size, true, &multi))
+	  return(1);
+     report("single block reads", size, &single);
+     report("multi-block reads", size, &multi);
+
+     // The same at the clock used for SDSC cards, and without CRC checks
+     if (!mount(true, SD_RAW_SPEED_STANDARD) ||
+	 !readFile(TEST_FILE, size, true, &standard))
+	  return(1);
+     report("standard SPI clock", size, &standard);
+     if (!mount(false, 0) ||
+	 !readFile(TEST_FILE, size, true, &nocrc))
+	  return(1);
+     report("no CRC checks", size, &nocrc);
+
+     if (!seekFile(TEST_FILE, size, &seeks))
+	  return(1);
+     report(SEEK_LABEL, size, &seeks);
+
+     // A CRC error midway through ends multi-block reads for the file
+     if (!mount(true, 0))
+	  return(1);
+     sdsim::corruptRead(multi.blocks / 2);
+     if (!readFile(TEST_FILE, size, true, &crc))
+	  return(1);
+     report("CRC error midway", size, &crc);
+
+     // A card which refuses CMD18 is read a block at a time
+     sdsim::refuse(18);
+     if (!readFile(TEST_FILE, size, true, &refused))
+	  return(1);
+     report("CMD18 refused", size, &refused);
+
+     unmount();
+     sdsim::eject();
+
+     // Multi-block reads pay when runs of clusters are more than a block
+     if (!fragment && multi.clocked >= single.clocked)
+     {
+	  fprintf(stderr, "Multi-block reads clocked no fewer bytes than single block reads\n");
+	  return(1);
+     }
+     if (crc.single == 0 || crc.multiple == 0 || refused.multiple != 1)
+     {
+	  fprintf(stderr, "Multi-block reads did not fall back to single block reads\n");
+	  return(1);
+     }
+     if ((type == sdsim::CARD_SDHC) != (multi.cycles < standard.cycles))
+     {
+	  fprintf(stderr, "SDHC cards alone should be clocked faster than the standard clock\n");
+	  return(1);
+     }
+     if (nocrc.cycles != standard.cycles)
+     {
+	  fprintf(stderr, "Cards should be clocked at the standard clock without CRC checks\n");
+	  return(1);
+     }
+     if ((multi.highest + 1) * 512 <= filler)
+     {
+	  fprintf(stderr, "The test file was not placed beyond the filler\n");
+	  return(1);
+     }
+#if FAT_EXTENT_COUNT
+     // The clusters of a contiguous file are all known once it is open.
+     // Those of a fragmented one are looked up FAT_EXTENT_COUNT at a time.
+     uint32_t clusters = (size + cluster - 1) / cluster;
+     if (fragment ? multi.fat_blocks > clusters / (FAT_EXTENT_COUNT / 2) :
+	 (multi.fat_blocks || seeks.fat_blocks))
+     {
+	  fprintf(stderr, "The FAT was read more often than the cluster cache should allow\n");
+	  return(1);
+     }
+#endif
+     return(0);
+}
@@ -0,0 +1,386 @@
+// sdslice.cc
+// Measure how long the main loop's slices wait on the SD card during playback
+//
+// The card is emulated at the SPI level by SdCardSim.cc and given a FAT
+// filesystem holding a test file, which is then played back as the main
+// loop does, into a command buffer from which a fixed number of bytes is
+// taken each time around the loop.  Every so often the card stalls before
+// sending a block, as real cards do.
+//
+// Playback is run twice: first with the command slice reading the file a
+// byte at a time with fat_read_file(), as without SD_READ_AHEAD, and then
+// with SDReadAhead.cc filling its buffers from a slice of its own and the
+// command slice taking bytes only from them.  For each, the longest and
+// mean time a slice spends clocking SPI is reported, along with the number
+// of times the command buffer ran dry before the end of the file.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "SdCardSim.hh"
+#include "lib_sd/sd_raw.h"
+#include "lib_sd/partition.h"
+#include "lib_sd/fat.h"
+#include "SDReadAhead.hh"
+
+#if defined(__arm__)
+#define GETOPTS_END (char)-1
+#else
+#define GETOPTS_END -1
+#endif
+
+#define PROGNAME "sdslice"
+#define OPTIONS "[-? | -h] [-b bytes] [-f file-KB] [-l bytes] [-r bytes] [-s blocks] [-S bytes]"
+#define GETOPTS ":b:f:hl:r:s:S:?"
+
+#define TEST_FILE "PLAY.X3G"
+
+// As in Command.cc
+#define COMMAND_BUFFER_SIZE 512
+
+// Bytes beyond the budget a read-ahead slice may clock: the command
+// starting a multi-block read and its response
+#define COMMAND_BYTES 32
+
+typedef struct {
+     uint64_t slices;        // Slices which clocked any bytes
+     uint64_t cycles;        // Their total CPU cycles
+     uint64_t worst;         // CPU cycles of the longest
+     uint64_t worst_bytes;   // Bytes it clocked
+     uint32_t loops;         // Times around the main loop
+     uint32_t starved;       // Loops on which the command buffer was empty
+} result_t;
+
+static struct partition_struct *partition = 0;
+static struct fat_fs_struct *fs = 0;
+static struct fat_dir_struct *root = 0;
+
+// The command buffer, drained a fixed number of bytes per loop
+static uint8_t commands[COMMAND_BUFFER_SIZE];
+static uint32_t queued, taken;
+
+static void usage(FILE *f, const char *prog)
+{
+     if (f == NULL)
+	  f = stderr;
+
+     fprintf(f,
+"Usage: %s " OPTIONS "\n"
+"     -b bytes -- Bytes a read-ahead slice may clock (default 128)\n"
+"   -f file-KB -- Test file size in kilobytes; a partial block is added\n"
+"                 (default 256)\n"
+"     -l bytes -- Card access time, in bytes clocked, before each block\n"
+"                 it sends (default 64)\n"
+"     -r bytes -- Bytes taken from the command buffer each loop (default 8)\n"
+"    -s blocks -- Stall before every this many blocks (default 16)\n"
+"     -S bytes -- Length of each stall, in bytes clocked (default 8000)\n"
+"        ?, -h -- This help message\n",
+	     prog ? prog : PROGNAME);
+}
+
+// Content of the test file
+static uint8_t pattern(uint32_t i)
+{
+     return (uint8_t)((i ^ (i >> 9) ^ (i >> 17)) * 131 + 17);
+}
+
+static void unmount(void)
+{
+     if (root)
+	  fat_close_dir(root);
+     if (fs)
+	  fat_close(fs);
+     if (partition)
+	  partition_close(partition);
+     root = 0;
+     fs = 0;
+     partition = 0;
+}
+
+static bool mount(void)
+{
+     struct fat_dir_entry_struct dir;
+
+     unmount();
+     if (!sd_raw_init(false, 0))
+     {
+	  fprintf(stderr, "sd_raw_init() failed, sd_errno 0x%02x\n", sd_errno);
+	  return false;
+     }
+     partition = partition_open(sd_raw_read, sd_raw_read_interval,
+				sd_raw_write, sd_raw_write_interval, 0);
+     if (!partition)
+     {
+	  fprintf(stderr, "partition_open() failed\n");
+	  return false;
+     }
+     fs = fat_open(partition);
+     if (!fs || !fat_get_dir_entry_of_path(fs, "/", &dir) ||
+	 !(root = fat_open_dir(fs, &dir)))
+     {
+	  fprintf(stderr, "Unable to open the filesystem, fat_errno 0x%02x\n", fat_errno);
+	  return false;
+     }
+     return true;
+}
+
+static struct fat_file_struct *openFile(const char *name)
+{
+     struct fat_dir_entry_struct entry;
+
+     fat_reset_dir(root);
+     while (fat_read_dir(root, &entry))
+	  if (!strcmp(entry.long_name, name))
+	       return fat_open_file(fs, &entry);
+     return 0;
+}
+
+static bool writeFile(uint32_t size)
+{
+     struct fat_dir_entry_struct entry;
+     struct fat_file_struct *fd;
+     uint8_t buf[512];
+
+     if (!fat_create_file(root, TEST_FILE, &entry) || !(fd = openFile(TEST_FILE)))
+     {
+	  fprintf(stderr, "Unable to create " TEST_FILE "\n");
+	  return false;
+     }
+     for (uint32_t i = 0; i < size; i += sizeof(buf))
+     {
+	  uint32_t n = (size - i < sizeof(buf)) ? size - i : sizeof(buf);
+	  for (uint32_t j = 0; j < n; j++)
+	       buf[j] = pattern(i + j);
+	  if (fat_write_file(fd, buf, n) != (intptr_t)n)
+	  {
+	       fprintf(stderr, "Write to " TEST_FILE " failed at offset %u\n", i);
+	       fat_close_file(fd);
+	       return false;
+	  }
+     }
+     fat_close_file(fd);
+     return sd_raw_sync() != 0;
+}
+
+// Account for the bytes clocked since the slice began
+static void endSlice(uint64_t clocked, uint64_t cycles, result_t *res)
+{
+     clocked = sdsim::stats.clocked - clocked;
+     cycles = sdsim::stats.cycles - cycles;
+     if (!clocked)
+	  return;
+     res->slices++;
+     res->cycles += cycles;
+     if (cycles > res->worst)
+     {
+	  res->worst = cycles;
+	  res->worst_bytes = clocked;
+     }
+}
+
+// Take the loop's bytes from the command buffer and check them
+static bool drain(uint32_t rate, uint32_t size, result_t *res)
+{
+     if (queued == taken && taken < size)
+	  res->starved++;
+     for (uint32_t i = 0; i < rate && taken < queued; i++, taken++)
+	  if (commands[taken % COMMAND_BUFFER_SIZE] != pattern(taken))
+	  {
+	       fprintf(stderr, TEST_FILE " differs at offset %u\n", taken);
+	       return false;
+	  }
+     res->loops++;
+     return true;
+}
+
+// Play the file back with the command slice reading it from the card
+static bool playDirect(uint32_t size, uint32_t rate, result_t *res)
+{
+     struct fat_file_struct *fd = openFile(TEST_FILE);
+     uint8_t next;
+     bool more;
+
+     if (!fd)
+     {
+	  fprintf(stderr, "Unable to open " TEST_FILE "\n");
+	  return false;
+     }
+     memset(res, 0, sizeof(*res));
+     queued = taken = 0;
+
+     // As startPlayback() does
+     sd_raw_stream(1);
+     more = fat_read_file(fd, &next, 1) > 0;
+
+     while (taken < size)
+     {
+	  uint64_t clocked = sdsim::stats.clocked, cycles = sdsim::stats.cycles;
+	  while (queued - taken < COMMAND_BUFFER_SIZE && more)
+	  {
+	       commands[queued++ % COMMAND_BUFFER_SIZE] = next;
+	       more = fat_read_file(fd, &next, 1) > 0;
+	  }
+	  endSlice(clocked, cycles, res);
+	  if (!more && queued < size)
+	  {
+	       fprintf(stderr, "Read of " TEST_FILE " failed at offset %u\n", queued);
+	       break;
+	  }
+	  if (!drain(rate, size, res))
+	       break;
+     }
+     sd_raw_stream(0);
+     fat_close_file(fd);
+     return taken == size;
+}
+
+// Play the file back through SDReadAhead.cc
+static bool playAhead(uint32_t size, uint32_t rate, uint16_t budget, result_t *res)
+{
+     struct fat_file_struct *fd = openFile(TEST_FILE);
+
+     if (!fd)
+     {
+	  fprintf(stderr, "Unable to open " TEST_FILE "\n");
+	  return false;
+     }
+     memset(res, 0, sizeof(*res));
+     queued = taken = 0;
+
+     // As startPlayback() does
+     sd_raw_stream(1);
+     sdreadahead::begin(fd, 0);
+     sdreadahead::fill(0xffff);
+
+     while (taken < size)
+     {
+	  // runPlaybackSlice()
+	  uint64_t clocked = sdsim::stats.clocked, cycles = sdsim::stats.cycles;
+	  sdreadahead::fill(budget);
+	  endSlice(clocked, cycles, res);
+
+	  // runCommandSlice()
+	  clocked = sdsim::stats.clocked;
+	  cycles = sdsim::stats.cycles;
+	  while (queued - taken < COMMAND_BUFFER_SIZE && sdreadahead::available())
+	       commands[queued++ % COMMAND_BUFFER_SIZE] = sdreadahead::next();
+	  endSlice(clocked, cycles, res);
+
+	  if (sdreadahead::finished() && queued < size)
+	  {
+	       fprintf(stderr, "Read of " TEST_FILE " failed at offset %u\n", queued);
+	       break;
+	  }
+	  if (!drain(rate, size, res))
+	       break;
+     }
+     bool ok = taken == size && sdreadahead::finished() && !sdreadahead::failed();
+     sdreadahead::end();
+     sd_raw_stream(0);
+     fat_close_file(fd);
+     return ok;
+}
+
+static double usecs(uint64_t cycles)
+{
+     return (double)cycles * 1.0e6 / (double)SDSIM_F_CPU;
+}
+
+static void report(const char *what, const result_t *res)
+{
+     printf("%-16s worst slice %8.1f us (%llu bytes clocked), mean %6.1f us over %llu slices; "
+	    "%u loops, command buffer empty on %u\n",
+	    what, usecs(res->worst), (unsigned long long)res->worst_bytes,
+	    res->slices ? usecs(res->cycles) / (double)res->slices : 0.0,
+	    (unsigned long long)res->slices, res->loops, res->starved);
+}
+
+int main(int argc, const char *argv[])
+{
+     char c;
+     uint32_t file_kb = 256, latency = 64, rate = 8, stall_every = 16, stall_bytes = 8000;
+     uint16_t budget = 128;
+     result_t direct, ahead;
+
+     while ((c = getopt(argc, (char **)argv, GETOPTS)) != GETOPTS_END)
+     {
+	  switch(c)
+	  {
+	  // Unknown switch
+	  case ':' :
+	  default :
+	       usage(stderr, argv[0]);
+	       return(1);
+
+	  // Explicit help request
+	  case 'h' :
+	  case '?' :
+	       usage(stdout, argv[0]);
+	       return(0);
+
+	  case 'b' :
+	       budget = (uint16_t)strtoul(optarg, NULL, 0);
+	       break;
+
+	  case 'f' :
+	       file_kb = (uint32_t)strtoul(optarg, NULL, 0);
+	       break;
+
+	  case 'l' :
+	       latency = (uint32_t)strtoul(optarg, NULL, 0);
+	       break;
+
+	  case 'r' :
+	       rate = (uint32_t)strtoul(optarg, NULL, 0);
+	       break;
+
+	  case 's' :
+	       stall_every = (uint32_t)strtoul(optarg, NULL, 0);
+	       break;
+
+	  case 'S' :
+	       stall_bytes = (uint32_t)strtoul(optarg, NULL, 0);
+	       break;
+	  }
+     }
+
+     if (budget < 1 || rate < 1)
+     {
+	  fprintf(stderr, "The budget and rate must be at least 1 byte\n");
+	  return(1);
+     }
+
+     uint32_t size = file_kb * 1024 + 123;
+
+     if (!sdsim::insert((uint64_t)128 << 20, sdsim::CARD_SDHC))
+	  return(1);
+     if (!sdsim::format(false, 8) || !mount() || !writeFile(size))
+	  return(1);
+     sdsim::setReadLatency(latency);
+     sdsim::setReadStall(stall_every, stall_bytes);
+
+     printf("%u byte file, %u byte access time, a %u byte stall every %u blocks, "
+	    "%u bytes taken per loop, %u bytes per read-ahead slice\n",
+	    size, latency, stall_bytes, stall_every, rate, budget);
+
+     if (!playDirect(size, rate, &direct))
+	  return(1);
+     report("command slice", &direct);
+     if (!playAhead(size, rate, budget, &ahead))
+	  return(1);
+     report("read-ahead", &ahead);
+
+     unmount();
+     sdsim::eject();
+
+     if (ahead.worst_bytes > (uint64_t)budget + COMMAND_BYTES)
+     {
+	  fprintf(stderr, "A read-ahead slice clocked %llu bytes, over its budget of %u\n",
+		  (unsigned long long)ahead.worst_bytes, budget);
+	  return(1);
+     }
+     return(0);
+}
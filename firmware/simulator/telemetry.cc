@@ -0,0 +1,265 @@
+// telemetry.cc
+// Decode the telemetry frames in a captured host serial stream
+//
+// The bytes the bot sent to the host, as captured from the serial port,
+// are read from a file or stdin.  Packets are picked out with the
+// firmware's own InPacket code; telemetry frames are printed and all other
+// packets are counted and skipped.  Gaps in the frame sequence numbers,
+// which mean frames were lost, are reported.
+//
+// With -t, a stream of telemetry frames, responses and line noise is
+// generated and decoded instead, and the decoding checked.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "Simulator.hh"
+#include "Packet.hh"
+#include "Telemetry.hh"
+
+#if defined(__arm__)
+#define GETOPTS_END (char)-1
+#else
+#define GETOPTS_END -1
+#endif
+
+#define PROGNAME "telemetry"
+#define OPTIONS "[-? | -h] [-q] [-t] [file]"
+#define GETOPTS ":hqt?"
+
+static const char *build_states[] = {
+     "none", "running", "finished", "paused", "cancelled", "cancelling"
+};
+
+typedef struct {
+     uint32_t frames;
+     uint32_t lost;
+     uint32_t others;
+     uint32_t errors;
+     uint32_t short_frames;
+     uint32_t line_sum;              // For the self test
+     bool     have_seq;
+     uint8_t  seq;
+} stats_t;
+
+static void usage(FILE *f, const char *prog)
+{
+     if (f == NULL)
+	  f = stderr;
+
+     fprintf(f,
+"Usage: %s " OPTIONS "\n"
+"   file -- Captured serial stream from the bot (default stdin)\n"
+"     -q -- Print only the totals, not each frame\n"
+"     -t -- Decode a generated stream and check the results\n"
+"  ?, -h -- This help message\n",
+	     prog ? prog : PROGNAME);
+}
+
+static void print_frame(const InPacket& p)
+{
+     uint8_t state = p.read8(TELEMETRY_BUILD_STATE);
+     uint8_t heat = p.read8(TELEMETRY_HEATERS);
+     const char *names[3] = { "T0", "T1", "HBP" };
+
+     printf("#%-3u status 0x%02x %-10s %3u%% line %-7u free %-4u",
+	    p.read8(TELEMETRY_SEQ), p.read8(TELEMETRY_BOARD_STATUS),
+	    state < sizeof(build_states) / sizeof(build_states[0]) ?
+	    build_states[state] : "?",
+	    p.read8(TELEMETRY_BUILD_PERCENT), p.read32(TELEMETRY_LINE),
+	    p.read16(TELEMETRY_CAPACITY));
+     for (int i = 0; i < 3; i++)
+     {
+	  uint8_t ready = (i < 2) ? (TELEMETRY_HEAT_TOOL0_READY << i) : TELEMETRY_HEAT_PLATFORM_READY;
+	  uint8_t failed = (i < 2) ? (TELEMETRY_HEAT_TOOL0_FAILED << i) : TELEMETRY_HEAT_PLATFORM_FAILED;
+	  printf(" %s %d/%d%s", names[i],
+		 (int16_t)p.read16(TELEMETRY_TEMPS + 4 * i),
+		 (int16_t)p.read16(TELEMETRY_TEMPS + 4 * i + 2),
+		 (heat & failed) ? "!" : (heat & ready) ? "*" : "");
+     }
+     printf(" pos");
+     for (int i = 0; i < 5; i++)
+	  printf(" %d", (int32_t)p.read32(TELEMETRY_POSITION + 4 * i));
+     printf(" end 0x%02x dropped %u\n", p.read8(TELEMETRY_ENDSTOPS),
+	    p.read16(TELEMETRY_RX_OVERRUNS));
+}
+
+static void decode_byte(InPacket& p, uint8_t b, stats_t *st, bool quiet)
+{
+     p.processByte(b);
+     if (p.hasError() || p.isFinished() == -1)
+     {
+	  st->errors++;
+	  p.reset();
+	  return;
+     }
+     if (p.isFinished() != 1)
+	  return;
+
+     if (p.read8(0) != TELEMETRY_FRAME)
+	  st->others++;
+     else if (p.getLength() < TELEMETRY_LENGTH)
+	  st->short_frames++;
+     else
+     {
+	  uint8_t seq = p.read8(TELEMETRY_SEQ);
+	  if (st->have_seq && seq != (uint8_t)(st->seq + 1))
+	  {
+	       st->lost += (uint8_t)(seq - st->seq - 1);
+	       if (!quiet)
+		    printf("-- %u frames lost\n", (uint8_t)(seq - st->seq - 1));
+	  }
+	  st->seq = seq;
+	  st->have_seq = true;
+	  st->frames++;
+	  st->line_sum += p.read32(TELEMETRY_LINE);
+	  if (!quiet)
+	       print_frame(p);
+     }
+     p.reset();
+}
+
+static void send(FILE *f, OutPacket& out)
+{
+     out.prepareForResend();
+     do
+	  fputc(out.getNextByteToSend(), f);
+     while (!out.isFinished());
+}
+
+// Write a stream of n telemetry frames, skipping frame "drop", with a
+// response after every third frame and noise after every fifth
+static void generate(FILE *f, uint32_t n, uint32_t drop)
+{
+     OutPacket out;
+
+     for (uint32_t i = 0; i < n; i++)
+     {
+	  out.reset();
+	  out.append8(TELEMETRY_FRAME);
+	  out.append8((uint8_t)i);
+	  out.append8(0x40);
+	  out.append8(1);
+	  out.append8(TELEMETRY_HEAT_TOOL0_READY | TELEMETRY_HEAT_PLATFORM_READY);
+	  out.append8(i % 101);
+	  for (int h = 0; h < 3; h++)
+	  {
+	       out.append16(200 + h);
+	       out.append16(210 + h);
+	  }
+	  for (int a = 0; a < 5; a++)
+	       out.append32(-1000 * (int32_t)i * (a + 1));
+	  out.append8(0);
+	  out.append16(512 - (i % 512));
+	  out.append32(i);
+	  out.append16(0);
+	  if (i != drop)
+	       send(f, out);
+
+	  if ((i % 3) == 2)
+	  {
+	       out.reset();
+	       out.append8(RC_OK);
+	       out.append32(512);
+	       send(f, out);
+	  }
+	  if ((i % 5) == 4)
+	       fputc(0x17, f);
+     }
+}
+
+static int self_test(void)
+{
+     const uint32_t n = 1000, drop = 600;
+     FILE *f = tmpfile();
+     InPacket p;
+     stats_t st;
+     int c;
+
+     if (f == NULL)
+     {
+	  perror("tmpfile");
+	  return(1);
+     }
+     generate(f, n, drop);
+     rewind(f);
+
+     memset(&st, 0, sizeof(st));
+     p.reset();
+     while ((c = fgetc(f)) != EOF)
+	  decode_byte(p, (uint8_t)c, &st, true);
+     fclose(f);
+
+     printf("%u frames, %u lost, %u other packets, %u noise bytes\n",
+	    st.frames, st.lost, st.others, st.errors);
+     if (st.frames != n - 1 || st.lost != 1 || st.others != n / 3 ||
+	 st.errors != n / 5 || st.short_frames ||
+	 st.line_sum != n * (n - 1) / 2 - drop)
+     {
+	  fprintf(stderr, "Decoded stream does not match the generated one\n");
+	  return(1);
+     }
+     return(0);
+}
+
+int main(int argc, const char *argv[])
+{
+     char c;
+     bool quiet = false;
+     FILE *f = stdin;
+     InPacket p;
+     stats_t st;
+     int b;
+
+     while ((c = getopt(argc, (char **)argv, GETOPTS)) != GETOPTS_END)
+     {
+	  switch(c)
+	  {
+	  // Unknown switch
+	  case ':' :
+	  default :
+	       usage(stderr, argv[0]);
+	       return(1);
+
+	  // Explicit help request
+	  case 'h' :
+	  case '?' :
+	       usage(stdout, argv[0]);
+	       return(0);
+
+	  case 'q' :
+	       quiet = true;
+	       break;
+
+	  case 't' :
+	       return(self_test());
+	  }
+     }
+
+     if (optind < argc)
+     {
+	  f = fopen(argv[optind], "rb");
+	  if (f == NULL)
+	  {
+	       perror(argv[optind]);
+	       return(1);
+	  }
+     }
+
+     memset(&st, 0, sizeof(st));
+     p.reset();
+     while ((b = fgetc(f)) != EOF)
+	  decode_byte(p, (uint8_t)b, &st, quiet);
+     if (f != stdin)
+	  fclose(f);
+
+     printf("%u telemetry frames, %u lost; %u other packets, %u packet errors",
+	    st.frames, st.lost, st.others, st.errors);
+     if (st.short_frames)
+	  printf(", %u short frames", st.short_frames);
+     printf("\n");
+     return(0);
+}
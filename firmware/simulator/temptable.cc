@@ -0,0 +1,353 @@
+// temptable.cc
+// Check TemperatureTable.cc's conversions against the breakpoint tables
+// they were resampled from
+//
+// The thermistor, thermocouple and cold junction tables were searched
+// entry by entry for the pair of breakpoints either side of a reading,
+// which were then interpolated between.  They are now held as values at
+// evenly spaced readings, found with a shift.  The breakpoint tables and
+// the search are kept here as the reference for the new conversion, which
+// is run over the whole range of readings, with and without the extra bits
+// given by ADC oversampling, and must agree with the reference about which
+// readings are out of scale and be within a tolerance of it elsewhere.
+//
+// The time each takes per conversion is reported, as are the table entries
+// each reads from program memory.  TemperatureTable.cc is compiled twice,
+// for the Replicator 2 and, by TemperatureTableRep1.cc, the Replicator.
+//
+// With -p, the resampled tables are printed for pasting into
+// TemperatureTable.cc.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <math.h>
+
+#include "TemperatureTable.hh"
+
+#if defined(__arm__)
+#define GETOPTS_END (char)-1
+#else
+#define GETOPTS_END -1
+#endif
+
+#define PROGNAME "temptable"
+#define OPTIONS "[-? | -h] [-p] [-r repeats]"
+#define GETOPTS ":hpr:?"
+
+// Thermistor.cc's limit, above which readings are errors
+#define MAX_TEMP 255
+
+// The TemperatureTable.cc compiled by TemperatureTableRep1.cc
+namespace rep1 {
+namespace TemperatureTable {
+float TempReadtoCelsius(int16_t reading, int8_t table_idx, float max_allowed_value,
+			uint8_t extra_bits);
+}
+}
+
+typedef struct {
+     int16_t adc;
+     int16_t value;
+} Entry;
+
+typedef float (*convert_t)(int16_t reading, int8_t table_idx, float max_allowed_value,
+			   uint8_t extra_bits);
+
+// The tables as they were before being resampled
+
+static const Entry rep1_table[] = {
+     {1, 841}, {54, 255}, {107, 209}, {160, 184}, {213, 166},
+     {266, 153}, {319, 142}, {372, 132}, {425, 124}, {478, 116},
+     {531, 108}, {584, 101}, {637, 93}, {690, 86}, {743, 78},
+     {796, 70}, {849, 61}, {902, 50}, {955, 34}, {1008, 3}
+};
+
+static const Entry rep2_table[] = {
+     {1, 916}, {54, 265}, {107, 216}, {160, 189}, {213, 171},
+     {266, 157}, {319, 135}, {372, 127}, {425, 119}, {478, 112},
+     {531, 104}, {584, 98}, {637, 91}, {690, 84}, {743, 77},
+     {796, 68}, {849, 58}, {902, 48}, {955, 34}, {1008, 2}
+};
+
+static const Entry thermocouple_table[] = {
+     {-304, -64}, {-232, -48}, {-157, -32}, {-79, -16}, {0, 0},
+     {82, 16}, {164, 32}, {248, 48}, {333, 64}, {418, 80},
+     {503, 96}, {588, 112}, {672, 128}, {755, 144}, {837, 160},
+     {919, 176}, {1001, 192}, {1083, 208}, {1165, 224}, {1248, 240},
+     {1331, 256}, {1415, 272}, {1499, 288}, {1584, 304}, {1754, 336}
+};
+
+static const Entry coldjunction_table[] = {
+     {-32, -157}, {-16, -79}, {0, 0}, {16, 81}, {32, 164}, {48, 248},
+     {64, 333}, {80, 418}, {96, 503}, {112, 587}, {128, 671}, {144, 754}
+};
+
+#define ENTRIES(t) ((int8_t)(sizeof(t) / sizeof(Entry)))
+
+typedef struct {
+     const char *name;
+     const char *array;       // Name of the resampled table's values
+     const Entry *table;      // Breakpoints
+     int8_t num;              // Number of breakpoints
+     int8_t table_idx;        // therm_tables index
+     convert_t convert;       // Conversion under test
+     uint8_t shift;           // ADC counts between resampled values, as a power of two
+     int16_t knot;            // Breakpoint which falls on a resampled value
+     int16_t min_reading;     // Readings tested, without extra bits
+     int16_t max_reading;
+     uint8_t extra_bits;      // Most extra bits tested
+     float max_allowed;       // Result for readings out of scale
+     float usable;            // Highest result held to the tolerance
+     float tolerance;
+} case_t;
+
+static const case_t cases[] = {
+     { "Replicator thermistor", "therm_values", rep1_table, ENTRIES(rep1_table),
+       TemperatureTable::table_thermistor, rep1::TemperatureTable::TempReadtoCelsius,
+       4, 54, 0, 1023, 2, MAX_TEMP, MAX_TEMP, 1.5 },
+     { "Replicator 2 thermistor", "therm_values", rep2_table, ENTRIES(rep2_table),
+       TemperatureTable::table_thermistor, TemperatureTable::TempReadtoCelsius,
+       4, 54, 0, 1023, 2, MAX_TEMP, MAX_TEMP, 1.5 },
+     { "Thermocouple", "thermocouple_values", thermocouple_table, ENTRIES(thermocouple_table),
+       TemperatureTable::table_thermocouple, TemperatureTable::TempReadtoCelsius,
+       5, 0, -32768, 32767, 0, MAX_TEMP, MAX_TEMP, 0.1 },
+     { "Cold junction", "coldjunction_values", coldjunction_table, ENTRIES(coldjunction_table),
+       TemperatureTable::table_coldjunction, TemperatureTable::TempReadtoCelsius,
+       4, 0, -32768, 32767, 0, 0x7FFF, 0x7FFF, 0.1 }
+};
+
+#define NCASES (sizeof(cases) / sizeof(case_t))
+
+// Table entries read by oldTempReadtoCelsius()
+static uint32_t entries_read;
+
+static void usage(FILE *f, const char *prog)
+{
+     if (f == NULL)
+	  f = stderr;
+
+     fprintf(f,
+"Usage: %s " OPTIONS "\n"
+"           -p -- Print the resampled tables\n"
+"   -r repeats -- Times each range of readings is converted when timing\n"
+"                 (default 20)\n"
+"        ?, -h -- This help message\n",
+	     prog ? prog : PROGNAME);
+}
+
+static void getEntry(Entry *rv, const Entry *table, int8_t entryIdx)
+{
+     memcpy(rv, &table[entryIdx], sizeof(Entry));
+     entries_read++;
+}
+
+// TempReadtoCelsius() as it was, searching the breakpoints
+static float oldTempReadtoCelsius(const Entry *table, int8_t num, int16_t reading,
+				  float max_allowed_value, uint8_t extra_bits)
+{
+     int8_t bottom = 0;
+     int8_t numtemps = num - 1;
+     int8_t top = numtemps;
+     int8_t mid = (bottom+top)/2;
+     Entry e;
+     while (mid > bottom) {
+	  getEntry(&e, table, mid);
+	  if (reading < (e.adc << extra_bits)) {
+	       top = mid;
+	       mid = (bottom+top)/2;
+	  } else {
+	       bottom = mid;
+	       mid = (bottom+top)/2;
+	  }
+     }
+     Entry eb, et;
+     getEntry(&eb, table, bottom);
+     getEntry(&et, table, top);
+     int16_t adc_b = eb.adc << extra_bits;
+     int16_t adc_t = et.adc << extra_bits;
+     if (bottom == 0 && reading < adc_b)
+	  return max_allowed_value;
+     if (top == numtemps && reading > adc_t)
+	  return max_allowed_value;
+     return (float)eb.value + (float)((int32_t)(reading - adc_b) * (et.value - eb.value)) / (float)(adc_t - adc_b);
+}
+
+// The breakpoints interpolated, and extrapolated beyond either end
+static double breakpoints(const Entry *table, int8_t num, int32_t reading)
+{
+     int8_t i = 0;
+     while (i < num - 2 && reading > table[i + 1].adc)
+	  i++;
+     return table[i].value + (double)(reading - table[i].adc) *
+	  (table[i + 1].value - table[i].value) / (double)(table[i + 1].adc - table[i].adc);
+}
+
+// Print the values of a case's table at evenly spaced readings, as
+// TemperatureTable.cc holds them
+static void resample(const case_t *c)
+{
+     int16_t first = c->table[0].adc;
+     int16_t last = c->table[c->num - 1].adc;
+     int32_t step = 1 << c->shift;
+     int32_t origin = c->knot - ((c->knot - first + step - 1) / step) * step;
+     int32_t count = ((last - origin) >> c->shift) + 2;
+
+     printf("// %s: from %d, every %d ADC counts\n", c->name, origin, step);
+     printf("static const int16_t %s[] PROGMEM = {", c->array);
+     for (int32_t i = 0; i < count; i++)
+     {
+	  double v = breakpoints(c->table, c->num, origin + i * step);
+	  long q = lround(v * (1 << TEMP_TABLE_FRAC_BITS));
+	  printf("%s%6ld%s", (i % 8) ? " " : "\n\t", q, (i < count - 1) ? "," : "\n");
+     }
+     printf("};\n");
+     printf("// { %d, %d, %d, %d, %s }\n\n", first, last, origin, c->shift, c->array);
+}
+
+static double now(void)
+{
+     struct timespec ts;
+
+     clock_gettime(CLOCK_MONOTONIC, &ts);
+     return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// Convert every reading in a case's range and compare the results
+static bool check(const case_t *c, uint8_t extra_bits)
+{
+     int32_t lo = (int32_t)c->min_reading << extra_bits;
+     int32_t hi = (c->max_reading < 0) ? c->max_reading :
+	  (((int32_t)c->max_reading + 1) << extra_bits) - 1;
+     uint32_t scale_mismatches = 0, in_scale = 0;
+     double worst = 0.0, worst_usable = 0.0;
+     int32_t worst_reading = 0;
+
+     for (int32_t r = lo; r <= hi; r++)
+     {
+	  float expect = oldTempReadtoCelsius(c->table, c->num, (int16_t)r,
+					      c->max_allowed, extra_bits);
+	  float got = c->convert((int16_t)r, c->table_idx, c->max_allowed, extra_bits);
+	  int16_t first = c->table[0].adc << extra_bits;
+	  int16_t last = c->table[c->num - 1].adc << extra_bits;
+
+	  if (r < first || r > last)
+	  {
+	       if (got != c->max_allowed)
+		    scale_mismatches++;
+	       continue;
+	  }
+	  in_scale++;
+	  double d = fabs((double)got - (double)expect);
+	  if (d > worst)
+	       worst = d;
+	  if (expect <= c->usable && d > worst_usable)
+	  {
+	       worst_usable = d;
+	       worst_reading = r;
+	  }
+     }
+
+     printf("%-24s %d extra bits: %6u readings in scale, worst deviation %.3f, "
+	    "%.3f at or below %.0f (reading %d)\n",
+	    c->name, extra_bits, in_scale, worst, worst_usable, c->usable, worst_reading);
+
+     if (scale_mismatches)
+     {
+	  fprintf(stderr, "%s: %u readings out of scale were converted\n",
+		  c->name, scale_mismatches);
+	  return false;
+     }
+     if (worst_usable > c->tolerance)
+     {
+	  fprintf(stderr, "%s: deviation %.3f exceeds %.3f\n",
+		  c->name, worst_usable, c->tolerance);
+	  return false;
+     }
+     return true;
+}
+
+// Time both conversions over the readings within a case's table
+static void timing(const case_t *c, uint8_t extra_bits, unsigned repeats)
+{
+     int16_t first = c->table[0].adc << extra_bits;
+     int16_t last = c->table[c->num - 1].adc << extra_bits;
+     volatile float sink = 0;
+     double t0, t_old, t_new;
+     uint32_t n = (uint32_t)(last - first + 1) * repeats;
+
+     entries_read = 0;
+     t0 = now();
+     for (unsigned i = 0; i < repeats; i++)
+	  for (int32_t r = first; r <= last; r++)
+	       sink = oldTempReadtoCelsius(c->table, c->num, (int16_t)r,
+					   c->max_allowed, extra_bits);
+     t_old = now() - t0;
+
+     t0 = now();
+     for (unsigned i = 0; i < repeats; i++)
+	  for (int32_t r = first; r <= last; r++)
+	       sink = c->convert((int16_t)r, c->table_idx, c->max_allowed, extra_bits);
+     t_new = now() - t0;
+     (void)sink;
+
+     printf("%-24s %d extra bits: search %6.1f ns, %4.1f entries read; "
+	    "indexed %6.1f ns, 2 values read; %.1f x faster\n",
+	    c->name, extra_bits, t_old * 1e9 / n, (double)entries_read / n,
+	    t_new * 1e9 / n, t_old / t_new);
+}
+
+int main(int argc, const char *argv[])
+{
+     char c;
+     bool print = false, ok = true;
+     unsigned repeats = 20;
+
+     while ((c = getopt(argc, (char **)argv, GETOPTS)) != GETOPTS_END)
+     {
+	  switch(c)
+	  {
+	  // Unknown switch
+	  case ':' :
+	  default :
+	       usage(stderr, argv[0]);
+	       return(1);
+
+	  // Explicit help request
+	  case 'h' :
+	  case '?' :
+	       usage(stdout, argv[0]);
+	       return(0);
+
+	  case 'p' :
+	       print = true;
+	       break;
+
+	  case 'r' :
+	       repeats = (unsigned)strtoul(optarg, NULL, 0);
+	       break;
+	  }
+     }
+
+     if (print)
+     {
+	  for (size_t i = 0; i < NCASES; i++)
+	       resample(&cases[i]);
+	  return(0);
+     }
+
+     for (size_t i = 0; i < NCASES; i++)
+	  for (uint8_t b = 0; b <= cases[i].extra_bits; b++)
+	       if (!check(&cases[i], b))
+		    ok = false;
+
+     if (repeats)
+	  for (size_t i = 0; i < NCASES; i++)
+	       for (uint8_t b = 0; b <= cases[i].extra_bits; b += 2)
+		    timing(&cases[i], b, repeats);
+
+     return(ok ? 0 : 1);
+}
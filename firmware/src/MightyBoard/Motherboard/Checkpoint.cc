@@ -0,0 +1,463 @@
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include "Checkpoint.hh"
+
+#ifdef PRINT_CHECKPOINT
+
+#include "EepromMap.hh"
+
+#ifndef SIMULATOR
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+#include <util/atomic.h>
+#include "Command.hh"
+#include "Commands.hh"
+#include "Eeprom.hh"
+#include "Host.hh"
+#include "SDCard.hh"
+#include "Steppers.hh"
+#include "StepperAccel.hh"
+#include "StepperAccelPlanner.hh"
+#include "Timeout.hh"
+#endif
+
+namespace checkpoint {
+
+// What the EEPROM writer is presently doing.  A header or record is
+// written in three steps so that it becomes valid atomically: its commit
+// byte is first spoiled, then the remaining bytes are written and finally
+// the commit byte is written.  Whatever a power failure leaves behind
+// before that last byte, the spoiled commit byte rejects it; the CRC alone
+// would pass one torn write in 65536.
+enum {
+	WRITE_IDLE = 0,
+	WRITE_SPOIL,
+	WRITE_BODY,
+	WRITE_COMMIT
+};
+
+static Header   header;
+static Record   record;
+
+static bool     header_pending = false;
+static bool     record_pending = false;
+static uint8_t  writing = WRITE_IDLE;
+static bool     write_record;        // Writing a record, else the header
+static uint16_t write_base;          // EEPROM address being written
+static const uint8_t *write_src;     // RAM image being written
+static uint8_t  write_len;           // Size of the image
+static uint8_t  write_pos;           // Next byte of the body to write
+static uint8_t  write_key;           // Offset of the commit byte
+static uint8_t  write_spoil;         // Commit byte value until committed
+static uint8_t  write_slot;
+
+// Newest valid slot for the current build, or 0xff if none
+static uint8_t  newest_slot = 0xff;
+static uint16_t newest_seq;
+
+// Last slot written, whatever the build.  Writes rotate through the
+// ring from here so that slot 0 doesn't take a write for every build.
+static uint8_t  last_slot = CHECKPOINT_SLOTS - 1;
+
+// Set while a checkpointed build is being restarted
+static bool     resuming = false;
+
+static uint16_t crc(const uint8_t *p, uint8_t len) {
+	uint16_t c = 0xffff;
+	while ( len-- ) c = _crc_ccitt_update(c, *p++);
+	return c;
+}
+
+static inline uint16_t slotAddress(uint8_t slot) {
+	return eeprom_offsets::CHECKPOINT_RING + (uint16_t)slot * sizeof(Record);
+}
+
+static void readBlock(uint8_t *dst, uint16_t addr, uint8_t len) {
+	while ( len-- ) *dst++ = eeprom_read_byte((const uint8_t *)(uintptr_t)addr++);
+}
+
+static bool headerValid(const Header& h) {
+	return h.crc == crc((const uint8_t *)&h, sizeof(Header) - sizeof(uint16_t));
+}
+
+static bool readSlot(uint8_t slot, Record& rec) {
+	readBlock((uint8_t *)&rec, slotAddress(slot), sizeof(Record));
+	return ( rec.crc == crc((const uint8_t *)&rec, sizeof(Record) - sizeof(uint16_t)) ) &&
+		( rec.build_id == header.build_id );
+}
+
+void init() {
+	header_pending = false;
+	record_pending = false;
+	writing = WRITE_IDLE;
+	newest_slot = 0xff;
+
+	readBlock((uint8_t *)&header, eeprom_offsets::CHECKPOINT_HEADER, sizeof(Header));
+	if ( !headerValid(header) ) {
+		memset(&header, 0, sizeof(Header));
+		return;
+	}
+
+	// Sequence numbers are compared as serial numbers so that
+	// wrap around of the 16 bit counter is harmless
+	Record rec;
+	for ( uint8_t slot = 0; slot < CHECKPOINT_SLOTS; slot++ ) {
+		if ( !readSlot(slot, rec) ) continue;
+		if ( newest_slot == 0xff || (int16_t)(rec.seq - newest_seq) > 0 ) {
+			newest_slot = slot;
+			newest_seq  = rec.seq;
+		}
+	}
+	if ( newest_slot != 0xff ) last_slot = newest_slot;
+}
+
+bool available() {
+	return header.active && newest_slot != 0xff && !header_pending &&
+		!( writing != WRITE_IDLE && !write_record );
+}
+
+bool load(Record& rec, char *name) {
+	if ( !available() || !readSlot(newest_slot, rec) ) return false;
+	if ( name ) {
+		memcpy(name, header.name, CHECKPOINT_NAME_LEN);
+		name[CHECKPOINT_NAME_LEN] = '\0';
+	}
+	return true;
+}
+
+void beginBuild(const char *name) {
+	if ( resuming ) return;
+
+	// Records of the prior build are left in place; the new build id
+	// orphans them.  Abandon any write in progress: it is either for the
+	// prior build or is a header write which we are about to redo.  The
+	// abandoned write's commit byte is still spoiled.
+	writing = WRITE_IDLE;
+	record_pending = false;
+	newest_slot = 0xff;
+
+	// Choose a build id which no slot carries, valid or not.  The id
+	// wraps and a torn header loses it altogether; either way, records
+	// of an earlier build must never pass for this build's.
+	uint8_t id = header.build_id;
+	bool used;
+	do {
+		id++;
+		used = false;
+		for ( uint8_t slot = 0; slot < CHECKPOINT_SLOTS && !used; slot++ )
+			used = ( id == eeprom_read_byte((const uint8_t *)(uintptr_t)(slotAddress(slot) + offsetof(Record, build_id))) );
+	} while ( used );
+
+	strncpy(header.name, name, CHECKPOINT_NAME_LEN);
+	header.name[CHECKPOINT_NAME_LEN] = '\0';
+	header.build_id = id;
+	header.active = 1;
+	header.crc = crc((const uint8_t *)&header, sizeof(Header) - sizeof(uint16_t));
+	header_pending = true;
+}
+
+void endBuild() {
+	if ( !header.active ) return;
+	writing = WRITE_IDLE;
+	record_pending = false;
+	header.active = 0;
+	header.crc = crc((const uint8_t *)&header, sizeof(Header) - sizeof(uint16_t));
+	header_pending = true;
+}
+
+bool save(Record& rec) {
+	if ( record_pending || ( writing != WRITE_IDLE && write_record ) || !header.active )
+		return false;
+
+	rec.seq = newest_seq + 1;
+	rec.build_id = header.build_id;
+	rec.reserved = 0;
+	rec.crc = crc((const uint8_t *)&rec, sizeof(Record) - sizeof(uint16_t));
+	memcpy(&record, &rec, sizeof(Record));
+	record_pending = true;
+	return true;
+}
+
+bool isWriting() {
+	return writing != WRITE_IDLE || header_pending || record_pending;
+}
+
+void runWriterSlice() {
+	if ( writing == WRITE_IDLE ) {
+		// The header always goes first: a record must never reference
+		// a build id which is not yet in the EEPROM
+		if ( header_pending ) {
+			header_pending = false;
+			write_record = false;
+			write_base   = eeprom_offsets::CHECKPOINT_HEADER;
+			write_src    = (const uint8_t *)&header;
+			write_len    = sizeof(Header);
+			write_key    = offsetof(Header, active);
+			write_spoil  = 0;
+		}
+		else if ( record_pending ) {
+			record_pending = false;
+			// Overwrite the slot after the last written; that is, the oldest
+			write_slot   = ( last_slot >= CHECKPOINT_SLOTS - 1 ) ? 0 : last_slot + 1;
+			write_record = true;
+			write_base   = slotAddress(write_slot);
+			write_src    = (const uint8_t *)&record;
+			write_len    = sizeof(Record);
+			write_key    = offsetof(Record, build_id);
+			write_spoil  = ~header.build_id;
+		}
+		else
+			return;
+		writing = WRITE_SPOIL;
+	}
+
+	// Bytes which already hold the desired value are skipped; they cost
+	// neither time nor wear.  At most one byte is written per call.
+	while ( eeprom_is_ready() ) {
+		uint8_t pos, b;
+		if ( writing == WRITE_BODY ) {
+			if ( write_pos >= write_len ) {
+				writing = WRITE_COMMIT;
+				continue;
+			}
+			pos = write_pos++;
+			b = ( pos == write_key ) ? write_spoil : write_src[pos];
+		}
+		else {
+			pos = write_key;
+			b = ( writing == WRITE_SPOIL ) ? write_spoil : write_src[pos];
+		}
+
+		uint8_t *addr = (uint8_t *)(uintptr_t)(write_base + pos);
+		bool differs = ( eeprom_read_byte(addr) != b );
+		if ( differs ) eeprom_write_byte(addr, b);
+
+		if ( writing == WRITE_SPOIL ) {
+			writing = WRITE_BODY;
+			write_pos = 0;
+		}
+		else if ( writing == WRITE_COMMIT ) {
+			if ( write_record ) {
+				last_slot   = write_slot;
+				newest_slot = write_slot;
+				newest_seq  = record.seq;
+			}
+			writing = WRITE_IDLE;
+			return;
+		}
+		if ( differs ) return;
+	}
+}
+
+#ifndef SIMULATOR
+
+static Timeout  checkpoint_timeout;
+static bool     snapshot_pending = false;
+static Record   snapshot;
+static uint8_t  snapshot_head;
+static uint8_t  snapshot_blocks;
+static uint32_t last_line_number;
+
+// Lift the nozzle this far off the part while heating and homing
+#define CHECKPOINT_Z_CLEARANCE_MM 2.0
+
+// Homing feedrate, us per step, and timeout, seconds
+#define CHECKPOINT_HOME_FEEDRATE 361
+#define CHECKPOINT_HOME_TIMEOUT  20
+
+// Heater wait timeout, seconds
+#define CHECKPOINT_HEAT_TIMEOUT  1200
+
+void runCheckpointSlice() {
+	runWriterSlice();
+
+	if ( host::getHostState() != host::HOST_STATE_BUILDING_FROM_SD ||
+	     host::getBuildState() != host::BUILD_RUNNING ||
+	     command::isPaused() || command::pauseIntermediateState() ) {
+		snapshot_pending = false;
+		return;
+	}
+
+	if ( snapshot_pending ) {
+		// The snapshot may be committed once every block which was in the
+		// planner when it was taken has been executed.  That has happened
+		// when the planner tail reaches the head as it was at the time of
+		// the snapshot.  As the tail may pass that point between calls,
+		// treat an increase in the distance as having passed it.
+		uint8_t blocks = (snapshot_head - block_buffer_tail) & (BLOCK_BUFFER_SIZE - 1);
+		if ( blocks == 0 || blocks > snapshot_blocks ) {
+			if ( save(snapshot) ) {
+				snapshot_pending = false;
+				checkpoint_timeout.start(CHECKPOINT_INTERVAL_MICROS);
+			}
+		}
+		else
+			snapshot_blocks = blocks;
+		return;
+	}
+
+	if ( checkpoint_timeout.isActive() && !checkpoint_timeout.hasElapsed() )
+		return;
+
+	// Nothing worth recording if no commands have executed since the
+	// last checkpoint
+	if ( command::getLineNumber() == last_line_number ) {
+		checkpoint_timeout.start(CHECKPOINT_INTERVAL_MICROS);
+		return;
+	}
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		snapshot_head   = block_buffer_head;
+		snapshot_blocks = movesplanned();
+	}
+	if ( command::fillCheckpoint(snapshot) ) {
+		snapshot_pending = true;
+		last_line_number = snapshot.line_number;
+	}
+	else
+		// Try again shortly
+		checkpoint_timeout.start(CHECKPOINT_INTERVAL_MICROS >> 4);
+}
+
+static uint8_t resume_commands;
+
+static void push32(uint32_t value) {
+	for ( uint8_t i = 0; i < 4; i++ ) {
+		command::push((uint8_t)(value & 0xff));
+		value >>= 8;
+	}
+}
+
+static void push16(uint16_t value) {
+	command::push((uint8_t)(value & 0xff));
+	command::push((uint8_t)(value >> 8));
+}
+
+static void pushCommand(uint8_t cmd) {
+	command::push(cmd);
+	resume_commands++;
+}
+
+static void pushToolCommand(uint8_t tool, uint8_t cmd, int16_t temp) {
+	pushCommand(HOST_CMD_TOOL_COMMAND);
+	command::push(tool);
+	command::push(cmd);
+	command::push(2);
+	push16((uint16_t)temp);
+}
+
+static void pushWait(uint8_t cmd, uint8_t tool) {
+	pushCommand(cmd);
+	command::push(tool);
+	push16(100);
+	push16(CHECKPOINT_HEAT_TIMEOUT);
+}
+
+static void pushMove(int32_t x, int32_t y, int32_t z, uint32_t us, uint8_t relative) {
+	pushCommand(HOST_CMD_QUEUE_POINT_NEW);
+	push32((uint32_t)x);
+	push32((uint32_t)y);
+	push32((uint32_t)z);
+	push32(0);
+	push32(0);
+	push32(us);
+	command::push(relative);
+}
+
+bool resume() {
+	Record rec;
+	char name[CHECKPOINT_NAME_LEN + 1];
+
+	if ( !load(rec, name) ) return false;
+
+	// Restarting the build must not begin a new checkpoint generation:
+	// until the resumed build commits a checkpoint of its own, the one
+	// we are resuming from must remain valid.
+	resuming = true;
+	sdcard::SdErrorCode e = host::startBuildFromSD(name, strlen(name));
+	resuming = false;
+	if ( e != sdcard::SD_SUCCESS ) return false;
+	if ( !sdcard::playbackSeek(rec.sd_offset) ) {
+		sdcard::finishPlayback();
+		return false;
+	}
+
+	// Ahead of the remainder of the file, queue the commands which put
+	// the bot back into the state the checkpoint describes.  The file's
+	// commands then follow in the command buffer.
+	resume_commands = 0;
+	int32_t lift = stepperAxisMMToSteps(CHECKPOINT_Z_CLEARANCE_MM, Z_AXIS);
+
+	pushCommand(HOST_CMD_ENABLE_AXES);
+	command::push(0x80 | 0x1f);
+
+	// Z and the extruders are where they were; X and Y are placeholders
+	// until homed
+	pushCommand(HOST_CMD_CHANGE_TOOL);
+	command::push(rec.tool);
+	pushCommand(HOST_CMD_SET_POSITION_EXT);
+	push32(0);
+	push32(0);
+	push32((uint32_t)rec.position[Z_AXIS]);
+	push32((uint32_t)rec.position[A_AXIS]);
+	push32((uint32_t)rec.position[B_AXIS]);
+
+	// Get the nozzle off the part before it heats and oozes
+	pushMove(0, 0, lift, 1000000L, 0x1f);
+
+	if ( rec.temp[2] > 0 )
+		pushToolCommand(0, SLAVE_CMD_SET_PLATFORM_TEMP, rec.temp[2]);
+	for ( uint8_t i = 0; i < EXTRUDERS; i++ )
+		if ( rec.temp[i] > 0 )
+			pushToolCommand(i, SLAVE_CMD_SET_TEMP, rec.temp[i]);
+	if ( rec.temp[2] > 0 )
+		pushWait(HOST_CMD_WAIT_FOR_PLATFORM, 0);
+	for ( uint8_t i = 0; i < EXTRUDERS; i++ )
+		if ( rec.temp[i] > 0 )
+			pushWait(HOST_CMD_WAIT_FOR_TOOL, i);
+
+	// Waiting on a tool selects it; reselect the checkpointed tool
+	pushCommand(HOST_CMD_CHANGE_TOOL);
+	command::push(rec.tool);
+
+	uint8_t home_dir = eeprom::getEeprom8(eeprom_offsets::AXIS_HOME_DIRECTION, 0x1b);
+	for ( uint8_t axis = X_AXIS; axis <= Y_AXIS; axis++ ) {
+		pushCommand(( home_dir & _BV(axis) ) ? HOST_CMD_FIND_AXES_MAXIMUM : HOST_CMD_FIND_AXES_MINIMUM);
+		command::push(_BV(axis));
+		push32(CHECKPOINT_HOME_FEEDRATE);
+		push16(CHECKPOINT_HOME_TIMEOUT);
+	}
+	pushCommand(HOST_CMD_RECALL_HOME_POSITION);
+	command::push(_BV(X_AXIS) | _BV(Y_AXIS));
+
+	// Travel from home to the checkpointed X/Y at roughly 50 mm/s
+	float dx = (float)(rec.position[X_AXIS] - (int32_t)eeprom::getEeprom32(eeprom_offsets::AXIS_HOME_POSITIONS_STEPS + X_AXIS * sizeof(uint32_t), 0)) / stepperAxisStepsPerMM(X_AXIS);
+	float dy = (float)(rec.position[Y_AXIS] - (int32_t)eeprom::getEeprom32(eeprom_offsets::AXIS_HOME_POSITIONS_STEPS + Y_AXIS * sizeof(uint32_t), 0)) / stepperAxisStepsPerMM(Y_AXIS);
+	uint32_t us = (uint32_t)(sqrt(dx * dx + dy * dy) * (1000000.0 / 50.0));
+	if ( us < 500000L ) us = 500000L;
+	pushMove(rec.position[X_AXIS], rec.position[Y_AXIS], 0, us,
+		 _BV(Z_AXIS) | _BV(A_AXIS) | _BV(B_AXIS));
+	pushMove(0, 0, -lift, 1000000L, 0x1f);
+
+	if ( rec.fan ) {
+		pushCommand(HOST_CMD_TOOL_COMMAND);
+		command::push(rec.tool);
+		command::push(SLAVE_CMD_TOGGLE_VALVE);
+		command::push(1);
+		command::push(1);
+	}
+
+	// The commands above are counted as they execute
+	command::setLineNumber(rec.line_number - resume_commands);
+	last_line_number = rec.line_number;
+	host::resumeBuild();
+	checkpoint_timeout.start(CHECKPOINT_INTERVAL_MICROS);
+	return true;
+}
+
+#endif // !SIMULATOR
+
+}
+
+#endif // PRINT_CHECKPOINT
@@ -0,0 +1,113 @@
+#ifndef CHECKPOINT_HH_
+#define CHECKPOINT_HH_
+
+#include <stdint.h>
+
+#ifndef SIMULATOR
+#include "Configuration.hh"
+#else
+#include "Simulator.hh"
+#endif
+
+#ifdef PRINT_CHECKPOINT
+
+/// Crash-consistent checkpointing of SD card builds.
+///
+/// While building from SD card, the state of the build is periodically
+/// recorded to a ring of slots in EEPROM: the file offset of the next command
+/// to execute, the line number, the planner position, the active tool, the
+/// heater setpoints and the cooling fan.  A checkpoint is only taken at a
+/// command boundary and is only committed to EEPROM once the planner has
+/// actually executed every move queued before it.  Thus a committed
+/// checkpoint never describes motion which had not yet occurred.
+///
+/// The slots are written round robin, oldest first, so each slot sees
+/// 1/CHECKPOINT_SLOTS of the writes.  A slot is written one byte per slice
+/// and only when the EEPROM is ready: the main loop never blocks waiting on
+/// the EEPROM.  Each slot carries a sequence number and a CRC, and its build
+/// id is written last so that the slot becomes valid atomically.  A slot torn
+/// by a power failure is rejected and the previous slot remains the newest
+/// valid checkpoint.
+namespace checkpoint {
+
+/// How often a checkpoint is taken while building from SD
+#define CHECKPOINT_INTERVAL_MICROS (15L * 1000L * 1000L)
+
+/// Longest build name we retain; matches host::MAX_FILE_LEN
+#define CHECKPOINT_NAME_LEN 31
+
+/// Size of the EEPROM ring; see eeprom_offsets::CHECKPOINT_RING
+#define CHECKPOINT_RING_SIZE 0x0380
+
+/// The state of a build, sufficient to resume it
+struct Record {
+	uint16_t seq;            ///< Sequence number; the newest slot wins
+	uint8_t  build_id;       ///< Must match the header's build id
+	uint8_t  tool;           ///< Active tool index
+	uint32_t sd_offset;      ///< File offset of the next command to execute
+	uint32_t line_number;    ///< command::getLineNumber() at sd_offset
+	int32_t  position[5];    ///< Planner position in steps, X/Y/Z/A/B
+	int16_t  temp[3];        ///< Setpoints: tool 0, tool 1, platform
+	uint8_t  fan;            ///< Cooling fan on (1) or off (0)
+	uint8_t  reserved;
+	uint16_t crc;            ///< CRC-CCITT of all of the above
+} __attribute__ ((__packed__));
+
+/// Identifies the build the ring slots belong to
+struct Header {
+	char     name[CHECKPOINT_NAME_LEN + 1];
+	uint8_t  build_id;
+	uint8_t  active;         ///< Non-zero while the build is running
+	uint16_t crc;
+} __attribute__ ((__packed__));
+
+#define CHECKPOINT_SLOTS (CHECKPOINT_RING_SIZE / sizeof(checkpoint::Record))
+
+/// Scan the EEPROM ring and locate the newest valid checkpoint.
+/// Any write in progress is abandoned.
+void init();
+
+/// Returns true when a build was interrupted and has a valid checkpoint
+bool available();
+
+/// Retrieve the newest valid checkpoint and the name of its build file
+/// \param[out] rec Checkpoint record
+/// \param[out] name Buffer of at least CHECKPOINT_NAME_LEN + 1 bytes, or 0
+/// \return true if a valid checkpoint was found
+bool load(Record& rec, char *name);
+
+/// Note the start of a new SD card build; prior checkpoints are discarded
+void beginBuild(const char *name);
+
+/// Note the end, normal or otherwise, of the current build
+void endBuild();
+
+/// Queue a record for writing to the next slot of the ring.  The sequence
+/// number, build id and CRC are filled in here.
+/// \return false if a previous write is still in progress
+bool save(Record& rec);
+
+/// Returns true while a header or record is being written to EEPROM
+bool isWriting();
+
+/// Advance any EEPROM write in progress by at most one byte.  Never waits
+/// on the EEPROM.
+void runWriterSlice();
+
+#ifndef SIMULATOR
+
+/// Take checkpoints while building from SD and advance the EEPROM writer
+void runCheckpointSlice();
+
+/// Restart the interrupted build: reheat, home X and Y, restore Z and
+/// continue from the checkpointed command.
+/// \return true if the build was restarted
+bool resume();
+
+#endif
+
+}
+
+#endif // PRINT_CHECKPOINT
+
+#endif // CHECKPOINT_HH_
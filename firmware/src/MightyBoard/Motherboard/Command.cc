@@ -37,6 +37,7 @@
 #include "stdio.h"
 #include "Menu_locales.hh"
 #include "Version.hh"
+#include "Preheat.hh"
 #include <math.h>
 
 namespace command {
@@ -78,7 +79,7 @@ uint32_t line_number;
 #endif
 #endif
 
-#if !defined(HEATERS_ON_STEROIDS)
+#if !defined(HEATERS_ON_STEROIDS) && !defined(PREHEAT_SCHEDULER)
 bool check_temp_state = false;
 #endif
 bool outstanding_tool_command = false;
@@ -310,7 +311,9 @@ void buildReset() {
 	sdCardError = false;
 
 	line_number = 0;
-#if !defined(HEATERS_ON_STEROIDS)
+#if defined(PREHEAT_SCHEDULER)
+	preheat::abort();
+#elif !defined(HEATERS_ON_STEROIDS)
 	check_temp_state = false;
 #endif
 	paused = PAUSE_STATE_NONE;
@@ -384,6 +387,47 @@ void clearLineNumber() {
 	line_number = 0;
 }
 
+#ifdef PRINT_CHECKPOINT
+
+void setLineNumber(uint32_t line) {
+	line_number = line;
+}
+
+bool fillCheckpoint(checkpoint::Record& rec) {
+	// Homing leaves the planner position meaningless
+	if ( mode == HOMING ) return false;
+
+	// Between slices, the command buffer always begins on a command
+	// boundary: a command is only popped once it is complete.  So the
+	// next command to execute is at the file offset of the bytes read
+	// less those still waiting in the command buffer.
+	uint32_t played = sdcard::playbackPosition();
+	uint16_t buffered = command_buffer.getLength();
+	if ( played < buffered ) return false;
+	rec.sd_offset = played - buffered;
+
+	rec.line_number = line_number;
+	rec.tool = currentToolIndex;
+
+	Point p = steppers::getPlannerPosition();
+	for ( uint8_t i = 0; i < STEPPER_COUNT; i++ )
+		rec.position[i] = p[i];
+
+	Motherboard& board = Motherboard::getBoard();
+	rec.temp[0] = board.getExtruderBoard(0).getExtruderHeater().get_set_temperature();
+#if EXTRUDERS > 1
+	rec.temp[1] = board.getExtruderBoard(1).getExtruderHeater().get_set_temperature();
+#else
+	rec.temp[1] = 0;
+#endif
+	rec.temp[2] = board.getPlatformHeater().get_set_temperature();
+	rec.fan = EXTRA_FET.getValue() ? 1 : 0;
+
+	return true;
+}
+
+#endif
+
 //If retract is true, the filament is retracted by 1mm,
 //if it's false, it's pushed back out by 1mm
 void retractFilament(bool retract) {
@@ -762,7 +806,10 @@ bool processExtruderCommandPacket(int8_t overrideToolIndex) {
 
 			board.getExtruderBoard(toolIndex).getExtruderHeater().set_target_temperature(temp);
 
-#if !defined(HEATERS_ON_STEROIDS)
+#if defined(PREHEAT_SCHEDULER)
+			/// hold the extruder back if it would be hot before the others
+			preheat::schedule();
+#elif !defined(HEATERS_ON_STEROIDS)
 			/// if platform is actively heating and extruder is not cooling down, pause extruder
 			if( board.getPlatformHeater().isHeating() &&
 			    !board.getPlatformHeater().isCooling() &&
@@ -805,7 +852,10 @@ bool processExtruderCommandPacket(int8_t overrideToolIndex) {
 			// so go ahead and consider the platform as being used and handle the
 			// check_temp_state flag.
 			board.setUsingPlatform(true);
-#if !defined(HEATERS_ON_STEROIDS)
+#if defined(PREHEAT_SCHEDULER)
+			// hold back whichever heaters would be hot first
+			preheat::schedule();
+#elif !defined(HEATERS_ON_STEROIDS)
 			// pause extruder heaters platform is heating up
 			bool pause_state; /// avr-gcc doesn't allow cross-initializtion of variables within a switch statement
 			pause_state = !board.getPlatformHeater().isCooling();
@@ -942,7 +992,7 @@ void handlePauseState(void) {
 		if ( temp > 0 ) {
 			board.getExtruderBoard(0).getExtruderHeater().Pause(false);
 			board.getExtruderBoard(0).getExtruderHeater().set_target_temperature(temp);
-#if !defined(HEATERS_ON_STEROIDS)
+#if !defined(HEATERS_ON_STEROIDS) && !defined(PREHEAT_SCHEDULER)
 			if ( pausedPlatformTemp > 0 ) 
 				board.getExtruderBoard(0).getExtruderHeater().Pause(true);
 #endif
@@ -951,11 +1001,14 @@ void handlePauseState(void) {
 		if ( temp > 0 ) {
 			board.getExtruderBoard(1).getExtruderHeater().Pause(false);
 			board.getExtruderBoard(1).getExtruderHeater().set_target_temperature(temp);
-#if !defined(HEATERS_ON_STEROIDS)
+#if !defined(HEATERS_ON_STEROIDS) && !defined(PREHEAT_SCHEDULER)
 			if ( pausedPlatformTemp > 0 )
 				board.getExtruderBoard(1).getExtruderHeater().Pause(true);
 #endif
 		}
+#if defined(PREHEAT_SCHEDULER)
+		preheat::schedule();
+#endif
 
 		paused = PAUSE_STATE_EXIT_WAIT_FOR_PLATFORM_HEATER;
 		break;
@@ -1038,7 +1091,12 @@ void runCommandSlice() {
 
     // get command from SD card if building from SD
     if ( sdcard::isPlaying() ) {
+#ifdef SD_READ_AHEAD
+	// Only what runPlaybackSlice() has read ahead, so as not to wait on the card
+	while (command_buffer.getRemainingCapacity() > 0 && sdcard::playbackAvailable()) {
+#else
 	while (command_buffer.getRemainingCapacity() > 0 && sdcard::playbackHasNext()) {
+#endif
 	    command_buffer.push(sdcard::playbackNext());
 	}
 
@@ -1098,7 +1156,11 @@ void runCommandSlice() {
 		}
 	}
 
-#if !defined(HEATERS_ON_STEROIDS)
+#if defined(PREHEAT_SCHEDULER)
+	// release the heaters held back by the preheat schedule as their
+	// time comes
+	preheat::runPreheatSlice();
+#elif !defined(HEATERS_ON_STEROIDS)
 	// if printer is not waiting for tool or platform to heat, we need to make
 	// sure the extruders are not in a paused state.  this is relevant when 
 	// heating using the control panel in desktop software
@@ -20,6 +20,7 @@
 
 #include <stdint.h>
 #include "Configuration.hh"
+#include "Checkpoint.hh"
 
 
 //Pause states are used internally to determine various scenarios, so the 
@@ -163,6 +164,17 @@ uint32_t getLineNumber();
 /// clear line number count
 void clearLineNumber();
 
+#ifdef PRINT_CHECKPOINT
+
+/// set the line number of a build resumed from a checkpoint
+void setLineNumber(uint32_t line);
+
+/// Record the state of the build as of the next command to execute
+/// \return false if the build can not be checkpointed at this time
+bool fillCheckpoint(checkpoint::Record& rec);
+
+#endif
+
 /// if we update the line_counter  to allow overflow, we'll need to update the BuildStats Screen implementation
 const static uint32_t MAX_LINE_COUNT = 1000000000;
 
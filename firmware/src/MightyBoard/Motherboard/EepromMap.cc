@@ -36,6 +36,9 @@
 // To convert millimeters to steps
 #include "StepperAxis.hh"
 
+// for the learned heat up of the heaters
+#include "Preheat.hh"
+
 namespace eeprom {
 
 #define DEFAULT_P_VALUE  (7.0f)
@@ -227,6 +230,8 @@ void setDefaultsAcceleration()
 	eeprom_write_word((uint16_t *)(eeprom_offsets::ACCELERATION2_SETTINGS + acceleration2_eeprom_offsets::EXTRUDER_DEPRIME_STEPS + sizeof(uint16_t)*1), DEFAULT_EXTRUDER_DEPRIME_STEPS_B);
 	eeprom_write_byte((uint8_t *)eeprom_offsets::EXTRUDER_DEPRIME_ON_TRAVEL, DEFAULT_EXTRUDER_DEPRIME_ON_TRAVEL);
 	eeprom_write_byte((uint8_t *)(eeprom_offsets::ACCELERATION2_SETTINGS + acceleration2_eeprom_offsets::SLOWDOWN_FLAG), DEFAULT_SLOWDOWN_FLAG);
+	eeprom_write_word((uint16_t *)(eeprom_offsets::ACCELERATION2_SETTINGS + acceleration2_eeprom_offsets::MAX_VOLUMETRIC_FLOW + sizeof(uint16_t)*0), DEFAULT_MAX_VOLUMETRIC_FLOW);
+	eeprom_write_word((uint16_t *)(eeprom_offsets::ACCELERATION2_SETTINGS + acceleration2_eeprom_offsets::MAX_VOLUMETRIC_FLOW + sizeof(uint16_t)*1), DEFAULT_MAX_VOLUMETRIC_FLOW);
 
 	eeprom_write_byte((uint8_t *)(eeprom_offsets::ACCELERATION_SETTINGS + acceleration_eeprom_offsets::DEFAULTS_FLAG), _BV(ACCELERATION_INIT_BIT));
 }  
@@ -393,6 +398,19 @@ void factoryResetEEPROM() {
 	// Use SD card CRC checking
 	eeprom_write_byte((uint8_t *)eeprom_offsets::SD_USE_CRC, DEFAULT_SD_USE_CRC);
 
+	// Extrusion feed-forward and filament diameter for each hotend
+	for ( uint8_t i = 0; i < 2; i++ ) {
+		setEepromFixed16Raw(eeprom_offsets::FEEDFORWARD_COEFFICIENT + i * sizeof(uint16_t),
+				    DEFAULT_FEEDFORWARD_COEFFICIENT);
+		eeprom_write_word((uint16_t *)(eeprom_offsets::FILAMENT_DIAMETER + i * sizeof(uint16_t)),
+				  DEFAULT_FILAMENT_DIAMETER);
+	}
+
+#ifdef PREHEAT_SCHEDULER
+	// Heat up is learned afresh
+	preheat::forget();
+#endif
+
 	setToolHeadCount(0);
 
 #if defined(MODEL_REPLICATOR) || !defined(SINGLE_EXTRUDER)
@@ -294,7 +294,14 @@ const static uint16_t T0_DATA_BASE				= 0x0100;
 //$BEGIN_ENTRY
 //$eeprom_map:toolhead_eeprom_offsets $tool_index:0
 const static uint16_t T1_DATA_BASE				= 0x011C;
-/// unused 8 bytes								= 0x0138;
+/// Extrusion feed-forward per hotend, output per mm^3/s: 2 x 2 bytes
+//$BEGIN_ENTRY
+//$type:HH $floating_point:True $constraints:m,0,20 $tooltip:Heater output (0 - 255) added per cubic millimetre per second of filament the queued moves will extrude, for the right and left hotends.  Zero, the default, disables it; 2.9 suits a stock hotend.
+const static uint16_t FEEDFORWARD_COEFFICIENT		= 0x0138;
+/// Filament diameter per extruder, hundredths of a mm: 2 x 2 bytes
+//$BEGIN_ENTRY
+//$type:HH $constraints:m,100,300 $unit:mm / 100
+const static uint16_t FILAMENT_DIAMETER				= 0x013C;
 /// Light Effect table. 3 Bytes x 3 entries
 //$BEGIN_ENTRY
 //$eeprom_map:blink_eeprom_offsets 
@@ -373,6 +380,15 @@ const static uint16_t EXTRUDER_DEPRIME_ON_TRAVEL        = 0x020B;
 /// start of free space
 const static uint16_t FREE_EEPROM_STARTS        = 0x020C;
 
+/// Learned heat up of each heater: 4 bytes x 3 heaters = 12 bytes (see Preheat.hh)
+const static uint16_t HEATUP_MODELS             = 0x0BD0;
+
+/// Print checkpoint header: 36 bytes (see Checkpoint.hh)
+const static uint16_t CHECKPOINT_HEADER         = 0x0BDC;
+
+/// Print checkpoint ring: 0x0380 bytes ending at 0x0F80
+const static uint16_t CHECKPOINT_RING           = 0x0C00;
+
 //Sailfish specific settings work backwards from the end of the eeprom 0xFFF
 
 //P-Stop enable (1 byte)
@@ -438,10 +454,14 @@ const static uint16_t DITTO_PRINT_ENABLED       = 0x0FFF;
 #define DEFAULT_EXTRUDER_DEPRIME_ON_TRAVEL 1
 
 #define DEFAULT_SLOWDOWN_FLAG 0x01
+#define DEFAULT_MAX_VOLUMETRIC_FLOW 0  // no limit
 #define DEFAULT_EXTRUDER_HOLD 0x00
 #define DEFAULT_TOOLHEAD_OFFSET_SYSTEM 0x01
 #define DEFAULT_SD_USE_CRC    0x00
 
+#define DEFAULT_FEEDFORWARD_COEFFICIENT 0      // off; 0x02E6, 2.9, suits a stock hotend
+#define DEFAULT_FILAMENT_DIAMETER       175    // 1.75 mm
+
 #define ACCELERATION_INIT_BIT 7
 
 namespace acceleration_eeprom_offsets{
@@ -478,7 +498,10 @@ const static uint16_t EXTRUDER_DEPRIME_STEPS = 0x08; //2 * uint16_t (A & B axis)
 //$BEGIN_ENTRY
 //$type:B $constraints:l,0,1 $tooltip:Check or set to 1 to enable automatic print slowdown when the queue of planned segments is running low.  Uncheck or set to 0 to disable automatic slowdown.
 const static uint16_t SLOWDOWN_FLAG         = 0x0C; //uint8_t Bit 0 == 1 is slowdown enabled
-const static uint16_t FUTURE_USE            = 0x0E; //18 bytes for future use
+//$BEGIN_ENTRY
+//$type:HH $constraints:m,0,1000 $unit:0.1 mm³/s $tooltip:Most filament, in tenths of a cubic millimetre per second, the right and left hotends can melt.  Printing moves which would extrude faster are slowed to this rate.  Set to zero for no limit.
+const static uint16_t MAX_VOLUMETRIC_FLOW   = 0x0E; //2 * uint16_t (A & B axis)
+const static uint16_t FUTURE_USE            = 0x12; //14 bytes for future use
 //0x1C is end of acceleration2 settings (28 bytes long)
 }
 
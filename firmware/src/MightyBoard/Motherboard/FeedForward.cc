@@ -0,0 +1,88 @@
+#include <stdlib.h>
+#include <math.h>
+#include "FeedForward.hh"
+
+#ifdef EXTRUSION_FEEDFORWARD
+
+#include "StepperAxis.hh"
+
+#ifndef SIMULATOR
+#include "Eeprom.hh"
+#include "EepromMap.hh"
+#endif
+
+namespace feedforward {
+
+static uint16_t coefficient[2];     // Output per mm^3/s, Q8.8
+static float    area[2];            // Filament cross section, mm^2
+
+void setHotend(uint8_t tool, uint16_t coefficient_in, float diameter) {
+	coefficient[tool] = coefficient_in;
+	area[tool] = (float)M_PI * 0.25 * diameter * diameter;
+}
+
+float demand(const block_t *blocks, uint8_t tail, uint8_t head, uint8_t tool,
+	     float steps_per_mm) {
+	float seconds = 0, volume = 0;
+
+	for ( uint8_t i = tail; i != head && seconds < FEEDFORWARD_HORIZON;
+	      i = (i + 1) & (BLOCK_BUFFER_SIZE - 1) ) {
+		const block_t *block = &blocks[i];
+
+		// Only accelerated blocks have a nominal speed
+		if ( !block->use_accel || block->nominal_speed <= 0 )
+			continue;
+
+		float t = FPTOF(block->millimeters) / FPTOF(block->nominal_speed);
+		float part = 1.0;
+
+		if ( seconds + t > FEEDFORWARD_HORIZON ) {
+			part = (FEEDFORWARD_HORIZON - seconds) / t;
+			t = FEEDFORWARD_HORIZON - seconds;
+		}
+		seconds += t;
+
+		// Retracts and primes take no heat to speak of
+		if ( block->steps[X_AXIS] == 0 && block->steps[Y_AXIS] == 0 &&
+		     block->steps[Z_AXIS] == 0 )
+			continue;
+		volume += part * (float)labs(block->steps[A_AXIS + tool]) / steps_per_mm;
+	}
+	return volume * area[tool] / FEEDFORWARD_HORIZON;
+}
+
+uint8_t output(uint8_t tool, float rate) {
+	float out = rate * (float)coefficient[tool] / 256.0;
+
+	if ( out >= 255.0 )
+		return 255;
+	return (uint8_t)(out + 0.5);
+}
+
+#ifndef SIMULATOR
+
+void init() {
+	for ( uint8_t tool = 0; tool < 2; tool++ )
+		setHotend(tool,
+			  eeprom::getEepromFixed16Raw(eeprom_offsets::FEEDFORWARD_COEFFICIENT + tool * sizeof(uint16_t),
+						      DEFAULT_FEEDFORWARD_COEFFICIENT),
+			  (float)eeprom::getEeprom16(eeprom_offsets::FILAMENT_DIAMETER + tool * sizeof(uint16_t),
+						     DEFAULT_FILAMENT_DIAMETER) / 100.0);
+}
+
+uint8_t output(uint8_t tool) {
+	if ( coefficient[tool] == 0 )
+		return 0;
+
+	// The stepper interrupt only ever advances the tail; the head is
+	// moved by the main loop, which is running this
+	uint8_t tail = block_buffer_tail;
+	return output(tool, demand(block_buffer, tail, block_buffer_head, tool,
+				   stepperAxisStepsPerMM(A_AXIS + tool)));
+}
+
+#endif
+
+}
+
+#endif // EXTRUSION_FEEDFORWARD
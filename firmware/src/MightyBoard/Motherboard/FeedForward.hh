@@ -0,0 +1,70 @@
+#ifndef FEEDFORWARD_HH_
+#define FEEDFORWARD_HH_
+
+#include <stdint.h>
+
+#ifndef SIMULATOR
+#include "Configuration.hh"
+#else
+#include "Simulator.hh"
+#endif
+
+#ifdef EXTRUSION_FEEDFORWARD
+
+#include "StepperAccelPlanner.hh"
+
+/// Extrusion rate feed-forward for the hotend heaters.
+///
+/// Melting filament draws heat from the hotend in proportion to the volume
+/// extruded.  The PID only sees this once the nozzle has cooled, and with
+/// the sensor lagging the heater by seconds, a step up in flow, such as
+/// from perimeters into infill, leaves the nozzle well short of its target
+/// for a while.  The planner knows the flow to come: each queued block
+/// carries its extruder steps, its length and its nominal speed.  The
+/// volumetric rate those blocks will draw over the next
+/// FEEDFORWARD_HORIZON seconds, times a per-hotend coefficient, is added
+/// to the hotend's PID output ahead of the demand.
+///
+/// The coefficient, in output per mm^3/s, and the filament diameter are
+/// kept in EEPROM for each hotend.  A coefficient of zero, the default,
+/// disables the feed-forward for that hotend, so that it is only used once
+/// the user sets a coefficient.
+namespace feedforward {
+
+/// Seconds of queued moves averaged over; about the lag from heater to sensor
+#define FEEDFORWARD_HORIZON 3.0
+
+/// Set a hotend up
+/// \param[in] tool 0 or 1
+/// \param[in] coefficient Output per mm^3/s, Q8.8
+/// \param[in] diameter Filament diameter, mm
+void setHotend(uint8_t tool, uint16_t coefficient, float diameter);
+
+/// Volumetric rate the queued blocks will draw from a hotend
+/// \param[in] blocks Ring of BLOCK_BUFFER_SIZE blocks
+/// \param[in] tail Index of the executing block
+/// \param[in] head Index one past the last queued block
+/// \param[in] tool 0 or 1
+/// \param[in] steps_per_mm Steps per mm of filament for the tool's extruder
+/// \return Mean over the next FEEDFORWARD_HORIZON seconds, mm^3/s
+float demand(const block_t *blocks, uint8_t tail, uint8_t head, uint8_t tool,
+	     float steps_per_mm);
+
+/// Output to add to a hotend's PID for a volumetric rate
+uint8_t output(uint8_t tool, float rate);
+
+#ifndef SIMULATOR
+
+/// Read each hotend's coefficient and filament diameter from EEPROM
+void init();
+
+/// Output to add to a hotend's PID for the moves now queued
+uint8_t output(uint8_t tool);
+
+#endif
+
+}
+
+#endif // EXTRUSION_FEEDFORWARD
+
+#endif // FEEDFORWARD_HH_
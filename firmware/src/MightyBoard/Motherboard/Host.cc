@@ -36,6 +36,18 @@
 #include "Eeprom.hh"
 #include "EepromMap.hh"
 #include "UtilityScripts.hh"
+#ifdef PRINT_CHECKPOINT
+#include "Checkpoint.hh"
+#endif
+#ifdef HOST_TELEMETRY
+#include "Telemetry.hh"
+#endif
+#ifdef SLICE_SCHEDULER
+#include "Scheduler.hh"
+#endif
+#ifdef SLICE_PROFILE
+#include "SliceProfile.hh"
+#endif
 #include "stdio.h"
 
 namespace host {
@@ -48,6 +60,19 @@ bool processCommandPacket(const InPacket& from_host, OutPacket& to_host);
 bool processQueryPacket(const InPacket& from_host, OutPacket& to_host);
 bool processExtruderQueryPacket(const InPacket& from_host, OutPacket& to_host);
 
+#ifdef HOST_TELEMETRY
+#if PACKET_BUFFER_SIZE < TELEMETRY_LENGTH
+#error HOST_TELEMETRY needs packets of at least TELEMETRY_LENGTH bytes
+#endif
+void appendTelemetry(OutPacket& to_host);
+
+// Telemetry frames are sent every telemetry_interval microseconds, when
+// the UART is otherwise idle.  0 when the host hasn't asked for them.
+static micros_t telemetry_interval = 0;
+static uint8_t telemetry_seq = 0;
+Timeout telemetry_timeout;
+#endif
+
 // Timeout from time first bit recieved until we abort packet reception
 Timeout packet_in_timeout;
 Timeout cancel_timeout;
@@ -57,6 +82,13 @@ bool buildWasCancelled;
 #define HOST_PACKET_TIMEOUT_MS 200
 #define HOST_PACKET_TIMEOUT_MICROS (1000L*HOST_PACKET_TIMEOUT_MS)
 
+#ifdef HOST_BAUD_SWITCH
+// Time allowed after a baud rate switch for a packet to arrive at the new
+// rate, after which the host is presumed lost and the default rate restored
+#define HOST_BAUD_CONFIRM_MICROS 2000000L
+Timeout baud_confirm_timeout;
+#endif
+
 //#define HOST_TOOL_RESPONSE_TIMEOUT_MS 50
 //#define HOST_TOOL_RESPONSE_TIMEOUT_MICROS (1000L*HOST_TOOL_RESPONSE_TIMEOUT_MS)
 
@@ -90,6 +122,17 @@ const static uint32_t ONE_HOUR = 3600000000U;
 
 bool do_host_reset = false;
 bool hard_reset = false;
+
+#if HOST_RX_PACKETS > 1
+// Set once the host has had more than one packet in flight.  When an
+// action command overflows the command buffer, such a host has likely
+// sent further action commands before learning of it.  They must not be
+// queued ahead of the rejected command, so action commands are rejected
+// until the host sends a query, which it does only once it has collected
+// the responses to all of its outstanding packets.
+static bool pipelined = false;
+static bool overflowed = false;
+#endif
 bool cancelBuild = false;
 
 void runHostSlice() {
@@ -98,8 +141,17 @@ void runHostSlice() {
 	if (( buildState == BUILD_CANCELLING ) && ( command::pauseState() == PAUSE_STATE_PAUSED )) {
 		stopBuildNow();
 	}
+
+#ifdef HOST_BAUD_SWITCH
+	if (baud_confirm_timeout.isActive() && baud_confirm_timeout.hasElapsed()) {
+		UART::getHostUART().setBaud(HOST_DEFAULT_BAUD);
+	}
+#endif
+#ifdef HOST_RX_RING
+	UART::getHostUART().processReceived();
+#endif
 	
-        InPacket& in = UART::getHostUART().in;
+        InPacket& in = UART::getHostUART().in.current();
         OutPacket& out = UART::getHostUART().out;
 	if (out.isSending() && 
 	    (( ! do_host_reset) || (do_host_reset && (! do_host_reset_timeout.hasElapsed())))) {
@@ -126,6 +178,14 @@ void runHostSlice() {
 		machineName[0] = 0;
 		buildName[0] = 0;
 		currentState = HOST_STATE_READY;
+#if HOST_RX_PACKETS > 1
+		pipelined = false;
+		overflowed = false;
+#endif
+#ifdef HOST_TELEMETRY
+		telemetry_interval = 0;
+		telemetry_timeout.abort();
+#endif
 			
 		return;
 	}
@@ -161,7 +221,7 @@ void runHostSlice() {
 				break;
 		}
 		  	
-		in.reset();
+		UART::getHostUART().in.release();
 		UART::getHostUART().beginSend();
 #if HONOR_DEBUG_PACKETS
 		Motherboard::getBoard().indicateError(ERR_HOST_PACKET_MISC);
@@ -171,7 +231,15 @@ void runHostSlice() {
 	else if (in.isFinished() == 1) {
 		//DEBUG_PIN1.setValue(false);
 		packet_in_timeout.abort();
+#ifdef HOST_BAUD_SWITCH
+		// The host is being heard at the current rate
+		baud_confirm_timeout.abort();
+#endif
 		out.reset();
+#if HOST_RX_PACKETS > 1
+		if (UART::getHostUART().in.hasBacklog())
+			pipelined = true;
+#endif
 	  // do not respond to commands if the bot has had a heater failure
 		if(currentState == HOST_STATE_HEAT_SHUTDOWN){
 			if(cancelBuild){
@@ -196,13 +264,26 @@ void runHostSlice() {
 			// okay, processed
 		} else if (processQueryPacket(in, out)) {
 			// okay, processed
+#if HOST_RX_PACKETS > 1
+			overflowed = false;
+#endif
 		} else {
 			// Unrecognized command
 			out.append8(RC_CMD_UNSUPPORTED);
 		}
-		in.reset();
+		UART::getHostUART().in.release();
                 UART::getHostUART().beginSend();
 	}
+#ifdef HOST_TELEMETRY
+	// Send telemetry only while no packet is coming in, so that it holds
+	// up no response
+	else if (telemetry_interval && !in.isStarted() && telemetry_timeout.hasElapsed()) {
+		telemetry_timeout.start(telemetry_interval);
+		out.reset();
+		appendTelemetry(out);
+		UART::getHostUART().beginSend();
+	}
+#endif
 	/// mark new state as ready if done building from SD
 	if(currentState==HOST_STATE_BUILDING_FROM_SD)
 	{
@@ -223,6 +304,52 @@ void runHostSlice() {
 	managePrintTime();
 }
 
+/** Queue the action commands in a packet, starting at byte "first" of
+ * its payload.  The commands are queued all together or not at all.
+ */
+static void queueCommands(const InPacket& from_host, uint8_t first, OutPacket& to_host) {
+#ifdef S3G_CAPTURE_2_SD
+	// If we're capturing a file to an SD card, we send it to the sdcard module
+	// for processing.
+	if (sdcard::isCapturing()) {
+		sdcard::capturePacket(from_host, first);
+		to_host.append8(RC_OK);
+		return;
+	}
+#endif
+	if(sdcard::isPlaying() || utility::isPlaying()){
+		// ignore action commands if SD card build is playing
+		// or if ONBOARD script is playing
+		to_host.append8(RC_BOT_BUILDING);
+		return;
+	}
+
+#if HOST_RX_PACKETS > 1
+	if (overflowed) {
+		to_host.append8(RC_BUFFER_OVERFLOW);
+		return;
+	}
+#endif
+	
+	// Queue command, if there's room.
+	// Turn off interrupts while querying or manipulating the queue!
+	ATOMIC_BLOCK(ATOMIC_FORCEON) {
+		const uint8_t command_length = from_host.getLength() - first;
+		if (command::getRemainingCapacity() >= command_length) {
+			// Append command to buffer
+			for (uint8_t i = first; i < from_host.getLength(); i++) {
+				command::push(from_host.read8(i));
+			}
+			to_host.append8(RC_OK);
+		} else {
+			to_host.append8(RC_BUFFER_OVERFLOW);
+#if HOST_RX_PACKETS > 1
+			overflowed = pipelined;
+#endif
+		}
+	}
+}
+
 /** Identify a command packet, and process it.  If the packet is a command
  * packet, return true, indicating that the packet has been queued and no
  * other processing needs to be done. Otherwise, processing of this packet
@@ -232,38 +359,18 @@ bool processCommandPacket(const InPacket& from_host, OutPacket& to_host) {
 	if (from_host.getLength() >= 1) {
 		uint8_t command = from_host.read8(0);
 		if ((command & 0x80) != 0) {
-#ifdef S3G_CAPTURE_2_SD
-			// If we're capturing a file to an SD card, we send it to the sdcard module
-			// for processing.
-			if (sdcard::isCapturing()) {
-				sdcard::capturePacket(from_host);
-				to_host.append8(RC_OK);
-				return true;
-			}
-#endif
-			if(sdcard::isPlaying() || utility::isPlaying()){
-				// ignore action commands if SD card build is playing
-				// or if ONBOARD script is playing
-				to_host.append8(RC_BOT_BUILDING);
-				return true;
-			}
-			
-			// Queue command, if there's room.
-			// Turn off interrupts while querying or manipulating the queue!
-			ATOMIC_BLOCK(ATOMIC_FORCEON) {
-				const uint8_t command_length = from_host.getLength();
-				if (command::getRemainingCapacity() >= command_length) {
-					// Append command to buffer
-					for (int i = 0; i < command_length; i++) {
-						command::push(from_host.read8(i));
-					}
-					to_host.append8(RC_OK);
-				} else {
-					to_host.append8(RC_BUFFER_OVERFLOW);
-				}
-			}
+			queueCommands(from_host, 0, to_host);
+			return true;
+		}
+#ifdef HOST_BATCH_PAYLOAD
+		// A batch of action commands follows the batch command byte.  The
+		// reply carries the remaining capacity so that the host needn't ask.
+		if (command == HOST_CMD_BATCH) {
+			queueCommands(from_host, 1, to_host);
+			to_host.append32(command::getRemainingCapacity());
 			return true;
 		}
+#endif
 	}
 	return false;
 }
@@ -302,11 +409,39 @@ inline void handleGetAdvancedVersion(const InPacket& from_host, OutPacket& to_ho
 	to_host.append16(firmware_version);
 	to_host.append16((uint16_t)0);
 	to_host.append8(SOFTWARE_VARIANT_ID);
-	to_host.append8(0);
+#ifdef HOST_BATCH_PAYLOAD
+	to_host.append8(HOST_BATCH_PAYLOAD);	// largest HOST_CMD_BATCH payload
+#else
+	to_host.append8(0);			// no HOST_CMD_BATCH
+#endif
+	to_host.append16(HOST_RX_PACKETS);	// packets the host may have in flight
+#ifdef HOST_RX_RING
+	to_host.append16(UART::getHostUART().getRxOverruns());	// bytes dropped
+#else
 	to_host.append16(0);
+#endif
 
 }
 
+#ifdef HOST_BAUD_SWITCH
+// Switch baud rate once the response has been sent.  The host follows once
+// it has the response; if it is not heard from at the new rate, the default
+// rate is restored.
+inline void handleSetBaud(const InPacket& from_host, OutPacket& to_host) {
+	if (UART::getHostUART().setBaudAfterSend(from_host.read32(1))) {
+		baud_confirm_timeout.start(HOST_BAUD_CONFIRM_MICROS);
+#ifdef HOST_TELEMETRY
+		// Don't let a telemetry frame follow at the old rate
+		if (telemetry_interval)
+			telemetry_timeout.start(telemetry_interval);
+#endif
+		to_host.append8(RC_OK);
+	} else {
+		to_host.append8(RC_CMD_UNSUPPORTED);
+	}
+}
+#endif
+
     // return build name
 inline void handleGetBuildName(const InPacket& from_host, OutPacket& to_host) {
 	to_host.append8(RC_OK);
@@ -542,6 +677,10 @@ void handleBuildStopNotification(uint8_t stopFlags) {
 
 	buildState = BUILD_FINISHED_NORMALLY;
 	currentState = HOST_STATE_READY;
+
+#ifdef PRINT_CHECKPOINT
+	checkpoint::endBuild();
+#endif
 }
 
 /// get current print stats if printing, or last print stats if not printing
@@ -569,6 +708,169 @@ inline void handleGetBoardStatus(OutPacket& to_host) {
 	to_host.append8(board_status);
 }
 
+#ifdef PID_AUTOTUNE
+
+// Start a relay autotune of a heater at a target, or with a target of 0
+// report on the last tune.  Heaters 0 and 1 are the extruders, 2 the
+// platform.
+inline void handleAutotune(const InPacket& from_host, OutPacket& to_host) {
+	uint8_t id = from_host.read8(1);
+	int16_t target = (int16_t)from_host.read16(2);
+	if ( id > 2 ) {
+		to_host.append8(RC_CMD_UNSUPPORTED);
+		return;
+	}
+	Motherboard& board = Motherboard::getBoard();
+	Heater& heater = (id == 2) ? board.getPlatformHeater() :
+		board.getExtruderBoard(id).getExtruderHeater();
+	if ( target > 0 ) {
+		// Not while building: the tune takes the heater for many minutes
+		if ( currentState != HOST_STATE_READY ) {
+			to_host.append8(RC_BOT_BUILDING);
+			return;
+		}
+		if ( !heater.startAutotune(target) ) {
+			to_host.append8(RC_CMD_UNSUPPORTED);
+			return;
+		}
+	}
+	const PIDAutotune& tune = Heater::getAutotune();
+	to_host.append8(RC_OK);
+	to_host.append8(tune.getState());
+	to_host.append8(tune.getCycles());
+	to_host.append8(heater.isAutotuning() ? 1 : 0);
+	to_host.append16(tune.getPGain());
+	to_host.append16(tune.getIGain());
+	to_host.append16(tune.getDGain());
+}
+
+#endif
+
+#ifdef SLICE_SCHEDULER
+
+// Report on a task of the main loop, clearing its statistics when the flag
+// is non-zero.  Besides the task's runs, the average and longest run in
+// microseconds and the runs started past its deadline, the number of tasks
+// is given.
+inline void handleGetTaskStats(const InPacket& from_host, OutPacket& to_host) {
+	scheduler::TaskStats stats;
+	if ( !scheduler::getStats(from_host.read8(1), &stats, from_host.read8(2) != 0) ) {
+		to_host.append8(RC_CMD_UNSUPPORTED);
+		return;
+	}
+	to_host.append8(RC_OK);
+	to_host.append8(scheduler::TASKS);
+	to_host.append32(stats.runs);
+	to_host.append16(stats.runs ? stats.total / stats.runs : 0);
+	to_host.append16(stats.longest);
+	to_host.append16(stats.misses);
+}
+#endif
+
+#ifdef SLICE_PROFILE
+
+// Report a slice's histogram of run times and clear it: the number of
+// slices, the longest run in microseconds and the count in each bucket.
+inline void handleGetSliceProfile(const InPacket& from_host, OutPacket& to_host) {
+	profile::Histogram histogram;
+	if ( !profile::get(from_host.read8(1), &histogram, true) ) {
+		to_host.append8(RC_CMD_UNSUPPORTED);
+		return;
+	}
+	to_host.append8(RC_OK);
+	to_host.append8(profile::SLICES);
+	to_host.append16(histogram.longest);
+	for ( uint8_t i = 0; i < PROFILE_BUCKETS; i++ )
+		to_host.append16(histogram.counts[i]);
+}
+#endif
+
+#ifdef HOST_TELEMETRY
+
+// Start or stop telemetry frames.  The interval is in milliseconds; 0
+// stops them.
+inline void handleSetTelemetry(const InPacket& from_host, OutPacket& to_host) {
+	uint16_t interval = from_host.read16(1);
+	if (interval == 0) {
+		telemetry_interval = 0;
+		telemetry_timeout.abort();
+	} else {
+		if (interval < TELEMETRY_MIN_INTERVAL)
+			interval = TELEMETRY_MIN_INTERVAL;
+		telemetry_interval = (micros_t)interval * 1000L;
+		telemetry_timeout.start(telemetry_interval);
+	}
+	to_host.append8(RC_OK);
+}
+
+// See Telemetry.hh for the layout
+void appendTelemetry(OutPacket& to_host) {
+	Motherboard& board = Motherboard::getBoard();
+	Heater& platform = board.getPlatformHeater();
+	uint8_t heaters = 0;
+
+	to_host.append8(TELEMETRY_FRAME);
+	to_host.append8(telemetry_seq++);
+	to_host.append8(board_status);
+	to_host.append8(buildState);
+
+	for (uint8_t i = 0; i < EXTRUDERS; i++) {
+		Heater& heater = board.getExtruderBoard(i).getExtruderHeater();
+		if (heater.has_reached_target_temperature())
+			heaters |= TELEMETRY_HEAT_TOOL0_READY << i;
+		if (heater.has_failed())
+			heaters |= TELEMETRY_HEAT_TOOL0_FAILED << i;
+	}
+	if (platform.has_reached_target_temperature())
+		heaters |= TELEMETRY_HEAT_PLATFORM_READY;
+	if (platform.has_failed())
+		heaters |= TELEMETRY_HEAT_PLATFORM_FAILED;
+	to_host.append8(heaters);
+	to_host.append8(command::getBuildPercentage());
+
+	for (uint8_t i = 0; i < 2; i++) {
+		if (i < EXTRUDERS) {
+			Heater& heater = board.getExtruderBoard(i).getExtruderHeater();
+			to_host.append16(heater.get_current_temperature());
+			to_host.append16(heater.get_set_temperature());
+		} else {
+			to_host.append16(0);
+			to_host.append16(0);
+		}
+	}
+	to_host.append16(platform.get_current_temperature());
+	to_host.append16(platform.get_set_temperature());
+
+	uint8_t toolIndex;
+	ATOMIC_BLOCK(ATOMIC_FORCEON) {
+		const Point p = steppers::getStepperPosition(&toolIndex);
+		to_host.append32(p[0]);
+		to_host.append32(p[1]);
+		to_host.append32(p[2]);
+#if STEPPER_COUNT > 3
+		to_host.append32(p[3]);
+		to_host.append32(p[4]);
+#else
+		to_host.append32(0);
+		to_host.append32(0);
+#endif
+		to_host.append8(steppers::getEndstopStatus());
+	}
+
+	to_host.append16(command::getRemainingCapacity());
+	if ((buildState == BUILD_RUNNING) || (buildState == BUILD_PAUSED))
+		to_host.append32(command::getLineNumber());
+	else
+		to_host.append32(last_print_line);
+#ifdef HOST_RX_RING
+	to_host.append16(UART::getHostUART().getRxOverruns());
+#else
+	to_host.append16(0);
+#endif
+}
+
+#endif
+
 // query packets (non action, not queued)
 bool processQueryPacket(const InPacket& from_host, OutPacket& to_host) {
 	if (from_host.getLength() >= 1) {
@@ -660,6 +962,31 @@ bool processQueryPacket(const InPacket& from_host, OutPacket& to_host) {
 			case HOST_CMD_ADVANCED_VERSION:
 				handleGetAdvancedVersion(from_host, to_host);
 				return true;
+#ifdef HOST_BAUD_SWITCH
+			case HOST_CMD_SET_BAUD:
+				handleSetBaud(from_host, to_host);
+				return true;
+#endif
+#ifdef HOST_TELEMETRY
+			case HOST_CMD_SET_TELEMETRY:
+				handleSetTelemetry(from_host, to_host);
+				return true;
+#endif
+#ifdef PID_AUTOTUNE
+			case HOST_CMD_AUTOTUNE:
+				handleAutotune(from_host, to_host);
+				return true;
+#endif
+#ifdef SLICE_SCHEDULER
+			case HOST_CMD_GET_TASK_STATS:
+				handleGetTaskStats(from_host, to_host);
+				return true;
+#endif
+#ifdef SLICE_PROFILE
+			case HOST_CMD_GET_SLICE_PROFILE:
+				handleGetSliceProfile(from_host, to_host);
+				return true;
+#endif
 			}
 		}
 	}
@@ -734,8 +1061,22 @@ sdcard::SdErrorCode startBuildFromSD(char *fname, uint8_t flen) {
 	buildWasCancelled = false;
 	currentState = HOST_STATE_BUILDING_FROM_SD;
 
+#ifdef PRINT_CHECKPOINT
+	checkpoint::beginBuild(buildName);
+#endif
+
 	return e;
 }
+
+#ifdef PRINT_CHECKPOINT
+// Mark a build restarted from a checkpoint as running.  There is no
+// build start notification to do this as we skipped past it.
+void resumeBuild() {
+	startPrintTime();
+	buildState = BUILD_RUNNING;
+	buildWasCancelled = false;
+}
+#endif
 // start build from utility script
 void startOnboardBuild(uint8_t  build){
     buildWasCancelled = false;
@@ -762,6 +1103,10 @@ void stopBuildNow() {
     do_host_reset = true; // indicate reset after response has been sent
     do_host_reset_timeout.start(200000);	//Protection against the firmware sending to a down host
     buildState = BUILD_CANCELED;
+
+#ifdef PRINT_CHECKPOINT
+    checkpoint::endBuild();
+#endif
 }
 
 // Stop the current build, if any via an intermediate state (BUILD_CANCELLING),
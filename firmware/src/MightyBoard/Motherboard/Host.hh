@@ -74,6 +74,11 @@ BuildState getBuildState();
 /// \return True if build started successfully.
 sdcard::SdErrorCode startBuildFromSD(char *fname, uint8_t flen);
 
+#ifdef PRINT_CHECKPOINT
+/// Set the build state for an SD card build restarted from a checkpoint
+void resumeBuild();
+#endif
+
 /// start build from onboard script 
 /// no error check here yet, should not have read errors
 void startOnboardBuild(uint8_t  build);
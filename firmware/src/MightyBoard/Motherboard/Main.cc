@@ -31,6 +31,12 @@
 #include <util/delay.h>
 #include "UtilityScripts.hh"
 #include "Piezo.hh"
+#ifdef PRINT_CHECKPOINT
+#include "Checkpoint.hh"
+#endif
+#ifdef SLICE_SCHEDULER
+#include "Scheduler.hh"
+#endif
 
 #if defined(STACK_PAINT) && defined(DEBUG_SRAM_MONITOR)
 	bool stackAlertLockout = false;
@@ -119,12 +125,18 @@ void reset(bool hard_reset) {
 		command::reset();
 #ifndef ERASE_EEPROM_ON_EVERY_BOOT
 		eeprom::init();
+#endif
+#ifdef PRINT_CHECKPOINT
+		checkpoint::init();
 #endif
 		steppers::init();
 		steppers::abort();
 		steppers::reset();
 //		initThermistorTables();
 		board.reset(hard_reset);
+#ifdef SLICE_SCHEDULER
+		scheduler::reset();
+#endif
 		
 	// brown out occurs on normal power shutdown, so this is not a good message		
 	//	if(brown_out)
@@ -150,14 +162,28 @@ int main() {
 	reset(true);
 	sei();
 	while (1) {
+#ifdef SLICE_SCHEDULER
+		// Host, command, motherboard and the other slices, as they
+		// fall due
+		scheduler::runPass();
+#else
 		// Host interaction thread.
 		host::runHostSlice();
+#ifdef SD_READ_AHEAD
+		// SD card read-ahead slice
+		sdcard::runPlaybackSlice();
+#endif
 		// Command handling thread.
 		command::runCommandSlice();
 		// Motherboard slice
 		board.runMotherboardSlice();
                 // Stepper slice
                 steppers::runSteppersSlice();
+#ifdef PRINT_CHECKPOINT
+		// Print checkpoint slice
+		checkpoint::runCheckpointSlice();
+#endif
+#endif
 
 		//Alert if SRAM/stack has been corrupted by running out of SRAM
 #if defined(STACK_PAINT) && defined(DEBUG_SRAM_MONITOR)
@@ -171,8 +197,10 @@ int main() {
 		}
 #endif
 
+#ifndef SLICE_SCHEDULER
 		// Piezo slice
 		Piezo::runPiezoSlice();
+#endif
 
 		// reset the watch dog timer
 		wdt_reset();
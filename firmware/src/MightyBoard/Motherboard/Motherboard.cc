@@ -39,6 +39,21 @@
 #include "TemperatureTable.hh"
 #include "SDCard.hh"
 #include "TWI.hh"
+#ifdef PWM_OUTPUTS
+#include "PwmOutputs.hh"
+#endif
+#ifdef SLICE_SCHEDULER
+#include "Scheduler.hh"
+#endif
+#ifdef EXTRUSION_FEEDFORWARD
+#include "FeedForward.hh"
+
+// Give a hotend the output the moves queued for it will draw
+#define FEED_FORWARD(extruder, tool) \
+	(extruder).getExtruderHeater().setFeedForward(feedforward::output(tool))
+#else
+#define FEED_FORWARD(extruder, tool)
+#endif
 
 //Warnings to remind us that certain things should be switched off for release
 
@@ -303,6 +318,7 @@ void Motherboard::reset(bool hard_reset) {
 
 		splashScreen.hold_on = false;
 		interfaceBoard.pushScreen(&splashScreen);
+		lcd.flush();
 
 		if ( hard_reset )
 			_delay_ms(3000);
@@ -343,11 +359,20 @@ void Motherboard::reset(bool hard_reset) {
 	extruder_manage_timeout.start(SAMPLE_INTERVAL_MICROS_THERMOCOUPLE);
 #endif
 
+#ifdef PWM_OUTPUTS
+	pwm::init();
+#endif
+
 	// initialize the extruders
 	Extruder_One.reset();
 	Extruder_Two.reset();
+#ifdef EXTRUSION_FEEDFORWARD
+	feedforward::init();
+#endif
     
+#ifndef PWM_OUTPUTS
 	HBP_HEAT.setDirection(true);
+#endif
 	platform_thermistor.init();
 	platform_heater.reset();
 	platform_timeout.start(SAMPLE_INTERVAL_MICROS_THERMISTOR);
@@ -384,6 +409,24 @@ micros_t Motherboard::getCurrentMicros() {
 	return micros_snapshot;
 }
 
+#ifdef SLICE_SCHEDULER
+micros_t Motherboard::getPreciseMicros() {
+	micros_t micros_snapshot;
+	uint8_t count;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		micros_snapshot = micros;
+		count = TCNT5;
+		// an interrupt waiting to count the last 100 us
+		if ( TIFR5 & _BV(OCF5A) ) {
+			micros_snapshot += MICROS_INTERVAL;
+			count = TCNT5;
+		}
+	}
+	// timer 5 counts at 250 KHz
+	return micros_snapshot + (micros_t)count * 4;
+}
+#endif
+
 /// Run the motherboard interrupt
 void Motherboard::doStepperInterrupt() {
 	//We never ignore interrupts on pause, because when paused, we might
@@ -559,18 +602,31 @@ bool extruder_update = false;
 
 // main motherboard loop
 void Motherboard::runMotherboardSlice() {
+#ifndef SLICE_SCHEDULER
 	bool interface_updated = false;
 
 	// check for user button press
 	// update interface screen as necessary
 	if ( hasInterfaceBoard ) {
 		interfaceBoard.doInterrupt();
+#ifdef LCD_FRAMEBUFFER
+		// screens only draw into the LCD's framebuffer, and a few of the
+		// changed characters are sent, or with LCD_QUEUE queued, on each
+		// loop they are not drawn
+		if ( interface_update_timeout.hasElapsed() ) {
+			interfaceBoard.doUpdate();
+			interface_update_timeout.start(interfaceBoard.getUpdateRate());
+		}
+		else
+			lcd.flush(LCD_FLUSH_CELLS);
+#else
 		// stagger motherboard updates so that they do not all occur on the same loop
 		if ( interface_update_timeout.hasElapsed() ) {
 			interfaceBoard.doUpdate();
 			interface_update_timeout.start(interfaceBoard.getUpdateRate());
 			interface_updated = true;
 		}
+#endif
 	}
 
 	if ( isUsingPlatform() && platform_timeout.hasElapsed() ) {
@@ -578,6 +634,7 @@ void Motherboard::runMotherboardSlice() {
 		platform_heater.manage_temperature();
 		platform_timeout.start(SAMPLE_INTERVAL_MICROS_THERMISTOR);
 	}
+#endif
 
 	// if waiting on button press
 	if ( buttonWait ) {
@@ -697,16 +754,20 @@ void Motherboard::runMotherboardSlice() {
 	}
 
 	// Temperature monitoring thread
-#ifdef MODEL_REPLICATOR2
+#if defined(SLICE_SCHEDULER)
+	// run by the scheduler, as are the interface and the platform
+#elif defined(MODEL_REPLICATOR2)
 	if ( therm_sensor_timeout.hasElapsed() && !interface_updated ) {
 		if ( therm_sensor.update() ) {
 			therm_sensor_timeout.start(THERMOCOUPLE_UPDATE_RATE);
 			switch (therm_sensor.getLastUpdated()) {
 			case ThermocoupleReader::CHANNEL_ONE:
+				FEED_FORWARD(Extruder_One, 0);
 				Extruder_One.runExtruderSlice();
 				HeatingAlerts();
 				break;
 			case ThermocoupleReader::CHANNEL_TWO:
+				FEED_FORWARD(Extruder_Two, 1);
 				Extruder_Two.runExtruderSlice();
 				break;
 			default:
@@ -717,18 +778,86 @@ void Motherboard::runMotherboardSlice() {
 #else
 	// stagger mid accounts for the case when we've just run the interface update
 	if ( extruder_manage_timeout.hasElapsed() && !interface_updated ) {
+		FEED_FORWARD(Extruder_One, 0);
 		Extruder_One.runExtruderSlice();
 		HeatingAlerts();
 		extruder_manage_timeout.start(SAMPLE_INTERVAL_MICROS_THERMOCOUPLE);
 		extruder_update = true;
 	}
 	else if (extruder_update) {
+		FEED_FORWARD(Extruder_Two, 1);
 		Extruder_Two.runExtruderSlice();
 		extruder_update = false;
 	}
 #endif
 }
 
+#ifdef SLICE_SCHEDULER
+
+// check for user button press, and send the LCD some of what the screens
+// have drawn
+void Motherboard::runInterfaceSlice() {
+	if ( !hasInterfaceBoard )
+		return;
+	interfaceBoard.doInterrupt();
+#ifdef LCD_FRAMEBUFFER
+	lcd.flush(LCD_FLUSH_CELLS);
+#endif
+}
+
+// update the interface screen, and again at the screen's rate
+void Motherboard::runScreenSlice() {
+	if ( !hasInterfaceBoard )
+		return;
+	interfaceBoard.doUpdate();
+	scheduler::runIn(scheduler::TASK_SCREEN, interfaceBoard.getUpdateRate());
+}
+
+// manage heating loops for the HBP
+void Motherboard::runPlatformSlice() {
+	if ( isUsingPlatform() )
+		platform_heater.manage_temperature();
+}
+
+#ifdef MODEL_REPLICATOR2
+// read the next of the thermocouple channels, and manage its extruder
+void Motherboard::runThermocoupleSlice() {
+	if ( !therm_sensor.update() ) {
+		// no reading yet; try again on the next pass
+		scheduler::runIn(scheduler::TASK_THERMOCOUPLE, 0);
+		return;
+	}
+	switch (therm_sensor.getLastUpdated()) {
+	case ThermocoupleReader::CHANNEL_ONE:
+		FEED_FORWARD(Extruder_One, 0);
+		Extruder_One.runExtruderSlice();
+		HeatingAlerts();
+		break;
+	case ThermocoupleReader::CHANNEL_TWO:
+		FEED_FORWARD(Extruder_Two, 1);
+		Extruder_Two.runExtruderSlice();
+		break;
+	default:
+		break;
+	}
+}
+#else
+// manage an extruder's heater
+void Motherboard::runExtruderSlice(uint8_t tool) {
+	if ( tool == 0 ) {
+		FEED_FORWARD(Extruder_One, 0);
+		Extruder_One.runExtruderSlice();
+		HeatingAlerts();
+	}
+	else {
+		FEED_FORWARD(Extruder_Two, 1);
+		Extruder_Two.runExtruderSlice();
+	}
+}
+#endif
+
+#endif // SLICE_SCHEDULER
+
 // reset user timeout to start from zero
 void Motherboard::resetUserInputTimeout(){
 	user_input_timeout.start(USER_INPUT_TIMEOUT);
@@ -797,18 +926,22 @@ void Motherboard::indicateError(int error_code) {
 // set on / off period for blinking interface LEDs
 // if both times are zero, LEDs are full on, if just on-time is zero, LEDs are full OFF
 void Motherboard::interfaceBlink(uint8_t on_time, uint8_t off_time) {
-	if ( off_time == 0 ) {
-		interface_blink_state = BLINK_NONE;
-		INTERFACE_LED_PORT |= INTERFACE_LED;
-	}
-	else if ( on_time == 0 ) {
-		interface_blink_state = BLINK_NONE;
-		INTERFACE_LED_PORT &= ~(INTERFACE_LED);
-	}
-	else {
-		interface_on_time = on_time;
-		interface_off_time = off_time;
-		interface_blink_state = BLINK_ON;
+	// The LEDs share their port with the LCD, which the timer 5 interrupt
+	// drives with LCD_QUEUE
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		if ( off_time == 0 ) {
+			interface_blink_state = BLINK_NONE;
+			INTERFACE_LED_PORT |= INTERFACE_LED;
+		}
+		else if ( on_time == 0 ) {
+			interface_blink_state = BLINK_NONE;
+			INTERFACE_LED_PORT &= ~(INTERFACE_LED);
+		}
+		else {
+			interface_on_time = on_time;
+			interface_off_time = off_time;
+			interface_blink_state = BLINK_ON;
+		}
 	}
 }
 
@@ -825,7 +958,9 @@ uint8_t blink_overflow_counter = 0;
 
 volatile micros_t m2;
 
-#if defined(FF_CREATOR_X)           ///add by FF_OU, impletement a softPWM to lower the HBP output
+#if defined(PWM_OUTPUTS)
+uint8_t soft_pwm_ticks = PWM_SOFT_TICKS;
+#elif defined(FF_CREATOR_X)           ///add by FF_OU, impletement a softPWM to lower the HBP output
 volatile uint8_t pwmcnt = 0;
 #define PWM_H   210
 #define PWM_COUST   255
@@ -835,6 +970,23 @@ ISR(TIMER5_COMPA_vect) {
 	// Motherboard::getBoard().UpdateMicros();
 	micros += MICROS_INTERVAL;
 
+#ifdef LCD_QUEUE
+	LiquidCrystalSerial::runQueue();
+#endif
+
+#if defined(PWM_OUTPUTS)
+	// One test per tick, as without the software PWM: the blink and the
+	// checks after it count software PWM steps rather than ticks, every
+	// 17 steps, 170 ticks, against the 166 ticks counted below
+	if ( --soft_pwm_ticks != 0 )
+		return;
+
+	soft_pwm_ticks = PWM_SOFT_TICKS;
+	pwm::runSoftPwm();
+
+	if (blink_overflow_counter++ < 0xA6 / PWM_SOFT_TICKS)
+		return;
+#else
 #if defined(FF_CREATOR_X)               ///add by FF_OU, impletement a softPWM to lower the HBP output
 	//softpwm
     if (pwmcnt < PWM_H)
@@ -853,6 +1005,7 @@ ISR(TIMER5_COMPA_vect) {
 
 	if (blink_overflow_counter++ <= 0xA4)
 		return;
+#endif
 
 	blink_overflow_counter = 0;
 
@@ -927,7 +1080,7 @@ void Motherboard::setExtra(bool on) {
 	}
 }
 
-#if defined(FF_CREATOR_X)
+#if defined(FF_CREATOR_X) && !defined(PWM_OUTPUTS)
 void softpwmHBP(bool on){
     if (on)
     {
@@ -939,6 +1092,14 @@ void softpwmHBP(bool on){
 #endif 
 
 void BuildPlatformHeatingElement::setHeatingElement(uint8_t value) {
+#if defined(PWM_OUTPUTS)
+	// Proportional, save that FF_CREATOR_X's platform is held to the
+	// 211/256 of full power its software PWM ran it at
+#if defined(FF_CREATOR_X)
+	value = (uint8_t)(((uint16_t)value * 211) >> 8);
+#endif
+	pwm::set(pwm::PLATFORM_HEATER, value);
+#else
 	// This is a bit of a hack to get the temperatures right until we fix our
 	// PWM'd PID implementation.  We reduce the MV to one bit, essentially.
 	// It works relatively well.
@@ -949,7 +1110,7 @@ void BuildPlatformHeatingElement::setHeatingElement(uint8_t value) {
         HBP_HEAT.setValue(value != 0);
 #endif
 	}
-
+#endif
 }
 
 void Motherboard::heatersOff(bool platform)
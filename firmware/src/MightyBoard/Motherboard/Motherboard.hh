@@ -151,6 +151,19 @@ public:
 
 	void runMotherboardSlice();
 
+#ifdef SLICE_SCHEDULER
+	/// Slices the scheduler runs as tasks of their own, in place of the
+	/// parts of runMotherboardSlice() which were staggered by hand
+	void runInterfaceSlice();
+	void runScreenSlice();
+	void runPlatformSlice();
+#ifdef MODEL_REPLICATOR2
+	void runThermocoupleSlice();
+#else
+	void runExtruderSlice(uint8_t tool);
+#endif
+#endif
+
 	/// Count the number of steppers available on this board.
         const int getStepperCount() const { return STEPPER_COUNT; }
 
@@ -159,6 +172,13 @@ public:
 	/// 2**32 microseconds (ca. 70 minutes); callers should compensate for this.
 	micros_t getCurrentMicros();
 
+#ifdef SLICE_SCHEDULER
+	/// Get the microseconds since the board was initialized, as
+	/// getCurrentMicros() does, but to within the timer's 4 us count rather
+	/// than its 100 us interrupts; for timing code.
+	micros_t getPreciseMicros();
+#endif
+
 #if defined(HONOR_DEBUG_PACKETS) && (HONOR_DEBUG_PACKETS == 1)
 	/// Write an error code to the debug pin.
 	void indicateError(int errorCode);
@@ -0,0 +1,311 @@
+#include <stddef.h>
+#include "Preheat.hh"
+
+#ifdef PREHEAT_SCHEDULER
+
+#include "EepromMap.hh"
+
+#ifndef SIMULATOR
+#include <avr/eeprom.h>
+#include "Motherboard.hh"
+#include "Heater.hh"
+#include "TemperatureSensor.hh"
+#endif
+
+namespace preheat {
+
+// Where a scheduled heater is in its heat up
+enum {
+	PHASE_OFF = 0,      // Not scheduled
+	PHASE_HELD,         // Held until it would no longer finish early
+	PHASE_FULL,         // Released at full power; its rate is being measured
+	PHASE_BAND,         // Within PREHEAT_BAND; its approach is being timed
+	PHASE_RUN           // Released, but not measured
+};
+
+// What is assumed of a heater until it has been learned: a MightyBoard
+// extruder and heated platform, a little pessimistically
+static const Model defaults[PREHEAT_HEATERS] = {
+	{ 250, 30 }, { 250, 30 }, { 40, 90 }
+};
+
+// A model outside these was never learned, or the EEPROM has been erased
+#define RATE_MIN     10
+#define RATE_MAX     2000
+#define APPROACH_MAX 1200
+
+static int16_t  tracked[PREHEAT_HEATERS];     // Target each heater was scheduled for
+static int16_t  temp_start[PREHEAT_HEATERS];  // Temperature when released
+static uint16_t t_start[PREHEAT_HEATERS];     // When released
+static uint16_t t_band[PREHEAT_HEATERS];      // When PREHEAT_BAND short of the target
+static uint16_t rate_seen[PREHEAT_HEATERS];   // Rate measured at full power, or 0
+static uint8_t  phase[PREHEAT_HEATERS];
+static uint8_t  scheduled = 0;                // Bit mask of the heaters scheduled
+static uint8_t  released = 0;                 // Those of them no longer held
+
+// Models learned but not yet in EEPROM.  They are written a byte at a time
+// by runWriterSlice(), as the checkpoint writer does, so that learning
+// never blocks the command slice on the EEPROM.
+static Model    unwritten[PREHEAT_HEATERS];
+static uint8_t  dirty = 0;                    // Bit mask of the heaters in unwritten
+
+#if defined(HEATERS_ON_STEROIDS)
+static bool     shared_supply = false;
+#else
+static bool     shared_supply = true;
+#endif
+
+static inline uint16_t modelAddress(uint8_t heater) {
+	return eeprom_offsets::HEATUP_MODELS + (uint16_t)heater * sizeof(Model);
+}
+
+bool getModel(uint8_t heater, Model& m) {
+	uint8_t *p = (uint8_t *)&m;
+	uint16_t addr = modelAddress(heater);
+
+	if ( dirty & (1 << heater) )
+		m = unwritten[heater];
+	else
+		for ( uint8_t i = 0; i < sizeof(Model); i++ )
+			*p++ = eeprom_read_byte((const uint8_t *)(uintptr_t)addr++);
+	if ( m.rate >= RATE_MIN && m.rate <= RATE_MAX && m.approach <= APPROACH_MAX )
+		return true;
+	m = defaults[heater];
+	return false;
+}
+
+void forget() {
+	dirty = 0;
+	for ( uint16_t addr = modelAddress(0); addr < modelAddress(PREHEAT_HEATERS); addr++ )
+		if ( eeprom_read_byte((const uint8_t *)(uintptr_t)addr) != 0xff )
+			eeprom_write_byte((uint8_t *)(uintptr_t)addr, 0xff);
+}
+
+void runWriterSlice() {
+	if ( !dirty || !eeprom_is_ready() )
+		return;
+
+	uint8_t heater = 0;
+	while ( !(dirty & (1 << heater)) )
+		heater++;
+
+	// Bytes which already hold the desired value are skipped; they cost
+	// neither time nor wear.  At most one byte is written per call.
+	const uint8_t *p = (const uint8_t *)&unwritten[heater];
+	uint16_t addr = modelAddress(heater);
+	for ( uint8_t i = 0; i < sizeof(Model); i++, addr++ ) {
+		if ( eeprom_read_byte((const uint8_t *)(uintptr_t)addr) != p[i] ) {
+			eeprom_write_byte((uint8_t *)(uintptr_t)addr, p[i]);
+			return;
+		}
+	}
+	dirty &= ~(1 << heater);
+}
+
+static uint16_t refine(uint16_t old, uint16_t seen) {
+	return (uint16_t)((int32_t)old + ((int32_t)seen - (int32_t)old) / (1 << PREHEAT_LEARN_SHIFT));
+}
+
+// A heater ran unheld from PREHEAT_BAND short of its target to it in
+// approach seconds, and at rate_seen[heater] before that.  The first
+// measurements replace the defaults; later ones are blended in.
+static void learn(uint8_t heater, uint16_t approach) {
+	Model m;
+	bool learned = getModel(heater, m);
+
+	if ( rate_seen[heater] )
+		m.rate = learned ? refine(m.rate, rate_seen[heater]) : rate_seen[heater];
+	m.approach = learned ? refine(m.approach, approach) : approach;
+	if ( m.rate < RATE_MIN ) m.rate = RATE_MIN;
+	else if ( m.rate > RATE_MAX ) m.rate = RATE_MAX;
+	if ( m.approach > APPROACH_MAX ) m.approach = APPROACH_MAX;
+	unwritten[heater] = m;
+	dirty |= 1 << heater;
+}
+
+uint16_t predict(const Model& m, int16_t temp, int16_t target) {
+	int16_t delta = target - temp;
+
+	if ( delta <= PREHEAT_REACHED )
+		return 0;
+	if ( delta < PREHEAT_BAND )
+		return (uint16_t)(((uint32_t)m.approach * (uint16_t)delta) / PREHEAT_BAND);
+
+	uint32_t t = ((uint32_t)(delta - PREHEAT_BAND + 1) * 100) / m.rate + m.approach;
+	return ( t > 0xffff ) ? 0xffff : (uint16_t)t;
+}
+
+uint8_t plan(uint16_t now, const int16_t *temp, const int16_t *target) {
+	uint16_t remaining[PREHEAT_HEATERS];
+	uint16_t slowest = 0;
+
+	for ( uint8_t i = 0; i < PREHEAT_HEATERS; i++ ) {
+		uint8_t bit = 1 << i;
+
+		if ( target[i] != tracked[i] ) {
+			// Schedule it anew, if it has any way to go
+			tracked[i] = target[i];
+			scheduled &= ~bit;
+			released &= ~bit;
+			phase[i] = PHASE_OFF;
+			if ( target[i] > 0 && temp[i] < target[i] - PREHEAT_REACHED ) {
+				scheduled |= bit;
+				phase[i] = PHASE_HELD;
+			}
+		}
+		if ( !(scheduled & bit) )
+			continue;
+
+		if ( temp[i] >= target[i] - PREHEAT_REACHED ) {
+			if ( phase[i] == PHASE_BAND )
+				learn(i, now - t_band[i]);
+			scheduled &= ~bit;
+			released &= ~bit;
+			phase[i] = PHASE_OFF;
+			continue;
+		}
+
+		Model m;
+		getModel(i, m);
+		remaining[i] = predict(m, temp[i], target[i]);
+		if ( remaining[i] > slowest )
+			slowest = remaining[i];
+	}
+
+	// With a shared supply, the extruders wait on the platform's full
+	// power run, which must then never be held itself
+	bool platform_full = shared_supply && (scheduled & (1 << PREHEAT_PLATFORM)) &&
+		(target[PREHEAT_PLATFORM] - temp[PREHEAT_PLATFORM] >= PREHEAT_BAND);
+
+	for ( uint8_t i = 0; i < PREHEAT_HEATERS; i++ ) {
+		uint8_t bit = 1 << i;
+
+		if ( !(scheduled & bit) )
+			continue;
+
+		if ( !(released & bit) ) {
+			if ( i == PREHEAT_PLATFORM ) {
+				if ( !platform_full && remaining[i] + PREHEAT_MARGIN < slowest )
+					continue;
+			}
+			else if ( platform_full || remaining[i] + PREHEAT_MARGIN < slowest )
+				continue;
+
+			released |= bit;
+			t_start[i] = now;
+			temp_start[i] = temp[i];
+			rate_seen[i] = 0;
+			phase[i] = ( target[i] - temp[i] >= PREHEAT_BAND ) ? PHASE_FULL : PHASE_RUN;
+		}
+
+		if ( phase[i] == PHASE_FULL && target[i] - temp[i] < PREHEAT_BAND ) {
+			int16_t rise = temp[i] - temp_start[i];
+			uint16_t secs = now - t_start[i];
+
+			if ( rise >= PREHEAT_MIN_RISE && secs > 0 )
+				rate_seen[i] = (uint16_t)(((uint32_t)rise * 100) / secs);
+			t_band[i] = now;
+			phase[i] = PHASE_BAND;
+		}
+	}
+
+	return scheduled & ~released;
+}
+
+bool active() {
+	return scheduled != 0;
+}
+
+void reset() {
+	scheduled = 0;
+	released = 0;
+	for ( uint8_t i = 0; i < PREHEAT_HEATERS; i++ ) {
+		tracked[i] = 0;
+		phase[i] = PHASE_OFF;
+	}
+}
+
+#ifdef SIMULATOR
+
+void setSharedSupply(bool shared) {
+	shared_supply = shared;
+}
+
+#else
+
+static uint8_t  paused = 0;         // Heaters paused by the schedule
+static uint16_t seconds = 0;
+static micros_t last_micros = 0;
+
+static Heater& heater(uint8_t i) {
+	Motherboard& board = Motherboard::getBoard();
+	return ( i == PREHEAT_PLATFORM ) ? board.getPlatformHeater() :
+		board.getExtruderBoard(i).getExtruderHeater();
+}
+
+static void replan() {
+	int16_t temp[PREHEAT_HEATERS], target[PREHEAT_HEATERS];
+
+	for ( uint8_t i = 0; i < PREHEAT_HEATERS; i++ ) {
+		Heater& h = heater(i);
+		temp[i] = h.get_current_temperature();
+		target[i] = ( h.has_failed() || temp[i] >= BAD_TEMPERATURE ) ? 0 :
+			h.get_set_temperature();
+	}
+
+	uint8_t hold = plan(seconds, temp, target);
+
+	for ( uint8_t i = 0; i < PREHEAT_HEATERS; i++ ) {
+		uint8_t bit = 1 << i;
+		Heater& h = heater(i);
+
+		if ( hold & bit ) {
+			// Leave alone a heater someone else has paused
+			if ( !(paused & bit) && !h.isPaused() ) {
+				h.Pause(true);
+				if ( h.isPaused() )
+					paused |= bit;
+			}
+		}
+		else if ( paused & bit ) {
+			paused &= ~bit;
+			h.Pause(false);
+		}
+	}
+}
+
+void schedule() {
+	// Heaters which left the schedule are looked at afresh, so that
+	// setting a heater back to a target it once reached schedules it
+	for ( uint8_t i = 0; i < PREHEAT_HEATERS; i++ )
+		if ( !(scheduled & (1 << i)) )
+			tracked[i] = 0;
+	replan();
+}
+
+void abort() {
+	reset();
+	for ( uint8_t i = 0; i < PREHEAT_HEATERS; i++ )
+		if ( paused & (1 << i) )
+			heater(i).Pause(false);
+	paused = 0;
+}
+
+void runPreheatSlice() {
+	micros_t now = Motherboard::getBoard().getCurrentMicros();
+
+	runWriterSlice();
+
+	if ( now - last_micros < 1000000L )
+		return;
+	last_micros = now;
+	seconds++;
+	if ( scheduled || paused )
+		replan();
+}
+
+#endif
+
+}
+
+#endif // PREHEAT_SCHEDULER
@@ -0,0 +1,118 @@
+#ifndef PREHEAT_HH_
+#define PREHEAT_HH_
+
+#include <stdint.h>
+
+#ifndef SIMULATOR
+#include "Configuration.hh"
+#else
+#include "Simulator.hh"
+#endif
+
+#ifdef PREHEAT_SCHEDULER
+
+/// Concurrent preheating which brings every heater to its setpoint at the
+/// same moment.
+///
+/// Each heater's heat up is modelled as a run at full power, at a learned
+/// rate, until it is within PREHEAT_BAND degrees of its target, where the
+/// Heater leaves its PID bypass, followed by a learned approach time under
+/// the PID.  From the model, the time each heater still needs is predicted
+/// once a second.  Heaters which would finish more than PREHEAT_MARGIN
+/// seconds ahead of the slowest are held, paused at their present
+/// temperature, and are released when they would no longer finish early;
+/// once released, a heater is not held again.
+///
+/// Unless HEATERS_ON_STEROIDS is defined, the supply is assumed unable to
+/// run the platform and the extruders at full power together, as the stock
+/// firmware does: extruders are also held while the platform is at least
+/// PREHEAT_BAND degrees short of its target.  The time the platform spends
+/// under its PID is then shared with the extruders rather than waited out.
+///
+/// Every heater which is released away from its target and runs to it
+/// unheld refines its model, which is kept in EEPROM and written from the
+/// preheat slice a byte at a time.
+namespace preheat {
+
+/// Heaters scheduled: tool 0, tool 1 and the platform
+#define PREHEAT_HEATERS  3
+#define PREHEAT_PLATFORM 2
+
+/// Degrees short of the target at which the Heater leaves its PID bypass;
+/// PID_BYPASS_DELTA in Heater.cc
+#define PREHEAT_BAND 15
+
+/// Degrees short of the target at which a heater has reached it;
+/// TARGET_HYSTERESIS in Heater.cc
+#define PREHEAT_REACHED 2
+
+/// Seconds early a heater may finish before it is held
+#define PREHEAT_MARGIN 5
+
+/// Fewest degrees a heater must rise at full power to measure its rate
+#define PREHEAT_MIN_RISE 20
+
+/// Weight of each new measurement in a learned model, 1 / 2^n
+#define PREHEAT_LEARN_SHIFT 2
+
+/// A heater's heat up, as kept in EEPROM at eeprom_offsets::HEATUP_MODELS
+struct Model {
+	uint16_t rate;           ///< Full power heat up, 1/100 degree per second
+	uint16_t approach;       ///< Seconds from PREHEAT_BAND short to reached
+} __attribute__ ((__packed__));
+
+/// Retrieve a heater's model; the defaults until it has been learned
+/// \param[in] heater 0 or 1 for the tools, PREHEAT_PLATFORM for the platform
+/// \param[out] m Model
+/// \return true if the model has been learned
+bool getModel(uint8_t heater, Model& m);
+
+/// Forget what has been learned of every heater.  Waits on the EEPROM.
+void forget();
+
+/// Write a learned model to EEPROM, by at most one byte.  Never waits on
+/// the EEPROM.
+void runWriterSlice();
+
+/// Predicted seconds for a heater to go from temp to target
+uint16_t predict(const Model& m, int16_t temp, int16_t target);
+
+/// Plan which heaters to hold.  A heater whose target is changed is
+/// scheduled anew; one which reaches its target or whose target is zero
+/// leaves the schedule.
+/// \param[in] now Seconds, from any origin
+/// \param[in] temp Present temperatures, PREHEAT_HEATERS of them
+/// \param[in] target Setpoints, PREHEAT_HEATERS of them; zero when off
+/// \return Bit mask of the heaters to hold
+uint8_t plan(uint16_t now, const int16_t *temp, const int16_t *target);
+
+/// Returns true while any heater is scheduled
+bool active();
+
+/// Drop the schedule; every heater is released
+void reset();
+
+#ifdef SIMULATOR
+
+/// Whether the supply is shared, as without HEATERS_ON_STEROIDS
+void setSharedSupply(bool shared);
+
+#else
+
+/// Schedule the heaters after their setpoints have been changed; those to
+/// be held are paused at once
+void schedule();
+
+/// Drop the schedule and unpause the heaters it paused
+void abort();
+
+/// Replan once a second, pausing and unpausing the heaters
+void runPreheatSlice();
+
+#endif
+
+}
+
+#endif // PREHEAT_SCHEDULER
+
+#endif // PREHEAT_HH_
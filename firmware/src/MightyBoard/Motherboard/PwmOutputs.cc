@@ -0,0 +1,97 @@
+#include "PwmOutputs.hh"
+
+#ifdef PWM_OUTPUTS
+
+#include <avr/io.h>
+#include <util/atomic.h>
+#include "Pin.hh"
+
+namespace pwm {
+
+static volatile uint8_t duty[CHANNELS];
+static uint8_t phase = 0;
+
+// A compare channel, given as PWM_<channel>_OC: 0 and 255 are held on the
+// pin, anything else is left to the timer
+#define SET_OC(oc, pin, value) SET_OC_(oc, pin, value)
+#define SET_OC_(ocr, tccr, com, pin, value)		\
+	if ( (value) == 0 || (value) == 255 ) {		\
+		tccr &= ~_BV(com);			\
+		pin.setValue((value) == 255);		\
+	} else {					\
+		ocr = (value);				\
+		tccr |= _BV(com);			\
+	}
+
+#define SET_SOFT(channel, pin) pin.setValue(duty[channel] > phase)
+
+void init() {
+	for ( uint8_t i = 0; i < CHANNELS; i++ )
+		set(i, 0);
+
+	PWM_TOOL0_HEATER.setDirection(true);
+	PWM_TOOL1_HEATER.setDirection(true);
+	PWM_TOOL0_FAN.setDirection(true);
+	PWM_TOOL1_FAN.setDirection(true);
+	PWM_PLATFORM_HEATER.setDirection(true);
+}
+
+void set(uint8_t channel, uint8_t value) {
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		duty[channel] = value;
+
+		switch ( channel ) {
+#ifdef PWM_TOOL0_HEATER_OC
+		case TOOL0_HEATER:
+			SET_OC(PWM_TOOL0_HEATER_OC, PWM_TOOL0_HEATER, value);
+			break;
+#endif
+#ifdef PWM_TOOL1_HEATER_OC
+		case TOOL1_HEATER:
+			SET_OC(PWM_TOOL1_HEATER_OC, PWM_TOOL1_HEATER, value);
+			break;
+#endif
+#ifdef PWM_TOOL0_FAN_OC
+		case TOOL0_FAN:
+			SET_OC(PWM_TOOL0_FAN_OC, PWM_TOOL0_FAN, value);
+			break;
+#endif
+#ifdef PWM_TOOL1_FAN_OC
+		case TOOL1_FAN:
+			SET_OC(PWM_TOOL1_FAN_OC, PWM_TOOL1_FAN, value);
+			break;
+#endif
+#ifdef PWM_PLATFORM_HEATER_OC
+		case PLATFORM_HEATER:
+			SET_OC(PWM_PLATFORM_HEATER_OC, PWM_PLATFORM_HEATER, value);
+			break;
+#endif
+		default:
+			// Software PWM'd from the next step
+			break;
+		}
+	}
+}
+
+void runSoftPwm() {
+	phase += PWM_SOFT_STEP;
+#ifndef PWM_TOOL0_HEATER_OC
+	SET_SOFT(TOOL0_HEATER, PWM_TOOL0_HEATER);
+#endif
+#ifndef PWM_TOOL1_HEATER_OC
+	SET_SOFT(TOOL1_HEATER, PWM_TOOL1_HEATER);
+#endif
+#ifndef PWM_TOOL0_FAN_OC
+	SET_SOFT(TOOL0_FAN, PWM_TOOL0_FAN);
+#endif
+#ifndef PWM_TOOL1_FAN_OC
+	SET_SOFT(TOOL1_FAN, PWM_TOOL1_FAN);
+#endif
+#ifndef PWM_PLATFORM_HEATER_OC
+	SET_SOFT(PLATFORM_HEATER, PWM_PLATFORM_HEATER);
+#endif
+}
+
+}
+
+#endif // PWM_OUTPUTS
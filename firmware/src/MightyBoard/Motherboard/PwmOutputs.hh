@@ -0,0 +1,54 @@
+#ifndef PWM_OUTPUTS_HH_
+#define PWM_OUTPUTS_HH_
+
+#include <stdint.h>
+#include "Configuration.hh"
+
+#ifdef PWM_OUTPUTS
+
+/// A single output layer for the heaters and the extruders' cooling fans.
+///
+/// Each output is a channel set to a duty of 0 - 255.  Configuration.hh
+/// names the pin of each, PWM_<channel>, and, where the pin is a timer
+/// compare output whose timer runs as an 8 bit PWM and is free for it,
+/// the compare channel, PWM_<channel>_OC.  Those channels are driven by
+/// their timers: 0 and 255 disconnect the compare output and hold the pin
+/// low or high, anything else connects it.  The remaining channels share
+/// one software PWM, stepped by runSoftPwm() every PWM_SOFT_TICKS ticks of
+/// the microsecond timer; each step sets every software channel's pin, so
+/// the cost is fixed by the board's configuration and not by the duties.
+namespace pwm {
+
+enum Channel {
+	TOOL0_HEATER = 0,
+	TOOL1_HEATER,
+	TOOL0_FAN,
+	TOOL1_FAN,
+	PLATFORM_HEATER,
+	CHANNELS
+};
+
+/// Ticks of the microsecond timer between software PWM steps
+#define PWM_SOFT_TICKS 10
+
+/// Duty added to the software PWM's phase each step; a software channel's
+/// period is 256 / PWM_SOFT_STEP steps, 32 ms, with that resolution
+#define PWM_SOFT_STEP 8
+
+/// Make every channel's pin an output, and set every channel off
+void init();
+
+/// Set a channel's duty
+/// \param[in] channel Channel
+/// \param[in] value Duty, 0 for off to 255 for fully on
+void set(uint8_t channel, uint8_t value);
+
+/// Step the software PWM; call from the microsecond timer's interrupt
+/// every PWM_SOFT_TICKS ticks
+void runSoftPwm();
+
+}
+
+#endif // PWM_OUTPUTS
+
+#endif // PWM_OUTPUTS_HH_
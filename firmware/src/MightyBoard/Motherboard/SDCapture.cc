@@ -0,0 +1,62 @@
+#include <stddef.h>
+#include <string.h>
+#include "SDCapture.hh"
+
+#ifdef SD_CAPTURE_BUFFER
+
+#include "lib_sd/fat.h"
+
+namespace sdcapture {
+
+static struct fat_file_struct *file = 0;
+static uint8_t buffer[SD_CAPTURE_BUFFER];
+static uint16_t buffered;
+static uint32_t total;
+
+void begin(struct fat_file_struct *fd) {
+	file = fd;
+	buffered = 0;
+	total = 0;
+}
+
+static bool flush() {
+	if ( buffered == 0 )
+		return true;
+	if ( fat_write_file(file, buffer, buffered) != (intptr_t)buffered )
+		return false;
+	total += buffered;
+	buffered = 0;
+	return true;
+}
+
+bool write(const uint8_t *data, uint16_t len) {
+	if ( file == 0 )
+		return false;
+	while ( len ) {
+		uint16_t n = sizeof(buffer) - buffered;
+		if ( n > len )
+			n = len;
+		memcpy(buffer + buffered, data, n);
+		buffered += n;
+		data += n;
+		len -= n;
+		if ( buffered == sizeof(buffer) && !flush() )
+			return false;
+	}
+	return true;
+}
+
+bool finish() {
+	bool ok = ( file == 0 ) || flush();
+	file = 0;
+	buffered = 0;
+	return ok;
+}
+
+uint32_t written() {
+	return total;
+}
+
+}
+
+#endif // SD_CAPTURE_BUFFER
@@ -0,0 +1,43 @@
+#ifndef SDCAPTURE_HH_
+#define SDCAPTURE_HH_
+
+#include <stdint.h>
+
+#ifndef SIMULATOR
+#include "Configuration.hh"
+#else
+#include "Simulator.hh"
+#endif
+
+#ifdef SD_CAPTURE_BUFFER
+
+struct fat_file_struct;
+
+/// Write-behind buffering of a file being captured to SD card.
+///
+/// Captured bytes are gathered in RAM and written to the file a whole
+/// SD_CAPTURE_BUFFER bytes at a time.  When the buffer is the size of a
+/// card block, each write then fills a block exactly and the card's block
+/// need not first be read and merged with the bytes written.
+namespace sdcapture {
+
+/// Start capturing to a file, which must be open and positioned at its end
+void begin(struct fat_file_struct *fd);
+
+/// Append bytes to the file
+/// \return false if the file could not be written
+bool write(const uint8_t *data, uint16_t len);
+
+/// Write out any bytes still buffered and stop capturing.  The file is
+/// left open.
+/// \return false if the file could not be written
+bool finish();
+
+/// Number of bytes written to the file since begin()
+uint32_t written();
+
+}
+
+#endif // SD_CAPTURE_BUFFER
+
+#endif // SDCAPTURE_HH_
@@ -23,6 +23,8 @@
 #include "lib_sd/fat.h"
 #include "lib_sd/sd_raw.h"
 #include "lib_sd/partition.h"
+#include "SDCapture.hh"
+#include "SDReadAhead.hh"
 #include "Motherboard.hh"
 #include "Menu_locales.hh"
 #include "Eeprom.hh"
@@ -90,6 +92,9 @@ static bool openFilesys()
 
 static SdErrorCode changeWorkingDir(struct fat_dir_entry_struct *newDir)
 {
+#ifdef SD_DIR_INDEX
+	sdindex::invalidate();
+#endif
 	if ( !newDir ) {
 		// Open the root directory
 		struct fat_dir_entry_struct rootdirectory;
@@ -137,7 +142,7 @@ retry:
 			if ( openFilesys() ) {
 				if ( changeWorkingDir(0) == SD_SUCCESS ) {
 					if ( checkVolumeSize() ) {
-						if ( !speed ) {
+						if ( speed <= SD_RAW_SPEED_STANDARD ) {
 							mustReinit = false;
 							sdErrno = 0;
 							sdAvailable = SD_SUCCESS;
@@ -152,14 +157,33 @@ retry:
 				else sderr = SD_ERR_NO_ROOT;
 			}
 			else {
-				if ( ++speed <= 5 )
+				// A slower clock won't help with clusters
+				// lib_sd cannot handle
+				if ( fat_errno != FAT_ERR_BADCLUSTERSIZE &&
+				     ++speed <= 5 )
 					goto retry;
 				sderr = SD_ERR_OPEN_FILESYSTEM;
 			}
 		}
-		else sderr = SD_ERR_PARTITION_READ;
+		else {
+#if SD_RAW_FAST_SPI
+			if ( speed < SD_RAW_SPEED_STANDARD ) {
+				++speed;
+				goto retry;
+			}
+#endif
+			sderr = SD_ERR_PARTITION_READ;
+		}
 	}
 	else {
+#if SD_RAW_FAST_SPI
+	    // The card may not manage the faster SPI clock, which
+	    // sd_raw_init() switches to before reading the first block
+	    if ( sd_raw_available() && speed < SD_RAW_SPEED_STANDARD ) {
+		++speed;
+		goto retry;
+	    }
+#endif
 	    if ( sd_errno == SDR_ERR_CRC )
 		sderr = SD_ERR_CRC;
 	    else
@@ -243,6 +267,25 @@ void directoryNextEntry(char* buffer, uint8_t bufsize, uint8_t *buflen, bool *is
 	}
 }
 
+#ifdef SD_DIR_INDEX
+
+uint8_t directoryCount(sdindex::Filter filter) {
+	if ( directoryReset() != SD_SUCCESS )
+		return 0;
+	return sdindex::count(cwd, filter);
+}
+
+bool directoryEntry(uint8_t index, sdindex::Filter filter,
+		    char* buffer, uint8_t bufsize, uint8_t *buflen, bool *isDir) {
+	if ( mustReinit && initCard() != SD_SUCCESS ) {
+		buffer[0] = 0;
+		return false;
+	}
+	return sdindex::entry(cwd, index, filter, buffer, bufsize, buflen, isDir);
+}
+
+#endif
+
 static bool findFileInDir(const char* name, struct fat_dir_entry_struct* dir_entry)
 {
 	fat_reset_dir(cwd);
@@ -305,6 +348,9 @@ static void deleteFile(char *name)
 {
 	struct fat_dir_entry_struct fileEntry;
 
+#ifdef SD_DIR_INDEX
+	sdindex::invalidate();
+#endif
 	if ( findFileInDir(name, &fileEntry) )
 		fat_delete_file(fs, &fileEntry);
 }
@@ -313,6 +359,9 @@ static bool createFile(char *name)
 {
 	struct fat_dir_entry_struct fileEntry;
 
+#ifdef SD_DIR_INDEX
+	sdindex::invalidate();
+#endif
 	return fat_create_file(cwd, name, &fileEntry) != 0;
 }
 
@@ -356,19 +405,26 @@ SdErrorCode startCapture(char* filename)
     if ( openFile(filename) != 1 )
 	return SD_ERR_GENERIC;
 
+#ifdef SD_CAPTURE_BUFFER
+    sdcapture::begin(file);
+#endif
     capturing = true;
     return SD_SUCCESS;
 }
 
 #ifdef S3G_CAPTURE_2_SD
 
-void capturePacket(const Packet& packet)
+void capturePacket(const Packet& packet, uint8_t first)
 {
 	if (file == 0) return;
 	// Casting away volatile is OK in this instance; we know where the
-	// data is located and that fat_write_file isn't caching
-	fat_write_file(file, (uint8_t*)packet.getData(), packet.getLength());
-	capturedBytes += packet.getLength();
+	// data is located and that it is copied before the packet changes
+#ifdef SD_CAPTURE_BUFFER
+	sdcapture::write((uint8_t*)packet.getData() + first, packet.getLength() - first);
+#else
+	fat_write_file(file, (uint8_t*)packet.getData() + first, packet.getLength() - first);
+	capturedBytes += packet.getLength() - first;
+#endif
 }
 
 #endif
@@ -377,7 +433,14 @@ void capturePacket(const Packet& packet)
 
 /// Writes b to the open file
 bool writeByte(uint8_t b) {
-    return ( (intptr_t)1 == fat_write_file(file, (uint8_t *)&b, (uintptr_t)1) );
+#ifdef SD_CAPTURE_BUFFER
+    return sdcapture::write(&b, 1);
+#else
+    if ( (intptr_t)1 != fat_write_file(file, (uint8_t *)&b, (uintptr_t)1) )
+	return false;
+    capturedBytes++;
+    return true;
+#endif
 }
 
 #endif
@@ -385,15 +448,52 @@ bool writeByte(uint8_t b) {
 uint32_t finishCapture()
 {
 	if ( capturing ) {
+#ifdef SD_CAPTURE_BUFFER
+		sdcapture::finish();
+		capturedBytes = sdcapture::written();
+#endif
 		finishFile();
 		capturing = false;
 	}
 	return capturedBytes;
 }
 
+#ifdef PRINT_CHECKPOINT
+static uint32_t playback_position = 0;
+#endif
+//static bool retry = false;
+
+// Note why reading the file being played back failed
+static void playbackFailed() {
+	if ( !sd_raw_available() ) {
+	    sdAvailable = SD_ERR_NO_CARD_PRESENT;
+	}
+	else
+	    sdAvailable = ( fat_errno == FAT_ERR_CRC ) ? SD_ERR_CRC : SD_ERR_READ;
+}
+
+#ifdef SD_READ_AHEAD
+
+static void fetchAhead(uint16_t budget) {
+	bool failed = sdreadahead::failed();
+	sdreadahead::fill(budget);
+	if ( !failed && sdreadahead::failed() )
+	    playbackFailed();
+}
+
+void runPlaybackSlice() {
+	if ( playing )
+	    fetchAhead(SD_READ_AHEAD_BUDGET);
+}
+
+bool playbackAvailable() {
+	return sdreadahead::available();
+}
+
+#else
+
 static uint8_t next_byte;
 static bool has_more = false;
-//static bool retry = false;
 
 void fetchNextByte() {
 
@@ -407,16 +507,13 @@ void fetchNextByte() {
 	    return;
 	else {
 	    has_more = false;
-	    if ( read < 0 ) {
-		if ( !sd_raw_available() ) {
-		    sdAvailable = SD_ERR_NO_CARD_PRESENT;
-		}
-		else
-		    sdAvailable = ( fat_errno == FAT_ERR_CRC ) ? SD_ERR_CRC : SD_ERR_READ;
-	    }
+	    if ( read < 0 )
+		playbackFailed();
 	}
 }
 
+#endif // SD_READ_AHEAD
+
 #if 0
 static bool playbackRetry() {
 	return retry;
@@ -424,15 +521,65 @@ static bool playbackRetry() {
 #endif
 
 bool playbackHasNext() {
+#ifdef SD_READ_AHEAD
+  return !sdreadahead::finished();
+#else
   return has_more;// || retry;
+#endif
 }
 
 uint8_t playbackNext() {
+#ifdef SD_READ_AHEAD
+  // Callers other than the command slice may take bytes faster than
+  // runPlaybackSlice() reads them ahead, so wait on the card for them
+  while ( !sdreadahead::available() && !sdreadahead::finished() )
+    fetchAhead(0xffff);
+  if ( !sdreadahead::available() )
+    return 0;
+  uint8_t rv = sdreadahead::next();
+#else
   uint8_t rv = next_byte;
+#endif
+#ifdef PRINT_CHECKPOINT
+  playback_position++;
+#endif
+#ifndef SD_READ_AHEAD
   fetchNextByte();
+#endif
   return rv;
 }
 
+#ifdef PRINT_CHECKPOINT
+
+uint32_t playbackPosition() {
+  return playback_position;
+}
+
+bool playbackSeek(uint32_t offset) {
+    if ( !playing || file == 0 )
+	return false;
+
+    // With write support, fat_seek_file() will grow the file when
+    //   seeking past its end.  We never want that here.
+    if ( offset > fat_get_file_size(file) )
+	return false;
+
+    int32_t off = (int32_t)offset;
+    if ( !fat_seek_file(file, &off, FAT_SEEK_SET) )
+	return false;
+
+    playback_position = offset;
+#ifdef SD_READ_AHEAD
+    sdreadahead::begin(file, offset);
+#else
+    has_more = true;
+    fetchNextByte();
+#endif
+    return true;
+}
+
+#endif
+
 SdErrorCode startPlayback(char* filename) {
 #ifndef BROKEN_SD
     if ( mustReinit ) {
@@ -456,23 +603,45 @@ SdErrorCode startPlayback(char* filename) {
 	return SD_CWD;
 
     // open_filesize = fat_get_file_size(file);
+#if SD_RAW_STREAM_READS
+    sd_raw_stream(1);
+#endif
     playing = true;
+#ifdef PRINT_CHECKPOINT
+    playback_position = 0;
+#endif
+#ifdef SD_READ_AHEAD
+    // Read the first bytes now, so that an empty file is finished at once
+    sdreadahead::begin(file, 0);
+    fetchAhead(0xffff);
+#else
     has_more = true;
     fetchNextByte();
+#endif
     return SD_SUCCESS;
 }
 
 void finishPlayback() {
 	if ( !playing ) return;
+#if SD_RAW_STREAM_READS
+	sd_raw_stream(0);
+#endif
 	finishFile();
 	playing = false;
+#ifdef SD_READ_AHEAD
+	sdreadahead::end();
+#else
 	has_more = false;
+#endif
 }
 
 void reset() {
 	finishPlayback();
 	finishCapture();
 	finishFile();
+#ifdef SD_DIR_INDEX
+	sdindex::invalidate();
+#endif
 	if (cwd != 0) {
 		fat_close_dir(cwd);
 		cwd = 0;
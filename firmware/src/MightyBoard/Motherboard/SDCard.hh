@@ -20,7 +20,9 @@
 #define SDCARD_HH_
 
 #include <stdint.h>
+#include "Configuration.hh"
 #include "Packet.hh"
+#include "SDIndex.hh"
 
 /// Interface to the SD card library. Provides straightforward functions for
 /// listing directory contents, and reading and writing jobs to files.
@@ -68,6 +70,26 @@ namespace sdcard {
     void directoryNextEntry(char* buffer, uint8_t bufsize,
 			    uint8_t* fileLength = 0, bool *isDir = 0);
 
+#ifdef SD_DIR_INDEX
+    /// Count the entries of the working directory which filter lists,
+    /// indexing them for directoryEntry().
+    /// \param[in] filter Entries listed
+    /// \return Number of entries listed, 0 if the card could not be read
+    uint8_t directoryCount(sdindex::Filter filter);
+
+
+    /// Get a listed entry of the working directory without scanning the
+    /// directory from its start.
+    /// \param[in] index Entry wanted, counting from 0
+    /// \param[in] filter Entries listed; that given to directoryCount()
+    /// \param[in] buffer Character buffer to store name in
+    /// \param[in] bufsize Size of buffer
+    /// \return false if there is no such entry
+    bool directoryEntry(uint8_t index, sdindex::Filter filter,
+			char* buffer, uint8_t bufsize,
+			uint8_t* fileLength = 0, bool *isDir = 0);
+#endif
+
 
     /// Begin capturing bufffered commands to a new file with the given filename.
     /// Returns an SD card error/success code.
@@ -78,7 +100,8 @@ namespace sdcard {
 
     /// Capture the contents of a packet to the currently open file.
     /// \param[in] packet Packet to write to file.
-    void capturePacket(const Packet& packet);
+    /// \param[in] first Index of the first payload byte to write.
+    void capturePacket(const Packet& packet, uint8_t first = 0);
 
 #ifdef EEPROM_MENU_ENABLE
     /// Writes b to the open file
@@ -112,6 +135,27 @@ namespace sdcard {
     /// \return The next byre in the file.
     uint8_t playbackNext();
 
+#ifdef SD_READ_AHEAD
+    /// Read ahead of playback, clocking at most about SD_READ_AHEAD_BUDGET
+    /// bytes over SPI.  Called from the main loop.
+    void runPlaybackSlice();
+
+    /// See if playbackNext() has a byte read ahead to return at once.
+    /// \return True if a byte is ready
+    bool playbackAvailable();
+#endif
+
+#ifdef PRINT_CHECKPOINT
+    /// Return the file offset of the byte the next call to playbackNext()
+    /// will return.
+    uint32_t playbackPosition();
+
+    /// Reposition playback within the currently open file.
+    /// \param[in] offset File offset to continue playback from
+    /// \return True if successful, false if the offset is beyond the end of file
+    bool playbackSeek(uint32_t offset);
+#endif
+
 
     /// Halt playback.  Should be called at the end of playback, or on manual
     /// halt; frees up resources.
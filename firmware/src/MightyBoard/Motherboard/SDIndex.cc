@@ -0,0 +1,121 @@
+#include <stddef.h>
+#include <string.h>
+#include "SDIndex.hh"
+
+#ifdef SD_DIR_INDEX
+
+#include "lib_sd/fat.h"
+
+namespace sdindex {
+
+#define SD_INDEX_INVALID 0xff
+#define SD_INDEX_MARKS   (SD_INDEX_MAX / SD_INDEX_STRIDE + 1)
+
+// Number of entries listed, or SD_INDEX_INVALID until counted
+static uint8_t entries = SD_INDEX_INVALID;
+
+// marks[i] is the directory position from which listed entry
+// i * SD_INDEX_STRIDE is next read
+static struct fat_dir_pos_struct marks[SD_INDEX_MARKS];
+
+// The entry fetched last, which the menu redraws repeatedly, and the
+// position from which the entry after it is read
+static uint8_t last = SD_INDEX_INVALID;
+static char lastName[sizeof(((struct fat_dir_entry_struct *)0)->long_name)];
+static bool lastIsDir;
+static struct fat_dir_pos_struct nextPos;
+
+void invalidate() {
+	entries = SD_INDEX_INVALID;
+	last = SD_INDEX_INVALID;
+}
+
+// Read forward to the next listed entry, noting the position it was read
+// from
+static bool readListed(struct fat_dir_struct *dd, Filter filter,
+		       struct fat_dir_entry_struct *dir_entry,
+		       struct fat_dir_pos_struct *pos) {
+	for (;;) {
+		fat_get_dir_pos(dd, pos);
+		if ( !fat_read_dir(dd, dir_entry) )
+			return false;
+		if ( dir_entry->attributes &
+		     (FAT_ATTRIB_HIDDEN | FAT_ATTRIB_SYSTEM | FAT_ATTRIB_VOLUME) )
+			continue;
+		if ( dir_entry->long_name[0] &&
+		     filter(dir_entry->long_name, strlen(dir_entry->long_name),
+			    (dir_entry->attributes & FAT_ATTRIB_DIR) != 0) )
+			return true;
+	}
+}
+
+uint8_t count(struct fat_dir_struct *dd, Filter filter) {
+	struct fat_dir_entry_struct dir_entry;
+	struct fat_dir_pos_struct pos;
+
+	invalidate();
+	entries = 0;
+	if ( !fat_reset_dir(dd) )
+		return 0;
+
+	while ( entries < SD_INDEX_MAX &&
+		readListed(dd, filter, &dir_entry, &pos) ) {
+		if ( (entries % SD_INDEX_STRIDE) == 0 )
+			marks[entries / SD_INDEX_STRIDE] = pos;
+		++entries;
+	}
+	return entries;
+}
+
+bool entry(struct fat_dir_struct *dd, uint8_t index, Filter filter,
+	   char *buffer, uint8_t bufsize, uint8_t *len, bool *isdir) {
+	struct fat_dir_entry_struct dir_entry;
+	struct fat_dir_pos_struct pos;
+	uint8_t i;
+
+	buffer[0] = 0;
+	if ( len ) *len = 0;
+	if ( isdir ) *isdir = false;
+
+	if ( entries == SD_INDEX_INVALID )
+		count(dd, filter);
+	if ( index >= entries )
+		return false;
+
+	if ( index != last ) {
+		// Start from the nearest known position at or before the entry
+		i = index - (index % SD_INDEX_STRIDE);
+		if ( last < index && last >= i ) {
+			i = last + 1;
+			pos = nextPos;
+		}
+		else
+			pos = marks[index / SD_INDEX_STRIDE];
+
+		if ( !fat_set_dir_pos(dd, &pos) )
+			return false;
+		do {
+			if ( !readListed(dd, filter, &dir_entry, &pos) ) {
+				// The directory changed without our being told
+				invalidate();
+				return false;
+			}
+		} while ( i++ < index );
+		last = index;
+		fat_get_dir_pos(dd, &nextPos);
+		strcpy(lastName, dir_entry.long_name);
+		lastIsDir = (dir_entry.attributes & FAT_ATTRIB_DIR) != 0;
+	}
+
+	bufsize--;  // Assumes bufsize > 0
+	for (i = 0; i < bufsize && lastName[i] != 0; i++)
+		buffer[i] = lastName[i];
+	buffer[i] = 0;
+	if ( len ) *len = i;
+	if ( isdir ) *isdir = lastIsDir;
+	return true;
+}
+
+}
+
+#endif // SD_DIR_INDEX
@@ -0,0 +1,71 @@
+#ifndef SDINDEX_HH_
+#define SDINDEX_HH_
+
+#include <stdint.h>
+
+#ifndef SIMULATOR
+#include "Configuration.hh"
+#else
+#include "Simulator.hh"
+#endif
+
+#ifdef SD_DIR_INDEX
+
+struct fat_dir_struct;
+
+/// An index of the entries listed from a directory, so that the LCD menu
+/// may fetch its Nth entry without reading the directory from the start.
+///
+/// The entries are counted once, when the directory is first listed.  As
+/// they are counted, the directory position of every SD_INDEX_STRIDE'th
+/// listed entry is recorded, as are the positions of the entry fetched last
+/// and the one following it.  An entry is then fetched by moving to the
+/// nearest recorded position before it and reading forward, which reads at
+/// most SD_INDEX_STRIDE - 1 listed entries more than the one wanted.
+/// Redrawing the same entry or scrolling to the next reads just the one.
+///
+/// The index describes a single directory and must be invalidated whenever
+/// the card, the directory or its contents change.
+namespace sdindex {
+
+/// Listed entries between recorded directory positions
+#ifndef SD_INDEX_STRIDE
+#define SD_INDEX_STRIDE 8
+#endif
+
+/// Most entries listed; the menu needs one more item for "exit"
+#define SD_INDEX_MAX 254
+
+/// Decides which entries are listed.  Hidden, system and volume entries
+/// and those with empty names are never listed.
+/// \param[in] name Entry's long name, NUL terminated
+/// \param[in] len Length of name
+/// \param[in] isdir True if the entry is a directory
+typedef bool (*Filter)(const char *name, uint8_t len, bool isdir);
+
+/// Forget the directory indexed
+void invalidate();
+
+/// Count the entries listed from a directory and index them
+/// \param[in] dd Directory, whose position is changed
+/// \param[in] filter Entries listed
+/// \return Number of entries listed, at most SD_INDEX_MAX
+uint8_t count(struct fat_dir_struct *dd, Filter filter);
+
+/// Fetch a listed entry, indexing the directory first if need be
+/// \param[in] dd Directory, whose position is changed
+/// \param[in] index Entry wanted, counting from 0
+/// \param[in] filter Entries listed; that given to count()
+/// \param[out] buffer Entry's name, truncated to fit bufsize
+/// \param[in] bufsize Size of buffer, at least 1
+/// \param[out] len Length of the name in buffer, or 0
+/// \param[out] isdir True if the entry is a directory, or 0
+/// \return false if there is no such entry or the card could not be read
+bool entry(struct fat_dir_struct *dd, uint8_t index, Filter filter,
+	   char *buffer, uint8_t bufsize, uint8_t *len, bool *isdir);
+
+}
+
+#endif // SD_DIR_INDEX
+
+#endif // SDINDEX_HH_
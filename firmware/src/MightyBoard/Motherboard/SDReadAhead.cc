@@ -0,0 +1,103 @@
+#include <stddef.h>
+#include "SDReadAhead.hh"
+
+#ifdef SD_READ_AHEAD
+
+#include "lib_sd/sd_raw.h"
+#include "lib_sd/fat.h"
+
+namespace sdreadahead {
+
+static struct fat_file_struct *file = 0;
+static uint8_t buffers[2][SD_READ_AHEAD];
+
+// Buffer bytes are taken from, and how many of its bytes are taken and held
+static uint8_t front;
+static uint16_t taken, held;
+
+// Bytes held in the other buffer, which is being filled
+static uint16_t filled;
+
+// File offset from which the other buffer is filled next
+static uint32_t position;
+
+static bool ended, error;
+
+void begin(struct fat_file_struct *fd, uint32_t offset) {
+	file = fd;
+	position = offset;
+	front = 0;
+	taken = held = filled = 0;
+	ended = error = false;
+}
+
+void end() {
+	begin(0, 0);
+}
+
+// Hand the buffer being filled over once the other is used up
+static void swap() {
+	if ( taken == held && filled ) {
+		front ^= 1;
+		held = filled;
+		taken = 0;
+		filled = 0;
+	}
+}
+
+void fill(uint16_t budget) {
+	if ( file == 0 || ended )
+		return;
+	swap();
+	if ( filled == SD_READ_AHEAD )
+		return;
+
+#if SD_RAW_STREAM_READS
+	// Have the block to be read next cached, a piece at a time
+	offset_t block = fat_get_file_block(file);
+	if ( block && !sd_raw_stream_fetch(block, budget) )
+		return;
+#else
+	(void)budget;
+#endif
+
+	// Then copy out what fits, up to the end of the block
+	uint16_t n = SD_READ_AHEAD - filled;
+	uint16_t left = 512 - (uint16_t)(position & 511);
+	if ( n > left )
+		n = left;
+	intptr_t got = fat_read_file(file, buffers[front ^ 1] + filled, n);
+	if ( got > 0 ) {
+		filled += (uint16_t)got;
+		position += (uint32_t)got;
+		// Then finished() is true as soon as the last byte is taken
+		if ( position >= fat_get_file_size(file) )
+			ended = true;
+	}
+	else {
+		ended = true;
+		error = got < 0;
+	}
+	swap();
+}
+
+bool available() {
+	swap();
+	return taken < held;
+}
+
+uint8_t next() {
+	return buffers[front][taken++];
+}
+
+bool finished() {
+	return ( file == 0 || ended ) && taken == held && filled == 0;
+}
+
+bool failed() {
+	return error;
+}
+
+}
+
+#endif // SD_READ_AHEAD
@@ -0,0 +1,61 @@
+#ifndef SDREADAHEAD_HH_
+#define SDREADAHEAD_HH_
+
+#include <stdint.h>
+
+#ifndef SIMULATOR
+#include "Configuration.hh"
+#else
+#include "Simulator.hh"
+#endif
+
+#ifdef SD_READ_AHEAD
+
+struct fat_file_struct;
+
+/// Read-ahead of a file being played back from SD card, so that the
+/// command slice takes its bytes from RAM rather than waiting on the card.
+///
+/// Two buffers of SD_READ_AHEAD bytes are kept: bytes are taken from one
+/// while the other is filled, and the two swap once the first is used up
+/// and the second is full.  Each call to fill() clocks at most about the
+/// budget it is given towards the card block to be read next, and then
+/// copies what it can of that block once it is cached.  A card which is
+/// slow to send a block thus holds up no single call for long.
+///
+/// The file's FAT is still read, at once, whenever the clusters cached by
+/// FAT_EXTENT_COUNT run out, and so is the first block after begin() when
+/// the file was seeked.
+namespace sdreadahead {
+
+/// Start reading ahead from a file, discarding anything read ahead before.
+/// \param[in] fd File, open and positioned where reading is to start
+/// \param[in] position File offset at which the file is positioned
+void begin(struct fat_file_struct *fd, uint32_t position);
+
+/// Stop reading ahead
+void end();
+
+/// Read ahead some more
+/// \param[in] budget Bytes which may be clocked over SPI waiting for and
+///   receiving a block from the card
+void fill(uint16_t budget);
+
+/// \return True if a byte has been read ahead
+bool available();
+
+/// Take the next byte read ahead; available() must be true
+uint8_t next();
+
+/// \return True once every byte up to the end of the file or a read
+///   error has been taken
+bool finished();
+
+/// \return True if reading ahead ended with a read error
+bool failed();
+
+}
+
+#endif // SD_READ_AHEAD
+
+#endif // SDREADAHEAD_HH_
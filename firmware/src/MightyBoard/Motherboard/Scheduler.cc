@@ -0,0 +1,227 @@
+#include "Scheduler.hh"
+
+#ifdef SLICE_SCHEDULER
+
+#include <string.h>
+#ifndef SIMULATOR
+#include <avr/pgmspace.h>
+#include "Motherboard.hh"
+#include "Host.hh"
+#include "Command.hh"
+#include "Steppers.hh"
+#include "SDCard.hh"
+#include "Piezo.hh"
+#ifdef PRINT_CHECKPOINT
+#include "Checkpoint.hh"
+#endif
+#else
+#include <stdlib.h>
+#include <math.h>
+#include "Simulator.hh"
+#endif
+#include "StepperAccelPlanner.hh"
+#ifdef SLICE_PROFILE
+#include "SliceProfile.hh"
+#endif
+
+// Older avr-libc has no pgm_read_ptr; a pointer is a word
+#ifndef pgm_read_ptr
+#define pgm_read_ptr(addr) (void *)pgm_read_word(addr)
+#endif
+
+// The harness keeps the board's clock, and stands in for each slice
+#ifdef SIMULATOR
+#define CURRENT_MICROS() simulatorMicros()
+#define PRECISE_MICROS() simulatorMicros()
+#define SLICE(name, task, call) static void name() { simulatorRunTask(task); }
+#else
+#define CURRENT_MICROS() Motherboard::getBoard().getCurrentMicros()
+#define PRECISE_MICROS() Motherboard::getBoard().getPreciseMicros()
+#define SLICE(name, task, call) static void name() { call; }
+#endif
+
+namespace scheduler {
+
+SLICE(runHost, TASK_HOST, host::runHostSlice())
+#ifdef SD_READ_AHEAD
+SLICE(runPlayback, TASK_SD_READ_AHEAD, sdcard::runPlaybackSlice())
+#endif
+SLICE(runCommand, TASK_COMMAND, command::runCommandSlice())
+SLICE(runSteppers, TASK_STEPPERS, steppers::runSteppersSlice())
+SLICE(runInterface, TASK_INTERFACE, Motherboard::getBoard().runInterfaceSlice())
+SLICE(runScreen, TASK_SCREEN, Motherboard::getBoard().runScreenSlice())
+SLICE(runMotherboard, TASK_MOTHERBOARD, Motherboard::getBoard().runMotherboardSlice())
+SLICE(runPlatform, TASK_PLATFORM, Motherboard::getBoard().runPlatformSlice())
+#ifdef MODEL_REPLICATOR2
+SLICE(runThermocouple, TASK_THERMOCOUPLE, Motherboard::getBoard().runThermocoupleSlice())
+#else
+SLICE(runExtruderOne, TASK_EXTRUDER_ONE, Motherboard::getBoard().runExtruderSlice(0))
+SLICE(runExtruderTwo, TASK_EXTRUDER_TWO, Motherboard::getBoard().runExtruderSlice(1))
+#endif
+#ifdef PRINT_CHECKPOINT
+SLICE(runCheckpoint, TASK_CHECKPOINT, checkpoint::runCheckpointSlice())
+#endif
+SLICE(runPiezo, TASK_PIEZO, Piezo::runPiezoSlice())
+
+// In the order of TaskId
+static const Task tasks[TASKS] PROGMEM = {
+	// run                         period  deadline  budget  priority  flags
+	{ runHost,                          0,     5000,    300,      200, TASK_FEEDS_PLANNER },
+#ifdef SD_READ_AHEAD
+	{ runPlayback,                      0,    10000,    300,      180, TASK_FEEDS_PLANNER },
+#endif
+	{ runCommand,                       0,     5000,    500,      190, TASK_FEEDS_PLANNER },
+	{ runSteppers,                      0,    10000,     10,      210, 0 },
+	{ runInterface,                     0,    20000,    500,      120, TASK_UI },
+	// Made due at the screen's own rate as it runs
+	{ runScreen,                    50000,   100000,   1500,      100, TASK_UI },
+	{ runMotherboard,                   0,    20000,    100,      150, 0 },
+	{ runPlatform, SAMPLE_INTERVAL_MICROS_THERMISTOR, 50000, 500, 140, 0 },
+#ifdef MODEL_REPLICATOR2
+	// Made due at once again while the ADS1118 has no reading
+	{ runThermocouple, THERMOCOUPLE_UPDATE_RATE, 50000,      500, 140, 0 },
+#else
+	{ runExtruderOne, SAMPLE_INTERVAL_MICROS_THERMOCOUPLE, 50000, 500, 140, 0 },
+	{ runExtruderTwo, SAMPLE_INTERVAL_MICROS_THERMOCOUPLE, 50000, 500, 140, 0 },
+#endif
+#ifdef PRINT_CHECKPOINT
+	{ runCheckpoint,                    0,   100000,    200,       60, 0 },
+#endif
+	{ runPiezo,                         0,    10000,     50,      160, 0 },
+};
+
+#ifdef SLICE_PROFILE
+// The histogram each task is counted in, in the order of TaskId
+static const uint8_t task_slices[TASKS] PROGMEM = {
+	profile::SLICE_HOST,
+#ifdef SD_READ_AHEAD
+	profile::SLICE_SD,
+#endif
+	profile::SLICE_COMMAND,
+	profile::SLICE_NONE,
+	profile::SLICE_INTERFACE,
+	profile::SLICE_INTERFACE,
+	profile::SLICE_MOTHERBOARD,
+	profile::SLICE_MOTHERBOARD,
+#ifdef MODEL_REPLICATOR2
+	profile::SLICE_MOTHERBOARD,
+#else
+	profile::SLICE_MOTHERBOARD,
+	profile::SLICE_MOTHERBOARD,
+#endif
+#ifdef PRINT_CHECKPOINT
+	profile::SLICE_NONE,
+#endif
+	profile::SLICE_NONE,
+};
+
+static micros_t last_pass;
+static bool passed;
+#endif
+
+static micros_t due[TASKS];
+static TaskStats stats[TASKS];
+
+void reset() {
+	memset(due, 0, sizeof(due));
+	memset(stats, 0, sizeof(stats));
+#ifdef SLICE_PROFILE
+	profile::reset();
+	passed = false;
+#endif
+}
+
+void runIn(uint8_t task, micros_t micros) {
+	due[task] = CURRENT_MICROS() + micros;
+}
+
+void runPass() {
+	micros_t start = PRECISE_MICROS();
+	uint8_t order[TASKS];
+	uint8_t rank[TASKS];
+	uint8_t count = 0;
+
+#ifdef SLICE_PROFILE
+	if ( passed )
+		profile::record(profile::SLICE_LOOP, start - last_pass);
+	last_pass = start;
+	passed = true;
+#endif
+
+	uint8_t planned = movesplanned();
+	uint8_t raised = 0;
+	if ( planned < SCHEDULER_PLANNER_LOW )
+		raised = TASK_FEEDS_PLANNER;
+	else if ( planned >= BLOCK_BUFFER_SIZE - 1 )
+		raised = TASK_UI;
+
+	// Rank the tasks due, those past their deadline first, and order them
+	micros_t now = CURRENT_MICROS();
+	for ( uint8_t i = 0; i < TASKS; i++ ) {
+		int32_t late = (int32_t)(now - due[i]);
+		if ( late < 0 )
+			continue;
+
+		uint8_t r;
+		if ( late >= (int32_t)pgm_read_dword(&tasks[i].deadline) )
+			r = 0xff;
+		else {
+			r = pgm_read_byte(&tasks[i].priority);
+			if ( pgm_read_byte(&tasks[i].flags) & raised )
+				r = (r > 0xfe - SCHEDULER_BOOST) ? 0xfe : r + SCHEDULER_BOOST;
+		}
+
+		uint8_t j = count++;
+		for ( ; j > 0 && rank[j - 1] < r; j-- ) {
+			order[j] = order[j - 1];
+			rank[j] = rank[j - 1];
+		}
+		order[j] = i;
+		rank[j] = r;
+	}
+
+	for ( uint8_t j = 0; j < count; j++ ) {
+		uint8_t i = order[j];
+		micros_t began = PRECISE_MICROS();
+
+		// Always run the first, and any past their deadline
+		if ( j > 0 && rank[j] != 0xff &&
+		     began - start + pgm_read_word(&tasks[i].budget) > SCHEDULER_PASS_MICROS )
+			continue;
+
+		if ( rank[j] == 0xff )
+			stats[i].misses++;
+
+		// Due a period after it last fell due, or from now if that has
+		// already gone
+		micros_t period = pgm_read_dword(&tasks[i].period);
+		due[i] += period;
+		if ( (int32_t)(now - due[i]) >= 0 )
+			due[i] = now + period;
+
+		void (*run)() = (void (*)())pgm_read_ptr(&tasks[i].run);
+		run();
+
+		micros_t took = PRECISE_MICROS() - began;
+		stats[i].runs++;
+		stats[i].total += took;
+		if ( took > stats[i].longest )
+			stats[i].longest = (took > 0xffff) ? 0xffff : took;
+#ifdef SLICE_PROFILE
+		profile::record(pgm_read_byte(&task_slices[i]), took);
+#endif
+	}
+}
+
+bool getStats(uint8_t task, TaskStats *s, bool clear) {
+	if ( task >= TASKS )
+		return false;
+	*s = stats[task];
+	if ( clear )
+		memset(&stats[task], 0, sizeof(TaskStats));
+	return true;
+}
+
+}
+
+#endif // SLICE_SCHEDULER
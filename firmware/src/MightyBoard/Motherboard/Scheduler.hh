@@ -0,0 +1,108 @@
+#ifndef SCHEDULER_HH_
+#define SCHEDULER_HH_
+
+#include <stdint.h>
+#include "Configuration.hh"
+
+#ifdef SLICE_SCHEDULER
+
+#include "Types.hh"
+
+/// A cooperative scheduler for the main loop's slices.
+///
+/// Each slice is a task in a table, with a period, a deadline, a priority
+/// and a budget.  A task falls due a period after it last did, or on every
+/// pass of the main loop when its period is 0.  On each pass the tasks due
+/// are run highest priority first, each so long as its budget fits in what
+/// is left of the pass's SCHEDULER_PASS_MICROS; a task which does not fit
+/// waits for a later pass, unless it is its deadline past due, when it is
+/// run ahead of the rest.  The budgets keep the screen update and the
+/// heaters' slices off the same pass, as the hand staggering of
+/// runMotherboardSlice() did.
+///
+/// While the planner holds fewer than SCHEDULER_PLANNER_LOW blocks, the
+/// tasks which feed it are raised by SCHEDULER_BOOST; while it is full,
+/// the interface's tasks are.
+///
+/// Each task's runs, the time they took and its missed deadlines are kept
+/// and may be read, and cleared, with HOST_CMD_GET_TASK_STATS.
+namespace scheduler {
+
+enum TaskId {
+	TASK_HOST = 0,
+#ifdef SD_READ_AHEAD
+	TASK_SD_READ_AHEAD,
+#endif
+	TASK_COMMAND,
+	TASK_STEPPERS,
+	TASK_INTERFACE,
+	TASK_SCREEN,
+	TASK_MOTHERBOARD,
+	TASK_PLATFORM,
+#ifdef MODEL_REPLICATOR2
+	TASK_THERMOCOUPLE,
+#else
+	TASK_EXTRUDER_ONE,
+	TASK_EXTRUDER_TWO,
+#endif
+#ifdef PRINT_CHECKPOINT
+	TASK_CHECKPOINT,
+#endif
+	TASK_PIEZO,
+	TASKS
+};
+
+/// Microseconds the tasks run on one pass may take between them
+#define SCHEDULER_PASS_MICROS 2000
+
+/// Planner blocks below which the tasks which feed it are raised
+#define SCHEDULER_PLANNER_LOW 4
+
+/// Priority added to raised tasks
+#define SCHEDULER_BOOST 64
+
+/// Task flags
+#define TASK_FEEDS_PLANNER 0x01 ///< Raised while the planner runs low
+#define TASK_UI            0x02 ///< Raised while the planner is full
+
+struct Task {
+	void (*run)();
+	micros_t period;         ///< Microseconds between runs, or 0 for every pass
+	micros_t deadline;       ///< Microseconds after falling due a run must start
+	uint16_t budget;         ///< Microseconds a run is expected to take
+	uint8_t priority;        ///< Higher runs first
+	uint8_t flags;
+};
+
+struct TaskStats {
+	uint32_t runs;
+	uint32_t total;          ///< Microseconds taken by all runs
+	uint16_t longest;        ///< Microseconds taken by the longest run
+	uint16_t misses;         ///< Runs started after their deadline
+};
+
+/// Make every task due, and clear their statistics; call once the board's
+/// microseconds have been reset
+void reset();
+
+/// Run a pass of the main loop
+void runPass();
+
+/// Make a task next due some time from now, rather than a period after it
+/// last fell due; for a task to call as it runs
+/// \param[in] task Task
+/// \param[in] micros Microseconds from now
+void runIn(uint8_t task, micros_t micros);
+
+/// Get a task's statistics
+/// \param[in] task Task
+/// \param[out] stats Statistics
+/// \param[in] clear True to clear them once read
+/// \return False when there is no such task
+bool getStats(uint8_t task, TaskStats *stats, bool clear);
+
+}
+
+#endif // SLICE_SCHEDULER
+
+#endif // SCHEDULER_HH_
@@ -0,0 +1,51 @@
+#include "SliceProfile.hh"
+
+#ifdef SLICE_PROFILE
+
+#include <string.h>
+
+namespace profile {
+
+static Histogram histograms[SLICES];
+
+void reset() {
+	memset(histograms, 0, sizeof(histograms));
+}
+
+void record(uint8_t slice, micros_t micros) {
+	if ( slice >= SLICES )
+		return;
+	Histogram& h = histograms[slice];
+
+	uint16_t us = (micros > 0xffff) ? 0xffff : (uint16_t)micros;
+	if ( us > h.longest )
+		h.longest = us;
+
+	uint8_t bucket = 0;
+	for ( uint16_t t = us >> 4; t > 1 && bucket < PROFILE_BUCKETS - 1; t >>= 1 )
+		bucket++;
+	if ( h.counts[bucket] != 0xffff )
+		h.counts[bucket]++;
+}
+
+bool get(uint8_t slice, Histogram *histogram, bool clear) {
+	if ( slice >= SLICES )
+		return false;
+	*histogram = histograms[slice];
+	if ( clear )
+		memset(&histograms[slice], 0, sizeof(Histogram));
+	return true;
+}
+
+uint8_t worst(uint16_t *longest) {
+	uint8_t slice = 0;
+	for ( uint8_t i = 1; i < SLICE_LOOP; i++ )
+		if ( histograms[i].longest > histograms[slice].longest )
+			slice = i;
+	*longest = histograms[slice].longest;
+	return slice;
+}
+
+}
+
+#endif // SLICE_PROFILE
@@ -0,0 +1,73 @@
+#ifndef SLICE_PROFILE_HH_
+#define SLICE_PROFILE_HH_
+
+#include <stdint.h>
+#include "Configuration.hh"
+
+#ifdef SLICE_PROFILE
+
+#ifndef SLICE_SCHEDULER
+#error "SLICE_PROFILE needs SLICE_SCHEDULER, which times the slices"
+#endif
+
+#include "Types.hh"
+
+/// Histograms of the time the main loop's slices take.
+///
+/// The scheduler times every task it runs, and the planner its blocks, with
+/// Motherboard::getPreciseMicros(); each time is counted in its slice's
+/// histogram, whose buckets double in width: bucket 0 counts runs under
+/// 32 us, bucket n > 0 those of 2^(n+4) us up to twice that, and the last
+/// bucket everything longer.  The longest run is also kept.  The loop's
+/// own histogram counts the time from the start of one pass of the main
+/// loop to the next, which is what holds off the planner.
+///
+/// Counts stop at 65535.  HOST_CMD_GET_SLICE_PROFILE reads and clears a
+/// slice's histogram, and the monitor screen shows the slowest slice.
+namespace profile {
+
+enum Slice {
+	SLICE_HOST = 0,
+	SLICE_COMMAND,
+	SLICE_MOTHERBOARD,       ///< The board's own slice and the heaters'
+	SLICE_INTERFACE,         ///< Buttons, the screen and the LCD
+	SLICE_SD,                ///< SD card read-ahead
+	SLICE_PLANNER,           ///< Planning a block, within the command slice
+	SLICE_LOOP,              ///< A whole pass of the main loop
+	SLICES,
+	SLICE_NONE = 0xff        ///< Not profiled
+};
+
+/// Buckets in each histogram
+#define PROFILE_BUCKETS 12
+
+struct Histogram {
+	uint16_t counts[PROFILE_BUCKETS];
+	uint16_t longest;        ///< Microseconds, up to 65535
+};
+
+/// Clear every histogram
+void reset();
+
+/// Count a run of a slice
+/// \param[in] slice Slice, or SLICE_NONE
+/// \param[in] micros Microseconds it took
+void record(uint8_t slice, micros_t micros);
+
+/// Get a slice's histogram
+/// \param[in] slice Slice
+/// \param[out] histogram Histogram
+/// \param[in] clear True to clear it once read
+/// \return False when there is no such slice
+bool get(uint8_t slice, Histogram *histogram, bool clear);
+
+/// Find the slice with the longest run, leaving out the loop as a whole
+/// \param[out] longest Microseconds of its longest run
+/// \return Slice
+uint8_t worst(uint16_t *longest);
+
+}
+
+#endif // SLICE_PROFILE
+
+#endif // SLICE_PROFILE_HH_
@@ -102,6 +102,9 @@ FPTYPE		smallest_max_speed_change;
 FPTYPE		max_speed_change[STEPPER_COUNT];			//The speed between junctions in the planner, reduces blobbing
 FPTYPE		minimumPlannerSpeed;
 int		slowdown_limit;
+#ifdef VOLUMETRIC_FLOW_LIMIT
+FPTYPE		max_filament_speed[EXTRUDERS];
+#endif
 
 bool		disable_slowdown = true;
 uint32_t	axis_steps_per_sqr_second[STEPPER_COUNT];
@@ -137,6 +140,10 @@ static FPTYPE   prev_final_speed = 0;
 
 #ifdef SIMULATOR
 static block_t	*sblock = NULL;
+#ifdef VOLUMETRIC_FLOW_LIMIT
+uint32_t	simulator_flow_limited = 0;
+float		simulator_flow_limited_time = 0.0;
+#endif
 #endif
 
 bool		acceleration_zhold = true;
@@ -1260,6 +1267,28 @@ void plan_buffer_line(FPTYPE feed_rate, const uint32_t &dda_rate, const uint8_t
 				block->nominal_rate = (uint32_t)FPTOI(FPMULT2( ITOFP((int32_t)block->nominal_rate), speed_factor));
 			}
 		}
+
+		#ifdef VOLUMETRIC_FLOW_LIMIT
+			// Slow printing moves which would extrude faster than the hotend can melt.
+			// Retracts and primes are left alone, they draw no melt to speak of.
+			if ( block->use_accel && ! extruder_only_move ) {
+				FPTYPE speed_factor = KCONSTANT_1;
+				for (unsigned char i=0; i < EXTRUDERS; i++)
+					if ( max_filament_speed[i] != 0 && FPABS(current_speed[A_AXIS + i]) > max_filament_speed[i] )
+						speed_factor = min(speed_factor, FPDIV(max_filament_speed[i], FPABS(current_speed[A_AXIS + i])));
+				if ( speed_factor < KCONSTANT_1 ) {
+					#ifdef SIMULATOR
+						simulator_flow_limited++;
+						simulator_flow_limited_time += FPTOF(block->millimeters) / FPTOF(feed_rate) *
+							(1.0 / FPTOF(speed_factor) - 1.0);
+					#endif
+					for (unsigned char i=0; i < STEPPER_COUNT; i++)
+						current_speed[i] = FPMULT2(current_speed[i], speed_factor);
+					feed_rate = FPMULT2(feed_rate, speed_factor);
+					block->nominal_rate = (uint32_t)FPTOI(FPMULT2( ITOFP((int32_t)block->nominal_rate), speed_factor));
+				}
+			}
+		#endif
 	}
 
 	//For code clarity purposes, we add to the buffer and drop out here for accelerated blocks
@@ -286,6 +286,13 @@ extern uint32_t		planner_master_steps;
 extern uint8_t		planner_master_steps_index;
 extern int32_t		planner_steps[STEPPER_COUNT];
 extern int		slowdown_limit;
+#ifdef VOLUMETRIC_FLOW_LIMIT
+extern FPTYPE		max_filament_speed[EXTRUDERS];				//Fastest filament feed (mm/s) the hotend can melt, 0 for no limit
+#ifdef SIMULATOR
+extern uint32_t		simulator_flow_limited;					//Blocks slowed by the volumetric flow limit
+extern float		simulator_flow_limited_time;				//Seconds those blocks were lengthened by at nominal speed
+#endif
+#endif
 extern int32_t		planner_position[STEPPER_COUNT];
 extern int32_t		planner_target[STEPPER_COUNT];
 extern uint32_t		axis_accel_step_cutoff[STEPPER_COUNT];
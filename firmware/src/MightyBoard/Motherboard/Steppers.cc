@@ -59,6 +59,21 @@
 
 #endif
 
+#ifdef SLICE_PROFILE
+#include "Motherboard.hh"
+#include "SliceProfile.hh"
+
+// plan_buffer_line(), counted in the planner's histogram
+#define PLAN_BUFFER_LINE(...) do {					\
+	micros_t began = Motherboard::getBoard().getPreciseMicros();	\
+	plan_buffer_line(__VA_ARGS__);					\
+	profile::record(profile::SLICE_PLANNER,				\
+			Motherboard::getBoard().getPreciseMicros() - began); \
+	} while (0)
+#else
+#define PLAN_BUFFER_LINE(...) plan_buffer_line(__VA_ARGS__)
+#endif
+
 #ifdef DEBUG_ONSCREEN
 	volatile float debug_onscreen1 = 0.0, debug_onscreen2 = 0.0;
 #endif
@@ -518,6 +533,17 @@ void reset() {
 	}
 	else	slowdown_limit = 0;	
 
+#ifdef VOLUMETRIC_FLOW_LIMIT
+	//Fastest each extruder may feed filament, from the most its hotend can melt
+	for ( uint8_t i = 0; i < EXTRUDERS; i ++ ) {
+		float flow     = (float)eeprom::getEeprom16(AC2_2(MAX_VOLUMETRIC_FLOW, i), DEFAULT_MAX_VOLUMETRIC_FLOW) / 10.0;
+		float diameter = (float)eeprom::getEeprom16(eeprom_offsets::FILAMENT_DIAMETER + sizeof(uint16_t) * i,
+							    DEFAULT_FILAMENT_DIAMETER) / 100.0;
+		max_filament_speed[i] = ( flow > 0.0 && diameter > 0.0 ) ?
+			FTOFP(flow / (0.7853982 * diameter * diameter)) : 0;	// pi / 4 * d^2
+	}
+#endif
+
 	//Clockwise extruder
 	extrude_when_negative[0] = ACCELERATION_EXTRUDE_WHEN_NEGATIVE_A;
 	extrude_when_negative[1] = ACCELERATION_EXTRUDE_WHEN_NEGATIVE_B;
@@ -738,7 +764,7 @@ void setTargetNew(const Point& target, int32_t dda_interval, int32_t us, uint8_t
 	//dda_rate is the number of dda steps per second for the master axis
 	uint32_t dda_rate = (uint32_t)(1000000 / dda_interval);
 
-	plan_buffer_line(0, dda_rate, toolIndex, false, toolIndex);
+	PLAN_BUFFER_LINE(0, dda_rate, toolIndex, false, toolIndex);
 
 	if ( movesplanned() >=  plannerMaxBufferSize)      is_running = true;
 	else                                               is_running = false;
@@ -847,7 +873,7 @@ void setTargetNewExt(const Point& target, int32_t dda_rate, uint8_t relative, fl
 		}
 	}
 
-	plan_buffer_line(feedrate, dda_rate, toolIndex, 
+	PLAN_BUFFER_LINE(feedrate, dda_rate, toolIndex,
 			 acceleration && segmentAccelState, toolIndex);
 
 	if ( movesplanned() >=  plannerMaxBufferSize)      is_running = true;
@@ -21,6 +21,9 @@
 #include "CoolingFan.hh"
 #include "Eeprom.hh"
 #include "EepromMap.hh"
+#ifdef PWM_OUTPUTS
+#include "PwmOutputs.hh"
+#endif
 #include <avr/interrupt.h>
 #include <util/atomic.h>
 #include <avr/sfr_defs.h>
@@ -33,7 +36,11 @@ ExtruderBoard::ExtruderBoard(uint8_t slave_id_in, Pin HeaterPin_In, Pin FanPin_I
      		extruder_element(slave_id_in),
      		extruder_heater(extruder_thermocouple,extruder_element,SAMPLE_INTERVAL_MICROS_THERMOCOUPLE,
 				(eeprom_base+ toolhead_eeprom_offsets::EXTRUDER_PID_BASE), true, slave_id_in),
+#ifdef PWM_OUTPUTS
+      		coolingFan(extruder_heater, (eeprom_base + toolhead_eeprom_offsets::COOLING_FAN_SETTINGS), pwm::TOOL0_FAN + slave_id_in),
+#else
       		coolingFan(extruder_heater, (eeprom_base + toolhead_eeprom_offsets::COOLING_FAN_SETTINGS), FanPin_In),
+#endif
       		slave_id(slave_id_in),
       		Heater_Pin(HeaterPin_In),
 		eeprom_base((uint8_t*)eeprom_base),
@@ -98,7 +105,9 @@ ExtruderHeatingElement::ExtruderHeatingElement(uint8_t id):
 }
 
 void ExtruderHeatingElement::setHeatingElement(uint8_t value) {
-	
+#ifdef PWM_OUTPUTS
+	pwm::set(pwm::TOOL0_HEATER + heater_id, value);
+#else
     
   	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
 	   if(heater_id == 0)
@@ -125,6 +134,7 @@ void ExtruderHeatingElement::setHeatingElement(uint8_t value) {
 			}
 		}
 	}
+#endif
 }
 
 
@@ -80,6 +80,33 @@
 
 // --- Host UART configuration ---
 // The host UART is presumed to always be present on the RX/TX lines.
+// Number of host packets which may be in flight at once.  Each costs
+// a packet's worth of SRAM.
+#if defined(__AVR_ATmega2560__)
+#define HOST_RX_PACKETS 4
+#else
+#define HOST_RX_PACKETS 1
+#endif
+// Largest payload of a HOST_CMD_BATCH packet.  Every packet buffer grows
+// to this size.  When not defined, batches are not supported.
+#if defined(__AVR_ATmega2560__)
+#define HOST_BATCH_PAYLOAD 96
+#endif
+// Bytes buffered between the host UART receive interrupt and the packet
+// decoder: a power of two, holding at least HOST_RX_PACKETS full packets.
+// When not defined, the interrupt decodes packets itself.
+#if defined(__AVR_ATmega2560__)
+#define HOST_RX_RING 512
+#endif
+// Allow the host to raise the baud rate with HOST_CMD_SET_BAUD
+#if defined(__AVR_ATmega2560__)
+#define HOST_BAUD_SWITCH
+#endif
+// Send telemetry frames when the host asks with HOST_CMD_SET_TELEMETRY.
+// Frames are longer than MAX_PACKET_PAYLOAD and so need HOST_BATCH_PAYLOAD.
+#if defined(__AVR_ATmega2560__)
+#define HOST_TELEMETRY
+#endif
 
 // --- Piezo Buzzer configuration ---
 // Define as 1 if the piezo buzzer is present, 0 if not.
@@ -195,6 +222,14 @@
 #define LCD_CLK			Pin(PortC,1)
 #define LCD_DATA		Pin(PortC,0)
 
+// The same pins for direct port access, with LCD_QUEUE
+#define LCD_STROBE_PORT		PORTC
+#define LCD_STROBE_BIT		3
+#define LCD_CLK_PORT		PORTC
+#define LCD_CLK_BIT		1
+#define LCD_DATA_PORT		PORTC
+#define LCD_DATA_BIT		0
+
 /// This is the pin mapping for the interface board. Because of the relatively
 /// high cost of using the pins in a direct manner, we will instead read the
 /// buttons directly by scanning their ports. If any of these definitions are
@@ -234,6 +269,14 @@
 #define THERMOCOUPLE_SCK       Pin(PortE,2)
 #define THERMOCOUPLE_DO        Pin(PortH,2)
 
+// The same pins for direct port access, with THERMOCOUPLE_DIRECT_IO
+#define THERMOCOUPLE_DI_PIN    PINE
+#define THERMOCOUPLE_DI_BIT    7
+#define THERMOCOUPLE_SCK_PORT  PORTE
+#define THERMOCOUPLE_SCK_BIT   2
+#define THERMOCOUPLE_DO_PORT   PORTH
+#define THERMOCOUPLE_DO_BIT    2
+
 #define DEFAULT_THERMOCOUPLE_VAL	1024
 
 /// POWER Pins for extruders, fans and heated build platform
@@ -247,6 +290,19 @@
 #define EX_FAN                  Pin(PortG,5)
 #define EXTRA_FET               EX_FAN
 
+/// Outputs driven by PwmOutputs.hh, and the timer compare channel of each
+/// which has one free, as its output compare register, control register and
+/// compare output mode bit.  Those without are software PWM'd; timer 4 is
+/// the piezo's
+#define PWM_TOOL0_HEATER        EXA_PWR
+#define PWM_TOOL0_HEATER_OC     OCR3C, TCCR3A, COM3C1
+#define PWM_TOOL1_HEATER        EXB_PWR
+#define PWM_TOOL1_HEATER_OC     OCR3A, TCCR3A, COM3A1
+#define PWM_TOOL0_FAN           EXA_FAN
+#define PWM_TOOL1_FAN           EXB_FAN
+#define PWM_TOOL1_FAN_OC        OCR3B, TCCR3A, COM3B1
+#define PWM_PLATFORM_HEATER     HBP_HEAT
+
 // sample intervals for heaters
 #define SAMPLE_INTERVAL_MICROS_THERMISTOR    (250L * 1000L)
 
@@ -263,6 +319,12 @@
 
 #define SAMPLE_INTERVAL_MICROS_THERMOCOUPLE (250L * 1000L)
 
+// Sample the platform thermistor continuously from the ADC's interrupt,
+// decimating this many samples into each 12 bit reading
+#if defined(__AVR_ATmega2560__)
+#define ADC_OVERSAMPLE 64
+#endif
+
 // bot shuts down printers after a defined timeout 
 #define USER_INPUT_TIMEOUT		1800000000 // 30 minutes
 
@@ -453,10 +515,123 @@
 #define SD_RAW_SDHC 1
 #endif
 
+// Read SD card files being printed with multi-block reads
+#if defined(__AVR_ATmega2560__)
+#define SD_RAW_STREAM_READS 1
+#endif
+
+// Clock SDHC cards at up to f_OSC / 4 rather than f_OSC / 16, when SD
+// card CRC checking is turned on
+#if defined(__AVR_ATmega2560__)
+#define SD_RAW_FAST_SPI 1
+#endif
+
+// Number of runs of contiguous clusters kept for the open file, so
+// that its cluster chain need not be read from the FAT as it is read
+#if defined(__AVR_ATmega2560__)
+#define FAT_EXTENT_COUNT 8
+#endif
+
+// Index the SD card folder listed by the LCD menu, so that scrolling
+// through it need not read the folder from its start for each line
+#if defined(__AVR_ATmega2560__)
+#define SD_DIR_INDEX
+#endif
+
+// Bytes of a file being captured to SD card to gather before writing them
+// out, and clusters to allocate at once as the file grows
+#if defined(__AVR_ATmega2560__)
+#define SD_CAPTURE_BUFFER 512
+#define FAT_WRITE_EXTENT 16
+#endif
+
+// Bytes of a file being played back from SD card to read ahead into each of
+// two buffers, and bytes which may be clocked over SPI towards the next card
+// block each time through the main loop
+#if defined(__AVR_ATmega2560__)
+#define SD_READ_AHEAD 128
+#define SD_READ_AHEAD_BUDGET 128
+#endif
+
 // When defined, the ability to write an SD card file over S3G is supported
 //#define S3G_CAPTURE_2_SD
 
 // When defined, VREF for the Z axis may be set above 40
 //#define DIGI_POT_HIGH_Z_VREF
 
+// When defined, SD card builds are periodically checkpointed to EEPROM
+// and may be resumed after a power failure from the main menu
+#if defined(__AVR_ATmega2560__)
+#define PRINT_CHECKPOINT
+#endif
+
+// When defined, a heater's PID may be tuned by relay feedback from the
+// utilities menu or with HOST_CMD_AUTOTUNE, and the gains saved to EEPROM
+#if defined(__AVR_ATmega2560__)
+#define PID_AUTOTUNE
+#endif
+
+// When defined, preheating holds back the heaters which would reach their
+// setpoints first, so that all finish together, and learns each heater's
+// heat up in EEPROM
+#if defined(__AVR_ATmega2560__)
+#define PREHEAT_SCHEDULER
+#endif
+
+// When defined, the hotend heaters are given the extra output the queued
+// moves' extrusion will draw, ahead of the nozzle cooling
+#if defined(__AVR_ATmega2560__)
+#define EXTRUSION_FEEDFORWARD
+#endif
+
+// When defined, printing moves are slowed to the most filament each
+// hotend can melt, as set in EEPROM
+#if defined(__AVR_ATmega2560__)
+#define VOLUMETRIC_FLOW_LIMIT
+#endif
+
+// When defined, the ADS1118 thermocouple ADC is clocked through direct port
+// access rather than Pin, and each read is spread over three slices: the
+// ADC bits, the config readback, then the conversion
+#if defined(__AVR_ATmega2560__)
+#define THERMOCOUPLE_DIRECT_IO
+#endif
+
+// When defined, the heaters and the extruders' cooling fans are driven
+// through PwmOutputs.hh, by timer compare channels where their pins have
+// them and by a shared software PWM otherwise, and the cooling fans' speed
+// follows the extruder temperature
+#if defined(__AVR_ATmega2560__)
+#define PWM_OUTPUTS
+#endif
+
+// When defined, screens draw into a framebuffer in RAM, and only the
+// characters which change are sent to the LCD, a few on each main loop
+#if defined(__AVR_ATmega2560__)
+#define LCD_FRAMEBUFFER
+#endif
+
+// When defined, what is sent to the LCD is queued, and sent a step at a
+// time by the microsecond timer's interrupt, so that the main loop never
+// waits on the LCD.  The interrupt drives the shift register only: I2C
+// LCDs are deliberately left out, as the TWI transfers would need their
+// own interrupt driven driver, and are still written directly
+#if defined(__AVR_ATmega2560__) && !defined(HAS_I2C_LCD)
+#define LCD_QUEUE
+#endif
+
+// When defined, the main loop's slices are run by a table driven scheduler,
+// by period, deadline and priority within a budget for each pass, rather
+// than in turn with their work staggered by hand
+#if defined(__AVR_ATmega2560__)
+#define SLICE_SCHEDULER
+#endif
+
+// When defined, the time each slice of the main loop takes is counted in
+// histograms, which the host may read and the monitor screen shows the
+// worst of; needs SLICE_SCHEDULER
+#if defined(__AVR_ATmega2560__)
+#define SLICE_PROFILE
+#endif
+
 #endif // BOARDS_MBV40_CONFIGURATION_HH_
@@ -25,6 +25,26 @@
 #include "Configuration.hh"
 #include "TemperatureTable.hh"
 
+#ifdef THERMOCOUPLE_DIRECT_IO
+#include <util/atomic.h>
+
+// The pins are fixed, so they are driven through their ports rather than
+// through Pin, which costs a call and a pointer chase for every edge.
+// PORTE and PINE are in the low I/O space, so SCK and DI are single sbi /
+// cbi / sbic instructions.  PORTH is not: DO is a load, OR or AND, and
+// store, and the microsecond timer's interrupt drives the software PWM
+// pins on PORTH, so the new byte is written with interrupts held off
+#define TC_SCK_HIGH()	THERMOCOUPLE_SCK_PORT |= _BV(THERMOCOUPLE_SCK_BIT)
+#define TC_SCK_LOW()	THERMOCOUPLE_SCK_PORT &= ~_BV(THERMOCOUPLE_SCK_BIT)
+#define TC_DO_SET(high)							\
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {				\
+		uint8_t port = THERMOCOUPLE_DO_PORT;			\
+		THERMOCOUPLE_DO_PORT = (high) ? (port | _BV(THERMOCOUPLE_DO_BIT)) : \
+			(port & ~_BV(THERMOCOUPLE_DO_BIT));		\
+	}
+#define TC_DI_READ()	(THERMOCOUPLE_DI_PIN & _BV(THERMOCOUPLE_DI_BIT))
+#endif
+
 /*
  * Thermocouple Reader Constructor
  * Create a new thermocouple instance, and attach it to the given pins.
@@ -102,6 +122,10 @@ void ThermocoupleReader::init() {
 #ifdef COLDJUNCTION
 	cold_comp = 0;
 #endif	
+#ifdef THERMOCOUPLE_DIRECT_IO
+	read_phase = PHASE_DATA;
+	pending_raw = 0;
+#endif
 	cs_pin.setValue(false);   // chip select hold low
 	sck_pin.setValue(false);  // Clock select is active low
 
@@ -123,41 +147,60 @@ void ThermocoupleReader::initConfig()
 	read_state = CHANNEL_ONE;
 	temp_check_counter = TEMP_CHECK_COUNT;
 	
-	uint16_t config = channel_one_config;
+	// send the config register; we don't care about the slave data here
+	transfer(channel_one_config);
 	
-	uint16_t config_reg = 0;
+	// read back the config reg
+	/// we could check here to make sure the config data has been read correctly
+	transfer(0);
 	
-	// send the config register 
-	for (int i = 0; i < 16; i++) {
-		
-		// shift out config register data
-		do_pin.setValue((config & 0b01) != 0);
-		config >>= 1;
-		
-		sck_pin.setValue(true);
-		// we don't care about the slave data here
-		sck_pin.setValue(false);
+	sck_pin.setValue(false);
+
+}
+
+#ifdef THERMOCOUPLE_DIRECT_IO
+
+uint16_t ThermocoupleReader::transfer(uint16_t out)
+{
+	uint16_t in = 0;
+
+	for (uint8_t i = 0; i < 16; i++) {
+		TC_DO_SET(out & 0x01);
+		out >>= 1;
+
+		// DOUT is valid within 50 ns of the rising edge, and the
+		// shift puts more than that between the edge and the read
+		TC_SCK_HIGH();
+		in <<= 1;
+		if (TC_DI_READ()) in |= 0x01;
+		TC_SCK_LOW();
 	}
-	
-	// read back the config reg
+	return in;
+}
+
+#else
+
+uint16_t ThermocoupleReader::transfer(uint16_t out)
+{
+	uint16_t in = 0;
+
 	for (int i = 0; i < 16; i++) {
 		
-		// shift out dummy data
-		do_pin.setValue(false);
+		// shift out data
+		do_pin.setValue((out & 0b01) != 0);
+		out >>= 1;
 		
 		sck_pin.setValue(true);
-		config_reg = config_reg << 1;
-		if (di_pin.getValue()) { config_reg = config_reg | 0x01; }
+		in = in << 1;
+		if (di_pin.getValue()) { in = in | 0x01; }
 
 		sck_pin.setValue(false);
 	}
-	
-	/// we could check here to make sure the config data has been read correctly
-	
-	sck_pin.setValue(false);
-
+	return in;
 }
 
+#endif
+
 
 /*
  * Get temperature read
@@ -189,12 +232,36 @@ static float ColdReadToCelsius(int16_t adc)
  */
 bool ThermocoupleReader::update() {
 
+#ifdef THERMOCOUPLE_DIRECT_IO
+	// Take the next step of a read begun by an earlier call.  The caller
+	// tries again on the next pass, well inside the 28 ms the ADS1118
+	// lets SCK idle low before it resets its interface
+	switch ( read_phase ) {
+	case PHASE_CONFIG:
+		// read back the config reg
+		transfer(0);
+		read_phase = PHASE_CONVERT;
+		return false;
+	case PHASE_CONVERT:
+		read_phase = PHASE_DATA;
+		store(pending_raw);
+		return true;
+	default:
+		break;
+	}
+
+	// check that data ready flag is low
+	// if it is high, return false so the calling function knows to try again
+	if ( TC_DI_READ() )
+		return false;
+#else
 	sck_pin.setValue(false);
 	
 	// check that data ready flag is low
 	// if it is high, return false so the calling function knows to try again
 	if ( di_pin.getValue() )
 		return false;
+#endif
 		
 	uint16_t config = 0;
 		
@@ -211,9 +278,6 @@ bool ThermocoupleReader::update() {
 			break;
 	}
 	
-	uint16_t config_reg = 0;
-	uint16_t raw = 0;
-	
 	/// the ADS1118 uses bidirection SPI communication
 	/// the sensor returns 4 bytes of data per read.  the first two bytes are the 
 	/// ADC bits.  the second two bytes are the config register bits
@@ -221,34 +285,34 @@ bool ThermocoupleReader::update() {
 	/// two bytes and sends dummy data for the second two bytes
 	
 	// read the temperature register
-	for (int i = 0; i < 16; i++) {
-		
-		// shift out config register data
-		do_pin.setValue((config & 0b01) != 0);
-		config >>= 1;
-		
-		sck_pin.setValue(true);
-		raw = raw << 1;
-		if (di_pin.getValue()) {raw = raw | 0x01; }
+	uint16_t raw = transfer(config);
 
-		sck_pin.setValue(false);
-	}
-	
+#ifdef THERMOCOUPLE_DIRECT_IO
+	// leave the config readback and the conversion to the next calls
+	pending_raw = raw;
+	read_phase = PHASE_CONFIG;
+	return false;
+#else
 	// read back the config reg
-	for (int i = 0; i < 16; i++) {
-		
-		// shift out dummy data
-		do_pin.setValue(false);
-		
-		sck_pin.setValue(true);
-		config_reg = config_reg << 1;
-		if (di_pin.getValue()) { config_reg = config_reg | 0x01; }
+	transfer(0);
 
-		sck_pin.setValue(false);
-	}
-	
 	sck_pin.setValue(false);
 
+	store(raw);
+	
+	// return true when temperature update is successful
+	return true;
+#endif
+}
+
+/*
+ * Convert and store a read, and choose the channel to read next
+ * 
+ * @param [in] raw  ADC bits read for the channel in read_state
+ * 
+ */
+void ThermocoupleReader::store(uint16_t raw) {
+
 	float temp;
 	/// store read to the temperature variable
 	switch(read_state){
@@ -326,7 +390,4 @@ bool ThermocoupleReader::update() {
 			config_state = CHANNEL_ONE; 
 			break;
 	}	
-	
-	// return true when temperature update is successful
-	return true;
 }
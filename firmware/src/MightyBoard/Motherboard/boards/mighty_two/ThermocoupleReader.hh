@@ -22,6 +22,7 @@
 #ifndef THERMOCOUPLE_READER_HH_
 #define THERMOCOUPLE_READER_HH_
 
+#include "Configuration.hh"
 #include "Pin.hh"
 #include "TemperatureSensor.hh"
 
@@ -108,6 +109,26 @@ private:
 
         uint16_t last_temp_updated;
 
+#ifdef THERMOCOUPLE_DIRECT_IO
+        /// Where update() is in a read, each step taken by its own call
+        enum read_phases {
+                PHASE_DATA = 0,   ///< waiting to clock in the ADC bits
+                PHASE_CONFIG,     ///< waiting to clock in the config readback
+                PHASE_CONVERT     ///< waiting to convert the ADC bits
+        };
+
+        uint8_t read_phase;     ///< #read_phases
+        uint16_t pending_raw;   ///< the ADC bits clocked in
+#endif
+
+        /// Clock one 16 bit half of a transfer: out is sent least significant bit
+        /// first and the bits received are returned most significant bit first
+        uint16_t transfer(uint16_t out);
+
+        /// Convert and store a read of the channel in read_state, then move
+        /// on to the next channel
+        void store(uint16_t raw);
+
 public:
         /// Create a new thermocouple instance, and attach it to the given pins.
         /// \param [in] do_p Data Out: MOSI (output).
@@ -119,6 +140,11 @@ public:
 	void init();
 	void initConfig();
 
+	/// Read the ADC, once it has a conversion ready.  With
+	/// THERMOCOUPLE_DIRECT_IO, the read is split over three calls: one
+	/// clocks in the ADC bits, the next the config readback, and the last
+	/// converts, so that no call holds up the slice for more than 16 bits.
+	/// \return true when a channel's temperature has been updated
 	bool update();
 
 	uint8_t getLastUpdated() { return last_temp_updated; }
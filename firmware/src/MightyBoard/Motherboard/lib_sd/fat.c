@@ -164,6 +164,16 @@ struct fat_fs_struct
     cluster_t cluster_free;
 };
 
+#if FAT_EXTENT_COUNT
+struct fat_extent_struct
+{
+    /* index within the file of the run's first cluster */
+    cluster_t index;
+    cluster_t cluster;
+    cluster_t count;
+};
+#endif
+
 struct fat_file_struct
 {
     struct fat_fs_struct* fs;
@@ -173,6 +183,20 @@ struct fat_file_struct
 #ifdef FAT_DELAY_DIRENTRY_UPDATE
     uint8_t needs_write;
 #endif
+#if FAT_EXTENT_COUNT
+    /* runs of contiguous clusters, from some point of the chain on */
+    struct fat_extent_struct extents[FAT_EXTENT_COUNT];
+    /* number of runs cached, 0 when the cache is not in use */
+    uint8_t extent_count;
+    /* the run holding pos_cluster */
+    uint8_t extent_pos;
+    /* whether the last run cached ends the chain */
+    uint8_t extent_last;
+#endif
+#if FAT_WRITE_SUPPORT && FAT_WRITE_EXTENT > 1
+    /* whether the chain may hold clusters beyond the end of the file */
+    uint8_t surplus;
+#endif
 };
 
 struct fat_dir_struct
@@ -208,6 +232,12 @@ static struct fat_dir_struct fat_dir_handles[FAT_DIR_COUNT];
 static uint8_t fat_read_header(struct fat_fs_struct* fs);
 static cluster_t fat_get_next_cluster(const struct fat_fs_struct* fs, cluster_t cluster_num);
 static offset_t fat_cluster_offset(const struct fat_fs_struct* fs, cluster_t cluster_num);
+#if FAT_EXTENT_COUNT
+static uint8_t fat_fill_extents(struct fat_file_struct* fd, cluster_t index, cluster_t cluster_num);
+static uint8_t fat_fill_next_extents(struct fat_file_struct* fd);
+static cluster_t fat_get_file_cluster(struct fat_file_struct* fd, cluster_t index);
+static cluster_t fat_next_file_cluster(struct fat_file_struct* fd, cluster_t cluster_num);
+#endif
 static uint8_t fat_dir_entry_read_callback(uint8_t* buffer, offset_t offset, void* p);
 #if FAT_LFN_SUPPORT
 static uint8_t fat_calc_83_checksum(const uint8_t* file_name_83);
@@ -395,6 +425,16 @@ uint8_t fat_read_header(struct fat_fs_struct* fs)
     }
 #endif
 
+    /* clusters of 64 kB and more, as large SDXC cards may be
+     * formatted with, overflow the 16-bit cluster size
+     */
+    if(sectors_per_cluster == 0 ||
+       (uint32_t) bytes_per_sector * sectors_per_cluster > 0x8000)
+    {
+        fat_errno = FAT_ERR_BADCLUSTERSIZE;
+        return 0;
+    }
+
     /* determine the type of FAT we have here */
     uint32_t data_sector_count = sector_count
                                  - reserved_sectors
@@ -539,6 +579,9 @@ cluster_t fat_get_next_cluster(const struct fat_fs_struct* fs, cluster_t cluster
  *
  * Set cluster_num to zero to create a completely new one.
  *
+ * The new clusters are chained in ascending order, so that clusters
+ * found free side by side are read back as a contiguous run.
+ *
  * \param[in] fs The file system on which to operate.
  * \param[in] cluster_num The cluster to which to append the new chain.
  * \param[in] count The number of clusters to allocate.
@@ -557,7 +600,8 @@ cluster_t fat_append_clusters(struct fat_fs_struct* fs, cluster_t cluster_num, c
     offset_t fat_offset = fs->header.fat_offset;
     cluster_t count_left = count;
     cluster_t cluster_current = fs->cluster_free;
-    cluster_t cluster_next = 0;
+    cluster_t cluster_first = 0;
+    cluster_t cluster_last = 0;
     cluster_t cluster_count;
     uint16_t fat_entry16;
 #if FAT_FAT32_SUPPORT
@@ -612,14 +656,16 @@ cluster_t fat_append_clusters(struct fat_fs_struct* fs, cluster_t cluster_num, c
                 break;
             }
 
-            /* allocate cluster */
-            if(cluster_next == 0)
-                fat_entry32 = HTOL32(FAT32_CLUSTER_LAST_MAX);
-            else
-                fat_entry32 = htol32(cluster_next);
-
+            /* allocate cluster as the end of the new chain */
+            fat_entry32 = HTOL32(FAT32_CLUSTER_LAST_MAX);
             if(!device_write(fat_offset + (offset_t) cluster_current * sizeof(fat_entry32), (uint8_t*) &fat_entry32, sizeof(fat_entry32)))
                 break;
+
+            /* and link the cluster allocated before it to it */
+            fat_entry32 = htol32(cluster_current);
+            if(cluster_last &&
+               !device_write(fat_offset + (offset_t) cluster_last * sizeof(fat_entry32), (uint8_t*) &fat_entry32, sizeof(fat_entry32)))
+                break;
         }
         else
 #endif
@@ -638,17 +684,21 @@ cluster_t fat_append_clusters(struct fat_fs_struct* fs, cluster_t cluster_num, c
                 break;
             }
 
-            /* allocate cluster */
-            if(cluster_next == 0)
-                fat_entry16 = HTOL16(FAT16_CLUSTER_LAST_MAX);
-            else
-                fat_entry16 = htol16((uint16_t) cluster_next);
-
+            /* allocate cluster as the end of the new chain */
+            fat_entry16 = HTOL16(FAT16_CLUSTER_LAST_MAX);
             if(!device_write(fat_offset + (offset_t) cluster_current * sizeof(fat_entry16), (uint8_t*) &fat_entry16, sizeof(fat_entry16)))
                 break;
+
+            /* and link the cluster allocated before it to it */
+            fat_entry16 = htol16((uint16_t) cluster_current);
+            if(cluster_last &&
+               !device_write(fat_offset + (offset_t) cluster_last * sizeof(fat_entry16), (uint8_t*) &fat_entry16, sizeof(fat_entry16)))
+                break;
         }
 
-        cluster_next = cluster_current;
+        if(!cluster_first)
+            cluster_first = cluster_current;
+        cluster_last = cluster_current;
         --count_left;
     }
 
@@ -665,7 +715,7 @@ cluster_t fat_append_clusters(struct fat_fs_struct* fs, cluster_t cluster_num, c
 #if FAT_FAT32_SUPPORT
             if(is_fat32)
             {
-                fat_entry32 = htol32(cluster_next);
+                fat_entry32 = htol32(cluster_first);
 
                 if(!device_write(fat_offset + (offset_t) cluster_num * sizeof(fat_entry32), (uint8_t*) &fat_entry32, sizeof(fat_entry32)))
                     break;
@@ -673,21 +723,21 @@ cluster_t fat_append_clusters(struct fat_fs_struct* fs, cluster_t cluster_num, c
             else
 #endif
             {
-                fat_entry16 = htol16((uint16_t) cluster_next);
+                fat_entry16 = htol16((uint16_t) cluster_first);
 
                 if(!device_write(fat_offset + (offset_t) cluster_num * sizeof(fat_entry16), (uint8_t*) &fat_entry16, sizeof(fat_entry16)))
                     break;
             }
         }
 
-        return cluster_next;
+        return cluster_first;
 
     } while(0);
 
     /* No space left on device or writing error.
      * Free up all clusters already allocated.
      */
-    fat_free_clusters(fs, cluster_next);
+    fat_free_clusters(fs, cluster_first);
 
     return 0;
 }
@@ -744,9 +794,11 @@ uint8_t fat_free_clusters(struct fat_fs_struct* fs, cluster_t cluster_num)
                 cluster_num_next = 0;
 
             /* We know we will free the cluster, so remember it as
-             * free for the next allocation.
+             * free for the next allocation.  A hint beyond it is moved
+             * back, so that clusters allocated ahead of a file and then
+             * trimmed are reused rather than skipped.
              */
-            if(!fs->cluster_free)
+            if(!fs->cluster_free || cluster_num < fs->cluster_free)
                 fs->cluster_free = cluster_num;
 
             /* free cluster */
@@ -786,6 +838,10 @@ uint8_t fat_free_clusters(struct fat_fs_struct* fs, cluster_t cluster_num)
             if(cluster_num_next >= FAT16_CLUSTER_LAST_MIN && cluster_num_next <= FAT16_CLUSTER_LAST_MAX)
                 cluster_num_next = 0;
 
+            /* remember the cluster as free for the next allocation */
+            if(!fs->cluster_free || cluster_num < fs->cluster_free)
+                fs->cluster_free = cluster_num;
+
             /* free cluster */
             fat_entry = HTOL16(FAT16_CLUSTER_FREE);
             fs->partition->device_write(fat_offset + (offset_t) cluster_num * sizeof(fat_entry), (uint8_t*) &fat_entry, sizeof(fat_entry));
@@ -1022,6 +1078,15 @@ struct fat_file_struct* fat_open_file(struct fat_fs_struct* fs, const struct fat
 #if FAT_DELAY_DIRENTRY_UPDATE
     fd->needs_write = 0;
 #endif
+#if FAT_WRITE_SUPPORT && FAT_WRITE_EXTENT > 1
+    fd->surplus = 0;
+#endif
+#if FAT_EXTENT_COUNT
+    /* find the runs of clusters now rather than on reading */
+    fd->extent_count = 0;
+    if(fd->pos_cluster)
+        fat_fill_extents(fd, 0, fd->pos_cluster);
+#endif
 
     return fd;
 }
@@ -1037,6 +1102,18 @@ void fat_close_file(struct fat_file_struct* fd)
 {
     if(fd)
     {
+#if FAT_WRITE_SUPPORT && FAT_WRITE_EXTENT > 1
+        if(fd->surplus)
+        {
+            /* free the clusters allocated but not written to; this
+             * also writes the directory entry
+             */
+            fat_resize_file(fd, fd->dir_entry.file_size);
+#if FAT_DELAY_DIRENTRY_UPDATE
+            fd->needs_write = 0;
+#endif
+        }
+#endif
 #if FAT_DELAY_DIRENTRY_UPDATE
         /* write directory entry */
 	if (fd->needs_write)
@@ -1101,6 +1178,16 @@ intptr_t fat_read_file(struct fat_file_struct* fd, uint8_t* buffer, uintptr_t bu
 	    }
         }
 
+#if FAT_EXTENT_COUNT
+        if(fd->extent_count)
+        {
+            /* look the cluster up among the runs cached */
+            cluster_num = fat_get_file_cluster(fd, (uint32_t) fd->pos / cluster_size);
+            if(!cluster_num)
+                return -1;
+        }
+        else
+#endif
         if(fd->pos)
         {
             uint32_t pos = fd->pos;
@@ -1146,7 +1233,14 @@ intptr_t fat_read_file(struct fat_file_struct* fd, uint8_t* buffer, uintptr_t bu
         if(first_cluster_offset + copy_length >= cluster_size)
         {
             /* we are on a cluster boundary, so get the next cluster */
-            if((cluster_num = fat_get_next_cluster(fd->fs, cluster_num)))
+#if FAT_EXTENT_COUNT
+            if(fd->extent_count)
+                cluster_num = fat_next_file_cluster(fd, cluster_num);
+            else
+#endif
+                cluster_num = fat_get_next_cluster(fd->fs, cluster_num);
+
+            if(cluster_num)
             {
                 first_cluster_offset = 0;
             }
@@ -1164,6 +1258,167 @@ intptr_t fat_read_file(struct fat_file_struct* fd, uint8_t* buffer, uintptr_t bu
     return buffer_len;
 }
 
+#if DOXYGEN || FAT_EXTENT_COUNT
+/**
+ * \ingroup fat_file
+ * Caches the runs of contiguous clusters of a file.
+ *
+ * The cluster chain is followed from the given cluster until it ends
+ * or FAT_EXTENT_COUNT runs have been found.  So a contiguous file is
+ * cached whole, and a fragmented one FAT_EXTENT_COUNT runs at a time.
+ *
+ * \param[in] fd The file whose clusters to cache.
+ * \param[in] index The index within the file of the given cluster.
+ * \param[in] cluster_num The cluster from which to start.
+ * \returns 0 on failure, 1 on success.
+ */
+uint8_t fat_fill_extents(struct fat_file_struct* fd, cluster_t index, cluster_t cluster_num)
+{
+    struct fat_extent_struct* extent = fd->extents;
+
+    fd->extent_count = 1;
+    fd->extent_pos = 0;
+    fd->extent_last = 0;
+    extent->index = index;
+    extent->cluster = cluster_num;
+    extent->count = 1;
+
+    while(1)
+    {
+        cluster_t cluster_next = fat_get_next_cluster(fd->fs, cluster_num);
+        if(!cluster_next)
+        {
+            /* the end of the chain, unless the fat could not be read */
+            if(fat_errno != FAT_ERR_BAD)
+            {
+                fd->extent_count = 0;
+                return 0;
+            }
+            fd->extent_last = 1;
+            return 1;
+        }
+
+        if(cluster_next == cluster_num + 1)
+        {
+            ++extent->count;
+        }
+        else
+        {
+            if(fd->extent_count >= FAT_EXTENT_COUNT)
+                return 1;
+
+            index = extent->index + extent->count;
+            ++extent;
+            ++fd->extent_count;
+            extent->index = index;
+            extent->cluster = cluster_next;
+            extent->count = 1;
+        }
+
+        cluster_num = cluster_next;
+    }
+}
+
+/**
+ * \ingroup fat_file
+ * Caches the runs of clusters following the last run cached.
+ *
+ * \param[in] fd The file whose clusters to cache.
+ * \returns 0 on failure, 1 on success.
+ */
+uint8_t fat_fill_next_extents(struct fat_file_struct* fd)
+{
+    struct fat_extent_struct* extent = &fd->extents[fd->extent_count - 1];
+    cluster_t cluster_num = fat_get_next_cluster(fd->fs, extent->cluster + extent->count - 1);
+    if(!cluster_num)
+    {
+        fd->extent_count = 0;
+        return 0;
+    }
+
+    return fat_fill_extents(fd, extent->index + extent->count, cluster_num);
+}
+
+/**
+ * \ingroup fat_file
+ * Looks up a cluster of a file by its index within the file.
+ *
+ * Further runs are cached as needed.
+ *
+ * \param[in] fd The file whose cluster to find.
+ * \param[in] index The index within the file of the cluster.
+ * \returns The number of the cluster, or 0 on failure.
+ */
+cluster_t fat_get_file_cluster(struct fat_file_struct* fd, cluster_t index)
+{
+    while(1)
+    {
+        struct fat_extent_struct* extent = fd->extents;
+        for(uint8_t i = 0; i < fd->extent_count; ++i, ++extent)
+        {
+            if((cluster_t) (index - extent->index) < extent->count)
+            {
+                fd->extent_pos = i;
+                return extent->cluster + (index - extent->index);
+            }
+        }
+
+        if(index < fd->extents[0].index)
+        {
+            /* before the runs cached, so start again from the beginning */
+            if(!fat_fill_extents(fd, 0, fd->dir_entry.cluster))
+                return 0;
+        }
+        else if(fd->extent_last)
+        {
+            /* beyond the end of the chain */
+            fat_errno = FAT_ERR_BAD;
+            return 0;
+        }
+        else if(!fat_fill_next_extents(fd))
+        {
+            return 0;
+        }
+    }
+}
+
+/**
+ * \ingroup fat_file
+ * Determines the cluster following the current cluster of a file.
+ *
+ * The runs cached are used in place of the FAT, and more are cached
+ * when the last of them ends.
+ *
+ * \param[in] fd The file whose next cluster to find.
+ * \param[in] cluster_num The file's current cluster.
+ * \returns The number of the next cluster, or 0 at the end of the chain or on failure.
+ */
+cluster_t fat_next_file_cluster(struct fat_file_struct* fd, cluster_t cluster_num)
+{
+    struct fat_extent_struct* extent = &fd->extents[fd->extent_pos];
+
+    if(cluster_num + 1 < extent->cluster + extent->count)
+        return cluster_num + 1;
+
+    if(fd->extent_pos + 1 < fd->extent_count)
+    {
+        ++fd->extent_pos;
+        return extent[1].cluster;
+    }
+
+    if(fd->extent_last)
+    {
+        fat_errno = FAT_ERR_BAD;
+        return 0;
+    }
+
+    if(!fat_fill_next_extents(fd))
+        return 0;
+
+    return fd->extents[0].cluster;
+}
+#endif
+
 #if DOXYGEN || FAT_WRITE_SUPPORT
 /**
  * \ingroup fat_file
@@ -1201,12 +1456,16 @@ intptr_t fat_write_file(struct fat_file_struct* fd, const uint8_t* buffer, uintp
             if(!fd->pos)
             {
                 /* empty file */
-                fd->dir_entry.cluster = cluster_num = fat_append_clusters(fd->fs, 0, 1);
+                fd->dir_entry.cluster = cluster_num = fat_append_clusters(fd->fs, 0, FAT_WRITE_EXTENT);
                 if(!cluster_num)
 		{
 		    fat_errno = FAT_ERR_FILESYSFULL;
 		    return -1;
 		}
+#if FAT_EXTENT_COUNT
+                /* cache the new chain while its part of the fat is at hand */
+                fat_fill_extents(fd, 0, cluster_num);
+#endif
             }
             else
             {
@@ -1232,7 +1491,11 @@ intptr_t fat_write_file(struct fat_file_struct* fd, const uint8_t* buffer, uintp
 		    }
 
                     /* the file exactly ends on a cluster boundary, and we append to it */
-                    cluster_num_next = fat_append_clusters(fd->fs, cluster_num, 1);
+                    cluster_num_next = fat_append_clusters(fd->fs, cluster_num, FAT_WRITE_EXTENT);
+#if FAT_EXTENT_COUNT
+                    /* the chain grew, so stop using the runs cached */
+                    fd->extent_count = 0;
+#endif
 		    if(!cluster_num_next)
 		    {
 			fat_errno = FAT_ERR_FILESYSFULL;
@@ -1266,10 +1529,32 @@ intptr_t fat_write_file(struct fat_file_struct* fd, const uint8_t* buffer, uintp
         if(first_cluster_offset + write_length >= cluster_size)
         {
             /* we are on a cluster boundary, so get the next cluster */
+#if FAT_EXTENT_COUNT
+            cluster_t cluster_num_next = fd->extent_count ?
+                fat_get_file_cluster(fd, (uint32_t) fd->pos / cluster_size) :
+                fat_get_next_cluster(fd->fs, cluster_num);
+#else
             cluster_t cluster_num_next = fat_get_next_cluster(fd->fs, cluster_num);
-            if(!cluster_num_next && buffer_left > 0)
-                /* we reached the last cluster, append a new one */
-                cluster_num_next = fat_append_clusters(fd->fs, cluster_num, 1);
+#endif
+            /* When allocating several clusters at once, do so even if
+             * no more is to be written now, so that the next write
+             * finds its cluster without searching the chain; any
+             * surplus is freed on closing
+             */
+            if(!cluster_num_next && (buffer_left > 0 || FAT_WRITE_EXTENT > 1))
+            {
+                /* we reached the last cluster, append new ones */
+                cluster_num_next = fat_append_clusters(fd->fs, cluster_num, FAT_WRITE_EXTENT);
+#if FAT_EXTENT_COUNT
+                /* and cache the runs from here on while that part of
+                 * the fat is at hand, so that the clusters appended
+                 * are found without reading it again
+                 */
+                fd->extent_count = 0;
+                if(cluster_num_next)
+                    fat_fill_extents(fd, (uint32_t) fd->pos / cluster_size - 1, cluster_num);
+#endif
+            }
             if(!cluster_num_next)
             {
                 fd->pos_cluster = 0;
@@ -1293,6 +1578,10 @@ intptr_t fat_write_file(struct fat_file_struct* fd, const uint8_t* buffer, uintp
 
         /* update file size */
         fd->dir_entry.file_size = fd->pos;
+#if FAT_WRITE_EXTENT > 1
+        /* clusters appended may not all have been written to */
+        fd->surplus = 1;
+#endif
 
 #if !FAT_DELAY_DIRENTRY_UPDATE
         /* write directory entry */
@@ -1469,6 +1758,14 @@ uint8_t fat_resize_file(struct fat_file_struct* fd, uint32_t size)
         fd->pos = size;
         fd->pos_cluster = 0;
     }
+#if FAT_EXTENT_COUNT
+    /* clusters may have been added or freed */
+    fd->extent_count = 0;
+#endif
+#if FAT_WRITE_EXTENT > 1
+    /* the chain now ends where the file does */
+    fd->surplus = 0;
+#endif
 
     return 1;
 }
@@ -1667,6 +1964,43 @@ uint8_t fat_reset_dir(struct fat_dir_struct* dd)
     return 1;
 }
 
+/**
+ * \ingroup fat_dir
+ * Retrieves the position of a directory handle.
+ *
+ * The position is that from which fat_read_dir() reads next, and
+ * may be returned to with fat_set_dir_pos() for as long as the
+ * directory is not changed.
+ *
+ * \param[in] dd The directory handle whose position to retrieve.
+ * \param[out] pos The position.
+ * \see fat_set_dir_pos
+ */
+void fat_get_dir_pos(const struct fat_dir_struct* dd, struct fat_dir_pos_struct* pos)
+{
+    pos->cluster = dd->entry_cluster;
+    pos->offset = dd->entry_offset;
+}
+
+/**
+ * \ingroup fat_dir
+ * Moves a directory handle to a position retrieved by fat_get_dir_pos().
+ *
+ * \param[in] dd The directory handle to move.
+ * \param[in] pos The position.
+ * \returns 0 on failure, 1 on success.
+ * \see fat_get_dir_pos
+ */
+uint8_t fat_set_dir_pos(struct fat_dir_struct* dd, const struct fat_dir_pos_struct* pos)
+{
+    if(!dd || !pos)
+        return 0;
+
+    dd->entry_cluster = pos->cluster;
+    dd->entry_offset = pos->offset;
+    return 1;
+}
+
 /**
  * \ingroup fat_fs
  * Callback function for reading a directory entry.
@@ -1996,7 +2330,7 @@ uint8_t fat_write_dir_entry(const struct fat_fs_struct* fs, struct fat_dir_entry
 
     /* generate 8.3 file name */
     memset(&buffer[0], ' ', 11);
-    char* name_ext = strrchr(name, '.');
+    const char* name_ext = strrchr(name, '.');
     if(name_ext && *++name_ext)
     {
         uint8_t name_ext_len = strlen(name_ext);
@@ -2435,6 +2769,26 @@ offset_t fat_get_file_size(const struct fat_file_struct* fd){
 	return fd->dir_entry.file_size;
 }
 
+/**
+ * \ingroup fat_file
+ * Returns where on the device the block the file is next read from lies.
+ *
+ * The block is only known when the file's position has been reached by
+ * reading, rather than by seeking, and lies within the file.  The FAT is
+ * never read to find it.
+ *
+ * \param[in] fd The file handle of the file.
+ * \returns The device offset of the block, or 0 if it is not known.
+ */
+offset_t fat_get_file_block(const struct fat_file_struct* fd)
+{
+    if(!fd || !fd->pos_cluster || fd->pos >= fd->dir_entry.file_size)
+        return 0;
+
+    uint16_t cluster_offset = (uint16_t) (fd->pos & (fd->fs->header.cluster_size - 1));
+    return fat_cluster_offset(fd->fs, fd->pos_cluster) + (cluster_offset & ~511);
+}
+
 
 #if DOXYGEN || (FAT_WRITE_SUPPORT && FAT_DATETIME_SUPPORT)
 /**
@@ -30,6 +30,7 @@ extern "C"
 #define FAT_ERR_UNKNOWNFILESYS   14
 #define FAT_ERR_TOOMANYOPENFILES 15
 #define FAT_ERR_FILESYSFULL      16
+#define FAT_ERR_BADCLUSTERSIZE   17
 
 extern uint8_t fat_errno;
 
@@ -103,6 +104,13 @@ struct fat_dir_entry_struct
     offset_t entry_offset;
 };
 
+/** A position within a directory, see fat_get_dir_pos(). */
+struct fat_dir_pos_struct
+{
+    cluster_t cluster;
+    uint16_t offset;
+};
+
 struct fat_fs_struct* fat_open(struct partition_struct* partition);
 void fat_close(struct fat_fs_struct* fs);
 
@@ -117,6 +125,8 @@ struct fat_dir_struct* fat_open_dir(struct fat_fs_struct* fs, const struct fat_d
 void fat_close_dir(struct fat_dir_struct* dd);
 uint8_t fat_read_dir(struct fat_dir_struct* dd, struct fat_dir_entry_struct* dir_entry);
 uint8_t fat_reset_dir(struct fat_dir_struct* dd);
+void fat_get_dir_pos(const struct fat_dir_struct* dd, struct fat_dir_pos_struct* pos);
+uint8_t fat_set_dir_pos(struct fat_dir_struct* dd, const struct fat_dir_pos_struct* pos);
 
 uint8_t fat_create_file(struct fat_dir_struct* parent, const char* file, struct fat_dir_entry_struct* dir_entry);
 uint8_t fat_delete_file(struct fat_fs_struct* fs, struct fat_dir_entry_struct* dir_entry);
@@ -131,6 +141,7 @@ uint8_t fat_get_dir_entry_of_path(struct fat_fs_struct* fs, const char* path, st
 offset_t fat_get_fs_size(const struct fat_fs_struct* fs);
 offset_t fat_get_fs_free(const struct fat_fs_struct* fs);
 offset_t fat_get_file_size(const struct fat_file_struct* fd);
+offset_t fat_get_file_block(const struct fat_file_struct* fd);
 
 /**
  * @}
@@ -81,6 +81,33 @@ extern "C"
  */
 #define FAT_DELAY_DIRENTRY_UPDATE 1
 
+/**
+ * \ingroup fat_config
+ * Controls caching of the cluster chains of open files.
+ *
+ * Set to the number of runs of contiguous clusters to keep for each
+ * open file, or to 0 to follow cluster chains through the FAT.  The
+ * runs are found when the file is opened, and again whenever reading
+ * passes the last run kept, so that reads and seeks cross cluster
+ * boundaries without reading the FAT.
+ */
+#ifndef FAT_EXTENT_COUNT
+#define FAT_EXTENT_COUNT 0
+#endif
+
+/**
+ * \ingroup fat_config
+ * Controls cluster allocation for files being written.
+ *
+ * Set to the number of clusters to allocate at once when writing runs
+ * past the end of a file's cluster chain.  The FAT is then searched and
+ * updated once for that many clusters rather than once for each.  The
+ * clusters left unused are freed when the file is closed.
+ */
+#ifndef FAT_WRITE_EXTENT
+#define FAT_WRITE_EXTENT 1
+#endif
+
 /**
  * \ingroup fat_config
  * Determines the function used for retrieving current date and time.
@@ -2,7 +2,13 @@
 // Dan Newman, February 2013
 
 #include <stdint.h>
+#ifndef SIMULATOR
 #include <avr/pgmspace.h>
+#else
+#define PROGMEM
+#define pgm_read_byte(p) (*(p))
+#define pgm_read_word(p) (*(p))
+#endif
 #include "sd_crc.h"
 
 // 7bit CRC with polynomial x^7 + x^3 + 1
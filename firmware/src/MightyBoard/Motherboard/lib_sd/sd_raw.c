@@ -8,11 +8,15 @@
  */
 
 #include <string.h>
+#ifndef SIMULATOR
 #include <avr/io.h>
+#endif
 #include "sd_raw.h"
+#ifndef SIMULATOR
 #include <util/delay.h>
 #include "Configuration.hh"
 #include "Pin.hh"
+#endif
 
 #if !SD_RAW_SAVE_RAM
 #include "sd_crc.h"
@@ -164,6 +168,20 @@ static uint8_t raw_block_written;
 #endif
 #endif
 
+#if SD_RAW_STREAM_READS
+/* flag to remember if sequential reads may use multi-block reads */
+static uint8_t raw_stream_enabled;
+/* flag to remember if a multi-block read is in progress */
+static uint8_t raw_stream_open;
+/* offset of the block the multi-block read will deliver next */
+static offset_t raw_stream_address;
+/* bytes of that block received so far, plus one for its start byte;
+ * 0 while waiting for the start byte */
+static uint16_t raw_stream_received;
+/* bytes clocked while waiting for the start byte */
+static uint16_t raw_stream_tries;
+#endif
+
 /* card type state */
 static uint8_t sd_raw_card_type;
 
@@ -171,6 +189,11 @@ static uint8_t sd_raw_card_type;
 static void sd_raw_send_byte(uint8_t b);
 static uint8_t sd_raw_rec_byte();
 static uint8_t sd_raw_send_command(uint8_t command, uint32_t arg);
+#if SD_RAW_STREAM_READS
+static uint8_t sd_raw_stream_read(offset_t block_address);
+static uint8_t sd_raw_stream_receive(offset_t block_address, uint16_t budget);
+static void sd_raw_stream_stop();
+#endif
 
 /**
  * \ingroup sd_raw
@@ -180,7 +203,7 @@ static uint8_t sd_raw_send_command(uint8_t command, uint32_t arg);
  */
 uint8_t sd_raw_init(bool use_crc, uint8_t speed)
 {
-#if !SD_POOR_DESIGN
+#if !SD_POOR_DESIGN && !SD_RAW_FAST_SPI
     (void)speed;
 #endif
 #if !SD_RAW_SAVE_RAM
@@ -191,6 +214,12 @@ uint8_t sd_raw_init(bool use_crc, uint8_t speed)
 
     sd_errno = 0;
 
+#if SD_RAW_STREAM_READS
+    /* any multi-block read ended with the card's reset */
+    raw_stream_enabled = 0;
+    raw_stream_open = 0;
+#endif
+
     /* enable inputs for reading card status */
     configure_pin_available();
     configure_pin_locked();
@@ -420,10 +449,36 @@ uint8_t sd_raw_init(bool use_crc, uint8_t speed)
     // SPCR &= ~((1 << SPR1) | (1 << SPR0)); /* Clock Frequency: f_OSC / 4 */
     // SPSR |= (1 << SPI2X); /* Doubled Clock Frequency: f_OSC / 2 */
 
-    /* f_OSC / 16 */
-    SPCR |=  ( 1 << SPR0 );
-    SPCR &= ~( 1 << SPR1 );
-    SPSR &= ~( 1 << SPI2X );
+#if SD_RAW_FAST_SPI
+    // The bus is no better for a newer card, so a faster clock is only
+    // used with CRC checking on, when a bit error fails the read rather
+    // than handing corrupt commands to the print.  SDCard.cc steps speed
+    // up, and so the clock down, if the filesystem then cannot be read.
+    if(sd_use_crc && (sd_raw_card_type & (1 << SD_RAW_SPEC_SDHC)) &&
+       speed < SD_RAW_SPEED_STANDARD)
+    {
+        SPCR &= ~( 1 << SPR1 );
+        if(speed == 0)
+        {
+            /* f_OSC / 4 */
+            SPCR &= ~( 1 << SPR0 );
+            SPSR &= ~( 1 << SPI2X );
+        }
+        else
+        {
+            /* f_OSC / 8 */
+            SPCR |=  ( 1 << SPR0 );
+            SPSR |=  ( 1 << SPI2X );
+        }
+    }
+    else
+#endif
+    {
+        /* f_OSC / 16 */
+        SPCR |=  ( 1 << SPR0 );
+        SPCR &= ~( 1 << SPR1 );
+        SPSR &= ~( 1 << SPI2X );
+    }
 #endif
 
 #if !SD_RAW_SAVE_RAM
@@ -522,7 +577,7 @@ uint8_t sd_raw_send_command(uint8_t command, uint32_t arg)
 
 #if !SD_RAW_SAVE_RAM
     if ( sd_use_crc ) {
-	uint8_t crc[6] = { command | 0x40, args[3], args[2], args[1], args[0] };
+	uint8_t crc[6] = { (uint8_t)(command | 0x40), args[3], args[2], args[1], args[0] };
 	crc[5] = sd_crc7(crc, 5);
 	for (uint8_t i = 0; i < 6; i++)
 	    sd_raw_send_byte(crc[i]);
@@ -550,6 +605,10 @@ uint8_t sd_raw_send_command(uint8_t command, uint32_t arg)
     }
 #endif
 
+    /* a multi-block read is stopped with a stuff byte, after which comes R1b */
+    if(command == CMD_STOP_TRANSMISSION)
+        sd_raw_rec_byte();
+
     /* receive response */
     for(uint8_t i = 0; i < 10; ++i)
     {
@@ -592,7 +651,12 @@ uint8_t sd_raw_read(offset_t offset, uint8_t* buffer, uintptr_t length)
 
 #if !SD_RAW_SAVE_RAM
         /* check if the requested data is cached */
-        if(block_address != raw_block_address)
+        if(block_address != raw_block_address
+#if SD_RAW_STREAM_READS
+           /* or can be had from a multi-block read */
+           && !(raw_stream_enabled && sd_raw_stream_read(block_address))
+#endif
+          )
 #endif
         {
 #if SD_RAW_WRITE_BUFFERING
@@ -827,6 +891,192 @@ uint8_t sd_raw_read_interval(offset_t offset, uint8_t* buffer, uintptr_t interva
 #endif
 }
 
+#if DOXYGEN || SD_RAW_STREAM_READS
+/**
+ * \ingroup sd_raw
+ * Starts or ends sequential reading.
+ *
+ * While sequential reading is on, a block which is not cached is
+ * read with a multi-block read which is then left open, with the
+ * card selected.  Should the next block be wanted next, it is taken
+ * from the card without a further command or access delay.  Reading
+ * any other block, writing or ending sequential reading closes the
+ * multi-block read.
+ *
+ * If a multi-block read fails, single block reads are used until
+ * sequential reading is started again.
+ *
+ * \param[in] enable 1 to start sequential reading, 0 to end it.
+ * \see sd_raw_read
+ */
+void sd_raw_stream(uint8_t enable)
+{
+    sd_raw_stream_stop();
+    raw_stream_enabled = enable;
+}
+
+/**
+ * \ingroup sd_raw
+ * Fills the block cache from a multi-block read.
+ *
+ * A multi-block read is started at the given block unless the one
+ * in progress has reached it.
+ *
+ * \param[in] block_address The offset of the block to read.
+ * \returns 0 on failure, 1 on success.
+ */
+uint8_t sd_raw_stream_read(offset_t block_address)
+{
+    /* the start byte is given up on well within this budget */
+    return sd_raw_stream_receive(block_address, 0xffff) == 1;
+}
+
+/**
+ * \ingroup sd_raw
+ * Moves a multi-block read on towards having a block cached.
+ *
+ * Receiving a block takes the card's access time and then 514 bytes,
+ * several milliseconds should the card be slow.  This clocks at most
+ * about \c budget bytes towards it, so that reading ahead may be
+ * spread over many short calls.  The block is received into the
+ * block cache, which is invalid until it is complete.  Once it is,
+ * sd_raw_read() takes the block from the cache.
+ *
+ * \param[in] block_address The offset of the block to read.
+ * \param[in] budget The number of bytes which may be clocked.
+ * \returns 0 if more of the block remains to be received, 1 once it is
+ *          cached or should it be left to sd_raw_read() to read
+ *          instead, as when sequential reading is off or has failed.
+ * \see sd_raw_stream
+ */
+uint8_t sd_raw_stream_fetch(offset_t block_address, uint16_t budget)
+{
+    if(!raw_stream_enabled || block_address == raw_block_address)
+        return 1;
+    return sd_raw_stream_receive(block_address, budget) != 2;
+}
+
+/**
+ * \ingroup sd_raw
+ * Receives what it can of a block from a multi-block read.
+ *
+ * \param[in] block_address The offset of the block to read.
+ * \param[in] budget The number of bytes which may be clocked.
+ * \returns 0 on failure, 1 once the block is cached, 2 if the budget
+ *          ran out first.
+ */
+uint8_t sd_raw_stream_receive(offset_t block_address, uint16_t budget)
+{
+    uint16_t crc;
+
+#if SD_RAW_WRITE_BUFFERING
+    if(!sd_raw_sync())
+        return 0;
+#endif
+
+    if(raw_stream_open && block_address != raw_stream_address)
+        sd_raw_stream_stop();
+
+    if(!raw_stream_open)
+    {
+        /* address card */
+        select_card();
+
+        /* send multiple block request */
+#if SD_RAW_SDHC
+        if(sd_raw_send_command(CMD_READ_MULTIPLE_BLOCK, (sd_raw_card_type & (1 << SD_RAW_SPEC_SDHC) ? block_address / 512 : block_address)))
+#else
+        if(sd_raw_send_command(CMD_READ_MULTIPLE_BLOCK, block_address))
+#endif
+        {
+            unselect_card();
+            raw_stream_enabled = 0;
+            return 0;
+        }
+        raw_stream_open = 1;
+        raw_stream_address = block_address;
+        raw_stream_received = 0;
+        raw_stream_tries = 0;
+    }
+
+    /* wait for data block (start byte 0xfe) */
+    while(!raw_stream_received)
+    {
+        if(!budget)
+            return 2;
+        --budget;
+        if(sd_raw_rec_byte() == 0xfe)
+            raw_stream_received = 1;
+        else if(raw_stream_tries++ >= 0x7FFF)
+            goto fail;
+    }
+
+    /* the cache is invalid until the block is complete */
+    raw_block_address = (offset_t) -1;
+
+    /* read byte block */
+    if(raw_stream_received <= 512)
+    {
+        uint16_t n = 513 - raw_stream_received;
+        if(n > budget)
+            n = budget;
+        budget -= n;
+        uint8_t* cache = raw_block + raw_stream_received - 1;
+        raw_stream_received += n;
+        while(n--)
+            *cache++ = sd_raw_rec_byte();
+        if(raw_stream_received <= 512)
+            return 2;
+    }
+
+    /* read crc16 */
+    if(budget < 2)
+        return 2;
+    crc = sd_raw_rec_byte() << 8;
+    crc |= sd_raw_rec_byte();
+    if(sd_use_crc && crc != sd_crc16(raw_block, (uint16_t)512))
+        goto fail;
+
+    raw_block_address = block_address;
+    raw_stream_address += 512;
+    raw_stream_received = 0;
+    raw_stream_tries = 0;
+    return 1;
+
+fail:
+    sd_raw_stream_stop();
+    raw_stream_enabled = 0;
+    return 0;
+}
+
+/**
+ * \ingroup sd_raw
+ * Ends any multi-block read in progress.
+ */
+void sd_raw_stream_stop()
+{
+    if(!raw_stream_open)
+        return;
+    raw_stream_open = 0;
+
+    sd_raw_send_command(CMD_STOP_TRANSMISSION, 0);
+
+    /* wait while card is busy */
+    uint16_t tries = 0;
+    while(sd_raw_rec_byte() != 0xff)
+    {
+        if(tries++ >= 0x7FFF)
+            break;
+    }
+
+    /* deaddress card */
+    unselect_card();
+
+    /* let card some time to finish */
+    sd_raw_rec_byte();
+}
+#endif
+
 #if DOXYGEN || SD_RAW_WRITE_SUPPORT
 /**
  * \ingroup sd_raw
@@ -893,6 +1143,10 @@ uint8_t sd_raw_write(offset_t offset, const uint8_t* buffer, uintptr_t length)
 #endif
         }
 
+#if SD_RAW_STREAM_READS
+        sd_raw_stream_stop();
+#endif
+
         /* address card */
         select_card();
 
@@ -1049,6 +1303,10 @@ uint8_t sd_raw_get_info(struct sd_raw_info* info)
 
     memset(info, 0, sizeof(*info));
 
+#if SD_RAW_STREAM_READS
+    sd_raw_stream_stop();
+#endif
+
     select_card();
 
     /* read cid register */
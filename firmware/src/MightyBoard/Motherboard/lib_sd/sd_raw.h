@@ -125,6 +125,18 @@ struct sd_raw_info
 typedef uint8_t (*sd_raw_read_interval_handler_t)(uint8_t* buffer, offset_t offset, void* p);
 typedef uintptr_t (*sd_raw_write_interval_handler_t)(uint8_t* buffer, offset_t offset, void* p);
 
+/**
+ * \ingroup sd_raw
+ * The largest \c speed argument to sd_raw_init() which still gives
+ * the standard SPI clock of f_OSC / 16.  Smaller values give faster
+ * clocks to SDHC cards when SD_RAW_FAST_SPI is 1 and CRCs are checked.
+ */
+#if SD_RAW_FAST_SPI
+#define SD_RAW_SPEED_STANDARD 2
+#else
+#define SD_RAW_SPEED_STANDARD 0
+#endif
+
 uint8_t sd_raw_init(bool use_crc, uint8_t speed);
 uint8_t sd_raw_available();
 uint8_t sd_raw_locked();
@@ -134,6 +146,10 @@ uint8_t sd_raw_read_interval(offset_t offset, uint8_t* buffer, uintptr_t interva
 uint8_t sd_raw_write(offset_t offset, const uint8_t* buffer, uintptr_t length);
 uint8_t sd_raw_write_interval(offset_t offset, uint8_t* buffer, uintptr_t length, sd_raw_write_interval_handler_t callback, void* p);
 uint8_t sd_raw_sync();
+#if SD_RAW_STREAM_READS
+void sd_raw_stream(uint8_t enable);
+uint8_t sd_raw_stream_fetch(offset_t block_address, uint16_t budget);
+#endif
 
 uint8_t sd_raw_get_info(struct sd_raw_info* info);
 
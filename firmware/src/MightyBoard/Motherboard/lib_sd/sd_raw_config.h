@@ -12,8 +12,12 @@
 #define SD_RAW_CONFIG_H
 
 #include <stdint.h>
+#ifndef SIMULATOR
 #include "Configuration.hh"
 #include "Pin.hh"
+#else
+#include "SdCardSim.hh"
+#endif
 
 #define SD_TIMEOUT 1000  //1ms
 
@@ -83,12 +87,46 @@ extern "C"
 #define SD_RAW_SDHC 0
 #endif
 
+/**
+ * \ingroup sd_raw_config
+ * Controls multi-block reads.
+ *
+ * Set to 1 to provide sd_raw_stream(), with which sequential reads
+ * are served from a single multi-block read rather than a command
+ * per block.
+ *
+ * \note This option has no effect when SD_RAW_SAVE_RAM is 1.
+ */
+#ifndef SD_RAW_STREAM_READS
+#define SD_RAW_STREAM_READS 0
+#endif
+
+/**
+ * \ingroup sd_raw_config
+ * Controls the SPI clock used with SDHC cards.
+ *
+ * Set to 1 to clock SDHC cards at f_OSC / 4 once they are
+ * initialized, when sd_raw_init() is asked to check CRCs.  A
+ * \c speed of 1 passed to sd_raw_init() clocks them at f_OSC / 8
+ * instead, and any larger \c speed at f_OSC / 16.
+ *
+ * Standard capacity cards, and any card read without CRC checks,
+ * are always clocked at f_OSC / 16; see SD_RAW_SPEED_STANDARD.
+ *
+ * \note This option has no effect when SD_RAW_SDHC is 0.
+ */
+#ifndef SD_RAW_FAST_SPI
+#define SD_RAW_FAST_SPI 0
+#endif
+
 /**
  * @}
  */
 
 /* defines for customisation of sd/mmc port access */
-#if defined(__AVR_ATmega8__) || \
+#if defined(SIMULATOR)
+    /* the card and its pins are emulated by SdCardSim.hh */
+#elif defined(__AVR_ATmega8__) || \
     defined(__AVR_ATmega48__) || \
     defined(__AVR_ATmega48P__) || \
     defined(__AVR_ATmega88__) || \
@@ -129,11 +167,13 @@ extern "C"
     #error "no sd/mmc pin mapping available!"
 #endif
 
+#ifndef SIMULATOR
 #define configure_pin_available() SD_DETECT_PIN.setDirection(false)
 #define configure_pin_locked() SD_WRITE_PIN.setDirection(false)
 
 #define get_pin_available() SD_DETECT_PIN.getValue()
 #define get_pin_locked() !SD_WRITE_PIN.getValue()
+#endif
 
 #if SD_RAW_SDHC
     typedef uint64_t offset_t;
@@ -149,6 +189,15 @@ extern "C"
 #undef SD_RAW_WRITE_BUFFERING
 #define SD_RAW_WRITE_BUFFERING 0
 #endif
+#if SD_RAW_SAVE_RAM
+#undef SD_RAW_STREAM_READS
+#define SD_RAW_STREAM_READS 0
+#endif
+/* the faster clock needs CRC checks, which saving RAM leaves out */
+#if !SD_RAW_SDHC || SD_POOR_DESIGN || SD_RAW_SAVE_RAM
+#undef SD_RAW_FAST_SPI
+#define SD_RAW_FAST_SPI 0
+#endif
 
 #ifdef __cplusplus
 }
@@ -21,12 +21,20 @@
 #include <util/atomic.h>
 
 
+#ifndef ADC_OVERSAMPLE
+
 volatile int16_t* adc_destination; //< Address to write the sampled data to
 
 volatile bool* adc_finished; //< Flag to set once the data is sampled
 
+#endif
+
 #if defined (__AVR_ATmega168__) || defined (__AVR_ATmega328__)
 
+#ifdef ADC_OVERSAMPLE
+#error ADC_OVERSAMPLE is not supported on the Atmega168
+#endif
+
     // We are using the AVcc as our reference.  There's a 100nF cap
     // to ground on the AREF pin.
     const uint8_t ANALOG_REF = 0x01;
@@ -88,6 +96,120 @@ volatile bool* adc_finished; //< Flag to set once the data is sampled
     // to ground on the AREF pin.
     const uint8_t ANALOG_REF = 0x01;
 
+#ifdef ADC_OVERSAMPLE
+
+#if ADC_OVERSAMPLE == 16
+#define ADC_DECIMATE 2
+#elif ADC_OVERSAMPLE == 32
+#define ADC_DECIMATE 3
+#elif ADC_OVERSAMPLE == 64
+#define ADC_DECIMATE 4
+#else
+#error ADC_OVERSAMPLE must be 16, 32 or 64
+#endif
+
+    // Pins sampled, in turn, and the one being sampled
+    static uint8_t adc_pins[ADC_CHANNELS];
+    static uint8_t adc_pin_count = 0;
+    static uint8_t adc_channel;
+
+    // Sum of the samples taken so far of that pin, and how many
+    static uint16_t adc_sum;
+    static uint8_t adc_samples;
+
+    // Latest reading of each pin, or -1 before the first
+    static volatile int16_t adc_readings[ADC_CHANNELS];
+
+    // Have the next conversion sample the given pin
+    static void selectAnalogPin(uint8_t pin) {
+            if (pin < 8) {
+                    // clear ADC Channel bit selecting upper 8 ADCs
+                    ADCSRB &= ~0b01000;
+            }
+            else {
+                    pin -= 8;
+                    // set ADC Channel bit selecting upper 8 ADCs
+                    ADCSRB |= 0b01000;
+            }
+            // select ADC Channel and connect AREF to AVCC
+            ADMUX = (ANALOG_REF << 6) | pin;
+    }
+
+    void initAnalogPin(uint8_t pin) {
+            uint8_t i;
+
+            // Analog pins are on ports F and K
+            if (pin < 8) {
+                    DDRF &= ~(_BV(pin));
+                    PORTF &= ~(_BV(pin));
+            }
+            else {
+                    DDRK &= ~(_BV(pin - 8));
+                    PORTK &= ~(_BV(pin - 8));
+            }
+
+            ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+                    for (i = 0; i < adc_pin_count; i++)
+                            if (adc_pins[i] == pin)
+                                    return;
+                    if (adc_pin_count >= ADC_CHANNELS)
+                            return;
+                    adc_pins[adc_pin_count] = pin;
+                    adc_readings[adc_pin_count] = -1;
+
+                    // The first pin starts the sampling, which then runs on
+                    // from the interrupt
+                    if (adc_pin_count++ == 0) {
+                            adc_channel = 0;
+                            adc_sum = 0;
+                            adc_samples = 0;
+                            selectAnalogPin(pin);
+                            // enable a2d conversions, interrupt on completion
+                            ADCSRA |= _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0) |
+                                    _BV(ADEN) | _BV(ADIE);
+                            ADCSRA |= _BV(ADSC);
+                    }
+            }
+    }
+
+    bool getAnalogReading(uint8_t pin, int16_t* reading) {
+            int16_t value = -1;
+
+            for (uint8_t i = 0; i < adc_pin_count; i++)
+                    if (adc_pins[i] == pin) {
+                            ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+                                    value = adc_readings[i];
+                            }
+                            break;
+                    }
+            *reading = value;
+            return value >= 0;
+    }
+
+    ISR(ADC_vect)
+    {
+            // ADC reads ADCL and then ADCH, as it must be read
+            adc_sum += ADC;
+
+            if (++adc_samples == ADC_OVERSAMPLE) {
+                    // ADC_OVERSAMPLE 10 bit samples hold 2 more bits of
+                    // resolution than one; any more bits are averaged away
+                    adc_readings[adc_channel] = (int16_t)(adc_sum >> ADC_DECIMATE);
+                    adc_sum = 0;
+                    adc_samples = 0;
+
+                    // On to the next pin
+                    if (++adc_channel >= adc_pin_count)
+                            adc_channel = 0;
+                    selectAnalogPin(adc_pins[adc_channel]);
+            }
+
+            // start the next conversion
+            ADCSRA |= _BV(ADSC);
+    }
+
+#else
+
     void initAnalogPin(uint8_t pin) {
             // Analog pins are on ports F and K
             if (pin < 8) {
@@ -159,5 +281,6 @@ volatile bool* adc_finished; //< Flag to set once the data is sampled
             *adc_finished = true;
     }
 
-#endif
+#endif // ADC_OVERSAMPLE
 
+#endif
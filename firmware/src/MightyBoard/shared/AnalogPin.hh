@@ -19,6 +19,9 @@
 #define ANALOG_PIN_HH_
 
 #include <stdint.h>
+#ifndef SIMULATOR
+#include "Configuration.hh"
+#endif
 
 /// Porting notes:
 /// This needs to be ported to each processor architecture.
@@ -27,6 +30,30 @@
 /// \param [in] Analog input number (0-7 on the Atmega168).
 void initAnalogPin(uint8_t pin);
 
+#ifdef ADC_OVERSAMPLE
+
+/// With ADC_OVERSAMPLE defined, the ADC samples continuously: its interrupt
+/// starts each conversion as the last completes, taking ADC_OVERSAMPLE
+/// samples from each pin given to #initAnalogPin() in turn.  Their sum is
+/// decimated to a reading of ADC_READING_BITS bits, so that a reading is
+/// both quieter and finer than a single sample.  At most ADC_CHANNELS pins
+/// may be sampled.  ADC_OVERSAMPLE may be 16, 32 or 64.
+
+/// Readings span 0 to (1 << ADC_READING_BITS) - 1
+#define ADC_READING_BITS 12
+
+#ifndef ADC_CHANNELS
+#define ADC_CHANNELS 2
+#endif
+
+/// Fetch the latest reading from an analog input being sampled.
+/// \param [in] pin Analog input number given to #initAnalogPin()
+/// \param [out] reading The reading
+/// \return False until the first reading of the pin has been made
+bool getAnalogReading(uint8_t pin, int16_t* reading);
+
+#else
+
 
 /// Initialize an asynchronous analog read from the specified input. The pin must first be
 /// placed into analog input mode by a call to #initAnalogPin(). The ADC will be set to
@@ -37,4 +64,6 @@ void initAnalogPin(uint8_t pin);
 ///              completed, and the output is stored in destination.
 bool startAnalogRead(uint8_t pin, volatile int16_t* destination, volatile bool* finished);
 
+#endif // ADC_OVERSAMPLE
+
 #endif /* ANALOG_PIN_HH_ */
@@ -0,0 +1,129 @@
+#include <math.h>
+#include "Autotune.hh"
+
+#ifdef PID_AUTOTUNE
+
+#include "PID.hh"
+
+// The relay's output swings over 0 - 254, as Marlin's does; the bias is
+// kept far enough from either end that the swing is never too small to
+// measure
+#define RELAY_MAX  254
+#define BIAS_LIMIT 20
+
+void PIDAutotune::start(int16_t target_in, uint8_t cycles_in) {
+	target  = target_in;
+	ncycles = (cycles_in < 3) ? 3 : cycles_in;
+	cycles  = 0;
+	bias    = RELAY_MAX / 2;
+	d       = RELAY_MAX / 2;
+	heating = true;
+	ticks   = 0;
+	t_high  = 0;
+	t_max   = 0;
+	t_min   = 10000;
+	ku_sum  = 0;
+	tu_sum  = 0;
+	state   = AT_HEATING;
+}
+
+float PIDAutotune::getUltimateGain() const {
+	return (ncycles > 2) ? ku_sum / (float)(ncycles - 2) : 0;
+}
+
+float PIDAutotune::getUltimatePeriod() const {
+	return (ncycles > 2) ? (float)tu_sum / (float)(ncycles - 2) : 0;
+}
+
+// Convert a gain to Q8.8, saturating
+static uint16_t toQ8_8(float g) {
+	if ( g <= 0 ) return 0;
+	if ( g >= 255.99 ) return 0xffff;
+	return PID_GAIN_Q8_8(g);
+}
+
+// Classic Ziegler-Nichols: Kp = 0.6 Ku, Ti = Tu / 2 and Td = Tu / 8.  The
+// PID scales its output by 2, sums the error once per update and takes the
+// derivative over DELTA_SAMPLES updates, so that with Tu in updates
+//
+//   P = Kp / 2
+//   I = Kp / (2 Ti)           = 0.6 Ku / Tu
+//   D = Kp Td / (2 * 4)       = 0.6 Ku Tu / 64
+//
+// The PID clamps its accumulated error to 256 degree-updates, so that too
+// small an I cannot supply the output which holds the target, and the
+// heater settles short of it.  The relay's bias, which made its time on and
+// off equal, is near that output; I is raised if need be to reach it.
+void PIDAutotune::finish() {
+	float ku = getUltimateGain();
+	float tu = getUltimatePeriod();
+	float kp = 0.6 * ku;
+	float ki = kp / tu;
+
+	if ( ki < bias / (2.0 * 256) )
+		ki = bias / (2.0 * 256);
+	p_gain = toQ8_8(kp / 2);
+	i_gain = toQ8_8(ki);
+	d_gain = toQ8_8(kp * tu / (2 * DELTA_SAMPLES * 8));
+	state  = AT_DONE;
+}
+
+uint8_t PIDAutotune::update(float temp) {
+	if ( !isRunning() )
+		return 0;
+
+	// Safety first: the relay is blind to everything else
+	if ( temp > (float)(target + AUTOTUNE_OVERSHOOT) || ++ticks > AUTOTUNE_MAX_TICKS ) {
+		state = AT_FAILED;
+		return 0;
+	}
+
+	if ( temp > t_max ) t_max = temp;
+	if ( temp < t_min ) t_min = temp;
+
+	if ( heating ) {
+		if ( temp > (float)target + AUTOTUNE_HYSTERESIS ) {
+			// Switch off and watch for the peak
+			heating = false;
+			state   = AT_CYCLING;
+			t_high  = ticks;
+			ticks   = 0;
+			t_max   = temp;
+		}
+	}
+	else if ( temp < (float)target - AUTOTUNE_HYSTERESIS ) {
+		// Switch on: a cycle is complete, its peak in t_max and its
+		// trough in t_min
+		uint16_t t_low = ticks;
+
+		heating = true;
+		ticks   = 0;
+		if ( cycles > 0 ) {
+			// The first cycles are disturbed by the heat up and by
+			// the bias settling; measure the rest
+			if ( cycles >= 2 ) {
+				float a = (t_max - t_min) / 2;
+				float h = AUTOTUNE_HYSTERESIS;
+				if ( a <= h ) a = h + 0.5;
+				ku_sum += (4.0 * d) / (M_PI * sqrt(a * a - h * h));
+				tu_sum += t_high + t_low;
+			}
+
+			// Move the bias towards equal time on and off
+			int16_t b = bias + (int16_t)(((int32_t)d * ((int32_t)t_high - (int32_t)t_low)) /
+						     (int32_t)(t_high + t_low));
+			if ( b < BIAS_LIMIT ) b = BIAS_LIMIT;
+			else if ( b > RELAY_MAX - BIAS_LIMIT ) b = RELAY_MAX - BIAS_LIMIT;
+			bias = (uint8_t)b;
+			d = ( bias > RELAY_MAX / 2 ) ? RELAY_MAX - bias : bias;
+		}
+		if ( ++cycles >= ncycles ) {
+			finish();
+			return 0;
+		}
+		t_min = temp;
+	}
+	return heating ? bias + d : bias - d;
+}
+
+#endif // PID_AUTOTUNE
@@ -0,0 +1,109 @@
+#ifndef AUTOTUNE_HH_
+#define AUTOTUNE_HH_
+
+#include <stdint.h>
+
+#ifndef SIMULATOR
+#include "Configuration.hh"
+#else
+#include "Simulator.hh"
+#endif
+
+#ifdef PID_AUTOTUNE
+
+/// Relay cycles to run, the first two of which are not measured
+#define AUTOTUNE_CYCLES 5
+
+/// Degrees either side of the target at which the relay switches
+#define AUTOTUNE_HYSTERESIS 1.0
+
+/// Degrees over the target at which the tune is abandoned
+#define AUTOTUNE_OVERSHOOT 20
+
+/// Longest the heater may take to reach the target, or spend in either
+/// half of a cycle, in calls to update()
+#define AUTOTUNE_MAX_TICKS 4800
+
+/// Relay feedback PID autotuning, after Astrom and Hagglund.
+///
+/// The heater is switched between two outputs, bias + d and bias - d, as
+/// its temperature crosses the target, which sets it oscillating about the
+/// target.  The bias is moved each cycle so that the heater spends as long
+/// on as off.  The amplitude of the oscillation, a, and its period, Tu,
+/// give the ultimate gain
+///
+///    Ku = 4d / (pi * sqrt(a^2 - h^2))
+///
+/// where h is the hysteresis of the relay, and Ziegler-Nichols gains
+/// follow from Ku and Tu.
+///
+/// update() must be called once per PID calculation, in place of the PID,
+/// and its output given to the heating element.  Time is counted in those
+/// calls, so that the gains come out in the units the PID uses them: per
+/// update for the integral and over the DELTA_SAMPLES updates for the
+/// derivative.  This class only does the arithmetic; the Heater decides
+/// what to do with the gains.
+class PIDAutotune {
+public:
+	enum State {
+		AT_IDLE = 0,    ///< Not run, or stopped
+		AT_HEATING,     ///< Heating to the target at full power
+		AT_CYCLING,     ///< Oscillating about the target
+		AT_DONE,        ///< Gains found
+		AT_FAILED       ///< Overshot, or took too long
+	};
+
+private:
+	float ku_sum;           ///< Sum of Ku over the measured cycles
+	float t_max;            ///< Highest temperature since switching off
+	float t_min;            ///< Lowest temperature since switching on
+	uint32_t tu_sum;        ///< Sum of the measured periods, in updates
+	uint16_t ticks;         ///< Updates in this half of the cycle
+	uint16_t t_high;        ///< Updates spent on in this cycle
+	uint16_t p_gain, i_gain, d_gain;        ///< Results, Q8.8
+	int16_t target;         ///< Temperature to oscillate about
+	uint8_t bias;           ///< Middle of the relay's output
+	uint8_t d;              ///< Half the relay's swing
+	uint8_t cycles;         ///< Cycles completed
+	uint8_t ncycles;        ///< Cycles to run
+	uint8_t state;          ///< One of State
+	bool heating;           ///< Relay is on
+
+	void finish();
+
+public:
+	PIDAutotune() : state(AT_IDLE) {}
+
+	/// Start tuning about a target
+	/// \param[in] target_in Temperature to oscillate about, in degrees Celsius
+	/// \param[in] cycles_in Relay cycles to run, at least 3
+	void start(int16_t target_in, uint8_t cycles_in = AUTOTUNE_CYCLES);
+
+	/// Stop tuning; the gains of a finished tune are kept
+	void stop() { if ( isRunning() ) state = AT_IDLE; }
+
+	/// Take the next temperature reading
+	/// \param[in] temp Current temperature, in degrees Celsius
+	/// \return Output for the heating element
+	uint8_t update(float temp);
+
+	bool isRunning() const { return state == AT_HEATING || state == AT_CYCLING; }
+	uint8_t getState() const { return state; }
+	uint8_t getCycles() const { return cycles; }
+	int16_t getTarget() const { return target; }
+
+	/// Ultimate gain, in output units per degree
+	float getUltimateGain() const;
+
+	/// Ultimate period, in updates
+	float getUltimatePeriod() const;
+
+	/// Gains found, Q8.8 as the PID and EEPROM hold them
+	uint16_t getPGain() const { return p_gain; }
+	uint16_t getIGain() const { return i_gain; }
+	uint16_t getDGain() const { return d_gain; }
+};
+
+#endif // PID_AUTOTUNE
+
+#endif // AUTOTUNE_HH_
@@ -81,6 +81,19 @@
 #define HOST_CMD_GET_BUILD_STATS   24
 #define HOST_CMD_ADVANCED_VERSION  27
 
+// Several consecutive action commands, queued as one.  The response
+// carries the remaining command buffer capacity.
+#define HOST_CMD_BATCH             28
+
+// Switch the host UART to another baud rate once the response is sent
+#define HOST_CMD_SET_BAUD          29
+
+// Start or stop unasked telemetry frames; see Telemetry.hh
+#define HOST_CMD_SET_TELEMETRY     30
+
+// Start a relay autotune of a heater's PID, or report on the last one
+#define HOST_CMD_AUTOTUNE          31
+
 // These are our bufferable commands from the host
 
 #define HOST_CMD_FIND_AXES_MINIMUM 131
@@ -119,6 +132,14 @@
 
 #define HOST_CMD_DEBUG_ECHO        0x70
 
+// Read a main loop task's run statistics, and optionally clear them; see
+// Scheduler.hh
+#define HOST_CMD_GET_TASK_STATS    0x78
+
+// Read a main loop slice's histogram of run times, and clear it; see
+// SliceProfile.hh
+#define HOST_CMD_GET_SLICE_PROFILE 0x79
+
 
 
 // These are our query commands from the host
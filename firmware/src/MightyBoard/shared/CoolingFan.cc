@@ -15,10 +15,17 @@
 // EEPROM map
 
 
+#ifdef PWM_OUTPUTS
+CoolingFan::CoolingFan(Heater& heater_in, uint16_t eeprom_base_in, uint8_t fan) :
+        heater(heater_in),
+        eeprom_base(eeprom_base_in),
+        fan_channel(fan)
+#else
 CoolingFan::CoolingFan(Heater& heater_in, uint16_t eeprom_base_in, const Pin &fan) :
         heater(heater_in),
         eeprom_base(eeprom_base_in),
         Fan_Pin(fan)
+#endif
 {
 	reset();
 }
@@ -27,8 +34,12 @@ void CoolingFan::reset() {
 	uint16_t offset = eeprom_base + cooler_eeprom_offsets::SETPOINT_C_OFFSET;
 	setSetpoint(eeprom::getEeprom8(offset, DEFAULT_COOLING_FAN_SETPOINT_C));
 
+#ifdef PWM_OUTPUTS
+	pwm::set(fan_channel, 0);
+#else
 	Fan_Pin.setValue(false);
 	Fan_Pin.setDirection(true);
+#endif
 
 	offset = eeprom_base + cooler_eeprom_offsets::ENABLE_OFFSET;
 	if (eeprom::getEeprom8(offset ,DEFAULT_COOLING_FAN_ENABLE) == FAN_ENABLED) {
@@ -60,7 +71,25 @@ void CoolingFan::manageCoolingFan() {
 	// TODO: only change the state if necessary
 	if (enabled) {
 		int temp = heater.get_current_temperature();
-		
+
+#ifdef PWM_OUTPUTS
+		if ((temp == DEFAULT_THERMOCOUPLE_VAL) ||
+		    (temp <= lowSetPoint - (fan_on ? COOLING_FAN_HYSTERESIS : 0))) {
+			fan_on = false;
+			disableFan();
+		}
+		else {
+			// From the slowest it is sure to run at to full speed
+			// over the 10 degrees up to the setpoint
+			int speed = COOLING_FAN_MIN_SPEED +
+				((temp - lowSetPoint) * (255 - COOLING_FAN_MIN_SPEED)) /
+				(midSetPoint - lowSetPoint);
+			if (speed < COOLING_FAN_MIN_SPEED) speed = COOLING_FAN_MIN_SPEED;
+			else if (speed > 255) speed = 255;
+			fan_on = true;
+			pwm::set(fan_channel, (uint8_t)speed);
+		}
+#else
 		if ((temp > setPoint) && (temp != DEFAULT_THERMOCOUPLE_VAL)){
 			enableFan();
 			// hysteresis in fan on/off behavior
@@ -84,21 +113,30 @@ void CoolingFan::manageCoolingFan() {
 				setPoint = midSetPoint;
 			}
 		}
+#endif
 	}
 }
 
 void CoolingFan::enableFan() {
+#ifdef PWM_OUTPUTS
+	pwm::set(fan_channel, 255);
+#else
 //#ifdef IS_EXTRUDER_BOARD
 	Fan_Pin.setValue(true);
+#endif
 //#else
 //	#warning cooling fan feature disabled
 //#endif
 }
 
 void CoolingFan::disableFan() {
+#ifdef PWM_OUTPUTS
+	pwm::set(fan_channel, 0);
+#else
 //#ifdef IS_EXTRUDER_BOARD
 //#warning cooling fan feature disabled
 	Fan_Pin.setValue(false);
+#endif
 //#else
 //	#warning cooling fan feature disabled
 //#endif
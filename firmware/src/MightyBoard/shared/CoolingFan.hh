@@ -20,6 +20,9 @@
 
 #include "Heater.hh"
 #include "Configuration.hh"
+#ifdef PWM_OUTPUTS
+#include "PwmOutputs.hh"
+#endif
 
 /// The cooling fan module represents a simple state machine that
 /// implements a bang/bang control mechanism to turn a fan on when
@@ -32,11 +35,24 @@
 /// #setExtruderMotor(). In addition, it expects that a separate entity
 /// is updating the heater, so that itfs current temperature reading is
 /// always valid.
+///
+/// With PWM_OUTPUTS, the fan is instead run in proportion to the
+/// temperature: it starts at #COOLING_FAN_MIN_SPEED once the temperature
+/// is 10 degrees short of the setpoint and is at full speed from the
+/// setpoint up.  Once running, it stops only when the temperature falls
+/// #COOLING_FAN_HYSTERESIS degrees below where it started.
 /// \ingroup SoftwareLibraries
 
 #define DEFAULT_COOLING_FAN_SETPOINT_C  50
 #define DEFAULT_COOLING_FAN_ENABLE      FAN_ENABLED
 
+#ifdef PWM_OUTPUTS
+/// Slowest a running fan is driven at, sure to start it
+#define COOLING_FAN_MIN_SPEED           128
+/// Degrees below the start temperature at which a running fan stops
+#define COOLING_FAN_HYSTERESIS          5
+#endif
+
 
 class CoolingFan {
 private:
@@ -48,7 +64,11 @@ private:
 
         Heater& heater;  ///<  Heater module to read the current temperature from.
         uint16_t eeprom_base;   ///< Base address to read EEPROM configuration from
+#ifdef PWM_OUTPUTS
+        uint8_t fan_channel;    ///< #pwm::Channel the fan is driven by
+#else
         Pin Fan_Pin;
+#endif
 
         bool enabled;   ///< If true, the control circuit actively controls the fan.
         int setPoint;   ///< Setpoint temperature, in degrees Celcius.
@@ -63,8 +83,14 @@ public:
         /// Create a new cooling fan controller instance.
         /// \param[in] heater Heater to use as an input to the controller
         /// \param[in] eeprom_base_in EEPROM address where the fan settings are stored.
+        /// \param[in] fan Pin, or with PWM_OUTPUTS #pwm::Channel, driving the fan
+#ifdef PWM_OUTPUTS
+        CoolingFan(Heater& heater,
+                   const uint16_t eeprom_base_in, uint8_t fan);
+#else
         CoolingFan(Heater& heater,
                    const uint16_t eeprom_base_in, const Pin &fan);
+#endif
 
         /// Temporarily override the setpoint temperature with a new one.
         /// The saved valued will be restored when the fan is reset.
@@ -85,7 +85,9 @@ bool saveToSDFile(const char *filename) {
 		wdt_reset();
 	}
 
-	sdcard::finishCapture();
+	// Buffered bytes are only written out here
+	if ( sdcard::finishCapture() != EEPROM_SIZE )
+		ret = false;
 
 	return ret;
 }
@@ -152,6 +154,15 @@ float getEepromFixed16(const uint16_t location, const float default_value) {
 }
 
 
+/// Fetch a fixed 16 value from eeprom as Q8.8, without converting it to float
+uint16_t getEepromFixed16Raw(const uint16_t location, const uint16_t default_value) {
+        uint8_t data[2];
+        eeprom_read_block(data,(const uint8_t*)location,2);
+        if (data[0] == 0xff && data[1] == 0xff) return default_value;
+        return ((uint16_t)data[0] << 8) | data[1];
+}
+
+
 /// Write a fixed 16 value to eeprom
 void setEepromFixed16(const uint16_t location, const float new_value)
 {
@@ -162,6 +173,16 @@ void setEepromFixed16(const uint16_t location, const float new_value)
 }
 
 
+/// Write a fixed 16 value to eeprom from Q8.8
+void setEepromFixed16Raw(const uint16_t location, const uint16_t new_value)
+{
+    uint8_t data[2];
+    data[0] = (uint8_t)(new_value >> 8);
+    data[1] = (uint8_t)new_value;
+    eeprom_write_block(data,(uint8_t*)location,2);
+}
+
+
 /// Fetch an int64 value from eeprom
 int64_t getEepromInt64(const uint16_t location, const int64_t default_value) {
         int64_t *ret;
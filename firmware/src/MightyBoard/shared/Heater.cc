@@ -15,13 +15,19 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>
  */
 
+#ifndef SIMULATOR
 #include "Configuration.hh"
+#endif
 #include "Heater.hh"
 #include "HeatingElement.hh"
 #include "Thermistor.hh"
 #include "Eeprom.hh"
 #include "EepromMap.hh"
+#ifndef SIMULATOR
 #include "Motherboard.hh"
+#else
+#include "Simulator.hh"
+#endif
 
 /// Offset to compensate for range clipping and bleed-off
 #define HEATER_OFFSET_ADJUSTMENT 0
@@ -61,6 +67,12 @@ const uint32_t HEAT_PROGRESS_TIME = 90000000; // 90 seconds
 /// threshold above starting temperature we check for heating progres
 const int16_t HEAT_PROGRESS_THRESHOLD = 10;
 
+#ifdef PID_AUTOTUNE
+// One heater is tuned at a time
+static PIDAutotune autotune;
+static Heater *autotune_heater = 0;
+#endif
+
 Heater::Heater(TemperatureSensor& sensor_in,
                HeatingElement& element_in,
                micros_t sample_interval_micros_in,
@@ -95,20 +107,28 @@ void Heater::abort() {
 	fail_mode = HEATER_FAIL_NONE;
 	value_fail_count = 0;
 
+#ifdef PID_AUTOTUNE
+	if ( isAutotuning() )
+		stopAutotune();
+#endif
+
 	heatingUpTimer = Timeout();
 	heatProgressTimer = Timeout();
 	progressChecked = false;
 	newTargetReached = false;
 	is_paused = false;
 	is_disabled = false;
+#ifdef EXTRUSION_FEEDFORWARD
+	feed_forward = 0;
+#endif
 
-	float p = eeprom::getEepromFixed16(eeprom_base+pid_eeprom_offsets::P_TERM_OFFSET,DEFAULT_P);
-	float i = eeprom::getEepromFixed16(eeprom_base+pid_eeprom_offsets::I_TERM_OFFSET,DEFAULT_I);
-	float d = eeprom::getEepromFixed16(eeprom_base+pid_eeprom_offsets::D_TERM_OFFSET,DEFAULT_D);
+	uint16_t p = eeprom::getEepromFixed16Raw(eeprom_base+pid_eeprom_offsets::P_TERM_OFFSET,DEFAULT_P_Q8_8);
+	uint16_t i = eeprom::getEepromFixed16Raw(eeprom_base+pid_eeprom_offsets::I_TERM_OFFSET,DEFAULT_I_Q8_8);
+	uint16_t d = eeprom::getEepromFixed16Raw(eeprom_base+pid_eeprom_offsets::D_TERM_OFFSET,DEFAULT_D_Q8_8);
 
 	pid.reset();
 	if (p == 0 && i == 0 && d == 0) {
-		p = DEFAULT_P; i = DEFAULT_I; d = DEFAULT_D;
+		p = DEFAULT_P_Q8_8; i = DEFAULT_I_Q8_8; d = DEFAULT_D_Q8_8;
 	}
 	pid.setPGain(p);
 	pid.setIGain(i);
@@ -148,6 +168,12 @@ void Heater::set_target_temperature(int16_t target_temp)
 	else if ( target_temp < 0 )
 		target_temp = 0;
 
+#ifdef PID_AUTOTUNE
+	// Whoever sets a temperature takes the heater back from the tune
+	if ( isAutotuning() )
+		stopAutotune();
+#endif
+
 	// Presently, MBI's code is broken when a new temp is set for
 	// a paused heater.  In MBI's fw, the paused heater's temp is
 	// changed to the new temp and thus the heater does not act
@@ -176,9 +202,11 @@ void Heater::set_target_temperature(int16_t target_temp)
 	     return;
 	}
 
+#ifndef SIMULATOR
 	if ( target_temp > 0 ) {
 		BOARD_STATUS_CLEAR(Motherboard::STATUS_HEAT_INACTIVE_SHUTDOWN);
 	}
+#endif
 
 	newTargetReached = false;
 
@@ -357,6 +385,29 @@ void Heater::manage_temperature() {
 
 	next_pid_timeout.start(UPDATE_INTERVAL_MICROS);
 
+#ifdef PID_AUTOTUNE
+	if ( isAutotuning() ) {
+		set_output(autotune.update(fp_current_temp));
+		if ( autotune.isRunning() )
+			return;
+		autotune_heater = 0;
+		if ( autotune.getState() == PIDAutotune::AT_DONE ) {
+			uint16_t p = autotune.getPGain();
+			uint16_t i = autotune.getIGain();
+			uint16_t d = autotune.getDGain();
+			eeprom::setEepromFixed16Raw(eeprom_base+pid_eeprom_offsets::P_TERM_OFFSET, p);
+			eeprom::setEepromFixed16Raw(eeprom_base+pid_eeprom_offsets::I_TERM_OFFSET, i);
+			eeprom::setEepromFixed16Raw(eeprom_base+pid_eeprom_offsets::D_TERM_OFFSET, d);
+			pid.setPGain(p);
+			pid.setIGain(i);
+			pid.setDGain(d);
+		}
+		// Done or failed, the heater goes off
+		set_target_temperature(0);
+		return;
+	}
+#endif
+
 	int delta = pid.getTarget() - current_temperature;
 
 	if ( bypassing_PID && (delta < PID_BYPASS_DELTA) ) {
@@ -378,6 +429,11 @@ void Heater::manage_temperature() {
 			// but this works pretty well.
 #if HEATER_OFFSET_ADJUSTMENT
 			mv += HEATER_OFFSET_ADJUSTMENT;
+#endif
+#ifdef EXTRUSION_FEEDFORWARD
+			// supply the heat the coming extrusion will draw
+			// before the nozzle cools
+			mv += feed_forward;
 #endif
 			// clamp value
 			if (mv < 0) mv = 0;
@@ -418,6 +474,52 @@ void Heater::Pause(bool on){
 	}
 }
 
+#ifdef PID_AUTOTUNE
+
+bool Heater::startAutotune(int16_t target)
+{
+	if ( has_failed() || is_disabled || target <= 0 )
+		return false;
+
+	// A heater whose tune is abandoned goes off, as when a tune fails,
+	// rather than holding the tune's target under its old gains
+	Heater *other = autotune_heater;
+	if ( other && other != this ) {
+		stopAutotune();
+		other->set_target_temperature(0);
+	}
+
+	// Sets the heat up checks going and takes the heater from any tune
+	if ( is_paused )
+		Pause(false);
+	set_target_temperature(target);
+
+	// Tune at the clipped target; the relay runs in place of the PID
+	autotune.start(pid.getTarget());
+	autotune_heater = this;
+	bypassing_PID = false;
+	pid.reset_state();
+	return true;
+}
+
+bool Heater::isAutotuning()
+{
+	return autotune_heater == this;
+}
+
+const PIDAutotune& Heater::getAutotune()
+{
+	return autotune;
+}
+
+void Heater::stopAutotune()
+{
+	autotune.stop();
+	autotune_heater = 0;
+}
+
+#endif
+
 void Heater::set_output(uint8_t value)
 {
 	element.setHeatingElement(value);
@@ -429,5 +531,9 @@ void Heater::fail()
 	fail_state = true;
 	set_target_temperature(0);
 	set_output(0);
+#ifndef SIMULATOR
 	Motherboard::getBoard().heaterFail(fail_mode, calibration_eeprom_offset);
+#else
+	simulatorHeaterFail(fail_mode, calibration_eeprom_offset);
+#endif
 }
@@ -20,10 +20,13 @@
 
 #include "TemperatureSensor.hh"
 #include "HeatingElement.hh"
+#ifndef SIMULATOR
 #include "Pin.hh"
+#endif
 #include "PID.hh"
 #include "Types.hh"
 #include "Timeout.hh"
+#include "Autotune.hh"
 
 #define MAX_VALID_TEMP 280
 #define MAX_HBP_TEMP   130
@@ -32,6 +35,11 @@
 #define DEFAULT_I 0.325
 #define DEFAULT_D 36.0
 
+// The defaults as the PID holds them
+#define DEFAULT_P_Q8_8 PID_GAIN_Q8_8(DEFAULT_P)
+#define DEFAULT_I_Q8_8 PID_GAIN_Q8_8(DEFAULT_I)
+#define DEFAULT_D_Q8_8 PID_GAIN_Q8_8(DEFAULT_D)
+
 enum HeaterFailMode{
 	HEATER_FAIL_NONE = 0,
 	HEATER_FAIL_NOT_PLUGGED_IN = 0x02,
@@ -85,6 +93,9 @@ class Heater
     const bool heat_timing_check;       ///< allow disabling of heat progress timing for heated build platform. 
     bool is_paused;						///< set to true when we wish to pause the heater from heating up 
     bool is_disabled;					///< heaters are disabled when they are not present (user settable)
+#ifdef EXTRUSION_FEEDFORWARD
+    uint8_t feed_forward;				///< output added to the PID's for the extrusion to come
+#endif
 
     // While the calibration offset is silly, we leverage the calibration_eeprom_offset
     // as a means of telling us if we're dealing with an extruder or HBP
@@ -126,7 +137,7 @@ class Heater
 
     /// Set the target output temperature
     /// \param temp New target temperature, in degrees Celcius.
-    void set_target_temperature(int temp);
+    void set_target_temperature(int16_t temp);
 
     /// Check if the heater is within the specified band
     /// \return True if the heater temperature is within #TARGET_HYSTERESIS degrees
@@ -185,6 +196,33 @@ class Heater
     void disable(bool on);
 
     bool isDisabled(){return is_disabled;}
+
+#ifdef EXTRUSION_FEEDFORWARD
+    /// Set the output to add to the PID's for the heat the queued moves
+    /// will draw; see feedforward::output()
+    void setFeedForward(uint8_t value) { feed_forward = value; }
+#endif
+
+#ifdef PID_AUTOTUNE
+    /// Tune this heater's PID by relay feedback about a target.  Any other
+    /// tune is stopped, and its heater switched off.  When the tune
+    /// finishes, its gains are written to this heater's PID settings in
+    /// EEPROM and put to use, and the heater is switched off.  Setting a
+    /// target, pausing or resetting the heater stops the tune.
+    /// \param[in] target Temperature to tune at, in degrees Celsius
+    /// \return false if the heater has failed or is disabled, or the
+    ///         target is not above 0
+    bool startAutotune(int16_t target);
+
+    /// Check if this heater is being tuned
+    bool isAutotuning();
+
+    /// Get the autotune, which all heaters share
+    static const PIDAutotune& getAutotune();
+
+    /// Stop any tune in progress
+    static void stopAutotune();
+#endif
 };
 
 #endif // HEATER_H
@@ -0,0 +1,73 @@
+#include <string.h>
+#include "LcdFramebuffer.hh"
+
+#ifdef LCD_FRAMEBUFFER
+
+// Cells in each of the DDRAM's two lines, rows 0 and 2 and rows 1 and 3;
+// the second starts at address 0x40
+#define LCD_FRAMEBUFFER_LINE (2 * LCD_FRAMEBUFFER_COLS)
+
+LcdFramebuffer::LcdFramebuffer() :
+	at(0),
+	at_known(false),
+	dirty(false)
+{
+	memset(drawn, ' ', sizeof(drawn));
+	memset(shown, ' ', sizeof(shown));
+}
+
+void LcdFramebuffer::clear() {
+	memset(drawn, ' ', sizeof(drawn));
+	dirty = true;
+}
+
+void LcdFramebuffer::put(uint8_t col, uint8_t row, uint8_t c) {
+	if ( col >= LCD_FRAMEBUFFER_COLS || row >= LCD_FRAMEBUFFER_ROWS )
+		return;
+
+	uint8_t i = col;
+	if ( row & 1 ) i += LCD_FRAMEBUFFER_LINE;
+	if ( row & 2 ) i += LCD_FRAMEBUFFER_COLS;
+
+	if ( drawn[i] != c ) {
+		drawn[i] = c;
+		dirty = true;
+	}
+}
+
+void LcdFramebuffer::displayCleared() {
+	memset(shown, ' ', sizeof(shown));
+	at = 0;
+	at_known = true;
+	dirty = true;
+}
+
+bool LcdFramebuffer::next(uint8_t *address, uint8_t *c, bool *move) {
+	if ( !dirty )
+		return false;
+
+	uint8_t i = at;
+	for ( uint8_t n = 0; n < LCD_FRAMEBUFFER_CELLS; n++ ) {
+		if ( drawn[i] != shown[i] ) {
+			*address = (i < LCD_FRAMEBUFFER_LINE) ? i : 0x40 + i - LCD_FRAMEBUFFER_LINE;
+			*move = !at_known || i != at;
+			*c = shown[i] = drawn[i];
+
+			// The counter runs on within a line; where it goes from the
+			// end of one is left alone
+			at = i + 1;
+			if ( at >= LCD_FRAMEBUFFER_CELLS )
+				at = 0;
+			at_known = (at != 0 && at != LCD_FRAMEBUFFER_LINE);
+			return true;
+		}
+		if ( ++i >= LCD_FRAMEBUFFER_CELLS )
+			i = 0;
+	}
+
+	// A whole pass found nothing to send
+	dirty = false;
+	return false;
+}
+
+#endif // LCD_FRAMEBUFFER
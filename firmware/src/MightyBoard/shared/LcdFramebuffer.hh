@@ -0,0 +1,74 @@
+#ifndef LCD_FRAMEBUFFER_HH_
+#define LCD_FRAMEBUFFER_HH_
+
+#include <stdint.h>
+
+#ifndef SIMULATOR
+#include "Configuration.hh"
+#else
+#include "Simulator.hh"
+#endif
+
+#ifdef LCD_FRAMEBUFFER
+
+/// Size of the display the framebuffer holds
+#define LCD_FRAMEBUFFER_COLS 20
+#define LCD_FRAMEBUFFER_ROWS 4
+#define LCD_FRAMEBUFFER_CELLS (LCD_FRAMEBUFFER_COLS * LCD_FRAMEBUFFER_ROWS)
+
+/// Most cells the main loop sends to the LCD per slice
+#define LCD_FLUSH_CELLS 8
+
+/// A copy in RAM of a 20 x 4 HD44780 display.
+///
+/// Screens draw into the frame with put(); nothing is sent to the LCD.
+/// A second copy holds what the LCD is showing, and next() hands out the
+/// cells which differ, one at a time, for the LCD to be sent.  Cells are
+/// kept in the order of the LCD's DDRAM addresses, 0x00 - 0x27 for rows 0
+/// and 2 and 0x40 - 0x67 for rows 1 and 3, and next() looks from the cell
+/// the LCD's address counter points at, so that a run of changed cells is
+/// written without setting the address between them.  It only asks for the
+/// address to be set when the next changed cell is not the one the counter
+/// points at.
+class LcdFramebuffer {
+private:
+	uint8_t drawn[LCD_FRAMEBUFFER_CELLS];   ///< As the screens have drawn it
+	uint8_t shown[LCD_FRAMEBUFFER_CELLS];   ///< As the LCD shows it
+	uint8_t at;                             ///< Cell the LCD's address counter
+	                                        ///< points at, or a cell to look
+	                                        ///< from when it is not known
+	bool at_known;                          ///< True when the counter is known
+	bool dirty;                             ///< True when a cell may differ
+
+public:
+	LcdFramebuffer();
+
+	/// Draw a space in every cell
+	void clear();
+
+	/// Draw a character
+	/// \param[in] col Column, 0 - 19
+	/// \param[in] row Row, 0 - 3
+	/// \param[in] c Character
+	void put(uint8_t col, uint8_t row, uint8_t c);
+
+	/// The LCD has been cleared, and its address counter set to 0
+	void displayCleared();
+
+	/// The LCD's address counter has been moved off the display, as by a
+	/// write to CGRAM
+	void addressLost() { at_known = false; }
+
+	/// Find the next cell the LCD does not show as drawn, and take it as
+	/// sent
+	/// \param[out] address DDRAM address of the cell
+	/// \param[out] c Character to send
+	/// \param[out] move True when the LCD's address must be set to address
+	/// before the character is sent
+	/// \return False when the LCD shows the frame as drawn
+	bool next(uint8_t *address, uint8_t *c, bool *move);
+};
+
+#endif // LCD_FRAMEBUFFER
+
+#endif // LCD_FRAMEBUFFER_HH_
@@ -0,0 +1,55 @@
+#include "LcdQueue.hh"
+
+#ifdef LCD_QUEUE
+
+namespace lcdqueue {
+
+static volatile uint8_t queue[LCD_QUEUE_SIZE];
+static volatile uint8_t head = 0;   // Next to push, moved by the main loop
+static volatile uint8_t tail = 0;   // Being sent, moved by the interrupt
+static uint8_t phase = 0;           // Steps of the tail's load taken
+
+void reset() {
+	head = tail = 0;
+	phase = 0;
+}
+
+uint8_t room() {
+	return (tail - head - 1) & (LCD_QUEUE_SIZE - 1);
+}
+
+bool empty() {
+	return head == tail;
+}
+
+void push(uint8_t load) {
+	uint8_t h = head;
+
+	queue[h] = load;
+	head = (h + 1) & (LCD_QUEUE_SIZE - 1);
+}
+
+bool step(uint8_t *value) {
+	uint8_t t = tail;
+
+	if ( t == head )
+		return false;
+
+	*value = queue[t];
+	if ( phase == 0 )
+		phase = 1;
+	else if ( phase == 1 ) {
+		*value |= LCD_LOAD_ENABLE;
+		phase = 2;
+	}
+	else {
+		// The enable falls, and the LCD takes the nibble
+		phase = 0;
+		tail = (t + 1) & (LCD_QUEUE_SIZE - 1);
+	}
+	return true;
+}
+
+}
+
+#endif // LCD_QUEUE
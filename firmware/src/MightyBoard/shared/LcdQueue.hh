@@ -0,0 +1,60 @@
+#ifndef LCD_QUEUE_HH_
+#define LCD_QUEUE_HH_
+
+#include <stdint.h>
+
+#ifndef SIMULATOR
+#include "Configuration.hh"
+#else
+#include "Simulator.hh"
+#endif
+
+#ifdef LCD_QUEUE
+
+/// Loads the queue holds; a power of two
+#define LCD_QUEUE_SIZE 64
+
+/// Bit of a load which drives the LCD's enable, as pulseEnable() sets it
+#define LCD_LOAD_ENABLE 0x08
+
+/// Microseconds to wait after each step when the queue is run from the
+/// main loop rather than by the timer.  The LCD needs 37 us after taking
+/// a byte before the next, and a byte's last step and the next one's
+/// enable are two steps apart, one of which may be the timer's
+#define LCD_QUEUE_STEP_MICROS 40
+
+/// The LCD's output, queued for the microsecond timer's interrupt to send.
+///
+/// Each entry is a load, as LiquidCrystalSerial::load() is given one: the
+/// byte for the LCD's shift register holding a nibble and the register
+/// select.  step() is called on every tick of the timer, and hands out
+/// what the shift register is to be set to: the load, then the load with
+/// the enable set, then the load again with it cleared, upon which the LCD
+/// takes the nibble.  A byte is two loads, six ticks, and the 100 us
+/// between them is well over what the LCD needs.  push() is only called
+/// from the main loop and step() only from the interrupt, so neither needs
+/// to hold off the other.
+namespace lcdqueue {
+
+/// Empty the queue, and start the next load from its first step
+void reset();
+
+/// Loads which may be pushed
+uint8_t room();
+
+/// True when every load pushed has been sent
+bool empty();
+
+/// Queue a load; there must be room for it
+void push(uint8_t load);
+
+/// Take the next step of sending the queue
+/// \param[out] value What to set the shift register to
+/// \return False when the queue is empty
+bool step(uint8_t *value);
+
+}
+
+#endif // LCD_QUEUE
+
+#endif // LCD_QUEUE_HH_
@@ -5,6 +5,9 @@
 #include <string.h>
 #include <util/delay.h>
 #include "TWI.hh"
+#ifdef LCD_QUEUE
+#include <util/atomic.h>
+#endif
 
 
 // When the display powers up, it is configured as follows:
@@ -88,6 +91,9 @@ void LiquidCrystalSerial::init(Pin strobe, Pin data, Pin clk)
   _clk_pin.setDirection(true);
   
   _displayfunction = LCD_4BITMODE | LCD_1LINE | LCD_5x8DOTS;
+#ifdef LCD_QUEUE
+  _queued = false;
+#endif
     
   // begin(16, 1);  
 }
@@ -109,6 +115,14 @@ void LiquidCrystalSerial::begin(uint8_t cols, uint8_t lines, uint8_t dotsize) {
   // according to datasheet, we need at least 40ms after power rises above 2.7V
   // before sending commands. Arduino can turn on way befer 4.5V so we'll wait 50
   _delay_us(50000);
+
+#ifdef LCD_QUEUE
+  // Whatever was queued is dropped, and the LCD set up directly
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    lcdqueue::reset();
+  }
+  _queued = false;
+#endif
   
 #ifndef HAS_I2C_LCD
   // Now we pull both RS and R/W low to begin commands
@@ -158,7 +172,14 @@ void LiquidCrystalSerial::begin(uint8_t cols, uint8_t lines, uint8_t dotsize) {
   display();
 
   // clear it off
+#ifdef LCD_FRAMEBUFFER
+  // What was drawn is sent again by the next flush()
+  command(LCD_CLEARDISPLAY);
+  _delay_us(2000);
+  _frame.displayCleared();
+#else
   clear();
+#endif
 
   // Initialize to default text direction (for romance languages)
   _displaymode = LCD_ENTRYLEFT | LCD_ENTRYSHIFTDECREMENT;
@@ -267,9 +288,29 @@ void LiquidCrystalSerial::begin(uint8_t cols, uint8_t lines, uint8_t dotsize) {
     createChar(LCD_CUSTOM_CHAR_PLATFORM_HEATING, platform_heating);
     createChar(LCD_CUSTOM_CHAR_PLATFORM_HEATING, platform_heating);
 #endif
+
+#ifdef LCD_QUEUE
+    _queued = true;
+#endif
 }
 
 /********** high level commands, for the user! */
+#ifdef LCD_FRAMEBUFFER
+
+// Only the framebuffer is cleared; flush() sends the cells which change
+void LiquidCrystalSerial::clear()
+{
+  _frame.clear();
+  _xcursor = 0; _ycursor = 0;
+}
+
+void LiquidCrystalSerial::home()
+{
+  setCursor(0, 0);
+}
+
+#else
+
 void LiquidCrystalSerial::clear()
 {
   command(LCD_CLEARDISPLAY);  // clear display, set cursor position to zero
@@ -282,6 +323,8 @@ void LiquidCrystalSerial::home()
   _delay_us(2000);  // this command takes a long time!
 }
 
+#endif
+
 // A faster version of home()
 void LiquidCrystalSerial::homeCursor()
 {
@@ -304,13 +347,15 @@ void LiquidCrystalSerial::clearHomeCursor()
 
 void LiquidCrystalSerial::setCursor(uint8_t col, uint8_t row)
 {
-  int row_offsets[] = { 0x00, 0x40, 0x14, 0x54 };
   if ( row > _numlines ) {
     row = _numlines-1;    // we count rows starting w/0
   }
   
   _xcursor = col; _ycursor = row;
+#ifndef LCD_FRAMEBUFFER
+  int row_offsets[] = { 0x00, 0x40, 0x14, 0x54 };
   command(LCD_SETDDRAMADDR | (col + row_offsets[row]));
+#endif
 }
 
 //If col or row = -1, then the current position is retained
@@ -388,10 +433,45 @@ void LiquidCrystalSerial::noAutoscroll(void) {
 void LiquidCrystalSerial::createChar(uint8_t location, uint8_t charmap[]) {
   location &= 0x7; // we only have 8 locations 0-7
   command(LCD_SETCGRAMADDR | (location << 3));
+#ifdef LCD_FRAMEBUFFER
+  for (int i=0; i<8; i++) {
+    send(charmap[i], true);
+  }
+  _frame.addressLost();
+#else
   for (int i=0; i<8; i++) {
     write(charmap[i]);
   }
+#endif
+}
+
+#ifdef LCD_FRAMEBUFFER
+void LiquidCrystalSerial::flush(uint8_t cells) {
+  uint8_t address, c;
+  bool move;
+  bool all = (cells == LCD_FLUSH_ALL);
+
+  for (; all || cells; cells--) {
+#ifdef LCD_QUEUE
+    // Room for a cursor move and a character, four loads, unless waiting
+    // for the queue to be sent
+    if (_queued && !all && lcdqueue::room() < 4)
+      break;
+#endif
+    if (!_frame.next(&address, &c, &move))
+      break;
+    if (move)
+      command(LCD_SETDDRAMADDR | address);
+    send(c, true);
+  }
+
+#ifdef LCD_QUEUE
+  if (all)
+    while (!lcdqueue::empty())
+      stepQueue();
+#endif
 }
+#endif
 
 /*********** mid level commands, for sending data/cmds */
 
@@ -400,7 +480,11 @@ void LiquidCrystalSerial::command(uint8_t value) {
 }
 
 inline void LiquidCrystalSerial::write(uint8_t value) {
+#ifdef LCD_FRAMEBUFFER
+  _frame.put(_xcursor, _ycursor, value);
+#else
   send(value, true);
+#endif
   _xcursor++;
   if(_xcursor >= _numCols)
 	setCursor(0,_ycursor+1);
@@ -640,11 +724,62 @@ void LiquidCrystalSerial::send(uint8_t value, bool mode) {
 	else
 		modeBits = 0b0000;
 		
+#ifdef LCD_QUEUE
+	if (_queued) {
+		queueLoad((value&0xF0) + modeBits);
+		queueLoad(((value<<4)&0xF0) + modeBits);
+		return;
+	}
+#endif
+
  //serial assumes 4 bit mode
     load((value&0xF0) + modeBits);
     load(((value<<4)&0xF0) + modeBits);
 }
 
+#ifdef LCD_QUEUE
+
+// writeSerial() through direct port access, for the timer's interrupt.
+// The shift register needs no more time than the instructions take, and
+// the LCD's timing is kept by the ticks between steps
+static inline void shiftLoad(uint8_t value) {
+	for (uint8_t bit = 0x80; bit; bit >>= 1) {
+		LCD_CLK_PORT &= ~_BV(LCD_CLK_BIT);
+		if (value & bit)
+			LCD_DATA_PORT |= _BV(LCD_DATA_BIT);
+		else
+			LCD_DATA_PORT &= ~_BV(LCD_DATA_BIT);
+		LCD_CLK_PORT |= _BV(LCD_CLK_BIT);
+	}
+	LCD_STROBE_PORT |= _BV(LCD_STROBE_BIT);
+	LCD_STROBE_PORT &= ~_BV(LCD_STROBE_BIT);
+}
+
+void LiquidCrystalSerial::runQueue() {
+	uint8_t value;
+
+	if (lcdqueue::step(&value))
+		shiftLoad(value);
+}
+
+// Take a step from the main loop, and give the LCD the time the timer
+// would have
+void LiquidCrystalSerial::stepQueue() {
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		runQueue();
+	}
+	_delay_us(LCD_QUEUE_STEP_MICROS);
+}
+
+// Queue a load, sending what is ahead of it when the queue is full
+void LiquidCrystalSerial::queueLoad(uint8_t value) {
+	while (!lcdqueue::room())
+		stepQueue();
+	lcdqueue::push(value);
+}
+
+#endif
+
 void LiquidCrystalSerial::load(uint8_t value)
 {
 	writeSerial(value);
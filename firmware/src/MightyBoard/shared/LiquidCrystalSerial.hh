@@ -6,6 +6,8 @@
 #include <stdint.h>
 #include <avr/pgmspace.h>
 #include "Pin.hh"
+#include "LcdFramebuffer.hh"
+#include "LcdQueue.hh"
 
 // commands
 #define LCD_CLEARDISPLAY 0x01
@@ -64,6 +66,9 @@
 
 // TODO:  make variable names for rs, rw, e places in the output vector
 
+/// flush() everything, and return once the LCD shows it
+#define LCD_FLUSH_ALL 0xff
+
 class LiquidCrystalSerial {
 public:
   LiquidCrystalSerial(Pin strobe, Pin data, Pin CLK);
@@ -118,11 +123,31 @@ public:
 
   void command(uint8_t);
 
+#ifdef LCD_FRAMEBUFFER
+  /// Send the LCD up to the given number of the cells drawn since it was
+  /// last sent them; with LCD_QUEUE they are queued, as far as there is
+  /// room, unless flushing everything
+  void flush(uint8_t cells = LCD_FLUSH_ALL);
+#else
+  /// Characters are sent as they are written
+  void flush(uint8_t cells = LCD_FLUSH_ALL) {}
+#endif
+
+#ifdef LCD_QUEUE
+  /// Take the next step of sending the queue; called by the microsecond
+  /// timer's interrupt
+  static void runQueue();
+#endif
+
 private:
   void send(uint8_t, bool);
   void writeSerial(uint8_t);
   void load(uint8_t);
   void pulseEnable(uint8_t value);
+#ifdef LCD_QUEUE
+  void queueLoad(uint8_t value);
+  void stepQueue();
+#endif
 
 #ifdef HAS_I2C_LCD
   void write4bits(uint8_t value, bool dataMode);
@@ -144,6 +169,13 @@ private:
   uint8_t _ycursor;
 
   uint8_t _numlines,_numCols;
+
+#ifdef LCD_FRAMEBUFFER
+  LcdFramebuffer _frame;
+#endif
+#ifdef LCD_QUEUE
+  bool _queued; // send() queues, once begin() has set the LCD up
+#endif
 };
 
 #endif // LIQUID_CRYSTAL_HH
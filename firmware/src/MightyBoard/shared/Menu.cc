@@ -28,6 +28,15 @@
 #include "Menu_locales.hh"
 #include "lib_sd/sd_raw_err.h"
 #include "Heater.hh" // for MAX_VALID_TEMP
+#ifdef PRINT_CHECKPOINT
+#include "Checkpoint.hh"
+#endif
+#ifdef PREHEAT_SCHEDULER
+#include "Preheat.hh"
+#endif
+#ifdef SLICE_PROFILE
+#include "SliceProfile.hh"
+#endif
 
 //#define HOST_PACKET_TIMEOUT_MS 20
 //#define HOST_PACKET_TIMEOUT_MICROS (1000L*HOST_PACKET_TIMEOUT_MS)
@@ -91,6 +100,10 @@ SelectAlignmentMenu           selectAlignmentMenu;
 EepromMenu                    eepromMenu;
 #endif
 
+#ifdef PID_AUTOTUNE
+AutotuneScreen                autotuneScreen;
+#endif
+
 /// Static instances of our menus
 
 //Macros to expand SVN revision macro into a str
@@ -359,6 +372,9 @@ void HeaterPreheatMenu::handleSelect(uint8_t index) {
 	case 0:
 		preheatActive = !preheatActive;
 		// clear paused state if any
+#if defined(PREHEAT_SCHEDULER)
+		preheat::abort();
+#endif
 		Motherboard::pauseHeaters(false);
 		if ( preheatActive ) {
 			Motherboard::getBoard().resetUserInputTimeout();
@@ -372,7 +388,9 @@ void HeaterPreheatMenu::handleSelect(uint8_t index) {
 				temp = eeprom::getEeprom16(eeprom_offsets::PREHEAT_SETTINGS + preheat_eeprom_offsets::PREHEAT_PLATFORM_TEMP, DEFAULT_PREHEAT_HBP) *_platformActive;
 				Motherboard::getBoard().getPlatformHeater().set_target_temperature(temp);
 			}
-#if !defined(HEATERS_ON_STEROIDS)
+#if defined(PREHEAT_SCHEDULER)
+			preheat::schedule();
+#elif !defined(HEATERS_ON_STEROIDS)
 			if ( Motherboard::getBoard().getPlatformHeater().isHeating() )
 				Motherboard::pauseHeaters(true);
 #endif
@@ -445,6 +463,7 @@ void NozzleCalibrationScreen::update(LiquidCrystalSerial& lcd, bool forceRedraw)
 			break;
 		}
 		lcd.writeFromPgmspace(msg);
+		lcd.flush();
 		_delay_us(500000);
 		Motherboard::interfaceBlinkOn();
 	}
@@ -680,6 +699,7 @@ void FilamentScreen::update(LiquidCrystalSerial& lcd, bool forceRedraw) {
 			/// alert user to press M to stop extusion / reversal
 		case FILAMENT_STOP:
 			lcd.writeFromPgmspace(STOP_EXIT_MSG);
+			lcd.flush();
 			Motherboard::interfaceBlinkOn();
 			_delay_us(1000000);
 			break;
@@ -1221,6 +1241,12 @@ void MonitorModeScreen::update(LiquidCrystalSerial& lcd, bool forceRedraw) {
 #ifdef ACCEL_STATS
 	const static PROGMEM prog_uchar mon_speed[] 	     = "Acc:                ";
 #endif
+#ifdef SLICE_PROFILE
+	const static PROGMEM prog_uchar mon_slowest[]            = "Slow:               ";
+	// Seven characters for each of profile::Slice
+	const static PROGMEM prog_uchar mon_slices[]             = "host   commandboard  screen sd     planner";
+	const static PROGMEM prog_uchar mon_ms[]                 = "ms";
+#endif
 #endif
 	Motherboard& board = Motherboard::getBoard();
 
@@ -1520,6 +1546,22 @@ void MonitorModeScreen::update(LiquidCrystalSerial& lcd, bool forceRedraw) {
 			lcd.write(' ');
 			break;
 #endif // ACCEL_STATS
+
+#ifdef SLICE_PROFILE
+		case BUILD_TIME_PHASE_SLICE_PROFILE:
+			{
+				// The slice which has held up the main loop longest
+				uint16_t longest;
+				uint8_t slice = profile::worst(&longest);
+				lcd.moveWriteFromPgmspace(0, 1, mon_slowest);
+				lcd.setCursor(6,1);
+				for ( uint8_t i = 0; i < 7; i++ )
+					lcd.write(pgm_read_byte(&mon_slices[slice * 7 + i]));
+				lcd.writeFloat((float)longest / 1000.0, 1, LCD_SCREEN_WIDTH - 2);
+				lcd.writeFromPgmspace(mon_ms);
+			}
+			break;
+#endif // SLICE_PROFILE
 		}
 
         	if ( ! okButtonHeld ) {
@@ -2964,6 +3006,10 @@ MainMenu::MainMenu() :
 void MainMenu::resetState() {
 	itemIndex = 1;
 	firstItemIndex = 1;
+#ifdef PRINT_CHECKPOINT
+	// Offer to resume a build interrupted by a power failure
+	itemCount = checkpoint::available() ? 5 : 4;
+#endif
 }
 
 void MainMenu::drawItem(uint8_t index, LiquidCrystalSerial& lcd) {
@@ -2989,6 +3035,11 @@ void MainMenu::drawItem(uint8_t index, LiquidCrystalSerial& lcd) {
 	case 3:
 		msg = UTILITIES_MSG;
 		break;
+#ifdef PRINT_CHECKPOINT
+	case 4:
+		msg = RESUME_PRINT_MSG;
+		break;
+#endif
 	}
 	lcd.writeFromPgmspace(msg);
 }
@@ -3007,6 +3058,15 @@ void MainMenu::handleSelect(uint8_t index) {
 		// home axes script
 		interface::pushScreen(&utilityMenu);
 		break;
+#ifdef PRINT_CHECKPOINT
+	case 4:
+		// Resume an interrupted SD card build
+		if ( host::getHostState() != host::HOST_STATE_READY )
+			MenuBadness(BUILDING_MSG);
+		else if ( !checkpoint::resume() )
+			MenuBadness((sdcard::sdAvailable == sdcard::SD_ERR_CRC) ? CARDCRC_MSG : CARDOPENERR_MSG);
+		break;
+#endif
 	}
 }
 
@@ -3022,11 +3082,23 @@ void UtilitiesMenu::resetState(){
 	singleTool = eeprom::isSingleTool();
 	itemCount = 17;
 	if ( singleTool ) --itemCount;
+#ifdef PID_AUTOTUNE
+	++itemCount;
+#endif
 	stepperEnable = ( axesEnabled ) ? false : true;
 }
 
 void UtilitiesMenu::drawItem(uint8_t index, LiquidCrystalSerial& lcd) {
 	const prog_uchar *msg;
+#ifdef PID_AUTOTUNE
+	// PID Autotune goes just before Exit
+	if ( index == itemCount - 2 ) {
+		lcd.writeFromPgmspace(AUTOTUNE_MSG);
+		return;
+	}
+	else if ( index == itemCount - 1 )
+		--index;
+#endif
 	switch (index) {
 	default:
 		return;
@@ -3091,6 +3163,14 @@ void UtilitiesMenu::drawItem(uint8_t index, LiquidCrystalSerial& lcd) {
 
 void UtilitiesMenu::handleSelect(uint8_t index) {
 
+#ifdef PID_AUTOTUNE
+	if ( index == itemCount - 2 ) {
+		interface::pushScreen(&autotuneScreen);
+		return;
+	}
+	else if ( index == itemCount - 1 )
+		--index;
+#endif
 	switch (index) {
 	case 0:
 		// Show monitor build screen
@@ -3219,6 +3299,131 @@ void BotStatsScreen::notifyButtonPressed(ButtonArray::ButtonName button) {
 		interface::popScreen();
 }
 
+#ifdef PID_AUTOTUNE
+
+Heater& AutotuneScreen::heater() {
+	Motherboard& board = Motherboard::getBoard();
+	return (heaterIndex == 2) ? board.getPlatformHeater() :
+		board.getExtruderBoard(heaterIndex).getExtruderHeater();
+}
+
+void AutotuneScreen::reset() {
+	singleTool = eeprom::isSingleTool();
+	hasHBP = eeprom::hasHBP();
+
+	// Show the tune in progress, if any
+	for ( heaterIndex = 0; heaterIndex < 3; heaterIndex++ )
+		if ( heater().isAutotuning() )
+			return;
+	heaterIndex = 0;
+	if ( target == 0 )
+		target = 220;
+}
+
+void AutotuneScreen::update(LiquidCrystalSerial& lcd, bool forceRedraw) {
+	const PIDAutotune& tune = Heater::getAutotune();
+	bool running = heater().isAutotuning();
+
+	if ( running )
+		target = tune.getTarget();
+
+	if ( forceRedraw ) {
+		lcd.clearHomeCursor();
+		lcd.writeFromPgmspace(AUTOTUNE_MSG);
+		lcd.moveWriteFromPgmspace(0, 2, AUTOTUNE_TEMPS_MSG);
+	}
+
+	lcd.moveWriteFromPgmspace(0, 1, (heaterIndex == 2) ? PLATFORM_SPACES_MSG :
+				  ((heaterIndex == 1) ? LEFT_SPACES_MSG : RIGHT_SPACES_MSG));
+
+	lcd.setCursor(7, 2);
+	lcd.writeInt(target, 3);
+	lcd.setCursor(16, 2);
+	lcd.writeInt((uint16_t)heater().get_current_temperature(), 3);
+
+	// The result of the last tune stays up until another is started
+	uint8_t state = tune.getState();
+	if ( !running && tune.isRunning() )
+		state = PIDAutotune::AT_IDLE;
+
+	switch ( state ) {
+	case PIDAutotune::AT_HEATING:
+		lcd.moveWriteFromPgmspace(0, 3, AUTOTUNE_HEATING_MSG);
+		break;
+	case PIDAutotune::AT_CYCLING:
+		lcd.moveWriteFromPgmspace(0, 3, AUTOTUNE_CYCLE_MSG);
+		lcd.setCursor(10, 3);
+		lcd.writeInt(tune.getCycles(), 1);
+		lcd.write('/');
+		lcd.writeInt(AUTOTUNE_CYCLES, 1);
+		break;
+	case PIDAutotune::AT_DONE:
+		lcd.moveWriteFromPgmspace(0, 3, AUTOTUNE_GAINS_MSG);
+		lcd.setCursor(0, 3);
+		lcd.writeFloat(tune.getPGain() / 256.0, 2, 6);
+		lcd.setCursor(7, 3);
+		lcd.writeFloat(tune.getIGain() / 256.0, 2, 13);
+		lcd.setCursor(14, 3);
+		lcd.writeFloat(tune.getDGain() / 256.0, 1, LCD_SCREEN_WIDTH);
+		break;
+	case PIDAutotune::AT_FAILED:
+		lcd.moveWriteFromPgmspace(0, 3, AUTOTUNE_FAILED_MSG);
+		break;
+	default:
+		lcd.moveWriteFromPgmspace(0, 3, UPDNLRM_MSG);
+		break;
+	}
+}
+
+void AutotuneScreen::notifyButtonPressed(ButtonArray::ButtonName button) {
+	bool running = heater().isAutotuning();
+	int16_t temp = (int16_t)target;
+
+	switch (button) {
+	case ButtonArray::CENTER:
+		if ( running )
+			// Stopping the tune turns the heater off
+			heater().set_target_temperature(0);
+		else if ( host::getHostState() != host::HOST_STATE_READY )
+			MenuBadness(BUILDING_MSG);
+		else
+			heater().startAutotune(target);
+		return;
+	case ButtonArray::LEFT:
+		// The tune carries on
+		interface::popScreen();
+		return;
+	case ButtonArray::RIGHT:
+		if ( running )
+			return;
+		// Next heater fitted
+		do {
+			heaterIndex = (heaterIndex + 1) % 3;
+		} while ( (heaterIndex == 1 && singleTool) || (heaterIndex == 2 && !hasHBP) );
+		temp = (heaterIndex == 2) ? 100 : 220;
+		break;
+	case ButtonArray::UP:
+		if ( running )
+			return;
+		temp += 1;
+		break;
+	case ButtonArray::DOWN:
+		if ( running )
+			return;
+		temp -= 1;
+		break;
+	default:
+		return;
+	}
+
+	int16_t maxtemp = (heaterIndex == 2) ? MAX_HBP_TEMP : MAX_VALID_TEMP;
+	if ( temp > maxtemp ) temp = maxtemp;
+	else if ( temp < 0 ) temp = 0;
+	target = (uint16_t)temp;
+}
+
+#endif
+
 SettingsMenu::SettingsMenu() :
 	CounterMenu(_BV((uint8_t)ButtonArray::UP) | _BV((uint8_t)ButtonArray::DOWN), (uint8_t)9
 #ifdef DITTO_PRINT
@@ -3444,7 +3649,7 @@ void SettingsMenu::handleSelect(uint8_t index) {
 //Returns true if the file is an s3g/j4g file
 //Keeping this in C instead of C++ saves 20 bytes
 
-bool isSXGFile(char *filename, uint8_t len) {
+bool isSXGFile(const char *filename, uint8_t len) {
 	if ((len >= 4) &&
 	    (filename[len-4] == '.') &&
 	    ((filename[len-3] == 's') || (filename[len-3] == 'x') ||
@@ -3454,9 +3659,32 @@ bool isSXGFile(char *filename, uint8_t len) {
 	return false;
 }
 
+// List .. and any folder which doesn't begin with ., and s3g/x3g files
+static bool isListed(const char *name, uint8_t len, bool isdir) {
+	if ( isdir )
+		return name[0] != '.' || ( name[1] == '.' && name[2] == 0 );
+	return isSXGFile(name, len);
+}
+
 // Count the number of files on the SD card
 static uint8_t fileCount;
 
+#ifdef SD_DIR_INDEX
+
+uint8_t countFiles() {
+	fileCount = sdcard::directoryCount(isListed);
+	return fileCount;
+}
+
+bool getFilename(uint8_t index, char buffer[], uint8_t buffer_size, uint8_t *buflen, bool *isdir) {
+#ifdef REVERSE_SD_FILES
+	index = (fileCount - 1) - index;
+#endif
+	return sdcard::directoryEntry(index, isListed, buffer, buffer_size, buflen, isdir);
+}
+
+#else
+
 uint8_t countFiles() {
 	fileCount = 0;
 
@@ -3474,11 +3702,7 @@ uint8_t countFiles() {
 		sdcard::directoryNextEntry(fnbuf,sizeof(fnbuf),&flen,&isdir);
 		if ( fnbuf[0] == 0 )
 			return fileCount;
-		// Count .. and anyfile which doesn't begin with .
-		if ( isdir ) {
-			if ( fnbuf[0] != '.' || ( fnbuf[1] == '.' && fnbuf[2] == 0 ) ) fileCount++;
-		}
-		else if ( isSXGFile(fnbuf, flen) ) fileCount++;
+		if ( isListed(fnbuf, flen, isdir) ) fileCount++;
 	} while (true);
 
 	// Never reached
@@ -3508,11 +3732,7 @@ bool getFilename(uint8_t index, char buffer[], uint8_t buffer_size, uint8_t *buf
 			if ( buffer[0] == 0 )
 				// No more files
 				return false;
-			if ( my_isdir ) {
-				if ( buffer[0] != '.' || ( buffer[1] == '.' && buffer[2] == 0 ) )
-					break;
-			}
-			else if ( isSXGFile(buffer, my_buflen) )
+			if ( isListed(buffer, my_buflen, my_isdir) )
 				break;
 		} while (true);
 	}
@@ -3523,6 +3743,8 @@ bool getFilename(uint8_t index, char buffer[], uint8_t buffer_size, uint8_t *buf
 	return true;
 }
 
+#endif // SD_DIR_INDEX
+
 FinishedPrintMenu::FinishedPrintMenu() :
 	Menu(0, (uint8_t)4)
 {
@@ -662,6 +662,9 @@ private:
 		BUILD_TIME_PHASE_FILAMENT,
 #ifdef ACCEL_STATS
 		BUILD_TIME_PHASE_ACCEL_STATS,
+#endif
+#ifdef SLICE_PROFILE
+		BUILD_TIME_PHASE_SLICE_PROFILE,
 #endif
 		BUILD_TIME_PHASE_LAST	//Not counted, just an end marker
 	};
@@ -776,6 +779,33 @@ public:
 	void notifyButtonPressed(ButtonArray::ButtonName button);
 };
 
+#ifdef PID_AUTOTUNE
+
+class Heater;
+
+class AutotuneScreen: public Screen {
+
+private:
+	uint8_t heaterIndex;    ///< 0 right tool, 1 left tool, 2 platform
+	uint16_t target;
+
+	Heater& heater();
+
+public:
+	AutotuneScreen() : Screen(_BV((uint8_t)ButtonArray::UP) | _BV((uint8_t)ButtonArray::DOWN)),
+			   heaterIndex(0), target(0) {}
+
+	micros_t getUpdateRate() {return 500L * 1000L;}
+
+	void update(LiquidCrystalSerial& lcd, bool forceRedraw);
+
+	void reset();
+
+	void notifyButtonPressed(ButtonArray::ButtonName button);
+};
+
+#endif
+
 class UtilitiesMenu: public Menu {
 
 public:
@@ -23,14 +23,23 @@
  */
 
 #include <stdlib.h>
+#include <math.h>
 #include "PID.hh"
 
-#define ERR_ACC_MAX 256
+#define ERR_ACC_MAX ((int32_t)256 << PID_ERROR_FRAC_BITS)
 #define ERR_ACC_MIN -ERR_ACC_MAX
 
 // scale the output term to account for our fixed-point bounds
 #define OUTPUT_SCALE 2
 
+// Multiply an error by a Q8.8 gain, keeping the error's fraction bits.  The
+// gain's whole and fraction parts are applied separately, so that neither
+// product can overflow 32 bits.
+static int32_t gain(const int32_t x, const uint16_t g) {
+	return x * (g >> PID_GAIN_FRAC_BITS) +
+		((x * (g & ((1 << PID_GAIN_FRAC_BITS) - 1))) >> PID_GAIN_FRAC_BITS);
+}
+
 PID::PID() {
     reset();
 }
@@ -67,8 +76,12 @@ void PID::reset_state() {
 // which will give us a delta impulse for that one calculation round and then
 // the D term will immediately disappear.  By averaging the last N deltas, we
 // allow changes to be registered rather than get subsumed in the sampling noise.
+//
+// The process value is the only float; it is rounded to 1/256 degree and all
+// else is integer.  The sum of the terms is truncated toward zero, as the
+// float terms were.
 int PID::calculate(const float pv) {
-	float e = sp - pv;
+	int32_t e = ((int32_t)sp << PID_ERROR_FRAC_BITS) - lround(pv * (1 << PID_ERROR_FRAC_BITS));
 	error_acc += e;
 	// Clamp the error accumulator at accepted values.
 	// This will help control overcorrection for accumulated error during the run-up
@@ -78,20 +91,21 @@ int PID::calculate(const float pv) {
 		error_acc = ERR_ACC_MAX;
 	else if (error_acc < ERR_ACC_MIN)
 		error_acc = ERR_ACC_MIN;
-	float p_term = (float)e * p_gain;
-	float i_term = (float)error_acc * i_gain;
-	float delta = e - prev_error;
+	int32_t p_term = gain(e, p_gain);
+	int32_t i_term = gain(error_acc, i_gain);
+	int32_t delta = e - prev_error;
 	// Add to delta history
 	delta_summation -= delta_history[delta_idx];
 	delta_history[delta_idx] = delta;
-	delta_summation += (float)delta;
+	delta_summation += delta;
 	delta_idx = (delta_idx+1) % DELTA_SAMPLES;
 	// Use the delta over the whole window
-	float d_term = delta_summation * d_gain;
+	int32_t d_term = gain(delta_summation, d_gain);
 
 	prev_error = e;
 
-	last_output = ((int)(p_term + i_term + d_term))*OUTPUT_SCALE;
+	last_output = ((int)((p_term + i_term + d_term) /
+			     ((int32_t)1 << PID_ERROR_FRAC_BITS)))*OUTPUT_SCALE;
 
 	return last_output;
 }
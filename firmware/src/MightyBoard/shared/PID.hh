@@ -29,21 +29,34 @@
 /// Number of delta samples to
 #define DELTA_SAMPLES 4 // PID::reset_state() assumes 4.
 
+/// Fraction bits of the errors the PID works with: 1/256 degree
+#define PID_ERROR_FRAC_BITS 8
+
+/// Fraction bits of the gains: Q8.8, as the EEPROM holds them
+#define PID_GAIN_FRAC_BITS 8
+
+/// Convert a gain to Q8.8 at compile time
+#define PID_GAIN_Q8_8(g) ((uint16_t)((g) * 256.0 + 0.5))
+
 /// The PID controller module implements a simple PID controller.
+///
+/// All of its arithmetic is integer: errors are fixed point with
+/// PID_ERROR_FRAC_BITS fraction bits and gains Q8.8, so that only the
+/// process value given to calculate() is a float.
 /// \ingroup SoftwareLibraries
 class PID {
 private:
-    float p_gain; ///< proportional gain
-    float i_gain; ///< integral gain
-    float d_gain; ///< derivative gain
+    uint16_t p_gain; ///< proportional gain, Q8.8
+    uint16_t i_gain; ///< integral gain, Q8.8
+    uint16_t d_gain; ///< derivative gain, Q8.8
 
     /// Data for approximating d (smoothing to handle discrete nature of sampling).
     /// See PID.cc for a description of why we do this.
-    float delta_history[DELTA_SAMPLES];
-    float delta_summation;      ///< ?
+    int32_t delta_history[DELTA_SAMPLES];
+    int32_t delta_summation;    ///< Sum of delta_history
     uint8_t delta_idx;          ///< Current index in the delta history buffer
-    float prev_error;             ///< Previous input for calculating next delta
-    float error_acc;              ///< Accumulated error, for calculating integral
+    int32_t prev_error;         ///< Previous input for calculating next delta
+    int32_t error_acc;          ///< Accumulated error, for calculating integral
 
     int sp;                     ///< Process set point
     int last_output;            ///< Last output of the PID controller
@@ -53,16 +66,16 @@ public:
     PID();
 
     /// Set the P term of the PID controller
-    /// \param[in] p_gain_in New proportional gain term
-    void setPGain(const float p_gain_in) { p_gain = p_gain_in; }
+    /// \param[in] p_gain_in New proportional gain term, Q8.8
+    void setPGain(const uint16_t p_gain_in) { p_gain = p_gain_in; }
 
     /// Set the I term of the PID controller
-    /// \param[in] i_gain_in New integration gain term
-    void setIGain(const float i_gain_in) { i_gain = i_gain_in; }
+    /// \param[in] i_gain_in New integration gain term, Q8.8
+    void setIGain(const uint16_t i_gain_in) { i_gain = i_gain_in; }
 
     /// Set the D term of the PID controller
-    /// \param[in] d_gain_in New derivative gain term
-    void setDGain(const float d_gain_in) { d_gain = d_gain_in; }
+    /// \param[in] d_gain_in New derivative gain term, Q8.8
+    void setDGain(const uint16_t d_gain_in) { d_gain = d_gain_in; }
 
     /// Set the setpoint of the PID controller
     /// \param[in] target New PID controller target
@@ -85,11 +98,11 @@ public:
 
     /// Get the current value of the error term
     /// \return Error term
-    int getErrorTerm() { return (int)error_acc; }
+    int getErrorTerm() { return (int)(error_acc / (1 << PID_ERROR_FRAC_BITS)); }
 
     /// Get the current value of the delta term
     /// \return Delta term
-    int getDeltaTerm() { return (int)delta_summation; }
+    int getDeltaTerm() { return (int)(delta_summation / (1 << PID_ERROR_FRAC_BITS)); }
 
     /// Get the last process output value
     /// \return Last process output value
@@ -16,11 +16,15 @@
  */
 
 #include "Packet.hh"
+#ifndef SIMULATOR
 #include <util/crc16.h>
+#else
+#include "Simulator.hh"
+#endif
 
 /// Append a byte and update the CRC
 void Packet::appendByte(uint8_t data) {
-	if (length < MAX_PACKET_PAYLOAD) {
+	if (length < PACKET_BUFFER_SIZE) {
 		crc = _crc_ibutton_update(crc, data);
 		payload[length] = data;
 		length++;
@@ -32,7 +36,7 @@ void Packet::reset() {
 	crc = 0;
 	length = 0;
 #ifdef PARANOID
-	for (uint8_t i = 0; i < MAX_PACKET_PAYLOAD; i++) {
+	for (uint8_t i = 0; i < PACKET_BUFFER_SIZE; i++) {
 		payload[i] = 0;
 	}
 #endif // PARANOID
@@ -58,7 +62,7 @@ void InPacket::processByte(uint8_t b) {
 			error(PacketError::NOISE_BYTE);
 		}
 	} else if (state == PS_LEN) {
-		if (b <= MAX_PACKET_PAYLOAD) {
+		if (b <= PACKET_BUFFER_SIZE) {
 			expected_length = b;
 			state = (expected_length == 0) ? PS_CRC : PS_PAYLOAD;
 		} else {
@@ -20,9 +20,23 @@
 
 #include <stdint.h>
 
+#ifndef SIMULATOR
+#include "Configuration.hh"
+#else
+#include "Simulator.hh"
+#endif
+
 #define START_BYTE 0xD5
 #define MAX_PACKET_PAYLOAD 32
 
+// Packets carry at most MAX_PACKET_PAYLOAD bytes of payload, save for
+// HOST_CMD_BATCH packets which may carry up to HOST_BATCH_PAYLOAD bytes
+#if defined(HOST_BATCH_PAYLOAD) && (HOST_BATCH_PAYLOAD > MAX_PACKET_PAYLOAD)
+#define PACKET_BUFFER_SIZE HOST_BATCH_PAYLOAD
+#else
+#define PACKET_BUFFER_SIZE MAX_PACKET_PAYLOAD
+#endif
+
 #define SLAVE_ID_BROADCAST 127
 
 namespace PacketError {
@@ -81,7 +95,7 @@ class Packet {
 protected:
     volatile uint8_t length; /// The current length of the payload (data[0] if raw packets)
     volatile uint8_t crc; /// The CRC of the current contents of the payload (data[-1] of raw packets)
-    volatile uint8_t payload[MAX_PACKET_PAYLOAD]; /// Data payload (starts at data[2] of raw packet)
+    volatile uint8_t payload[PACKET_BUFFER_SIZE]; /// Data payload (starts at data[2] of raw packet)
 	volatile uint8_t error_code; // Have any errors cropped up during processing?
 	volatile uint8_t state;
 
@@ -145,6 +159,57 @@ public:
 	}
 };
 
+/// A ring of input packets.  The receive interrupt fills the packet at the
+/// head while the main loop processes packets, in order, from the tail.
+/// The host may then have several packets in flight rather than waiting on
+/// the response to each before sending the next.  A ring of one packet
+/// behaves just as a lone InPacket.
+///
+/// A packet with an error is not moved past: it is reported once, as with
+/// a lone InPacket.  Should the ring fill, bytes are dropped until the tail
+/// is released; a host must not have more than N packets in flight.
+template<uint8_t N>
+class InPacketRing {
+private:
+	InPacket packets[N];
+	volatile uint8_t head;		///< Packet being received
+	volatile uint8_t tail;		///< Oldest packet not yet released
+
+	static uint8_t next(uint8_t i) { return ( i + 1 < N ) ? i + 1 : 0; }
+public:
+	InPacketRing() : head(0), tail(0) {}
+
+	/// Reset the ring, discarding every packet
+	void reset() {
+		for (uint8_t i = 0; i < N; i++) packets[i].reset();
+		head = tail = 0;
+	}
+
+	/// The oldest packet not yet released.  It may still be in reception.
+	InPacket& current() { return packets[tail]; }
+
+	/// Returns true when packets beyond the current one have arrived, or
+	/// begun to arrive
+	bool hasBacklog() const { return head != tail; }
+
+	/// Process a byte received from the wire.  Called at interrupt level.
+	void processByte(uint8_t b) {
+		if (packets[head].isFinished() == 1) {
+			uint8_t n = next(head);
+			if (n == tail) return;
+			head = n;
+		}
+		packets[head].processByte(b);
+	}
+
+	/// Release the current packet once it has been processed.  The next
+	/// packet, if any, becomes current.
+	void release() {
+		packets[tail].reset();
+		if (tail != head) tail = next(tail);
+	}
+};
+
 /// Output Packet.
 class OutPacket: public Packet {
 private:
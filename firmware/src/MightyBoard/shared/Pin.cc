@@ -24,14 +24,17 @@ void Pin::setDirection(bool out) const {
 void Pin::setValue(bool on) const {
 	// if (is_null)
 	//      return;
-	// uint8_t oldSREG = SREG;
-	// cli();
+	// The port is reached through a pointer, so this is a load, OR or
+	// AND, and store: the microsecond timer's software PWM writes pins on
+	// the same ports, and a step between the load and the store is lost
+	uint8_t oldSREG = SREG;
+	cli();
 	if (on) {
 		PORTx |= pin_mask;
 	} else {
 		PORTx &= pin_mask_inverted;
 	}
-	// SREG = oldSREG;
+	SREG = oldSREG;
 }
 
 bool Pin::getValue() const {
@@ -27,19 +27,19 @@ public:
 	void /*Pin::*/setValueOn() const {
 		// if (is_null)
 		// 	return;
-		// uint8_t oldSREG = SREG;
-		// cli();
+		uint8_t oldSREG = SREG;
+		cli();
 		PORTx |= pin_mask;
-		// SREG = oldSREG;
+		SREG = oldSREG;
 	};
 
 	void /*Pin::*/setValueOff() const {
 		// if (is_null)
 		// 	return;
-		// uint8_t oldSREG = SREG;
-		// cli();
+		uint8_t oldSREG = SREG;
+		cli();
 		PORTx &= pin_mask_inverted;
-		// SREG = oldSREG;
+		SREG = oldSREG;
 	};
 	// currently not used:
 	//const uint8_t getPinIndex() const { return pin_index; }
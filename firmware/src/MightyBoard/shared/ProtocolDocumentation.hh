@@ -59,6 +59,25 @@
 ///
 /// Every packet gets precisely one response packet.  Query commands must be sent in their own packet.  Only action or query commands can be sent in a single packet.  The first byte of the command payload will determine the nature of the entire packet.  Thus, you cannot mix query and action commands in a single packet!
 ///
+/// <h2>Pipelining</h2>
+/// Sailfish on the ATmega2560 will accept up to four host packets in flight at once: the host need not wait for a response before sending the next packet.  Packets are processed, and responded to, strictly in the order they are received.  The host must not have more packets outstanding than the firmware accepts; excess packets are dropped and will time out.
+///
+/// A pipelining host should not rely upon RC_BUFFER_OVERFLOW for flow control.  Rather, it should query the remaining buffer capacity (command 2) and keep the total length of the action commands it has sent since that query within the capacity reported.  Should an action command nonetheless overflow the buffer, every following action command is rejected with RC_BUFFER_OVERFLOW until a query command is received.  The host should collect the responses to its outstanding packets, send a query, and then resend from the first rejected command.
+///
+/// <h2>Batches</h2>
+/// Sailfish on the ATmega2560 also accepts several consecutive action commands in a single HOST_CMD_BATCH (command 28) packet.  The payload is the byte 28 followed by the action commands exactly as they would otherwise be sent, one after the other.  The batch must contain whole commands only; the firmware does not check this.  A batch is queued in its entirety or not at all.  The response is a normal action command response followed by a uint32 holding the remaining buffer capacity after the batch was queued, which the host may use in place of a separate query.  A rejected batch counts as an overflowed action command for the purposes of pipelining.
+///
+/// A batch packet may carry a larger payload than other packets.  The host learns the largest batch payload the firmware accepts, and the number of packets it may have in flight, from the response to the advanced version query (command 27): the uint8 following the variant ID is the largest batch payload, or 0 if batches are not supported, and the uint16 which follows it is the number of packets which may be in flight.  Firmware which reports 0 for both predates these features.  A final uint16 counts the bytes from the host the firmware has dropped since boot because its receive buffer was full, stopping at 65535; it stays 0 for a host which keeps within the packets in flight, at any baud rate.
+///
+/// <h2>Baud rate</h2>
+/// The host UART starts at 115200 baud.  Sailfish on the ATmega2560 may be switched to 250000, 500000 or 1000000 baud with HOST_CMD_SET_BAUD (command 29), whose payload is the uint32 baud rate.  The firmware responds at the old rate with RC_OK, and switches once the response has been sent, or with RC_CMD_UNSUPPORTED if it cannot use the rate.  The host must have no other packets in flight when it sends the command.  Upon receiving RC_OK it changes its own serial port to the new rate, which the USB interface follows, and sends any packet.  If no packet arrives at the new rate within two seconds, the firmware returns to 115200 baud.  Opening the serial port resets the bot and so also restores 115200 baud.
+///
+/// <h2>Telemetry</h2>
+/// Rather than polling for temperatures, position and build progress, a host may ask Sailfish on the ATmega2560 to send them unasked with HOST_CMD_SET_TELEMETRY (command 30).  Its payload is a uint16 interval in milliseconds, at least 50, or 0 to stop.  Telemetry frames are then sent at that interval whenever the bot is not receiving or answering a packet.  A frame is an ordinary packet whose first payload byte is 0x90, which no response begins with; the host must set such packets aside rather than take them as the response to its oldest outstanding packet.  Each frame carries a sequence number, the board status, build state and percentage, the heater states, temperatures and setpoints, the position in steps, the endstops, the free command buffer space, the line number and the count of dropped host bytes, as in the advanced version response.  Telemetry.hh gives the layout, and the simulator's telemetry tool decodes a captured stream.  A host reset stops telemetry.
+///
+/// <h2>PID autotune</h2>
+/// Sailfish on the ATmega2560 can tune a heater's PID gains by relay feedback.  HOST_CMD_AUTOTUNE (command 31) takes a uint8 heater, 0 or 1 for the extruders and 2 for the platform, and a uint16 target temperature.  A non-zero target starts a tune of that heater at that target, stopping any other tune and switching its heater off; it is refused with RC_BOT_BUILDING during a build, and with RC_CMD_UNSUPPORTED for a missing, disabled or failed heater.  A target of 0 only asks after the last tune.  The response is RC_OK followed by a uint8 state (0 idle or stopped, 1 heating, 2 cycling, 3 done, 4 failed), a uint8 count of relay cycles completed, a uint8 which is 1 if the heater given is being tuned, and the uint16 P, I and D gains found, Q8.8 as the EEPROM holds them.  A tune runs five cycles about the target and takes some minutes.  On finishing, the gains are written to the heater's PID settings in EEPROM and used at once, and the heater is switched off.  A tune fails, switching the heater off, if the heater overshoots the target by 20 degrees or takes too long.  Setting the heater's temperature, pausing or resetting stops a tune.
+///
 /// <h2>Command Types</h2>
 /// <table>
 ///  <tr>
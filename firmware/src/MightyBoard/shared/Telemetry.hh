@@ -0,0 +1,39 @@
+#ifndef TELEMETRY_HH_
+#define TELEMETRY_HH_
+
+// Layout of the telemetry frames sent to the host, unasked, once it has
+// enabled them with HOST_CMD_SET_TELEMETRY.  A frame is an ordinary packet
+// whose first payload byte is TELEMETRY_FRAME, which no response begins
+// with.  Multibyte fields are little endian, as elsewhere in the protocol.
+
+#define TELEMETRY_FRAME          0x90
+
+// Shortest interval between frames, milliseconds
+#define TELEMETRY_MIN_INTERVAL   50
+
+// Payload offsets
+#define TELEMETRY_SEQ             1  // uint8, incremented with each frame
+#define TELEMETRY_BOARD_STATUS    2  // uint8, as for HOST_CMD_BOARD_STATUS
+#define TELEMETRY_BUILD_STATE     3  // uint8, as for HOST_CMD_GET_BUILD_STATS
+#define TELEMETRY_HEATERS         4  // uint8, TELEMETRY_HEAT_* bits
+#define TELEMETRY_BUILD_PERCENT   5  // uint8, 0-100 or 101 if not yet set
+#define TELEMETRY_TEMPS           6  // 3 x (int16 temp, int16 setpoint):
+                                     //   tool 0, tool 1, platform
+#define TELEMETRY_POSITION       18  // 5 x int32, steps
+#define TELEMETRY_ENDSTOPS       38  // uint8, as for HOST_CMD_GET_POSITION
+#define TELEMETRY_CAPACITY       39  // uint16, free command buffer bytes
+#define TELEMETRY_LINE           41  // uint32, line number of the current
+                                     //   build, or of the last one
+#define TELEMETRY_RX_OVERRUNS    45  // uint16, bytes from the host dropped
+                                     //   since boot, saturating
+#define TELEMETRY_LENGTH         47
+
+// TELEMETRY_HEATERS bits
+#define TELEMETRY_HEAT_TOOL0_READY     0x01
+#define TELEMETRY_HEAT_TOOL1_READY     0x02
+#define TELEMETRY_HEAT_PLATFORM_READY  0x04
+#define TELEMETRY_HEAT_TOOL0_FAILED    0x10
+#define TELEMETRY_HEAT_TOOL1_FAILED    0x20
+#define TELEMETRY_HEAT_PLATFORM_FAILED 0x40
+
+#endif // TELEMETRY_HH_
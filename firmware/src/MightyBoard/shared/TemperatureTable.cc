@@ -16,11 +16,14 @@
  */
 
 #include "TemperatureTable.hh"
-#include "Configuration.hh"
-#include "EepromMap.hh"
-#include <avr/eeprom.h>
 #include <stdint.h>
+#include <math.h>
+#ifndef SIMULATOR
+#include "Configuration.hh"
 #include <avr/pgmspace.h>
+#else
+#include "Simulator.hh"
+#endif
 
 
 // TODO: Clean this up...
@@ -34,210 +37,110 @@
 // r2: 4700
 // beta: 4066
 // max adc: 1023
+//
+// The tables below were breakpoints, searched for the pair either side of
+// a reading.  They now hold values at evenly spaced readings, resampled
+// from those breakpoints by simulator/temptable -p, which also checks them
+// against the breakpoints.  Each is aligned so that a breakpoint, for the
+// thermistors the sharpest bend, falls on a value.  Values are in 1/16ths
+// (TEMP_TABLE_FRAC_BITS).  New thermistor tables may be made with the
+// --step option of createTemperatureLookup.py.
 
 #ifdef MODEL_REPLICATOR
 
-const TempTable default_therm_table PROGMEM = {
-  {1, 841},
-  {54, 255},
-  {107, 209},
-  {160, 184},
-  {213, 166},
-  {266, 153},
-  {319, 142},
-  {372, 132},
-  {425, 124},
-  {478, 116},
-  {531, 108},
-  {584, 101},
-  {637, 93},
-  {690, 86},
-  {743, 78},
-  {796, 70},
-  {849, 61},
-  {902, 50},
-  {955, 34},
-  {1008, 3}
+// Replicator thermistor: from -10, every 16 ADC counts
+static const int16_t therm_values[] PROGMEM = {
+	 15402,  12571,   9741,   6910,   4080,   3858,   3636,   3413,
+	  3261,   3140,   3019,   2911,   2824,   2738,   2652,   2589,
+	  2526,   2464,   2408,   2355,   2302,   2251,   2203,   2154,
+	  2107,   2069,   2030,   1991,   1953,   1914,   1875,   1837,
+	  1798,   1759,   1722,   1688,   1654,   1620,   1582,   1544,
+	  1505,   1469,   1435,   1401,   1366,   1328,   1289,   1250,
+	  1212,   1173,   1134,   1093,   1049,   1006,    959,    906,
+	   853,    800,    723,    645,    568,    441,    291,    142,
+	    -8
 };
 
-#define THERMISTOR_TABLE_NUM_TEMPS 20
-
 #else // MODEL_REPLICATOR2
 
-const TempTable default_therm_table PROGMEM = {
-  {1, 916},
-   {54, 265},
-   {107, 216},
-   {160, 189},
-   {213, 171},
-   {266, 157},
-   {319, 135}, // Temps above 135 will be invalid
-   {372, 127},
-   {425, 119},
-   {478, 112},
-   {531, 104},
-   {584, 98},
-   {637, 91},
-   {690, 84},
-   {743, 77},
-   {796, 68},
-   {849, 58},
-   {902, 48},
-   {955, 34},
-   {1008, 2}
+// Replicator 2 thermistor: from -10, every 16 ADC counts
+static const int16_t therm_values[] PROGMEM = {
+	 16818,  13673,  10529,   7384,   4240,   4003,   3767,   3530,
+	  3366,   3236,   3106,   2991,   2904,   2818,   2732,   2664,
+	  2597,   2529,   2432,   2326,   2220,   2143,   2104,   2066,
+	  2027,   1989,   1950,   1911,   1877,   1843,   1809,   1773,
+	  1734,   1695,   1659,   1630,   1601,   1572,   1538,   1505,
+	  1471,   1437,   1403,   1369,   1336,   1302,   1268,   1234,
+	  1191,   1148,   1104,   1058,   1010,    961,    913,    865,
+	   816,    768,    700,    633,    565,    438,    283,    129,
+	   -26
 };
 
-#define THERMISTOR_TABLE_NUM_TEMPS 20
-
-#endif
-
-// Convert from scaled mV to Celsius (32767 adc-counts/256 mV)
-
-const static Entry thermocouple_lookup[] PROGMEM = {
-{-304, -64},
-{-232, -48},
-{-157, -32},
-{-79, -16},
-{0, 0},
-{82, 16},
-{164, 32},
-{248, 48},
-{333, 64},
-{418, 80},
-{503, 96},
-{588, 112},
-{672, 128},
-{755, 144},
-{837, 160},
-{919, 176},
-{1001, 192},
-{1083, 208},
-{1165, 224},
-{1248, 240},
-{1331, 256},
-{1415, 272},
-{1499, 288},
-{1584, 304},
-{1754, 336},
-#if 0 // cut table off at 336C
-{1840, 352},
-{1926, 368},
-{2012, 384},
-{2099, 400},
-//#define THERMOCOUPLE_NUM_TEMPS 29
 #endif
 
+// Convert from scaled mV to Celsius (32767 adc-counts/256 mV); cut off at 336C
+
+// Thermocouple: from -320, every 32 ADC counts
+static const int16_t thermocouple_values[] PROGMEM = {
+	 -1081,   -967,   -853,   -741,   -631,   -522,   -417,   -312,
+	  -207,   -104,      0,    100,    200,    300,    400,    500,
+	   597,    695,    792,    888,    985,   1081,   1178,   1274,
+	  1370,   1467,   1563,   1659,   1756,   1853,   1950,   2048,
+	  2147,   2245,   2345,   2444,   2544,   2644,   2744,   2844,
+	  2944,   3044,   3144,   3244,   3344,   3444,   3543,   3643,
+	  3741,   3840,   3939,   4037,   4136,   4233,   4331,   4428,
+	  4526,   4623,   4719,   4816,   4912,   5009,   5105,   5201,
+	  5298,   5394
 };
 
-#define THERMOCOUPLE_NUM_TEMPS 25
-
 #ifdef COLDJUNCTION
 
 // Convert cold junction temps to millivolts * 32767 adc-counts / 256 mV
-// This is just the inverse table of thermocouple_table[]
-
-const static Entry coldjunction_lookup[] PROGMEM = {
-// {-64, -304},
-// {-48, -232},
-{-32, -157},
-{-16,  -79},
-{  0,    0},
-{ 16,   81},
-{ 32,  164},
-{ 48,  248},
-{ 64,  333},
-{ 80,  418},
-{ 96,  503},
-{112,  587},
-{128,  671},
-{144,  754},
-#if 0
-{160,  837},
-{176,  919},
-{192, 1000},
-{208, 1082},
-{224, 1164},
-{240, 1247},
-{256, 1330},
-{272, 1414},
-{288, 1499},
-{304, 1583},
-{336, 1754},
-{352, 1840},
-{368, 1926},
-{384, 2012},
-{400, 2098}
-#endif
-};
+// This is just the inverse of thermocouple_values[]
 
-#define COLDJUNCTION_NUM_TEMPS 12
-
-#else
-
-#define COLDJUNCTION_NUM_TEMPS 1
+// Cold junction: from -32, every 16 ADC counts
+static const int16_t coldjunction_values[] PROGMEM = {
+	 -2512,  -1264,      0,   1296,   2624,   3968,   5328,   6688,
+	  8048,   9392,  10736,  12064,  13392
+};
 
 #endif
 
 namespace TemperatureTable {
 
-int8_t num_temps[3] = { THERMISTOR_TABLE_NUM_TEMPS - 1,
-			THERMOCOUPLE_NUM_TEMPS - 1,
-			COLDJUNCTION_NUM_TEMPS - 1 };
-
-/// get value from lookup tables stored in progmem
-/// 
-/// @param[in] entryIdx table entry offset to read
-/// @param[in] table_id  which table to read (valid values defined by therm_table struct)
-/// @return  table Entry, a pair of the format (adc_read, temperature) 
-inline void getEntry(Entry *rv, int8_t entryIdx, int8_t table_id) {
-    if ( table_id == table_thermocouple )
-	memcpy_PF(rv, (uint_farptr_t)&(thermocouple_lookup[entryIdx]), sizeof(Entry));
-#if COLDJUNCTION
-    else if ( table_id == table_coldjunction )
-	memcpy_PF(rv, (uint_farptr_t)&(coldjunction_lookup[entryIdx]), sizeof(Entry));
+static const TempGrid tables[] = {
+	{ 1, 1008, -10, 4, therm_values },
+	{ -304, 1754, -320, 5, thermocouple_values },
+#ifdef COLDJUNCTION
+	{ -32, 144, -32, 4, coldjunction_values },
 #endif
-    else
-	memcpy_PF(rv, (uint_farptr_t)&(default_therm_table[entryIdx]), sizeof(Entry));
-}
+};
 
 /// Translate a temperature reading into degrees Celcius, using the provided lookup table.
 /// @param[in] reading Thermistor/Thermocouple voltage reading, in ADC counts
 /// @param[in] table_idx therm_tables index of the temperature lookup table
 /// @param[in] max_allowed_value default temperature if reading is outside of lookup table
+/// @param[in] extra_bits Bits of the reading beyond those of the table's ADC counts
 /// @return Temperature reading, in degrees Celcius
-float TempReadtoCelsius(int16_t reading, int8_t table_idx, float max_allowed_value) {
-  int8_t bottom = 0;
-  int8_t numtemps = num_temps[table_idx];
-  int8_t top = numtemps;
-  int8_t mid = (bottom+top)/2;
-  Entry e;
-  while (mid > bottom) {
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Winline"
-          getEntry(&e,mid,table_idx);
-	  if (reading < e.adc) {
-		  top = mid;
-		  mid = (bottom+top)/2;
-	  } else {
-		  bottom = mid;
-		  mid = (bottom+top)/2;
-	  }
-  }
-  Entry eb, et;
-  getEntry(&eb,bottom,table_idx);
-  getEntry(&et,top,table_idx);
-#pragma GCC diagnostic pop
-  if (bottom == 0 && reading < eb.adc) {
-	  // out of scale; safety mode
-	  return max_allowed_value;
-  }
-  if (top == numtemps && reading > et.adc) {
+float TempReadtoCelsius(int16_t reading, int8_t table_idx, float max_allowed_value,
+			uint8_t extra_bits) {
+  const TempGrid *t = &tables[table_idx];
+  if (reading < (t->first << extra_bits) || reading > (t->last << extra_bits)) {
 	  // out of scale; safety mode
 	  return max_allowed_value;
   }
 
-  // Interpolate
-  return (float)eb.value + (float)((reading - eb.adc) * (et.value - eb.value)) / (float)(et.adc - eb.adc);
+  // The values either side of the reading
+  uint8_t shift = t->shift + extra_bits;
+  uint16_t offset = (uint16_t)(reading - (t->origin << extra_bits));
+  const int16_t *v = t->values + (offset >> shift);
+  int16_t v0 = (int16_t)pgm_read_word(v);
+  int16_t v1 = (int16_t)pgm_read_word(v + 1);
+
+  // Interpolate; the spacing is a power of two, so there is no division
+  int32_t frac = offset & ((1 << shift) - 1);
+  return ldexp((float)(((int32_t)v0 << shift) + frac * (v1 - v0)),
+	       -(int)(shift + TEMP_TABLE_FRAC_BITS));
 }
 
 }
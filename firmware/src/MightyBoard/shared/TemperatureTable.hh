@@ -18,10 +18,11 @@
 #ifndef THERMISTOR_TABLE
 #define THERMISTOR_TABLE
 
-#define NUMTEMPS 20
-
 #include <stdint.h>
 
+/// Table values are fixed point, with this many fraction bits
+#define TEMP_TABLE_FRAC_BITS 4
+
 namespace TemperatureTable{
 	
 enum therm_tables {
@@ -33,18 +34,23 @@ enum therm_tables {
 /// Translate a temperature reading into degrees Celcius, using the provided lookup table.
 /// @param[in] reading Thermistor/Thermocouple voltage reading, in ADC counts
 /// @param[in] table_idx therm_tables index of the temperature lookup table
+/// @param[in] extra_bits Bits of the reading beyond those of the table's ADC counts
 /// @return Temperature reading, in degrees Celcius
-float TempReadtoCelsius(int16_t reading, int8_t table_idx, float max_allowed_value);
+float TempReadtoCelsius(int16_t reading, int8_t table_idx, float max_allowed_value,
+			uint8_t extra_bits = 0);
 
 }
 
+/// A lookup table holding values at evenly spaced ADC readings, so that
+/// the pair of values either side of a reading is found with a shift
+/// rather than by searching.  Values are interpolated linearly between.
 typedef struct {
-	int16_t adc;
-	int16_t value;
-} Entry;
-
-typedef Entry TempTable[NUMTEMPS];
-
-extern const TempTable default_therm_table;
+	int16_t first;		///< Lowest reading converted, in ADC counts
+	int16_t last;		///< Highest reading converted, in ADC counts
+	int16_t origin;		///< Reading at which values[0] applies
+	uint8_t shift;		///< ADC counts between values, as a power of two
+	const int16_t *values;	///< Values in program memory, TEMP_TABLE_FRAC_BITS fixed point;
+				///< there is one past the interval holding last
+} TempGrid;
 
 #endif // THERMISTOR_TABLE
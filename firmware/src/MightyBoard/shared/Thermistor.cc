@@ -18,7 +18,11 @@
 #include "Thermistor.hh"
 #include "TemperatureTable.hh"
 #include "AnalogPin.hh"
+#ifndef SIMULATOR
 #include <util/atomic.h>
+#else
+#include "Simulator.hh"
+#endif
 
 #define MAX_TEMP 255
 
@@ -30,13 +34,11 @@ struct ThermTableEntry {
 
 Thermistor::Thermistor(uint8_t analog_pin_in, uint8_t table_index_in) :
     analog_pin(analog_pin_in),
+#ifndef ADC_OVERSAMPLE
     raw_valid(false),
-    next_sample(0),
+#endif
     table_index(table_index_in)
 {
-        for (int i = 0; i < SAMPLE_COUNT; i++) {
-            sample_buffer[i] = 0;
-        }
 }
 
 void Thermistor::init() {
@@ -46,6 +48,11 @@ void Thermistor::init() {
 
 Thermistor::SensorState Thermistor::update() {
 	int16_t temp;
+
+#ifdef ADC_OVERSAMPLE
+	// There is always a fresh reading once the first has been made
+	if (!getAnalogReading(analog_pin, &temp)) return SS_ADC_WAITING;
+#else
 	bool valid;
 
 	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
@@ -63,27 +70,16 @@ Thermistor::SensorState Thermistor::update() {
 
 	// If we haven't gotten data yet, return.
 	if (!valid) return SS_ADC_WAITING;
-
-	sample_buffer[next_sample] = temp;
-	next_sample = (next_sample+1) % SAMPLE_COUNT;
-
-	// average
-	int16_t cumulative = 0;
-	for (int i = 0; i < SAMPLE_COUNT; i++) {
-		cumulative += sample_buffer[i];
-	}
+#endif
 
 	// TODO: The raw_value appears to be 0 the first time this loop is run,
 	//       which causes this failsafe to trigger unnecessarily. Disabling
 	//       for now, since it doesn't work for ABP/HBP thermistors.
-	if ((temp > ADC_RANGE - 2) || (temp < 2)) {
+	if ((temp > ADC_RANGE - (2 << ADC_EXTRA_BITS)) || (temp < (2 << ADC_EXTRA_BITS))) {
                 current_temp = BAD_TEMPERATURE + 1;	// Set the temperature to 1024 as an error condition
 		return SS_ERROR_UNPLUGGED;
 	}
 
-	//int16_t avg = cumulative / SAMPLE_COUNT;
-
-	//current_temp = thermistorToCelsius(avg,table_index);
-	current_temp = TemperatureTable::TempReadtoCelsius(temp,table_index,MAX_TEMP);
+	current_temp = TemperatureTable::TempReadtoCelsius(temp,table_index,MAX_TEMP,ADC_EXTRA_BITS);
 	return SS_OK;
 }
@@ -19,22 +19,30 @@
 #define THERMISTOR_HH_
 
 #include "TemperatureSensor.hh"
+#include "AnalogPin.hh"
 
 #define THERM_TABLE_SIZE 20
-#define SAMPLE_COUNT 4
 
 /// The thermistor module provides a driver to read the value of a thermistor connected
 /// to an analog pin, and convert it to a corrected temperature in degress Celcius.
+///
+/// With ADC_OVERSAMPLE defined, the pin is sampled continuously by the ADC's
+/// interrupt and update() converts its latest reading; otherwise update()
+/// converts the sample it started the time before and starts another.
 /// \ingroup SoftwareLibraries
 class Thermistor : public TemperatureSensor {
 private:
         uint8_t analog_pin;                 ///< index of analog pin
+#ifdef ADC_OVERSAMPLE
+        /// Bits of the readings beyond the 10 of the conversion table
+        const static uint8_t ADC_EXTRA_BITS = ADC_READING_BITS - 10;
+#else
         volatile int16_t raw_value;         ///< raw storage for asynchronous analog read
         volatile bool raw_valid;            ///< flag to state if raw_value contains valid data
+        const static uint8_t ADC_EXTRA_BITS = 0;
+#endif
         // TODO: This should come from the ADC!
-        const static int ADC_RANGE = 1024;  ///< Maximum ADC value
-        int16_t sample_buffer[SAMPLE_COUNT];///< Buffer for sampled temperature data
-        uint8_t next_sample;                ///< Index pointing to where the next sample should go in the buffer.
+        const static int ADC_RANGE = 1024 << ADC_EXTRA_BITS;  ///< Maximum ADC value
         const uint8_t table_index;          ///< EEPROM offset where the thermistor conversion table is located.
 
 public:
@@ -16,6 +16,12 @@
  */
 
 #include "Timeout.hh"
+
+#if defined SIMULATOR
+    #include "Simulator.hh"
+
+	inline micros_t getMicros() { return simulatorMicros(); }
+#else
 #include "Configuration.hh"
 
 #if defined IS_EXTRUDER_BOARD
@@ -27,6 +33,7 @@
 
     inline micros_t getMicros() { return Motherboard::getBoard().getCurrentMicros(); }
 #endif
+#endif
 
 Timeout::Timeout() : active(false), elapsed(false) {}
 
@@ -24,6 +24,7 @@
 #include <avr/io.h>
 #include <util/delay.h>
 #include <avr/io.h>
+#include <util/atomic.h>
 
 
 // TODO: There should be a better way to enable this flag?
@@ -39,6 +40,31 @@ const Pin RX_Enable = RX_ENABLE_PIN;
 // them from our receive buffer later.This is only used for RS485 mode.
 volatile uint8_t loopback_bytes = 0;
 
+#ifdef HOST_RX_RING
+// Bytes received from the host and not yet fed to the input packets.  The
+// receive interrupt does no more than store them, which keeps it short
+// enough to keep up with the higher baud rates; the packets are decoded
+// from the main loop.
+//
+// A host keeps no more than HOST_RX_PACKETS packets in flight, so a ring
+// holding that many full packets never fills, however long the main loop
+// stalls and whatever the baud rate.  Bytes arriving with the ring full
+// are dropped, and counted in rx_overruns, which the host may read.
+#if HOST_RX_RING < HOST_RX_PACKETS * (PACKET_BUFFER_SIZE + 3)
+#error HOST_RX_RING must hold HOST_RX_PACKETS full packets
+#endif
+static volatile uint8_t rx_ring[HOST_RX_RING];
+static volatile uint16_t rx_head = 0;
+static volatile uint16_t rx_tail = 0;
+static volatile uint16_t rx_overruns = 0;
+#define RX_RING_MASK (HOST_RX_RING - 1)
+#endif
+
+#ifdef HOST_BAUD_SWITCH
+// UBRR0 value to switch to once the current response has been sent, or 0
+static volatile uint8_t pending_ubrr = 0;
+#endif
+
 // We support three platforms: Atmega168 (1 UART), Atmega644, and Atmega1280/2560
 #if defined (__AVR_ATmega168__)     \
     || defined (__AVR_ATmega328__)  \
@@ -85,7 +111,7 @@ volatile uint8_t loopback_bytes = 0;
 #elif defined (__AVR_ATmega1280__) || defined (__AVR_ATmega2560__)
 
     // Use double-speed mode for more accurate baud rate?
-    #define UBRR0_VALUE 16 // 115200 baud
+    #define UBRR0_VALUE 16 // 115200 baud, HOST_DEFAULT_BAUD
     #define UBRR1_VALUE 51 // 38400 baud
     #define UCSRA_VALUE(uart_) _BV(U2X##uart_)
 
@@ -189,6 +215,11 @@ void UART::beginSend() {
 void UART::enable(bool enabled) {
         enabled_ = enabled;
         if (index_ == 0) {
+#ifdef HOST_RX_RING
+                ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+                        rx_tail = rx_head;
+                }
+#endif
                 if (enabled) { ENABLE_SERIAL_INTERRUPTS(0); }
                 else { DISABLE_SERIAL_INTERRUPTS(0); }
         }
@@ -219,6 +250,64 @@ void UART::reset() {
         }
 }
 
+#ifdef HOST_RX_RING
+
+void UART::processReceived() {
+        uint16_t head, tail = rx_tail;
+        ATOMIC_BLOCK(ATOMIC_FORCEON) {
+                head = rx_head;
+        }
+        while (tail != head) {
+                in.processByte(rx_ring[tail]);
+                tail = (tail + 1) & RX_RING_MASK;
+        }
+        ATOMIC_BLOCK(ATOMIC_FORCEON) {
+                rx_tail = tail;
+        }
+}
+
+uint16_t UART::getRxOverruns() {
+        uint16_t overruns;
+        ATOMIC_BLOCK(ATOMIC_FORCEON) {
+                overruns = rx_overruns;
+        }
+        return overruns;
+}
+
+#endif
+
+#ifdef HOST_BAUD_SWITCH
+
+// UBRR0 value, in double speed mode, for a supported baud rate; 0 if the
+// rate is not supported
+static uint8_t ubrrForBaud(uint32_t baud) {
+        switch (baud) {
+        case 115200:  return UBRR0_VALUE;
+        case 250000:  return 7;
+        case 500000:  return 3;
+        case 1000000: return 1;
+        }
+        return 0;
+}
+
+bool UART::setBaud(uint32_t baud) {
+        uint8_t ubrr = ubrrForBaud(baud);
+        if (ubrr == 0) return false;
+        pending_ubrr = 0;
+        UBRR0H = 0;
+        UBRR0L = ubrr;
+        return true;
+}
+
+bool UART::setBaudAfterSend(uint32_t baud) {
+        uint8_t ubrr = ubrrForBaud(baud);
+        if (ubrr == 0) return false;
+        pending_ubrr = ubrr;
+        return true;
+}
+
+#endif
+
 #if defined (__AVR_ATmega168__) || defined (__AVR_ATmega328__)
 
     // Send and receive interrupts
@@ -234,8 +323,8 @@ void UART::reset() {
 
                     // Workaround for buggy hardware: have slave hold line high.
     #if ASSERT_LINE_FIX
-                    if (UART::getHostUART().in.isFinished()
-                            && (UART::getHostUART().in.read8(0)
+                    if (UART::getHostUART().in.current().isFinished()
+                            && (UART::getHostUART().in.current().read8(0)
                             == ExtruderBoard::getBoard().getSlaveID())) {
                         speak();
                     }
@@ -258,7 +347,18 @@ void UART::reset() {
     // Send and receive interrupts
     ISR(USART0_RX_vect)
     {
+#ifdef HOST_RX_RING
+            uint8_t byte_in = UDR0;
+            uint16_t next = (rx_head + 1) & RX_RING_MASK;
+            if (next != rx_tail) {
+                    rx_ring[rx_head] = byte_in;
+                    rx_head = next;
+            } else if (rx_overruns != 0xFFFF) {
+                    rx_overruns++;
+            }
+#else
             UART::getHostUART().in.processByte( UDR0 );
+#endif
     }
 
     ISR(USART0_TX_vect)
@@ -266,6 +366,13 @@ void UART::reset() {
             if (UART::getHostUART().out.isSending()) {
                     UDR0 = UART::getHostUART().out.getNextByteToSend();
             }
+#ifdef HOST_BAUD_SWITCH
+            // The last byte of the response has left the shift register
+            else if (pending_ubrr) {
+                    UBRR0L = pending_ubrr;
+                    pending_ubrr = 0;
+            }
+#endif
     }
 
     #if HAS_SLAVE_UART
@@ -22,6 +22,15 @@
 #include "Configuration.hh"
 #include <stdint.h>
 
+// Number of packets which may be received ahead of the one being processed,
+// plus one.  See InPacketRing.
+#ifndef HOST_RX_PACKETS
+#define HOST_RX_PACKETS 1
+#endif
+
+// Baud rate the host UART starts at
+#define HOST_DEFAULT_BAUD 115200
+
 // TODO: Move to UART class
 /// Communication mode selection
 enum communication_mode {
@@ -80,7 +89,7 @@ private:
         volatile bool enabled_;             ///< True if the hardware is currently enabled
 
 public:
-        InPacket in;                        ///< Input packet
+        InPacketRing<HOST_RX_PACKETS> in;   ///< Input packets
         OutPacket out;                      ///< Output packet
 
         /// Begin sending the data located in the #out packet.
@@ -93,6 +102,29 @@ public:
         /// Reset the UART to a listening state.  This is important for
         /// RS485-based comms.
         void reset();
+
+#ifdef HOST_RX_RING
+        /// Feed the bytes received from the host so far to the input
+        /// packets.  Call before looking at #in.
+        void processReceived();
+
+        /// Bytes from the host dropped because the receive ring was
+        /// full, since boot.  Stops at 0xFFFF.
+        uint16_t getRxOverruns();
+#endif
+
+#ifdef HOST_BAUD_SWITCH
+        /// Change the host UART's baud rate at once.
+        /// \param[in] baud 115200, 250000, 500000 or 1000000
+        /// \return false if the rate is not supported
+        bool setBaud(uint32_t baud);
+
+        /// Change the host UART's baud rate once the response about to
+        /// be sent has gone out.
+        /// \param[in] baud As for setBaud()
+        /// \return false if the rate is not supported
+        bool setBaudAfterSend(uint32_t baud);
+#endif
 };
 
 #endif // UART_HH_
@@ -94,6 +94,13 @@ const static PROGMEM prog_uchar PLATFORM_TIMEOUT_MSG[] = "Timeout beim heizen "
 const static PROGMEM prog_uchar BUILD_MSG[] =            "Drucke von SD";
 const static PROGMEM prog_uchar PREHEAT_MSG[] =          "Vorheizen";
 const static PROGMEM prog_uchar UTILITIES_MSG[] =        "Utilities";
+const static PROGMEM prog_uchar RESUME_PRINT_MSG[] =     "Druck fortsetzen";
+const static PROGMEM prog_uchar AUTOTUNE_MSG[] =         "PID Autotune";
+const static PROGMEM prog_uchar AUTOTUNE_TEMPS_MSG[] =   "Ziel:     C Ist:   C";
+const static PROGMEM prog_uchar AUTOTUNE_HEATING_MSG[] = "Heize auf Ziel      ";
+const static PROGMEM prog_uchar AUTOTUNE_CYCLE_MSG[] =   "Zyklus              ";
+const static PROGMEM prog_uchar AUTOTUNE_GAINS_MSG[] =   "P      I      D     ";
+const static PROGMEM prog_uchar AUTOTUNE_FAILED_MSG[] =  "Fehlgeschlagen      ";
 const static PROGMEM prog_uchar MONITOR_MSG[] =          "Monitor Modus";
 const static PROGMEM prog_uchar JOG_MSG[]   =            "Manueller Modus";
 const static PROGMEM prog_uchar CALIBRATION_MSG[] =      "Kalibriere Achse";
@@ -94,6 +94,13 @@ const static PROGMEM prog_uchar PLATFORM_TIMEOUT_MSG[] = "I timed out while   at
 const static PROGMEM prog_uchar BUILD_MSG[] =            "Print from SD";
 const static PROGMEM prog_uchar PREHEAT_MSG[] =          "Preheat";
 const static PROGMEM prog_uchar UTILITIES_MSG[] =        "Utilities";
+const static PROGMEM prog_uchar RESUME_PRINT_MSG[] =     "Resume Print";
+const static PROGMEM prog_uchar AUTOTUNE_MSG[] =         "PID Autotune";
+const static PROGMEM prog_uchar AUTOTUNE_TEMPS_MSG[] =   "Target:   C Now:   C";
+const static PROGMEM prog_uchar AUTOTUNE_HEATING_MSG[] = "Heating to target   ";
+const static PROGMEM prog_uchar AUTOTUNE_CYCLE_MSG[] =   "Cycle               ";
+const static PROGMEM prog_uchar AUTOTUNE_GAINS_MSG[] =   "P      I      D     ";
+const static PROGMEM prog_uchar AUTOTUNE_FAILED_MSG[] =  "Tune failed         ";
 const static PROGMEM prog_uchar MONITOR_MSG[] =          "Monitor Mode";
 const static PROGMEM prog_uchar JOG_MSG[]   =            "Jog Mode";
 const static PROGMEM prog_uchar CALIBRATION_MSG[] =      "Calibrate Axes";
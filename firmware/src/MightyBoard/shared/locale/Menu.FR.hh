@@ -92,6 +92,13 @@ const static PROGMEM prog_uchar PLATFORM_TIMEOUT_MSG[] = "I timed out while   at
 const static PROGMEM prog_uchar BUILD_MSG[] =            "Imprimer depuis SD";
 const static PROGMEM prog_uchar PREHEAT_MSG[] =          "Prechauffage";
 const static PROGMEM prog_uchar UTILITIES_MSG[] =        "Utilitaires";
+const static PROGMEM prog_uchar RESUME_PRINT_MSG[] =     "Reprise impression";
+const static PROGMEM prog_uchar AUTOTUNE_MSG[] =         "Reglage PID auto";
+const static PROGMEM prog_uchar AUTOTUNE_TEMPS_MSG[] =   "Cible:    C Act:   C";
+const static PROGMEM prog_uchar AUTOTUNE_HEATING_MSG[] = "Chauffe             ";
+const static PROGMEM prog_uchar AUTOTUNE_CYCLE_MSG[] =   "Cycle               ";
+const static PROGMEM prog_uchar AUTOTUNE_GAINS_MSG[] =   "P      I      D     ";
+const static PROGMEM prog_uchar AUTOTUNE_FAILED_MSG[] =  "Reglage echoue      ";
 const static PROGMEM prog_uchar MONITOR_MSG[] =          "Visu Temp   ";
 const static PROGMEM prog_uchar JOG_MSG[]   =            "Mode Manuel";
 const static PROGMEM prog_uchar CALIBRATION_MSG[] =      "Calibration des axes";